@@ -17,6 +17,11 @@
 
 /* User interface */
 #define UI_LED_MAX_BRIGHT 7             // Max LED DIsplay brightness (for TM1637: 0-7)
+#define UI_REFRESH_PERIOD_MS 1000       // Period of the main loop posting the latest sample to the display
+#define UI_FRAME_PERIOD_MS 20           // Period of the display task (50 Hz), animation timing in ui_timing.h
+#define UI_TASK_STACK_SIZE 3072         // Stack of the display task
+#define UI_TASK_PRIORITY 3              // Priority of the display task (above app_main and the fetch task)
+#define UI_TM1637_BIT_DELAY_US 3        // Delay after each TM1637 bus edge (down to 1 us on short wires if no NACKs are counted)
 #define BUTTON_DEBOUNCE_MIN_COUNT 10    // Stable output counter min value for debounced output
 
 /* WiFi */
@@ -28,7 +33,106 @@
 #define WEB_PORT "443"                          // Web port (443 for SSL)
 #define WEB_URL "https://extranet.nationalgrid.com/Realtime/Home/SystemData"    // URL with freq data 
 #define HTTP_BUFFER_SIZE 2048       // Size of the buffer for HTTP response message (with HTML file)
-#define TEMP_BUFFER_SIZE 30         // Temporary buffer size (for searching Frequency data)
+#define HTTP_LINE_MAX_LEN 256       // Max stored length of an HTTP status/header line (longer lines are truncated)
+#define HTTP_REQUEST_MAX_LEN 512    // Size of the buffer for the HTTP request
+#define HTTP_VALIDATOR_MAX_LEN 80   // Max length of a stored ETag / Last-Modified value
+#define FETCH_CONDITIONAL_GET 1     // Send If-None-Match / If-Modified-Since with the stored validators
+#define HTTP_ACCEPT_COMPRESSION 1   // Accept gzip / deflate encoded responses (~43 kB of heap: the inflate window and
+                                    // state, allocated on the first compressed response and kept until reboot)
+                                    // With FETCH_RANGE_MODE only full fetches (the first poll and range fallbacks)
+                                    // are compressed: a range request asks for identity bytes
+#define HTTP_INFLATE_WINDOW_SIZE 32768  // Inflate window size (power of two, min. 32 kB deflate dictionary)
+#define FREQ_MARKER "Freq"          // Marker preceding the frequency value in the HTTP response
+#define FREQ_VALUE_OFFSET 11        // Bytes from the first marker character to the frequency value window
+#define FREQ_VALUE_WINDOW 29        // Size of the frequency value window (leading whitespace is skipped)
+#define FREQ_VALUE_SCALE 2          // Fractional digits of the frequency kept as a scaled integer (4999 = 49.99 Hz)
+#define FREQ_VALUE_ROUNDING DECIMAL_ROUND_HALF_UP    // Rounding of the remaining digits (see decimal_parser.h)
+#define FREQ_JSON_PATH "data.items[0].freq"    // Path to the frequency value in a JSON response
+
+/* Server certificate verification (TLS_TRUST_MODE), a failed verification aborts the handshake */
+#define TLS_TRUST_BUNDLE 0          // Search the ESP x509 certificate bundle (whole bundle kept in flash)
+#define TLS_TRUST_CA 1              // Verify against the CA certificates in TLS_TRUST_CA_PEM (parsed once at init)
+#define TLS_TRUST_PIN 2             // The key pinned by TLS_TRUST_PIN_SHA256 is the only trust anchor (leaf or issuer)
+#define TLS_TRUST_MODE TLS_TRUST_BUNDLE
+#define TLS_TRUST_CA_PEM ""         // PEM-encoded CA certificate(s) of the server (TLS_TRUST_CA)
+#define TLS_TRUST_PIN_SHA256 ""     // Hex SHA-256 of the pinned SubjectPublicKeyInfo (TLS_TRUST_PIN), e.g. from
+                                    // openssl x509 -pubkey -noout | openssl pkey -pubin -outform der | sha256sum
+
+/* TLS profile (TLS_PROFILE) */
+#define TLS_PROFILE_DEFAULT 0       // mbedtls defaults (all enabled ciphersuites and curves, 16 kB records)
+#define TLS_PROFILE_LOW_MEMORY 1    // Max fragment length, short ECDHE / AES-GCM ciphersuite and curve lists
+#define TLS_PROFILE TLS_PROFILE_DEFAULT
+#define TLS_MAX_FRAGMENT_LEN 4096   // Record size asked for in TLS_PROFILE_LOW_MEMORY (512, 1024, 2048 or 4096)
+
+/* mbedtls arena (fetch-task allocations of the TLS stack come from one region to avoid fragmenting the heap) */
+#define TLS_ARENA_SIZE 24576        // Size of the region reserved at init (0 to use the heap directly)
+#define TLS_ARENA_MAX_BLOCK 4096    // Larger allocations (record buffers) are left to the heap
+
+/* Format of a source page (DATA_SOURCE_FORMAT for the grid frequency source) */
+#define SOURCE_FORMAT_HTML 0        // Values follow text markers (e.g. FREQ_MARKER)
+#define SOURCE_FORMAT_JSON 1        // Values are addressed by JSON paths (e.g. FREQ_JSON_PATH)
+#define DATA_SOURCE_FORMAT SOURCE_FORMAT_HTML   // Format of the grid frequency source
+
+/* Early termination of the response read (FETCH_EARLY_STOP) */
+#define EARLY_STOP_OFF 0            // Always read the whole response
+#define EARLY_STOP_CLOSE 1          // Close the connection as soon as all values are extracted
+#define EARLY_STOP_DRAIN 2          // Read the rest without parsing to keep the connection alive
+#define FETCH_EARLY_STOP EARLY_STOP_DRAIN   // Selected early termination mode
+#define FETCH_DRAIN_MAX_BYTES 8192  // In drain mode: close instead if more bytes are left to read
+#define FETCH_RANGE_MODE 1          // Request only a byte range around the last known value offset (0 to disable)
+                                    // Ranges are sent without Accept-Encoding, so HTTP_ACCEPT_COMPRESSION then only
+                                    // helps full fetches: ~800 identity bytes per poll instead of the compressed page.
+                                    // Keep the decoder off if the server honours ranges and the heap is short
+#define FETCH_RANGE_MARGIN 256      // Bytes requested before and after the expected value window
+
+/* Fetch deadlines (a phase that overruns its limit aborts the fetch with ESP_ERR_TIMEOUT) */
+#define FETCH_CONNECT_TIMEOUT_MS 5000       // DNS lookup and TCP connect
+#define FETCH_HANDSHAKE_TIMEOUT_MS 10000    // TLS handshake
+#define FETCH_WRITE_TIMEOUT_MS 5000         // Sending the request
+#define FETCH_FIRST_BYTE_TIMEOUT_MS 10000   // From the request sent to the first byte of the response
+#define FETCH_TOTAL_TIMEOUT_MS 30000        // Whole fetch, including reconnects and the range fallback
+#define FETCH_HISTOGRAM_LOG_EVERY 10        // Print the latency histograms every N fetches (0 to disable)
+
+/* DNS cache */
+#define DNS_CACHE_ENTRIES 4             // Number of cached host names
+#define DNS_CACHE_TTL_S 300             // Lifetime of a resolved address (getaddrinfo does not report the record TTL)
+#define DNS_CACHE_PREFETCH_S 30         // Resolve again in the background this long before the entry expires
+#define DNS_CACHE_STALE_MAX_S 86400     // Keep using an expired address this long if resolution fails
+#define DNS_CACHE_TASK_STACK_SIZE 3072  // Stack of the prefetch task
+
+/* Fetch task */
+#define FETCH_PERIOD_MS 60000       // Poll period of the grid source, measured from the start of one fetch to the start of the next
+#define FETCH_MAX_SOURCES 4         // Max number of sources run by the fetch scheduler
+#define FETCH_MAX_TLS_SESSIONS 1    // Max number of TLS connections kept open at once (each holds ~20 kB of record buffers)
+#define FETCH_TASK_STACK_SIZE 8192  // Stack of the fetch task (TLS handshake included)
+#define FETCH_TASK_PRIORITY 1       // Priority of the fetch task (same as app_main, time-sliced with the display loop)
+
+/* Adaptive polling (FETCH_ADAPTIVE) */
+#define FETCH_ADAPTIVE 1                // Adapt the interval of each source to how fast its values change and to Cache-Control max-age
+#define FETCH_INTERVAL_MIN_MS 10000     // Shortest poll interval of the grid source (values changing quickly)
+#define FETCH_INTERVAL_MAX_MS 300000    // Longest poll interval of the grid source (stable values or long max-age)
+#define FETCH_VOLATILITY_HIGH 5         // Change between polls halving the interval [scaled units, e.g. 0.01 Hz]
+#define FETCH_VOLATILITY_LOW 2          // Change between polls below which the interval grows by half [scaled units]
+#define FETCH_VOLATILITY_SHIFT 1        // Smoothing of the change (EWMA weight of a new sample is 1/2^shift, 0 to 8)
+
+/* Push updates over MQTT (FETCH_PUSH) */
+#define FETCH_PUSH 0                    // Subscribe to the topic of each source and poll only while its messages arrive
+#define FETCH_PUSH_URI "mqtts://broker.example.com:8883"    // Broker (mqtt:// for a local test broker without TLS)
+#define FETCH_PUSH_TOPIC "grid/freq"    // Topic publishing the grid frequency document (same format as DATA_SOURCE_FORMAT)
+#define FETCH_PUSH_KEEPALIVE_S 60       // MQTT keep-alive (a dead connection is detected after 1.5x this time)
+#define FETCH_PUSH_PAYLOAD_MAX 512      // Max message size (longer messages are dropped)
+#define FETCH_PUSH_QUEUE_LEN 4          // Messages waiting for the fetch task (further messages are dropped)
+#define FETCH_PUSH_STALE_INTERVALS 2    // A subscribed source silent for this many poll intervals is polled again
+
+/* Local fan-out over UDP multicast (FETCH_FANOUT) */
+#define FETCH_FANOUT 0                  // Only the elected device fetches, the others receive its samples over the LAN
+#define FANOUT_GROUP "239.255.70.70"    // Multicast group (administratively scoped)
+#define FANOUT_PORT 47070               // UDP port
+#define FANOUT_KEY "change-this-site-key"   // Pre-shared HMAC-SHA256 key of the site (packets signed with another key are dropped)
+#define FANOUT_HELLO_MS 5000            // Presence announcement period
+#define FANOUT_LEADER_TIMEOUT_MS 15000  // A device not heard this long is dropped (leader failover)
+#define FANOUT_MAX_PEERS 16             // Max number of devices tracked
+#define FANOUT_TASK_STACK_SIZE 4096     // Stack of the fan-out task
 
 /* WiFi Provisioning */
 #define PROV_MGR_MAX_RETRY_CNT 5    // Max number of provisioning retries before resetting Prov Mgr
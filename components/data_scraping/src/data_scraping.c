@@ -6,12 +6,19 @@
 
 #include "data_scraping.h"
 
+#include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if TLS_TRUST_MODE == TLS_TRUST_BUNDLE
 #include "esp_crt_bundle.h"
+#endif
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "lwip/sockets.h"
 #include "mbedtls/certs.h"
 #include "mbedtls/ctr_drbg.h"
 #include "mbedtls/entropy.h"
@@ -20,151 +27,995 @@
 #include "mbedtls/net_sockets.h"
 #include "mbedtls/platform.h"
 #include "mbedtls/ssl.h"
+#include "dns_cache.h"
+#include "http_exchange.h"
+#include "tls_arena.h"
+#include "tls_pin.h"
 
 #define TAG "data_scraping"
 
-mbedtls_ssl_context ssl;            // SSL/TLS context
-mbedtls_net_context server_fd;      // Network context
+/* Connection to a server (one per host, up to FETCH_MAX_TLS_SESSIONS) */
+typedef struct {
+    mbedtls_ssl_context ssl;            // SSL/TLS context
+    mbedtls_net_context server_fd;      // Network context
+    mbedtls_ssl_session saved_session;  // Last negotiated TLS session (for session-ID/ticket resumption)
+    bool session_saved;                 // saved_session holds a resumable session
+    bool connected;                     // Keep-alive connection to the server is open
+    const char *host;                   // Server the context is bound to (NULL if unused)
+    const char *port;                   // Server port
+    int64_t last_used_us;               // Time of the last request (least recently used one is replaced)
+} data_scraping_conn_t;
+
 mbedtls_entropy_context entropy;    // Context for entropy source
 mbedtls_ctr_drbg_context ctr_drbg;  // Context for deterministic random bit generator
-mbedtls_x509_crt cacert;            // Certificate structure
-mbedtls_ssl_config conf;            // SSL/TLS configuration structure
+mbedtls_x509_crt cacert;            // Trusted CA certificates (TLS_TRUST_CA)
+mbedtls_ssl_config conf;            // SSL/TLS configuration structure (shared by all connections)
+static data_scraping_conn_t conns[FETCH_MAX_TLS_SESSIONS];  // Connection pool
+static data_scraping_conn_t *conn = NULL;                   // Connection used by the current fetch
+static http_exchange_cache_t caches[FETCH_MAX_SOURCES];     // Per-source state
+static http_exchange_cache_t *cache = NULL;                 // State of the source of the current fetch
+static const data_scraping_source_t *source = NULL;         // Source of the current fetch
+static http_exchange_t exchange;      // Request / response handling and the extractors (keep their state across chunks)
+static http_decoder_t decoder;        // gzip / deflate decoder (fixed window allocated on the first compressed response)
+static bool decoder_ready = false;    // Compressed responses are accepted (until the window cannot be allocated)
+static data_scraping_stats_t stats;   // Connection reuse and session resumption counters
+static data_scraping_fetch_t fetch;   // Measurements of the current (or last) fetch
+
+static data_scraping_phase_t phase = DATA_SCRAPING_PHASE_NONE;  // Current phase of the fetch
+static int64_t phase_deadline_us;     // Deadline of the current phase
+static int64_t total_deadline_us;     // Deadline of the whole fetch
+
+#if TLS_TRUST_MODE == TLS_TRUST_PIN
+static tls_pin_t pin;                 // Pinned key and the verdict of the current handshake
+#endif
+
+static size_t heap_free_start;        // Free internal heap at the start of the fetch
+static size_t heap_free_min;          // Least free internal heap seen during the fetch
+
+static latency_histogram_t histograms[DATA_SCRAPING_TIMING_COUNT];  // Latency of each timed part across fetches
+
+/* Ciphersuites offered in TLS_PROFILE_LOW_MEMORY (ECDHE with AES-GCM, accelerated by the AES hardware) */
+static const int LOW_MEMORY_CIPHERSUITES[] = {
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+    MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384,
+    MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384,
+    0
+};
 
-static const char *REQUEST = "GET " WEB_URL
-                             " HTTP/1.0\r\n"
-                             "Host: " WEB_SERVER
-                             "\r\n"
-                             "User-Agent: esp-idf/1.0 esp32\r\n"
-                             "\r\n";
+/* Curves offered in TLS_PROFILE_LOW_MEMORY (also restricts the curve of an ECDSA server key) */
+static const mbedtls_ecp_group_id LOW_MEMORY_CURVES[] = {
+    MBEDTLS_ECP_DP_SECP256R1,
+    MBEDTLS_ECP_DP_SECP384R1,
+    MBEDTLS_ECP_DP_NONE
+};
+
+/* Keys extracted from the page, indexed by data_scraping_value_t */
+static const stream_extractor_key_t KEYS[DATA_SCRAPING_VALUE_COUNT] = {
+    [DATA_SCRAPING_FREQ] = {"freq", FREQ_MARKER, STREAM_RULE_OFFSET, FREQ_VALUE_OFFSET, FREQ_VALUE_WINDOW, '\0',
+                            FREQ_VALUE_SCALE, FREQ_VALUE_ROUNDING},
+};
+
+/* Paths of the values in a JSON document, indexed by data_scraping_value_t */
+static const json_extractor_path_t JSON_PATHS[DATA_SCRAPING_VALUE_COUNT] = {
+    [DATA_SCRAPING_FREQ] = {"freq", FREQ_JSON_PATH, FREQ_VALUE_SCALE, FREQ_VALUE_ROUNDING},
+};
+
+/* Sources polled by the fetch scheduler, indexed by data_scraping_source_id_t */
+static const data_scraping_source_t SOURCES[DATA_SCRAPING_SOURCE_COUNT] = {
+    [DATA_SCRAPING_SOURCE_GRID] = {"grid", WEB_SERVER, WEB_PORT, WEB_URL, DATA_SOURCE_FORMAT, KEYS, JSON_PATHS,
+                                   DATA_SCRAPING_VALUE_COUNT, FETCH_PERIOD_MS, FETCH_INTERVAL_MIN_MS,
+                                   FETCH_INTERVAL_MAX_MS, 0, FETCH_PUSH_TOPIC},
+};
+
+_Static_assert(DATA_SCRAPING_MAX_VALUES <= STREAM_EXTRACTOR_MAX_KEYS &&
+                   DATA_SCRAPING_MAX_VALUES <= JSON_EXTRACTOR_MAX_PATHS,
+               "Too many values for the extractors");
+_Static_assert(DATA_SCRAPING_VALUE_COUNT <= DATA_SCRAPING_MAX_VALUES, "Too many values in the grid source");
+_Static_assert(DATA_SCRAPING_SOURCE_COUNT <= FETCH_MAX_SOURCES, "Too many sources");
 
 /**
- * @brief Extracts frequency data from a response string.
+ * @brief Enter the next phase of the fetch and arm its deadline.
  *
- * @param response       The response string to search for the frequency data.
- * @param response_size  The size of the response buffer.
- * @param freq           Pointer to a float variable where the extracted frequency will be stored.
+ * @param next     Phase being entered.
+ * @param limit_ms Time limit of the phase (0 if bounded only by the total deadline).
+ */
+static void data_scraping_phase_begin(data_scraping_phase_t next, int32_t limit_ms) {
+    phase = next;
+    phase_deadline_us = (limit_ms > 0) ? esp_timer_get_time() + (int64_t)limit_ms * 1000 : INT64_MAX;
+}
+
+/**
+ * @brief Get the time left until the earlier of the phase and the total deadline.
  *
- * @return ESP_OK if the frequency data is successfully extracted.
- * ESP_ERR_INVALID_ARG if `response` is NULL or `buffer_size` is 0.
+ * @return Remaining time in ms (rounded up), 0 if a deadline has passed.
  */
-static esp_err_t extract_freq_data(char *response, size_t response_size, float* freq) {
-    char temp_buff[TEMP_BUFFER_SIZE];
-    if (response == NULL || freq == NULL) {
-        return ESP_ERR_INVALID_ARG;
-    } else if (response_size == 0) {
-        return ESP_ERR_INVALID_SIZE;
+static uint32_t data_scraping_timeout_ms(void) {
+    int64_t deadline = (phase_deadline_us < total_deadline_us) ? phase_deadline_us : total_deadline_us;
+    int64_t remaining = deadline - esp_timer_get_time();
+    return (remaining > 0) ? (uint32_t)((remaining + 999) / 1000) : 0;
+}
+
+/**
+ * @brief Record that the current phase overran its deadline.
+ *
+ * @return ESP_ERR_TIMEOUT.
+ */
+static esp_err_t data_scraping_timeout(void) {
+    data_scraping_phase_t overran = (total_deadline_us <= phase_deadline_us) ? DATA_SCRAPING_PHASE_TOTAL : phase;
+
+    ESP_LOGE(TAG, "Timeout: %s deadline exceeded during the %s phase",
+             data_scraping_phase_name(overran), data_scraping_phase_name(phase));
+    fetch.timeout_phase = overran;
+    stats.timeouts++;
+    return ESP_ERR_TIMEOUT;
+}
+
+/**
+ * @brief Record the duration of a timed part of the fetch.
+ *
+ * @param timing   Timed part.
+ * @param start_us Timestamp of its start (esp_timer_get_time).
+ */
+static void data_scraping_record(data_scraping_timing_t timing, int64_t start_us) {
+    int64_t us = esp_timer_get_time() - start_us;
+
+    fetch.timings_us[timing] = us;
+    latency_histogram_add(&histograms[timing], us);
+}
+
+/**
+ * @brief Sample the free internal heap to track the peak usage of the fetch.
+ */
+static void data_scraping_heap_sample(void) {
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    if (free_bytes < heap_free_min) {
+        heap_free_min = free_bytes;
     }
+}
 
-    char* r = response;
-    for(int i = 0; i < (response_size-11-TEMP_BUFFER_SIZE); i++){
-        if((*(r+i) == 'F') && (*(r+i+1) == 'r' ) && (*(r+i+2) == 'e') && (*(r+i+3) == 'q')) {
-            memcpy(temp_buff, (r+i+11), (size_t) (TEMP_BUFFER_SIZE-1));
-            ESP_LOGD(TAG, "Freq data coppied to temp buffer: %s", temp_buff);
-            sscanf(temp_buff, " %f", freq);
-            break;
+/**
+ * @brief Bound blocking sends (request, handshake messages) by the remaining time of the current phase.
+ *
+ * @param timeout_ms Send timeout in ms. Must not be 0 (which would disable the timeout).
+ */
+static void data_scraping_set_send_timeout(uint32_t timeout_ms) {
+    struct timeval tv = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+    setsockopt(conn->server_fd.fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * @brief Reset the mbedtls context and free network resources (the saved session is kept for resumption).
+ */
+static void mbedtls_reset(void) {
+    tls_arena_bypass(true);     // Structures allocated by the reset for the next handshake stay on the heap
+    mbedtls_ssl_session_reset(&conn->ssl);
+    tls_arena_bypass(false);
+    mbedtls_net_free(&conn->server_fd);
+    tls_arena_reset();  // Every arena block belonged to the closed connection (counted in the resets of the stats)
+    conn->connected = false;
+}
+
+/**
+ * @brief Close the connection to the server.
+ *
+ * @param notify Send close_notify alert before closing the socket.
+ */
+static void data_scraping_disconnect(bool notify) {
+    if (conn->connected && notify) {
+        mbedtls_ssl_close_notify(&conn->ssl);
+    }
+    mbedtls_reset();
+}
+
+/**
+ * @brief Check if the idle keep-alive connection is still usable.
+ *
+ * An idle connection should have nothing to read. Readable data (close_notify alert, FIN or RST)
+ * means that the server has closed it in the meantime.
+ *
+ * @return true if the connection can be reused, false otherwise.
+ */
+static bool data_scraping_connection_alive(void) {
+    int ret = mbedtls_net_poll(&conn->server_fd, MBEDTLS_NET_POLL_READ, 0);
+    return ret == 0;
+}
+
+/**
+ * @brief Open a TCP connection to the server without blocking past the connect deadline.
+ *
+ * The address comes from the DNS cache, so most connects skip the DNS round trip.
+ * mbedtls_net_connect blocks in connect() until the TCP stack gives up, so the socket is connected
+ * in non-blocking mode and the completion is awaited with select(). The socket is switched back to
+ * blocking mode afterwards (reads and writes are bounded by timeouts).
+ *
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the deadline passed, ESP_FAIL otherwise.
+ */
+static esp_err_t data_scraping_tcp_connect(void) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    esp_err_t err;
+    int ret;
+
+    int64_t start_us = esp_timer_get_time();
+    if ((err = dns_cache_resolve(conn->host, conn->port, &addr, &addr_len)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to resolve %s (%s)", conn->host, esp_err_to_name(err));
+        return (data_scraping_timeout_ms() == 0) ? data_scraping_timeout() : ESP_FAIL;
+    }
+    data_scraping_record(DATA_SCRAPING_TIMING_DNS, start_us);
+
+    start_us = esp_timer_get_time();
+    conn->server_fd.fd = socket(addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (conn->server_fd.fd < 0) {
+        ESP_LOGE(TAG, "Failed to create a socket (errno %d)", errno);
+        return ESP_FAIL;
+    }
+
+    mbedtls_net_set_nonblock(&conn->server_fd);
+    if (connect(conn->server_fd.fd, (struct sockaddr *)&addr, addr_len) != 0) {
+        if (errno != EINPROGRESS) {
+            ESP_LOGW(TAG, "Connecting to %s failed (errno %d)", conn->host, errno);
+            mbedtls_net_free(&conn->server_fd);
+            dns_cache_expire(conn->host);   // Resolve again on the next attempt
+            return ESP_FAIL;
+        }
+
+        /* Wait until the socket becomes writable (connected or failed) or the deadline passes */
+        uint32_t timeout_ms = data_scraping_timeout_ms();
+        struct timeval tv = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+        fd_set write_fds;
+        FD_ZERO(&write_fds);
+        FD_SET(conn->server_fd.fd, &write_fds);
+        ret = (timeout_ms > 0) ? select(conn->server_fd.fd + 1, NULL, &write_fds, NULL, &tv) : 0;
+
+        int so_error = 0;
+        socklen_t so_error_len = sizeof(so_error);
+        if (ret == 0) {
+            mbedtls_net_free(&conn->server_fd);
+            return data_scraping_timeout();
+        } else if (ret < 0 || getsockopt(conn->server_fd.fd, SOL_SOCKET, SO_ERROR, &so_error, &so_error_len) != 0 ||
+                   so_error != 0) {
+            ESP_LOGW(TAG, "Connecting to %s failed (errno %d)", conn->host, (ret < 0) ? errno : so_error);
+            mbedtls_net_free(&conn->server_fd);
+            dns_cache_expire(conn->host);
+            return ESP_FAIL;
         }
     }
+    mbedtls_net_set_block(&conn->server_fd);
+
+    data_scraping_record(DATA_SCRAPING_TIMING_TCP, start_us);
     return ESP_OK;
 }
 
 /**
- * @brief Reset the mbedtls context and free network resources.
+ * @brief Set up verification of the server certificate according to TLS_TRUST_MODE.
+ *
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the configured CA set or pin is malformed, ESP_FAIL otherwise.
  */
-static void mbedtls_reset(void) {
-    mbedtls_ssl_session_reset(&ssl);
-    mbedtls_net_free(&server_fd);
+static esp_err_t data_scraping_trust_init(void) {
+#if TLS_TRUST_MODE == TLS_TRUST_BUNDLE
+    int ret;
+
+    ESP_LOGI(TAG, "Attaching the certificate bundle...");
+    if ((ret = esp_crt_bundle_attach(&conf)) != ESP_OK) {  // Attach the certificate bundle
+        ESP_LOGE(TAG, "esp_crt_bundle_attach returned -0x%x", -ret);
+        return ESP_FAIL;
+    }
+#elif TLS_TRUST_MODE == TLS_TRUST_CA
+    int ret;
+
+    ESP_LOGI(TAG, "Loading the CA certificates...");
+    if ((ret = mbedtls_x509_crt_parse(&cacert, (const unsigned char *)TLS_TRUST_CA_PEM,
+                                      sizeof(TLS_TRUST_CA_PEM))) != 0) {  // PEM length includes the terminator
+        ESP_LOGE(TAG, "mbedtls_x509_crt_parse returned -0x%x", -ret);
+        return ESP_ERR_INVALID_ARG;
+    }
+#elif TLS_TRUST_MODE == TLS_TRUST_PIN
+    ESP_LOGI(TAG, "Pinning the server key...");
+    if (tls_pin_init(&pin, TLS_TRUST_PIN_SHA256) != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid TLS_TRUST_PIN_SHA256");
+        return ESP_ERR_INVALID_ARG;
+    }
+    mbedtls_ssl_conf_verify(&conf, tls_pin_verify, &pin);
+#else
+#error "Unknown TLS_TRUST_MODE"
+#endif
+
+#if TLS_TRUST_MODE == TLS_TRUST_PIN
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_OPTIONAL);      // Verdict of the pin checked after the handshake
+#else
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);      // Abort the handshake if verification fails
+#endif
+    mbedtls_ssl_conf_ca_chain(&conf, &cacert, NULL);                    // Set CA chain
+    return ESP_OK;
 }
 
 /**
- * @brief Get frequency data by establishing an SSL/TLS connection with the server and sending an HTTP request.
+ * @brief Apply TLS_PROFILE to the SSL/TLS configuration.
+ *
+ * TLS_PROFILE_LOW_MEMORY asks the server for records of at most TLS_MAX_FRAGMENT_LEN bytes (with
+ * CONFIG_MBEDTLS_SSL_VARIABLE_BUFFER_LENGTH the record buffers shrink once it is accepted) and offers
+ * only a few ECDHE / AES-GCM suites and curves, which keeps the handshake state small.
+ *
+ * @return ESP_OK on success, ESP_FAIL otherwise.
  */
-esp_err_t data_scraping_get_freq(float* freq) {
-    esp_err_t err = ESP_OK;
-    int ret, flags, len;
-    char buf[HTTP_BUFFER_SIZE];
+static esp_err_t data_scraping_tls_profile(void) {
+    if (TLS_PROFILE != TLS_PROFILE_LOW_MEMORY) {
+        return ESP_OK;
+    }
 
-    mbedtls_net_init(&server_fd);   // Initialize network context
-    ESP_LOGI(TAG, "Connecting to %s:%s...", WEB_SERVER, WEB_PORT);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    int ret;
+    unsigned char mfl_code = (TLS_MAX_FRAGMENT_LEN <= 512)    ? MBEDTLS_SSL_MAX_FRAG_LEN_512
+                             : (TLS_MAX_FRAGMENT_LEN <= 1024) ? MBEDTLS_SSL_MAX_FRAG_LEN_1024
+                             : (TLS_MAX_FRAGMENT_LEN <= 2048) ? MBEDTLS_SSL_MAX_FRAG_LEN_2048
+                                                              : MBEDTLS_SSL_MAX_FRAG_LEN_4096;
+    if ((ret = mbedtls_ssl_conf_max_frag_len(&conf, mfl_code)) != 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_conf_max_frag_len returned -0x%x", -ret);
+        return ESP_FAIL;
+    }
+#else
+    ESP_LOGW(TAG, "MBEDTLS_SSL_MAX_FRAGMENT_LENGTH disabled, records of up to 16 kB");
+#endif
+    mbedtls_ssl_conf_ciphersuites(&conf, LOW_MEMORY_CIPHERSUITES);
+    mbedtls_ssl_conf_curves(&conf, LOW_MEMORY_CURVES);
+    ESP_LOGI(TAG, "Using the low-memory TLS profile");
+    return ESP_OK;
+}
+
+/**
+ * @brief Establish TCP connection and perform the SSL/TLS handshake, resuming the saved session if possible.
+ *
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the connect or handshake deadline passed, ESP_FAIL otherwise.
+ */
+static esp_err_t data_scraping_connect(void) {
+    esp_err_t err;
+    int ret;
+    bool full_handshake = false;
 
-    if ((ret = mbedtls_net_connect(&server_fd, WEB_SERVER,
-                                   WEB_PORT, MBEDTLS_NET_PROTO_TCP)) != 0) {
-        ESP_LOGE(TAG, "mbedtls_net_connect returned -%x", -ret);
+    ESP_LOGI(TAG, "Connecting to %s:%s...", conn->host, conn->port);
+    data_scraping_phase_begin(DATA_SCRAPING_PHASE_CONNECT, FETCH_CONNECT_TIMEOUT_MS);
+    if ((err = data_scraping_tcp_connect()) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to connect to %s:%s", conn->host, conn->port);
         mbedtls_reset();
-        return ESP_FAIL;
+        return err;
     } else {
         ESP_LOGI(TAG, "Connected.");
     }
 
-    mbedtls_ssl_set_bio(&ssl, &server_fd, mbedtls_net_send, mbedtls_net_recv, NULL);
+    /* Reads time out after conf.read_timeout, which is set to the remaining time before each blocking call */
+    mbedtls_ssl_set_bio(&conn->ssl, &conn->server_fd, mbedtls_net_send, NULL, mbedtls_net_recv_timeout);
+    stats.connections++;
+
+    if (conn->session_saved) {
+        if ((ret = mbedtls_ssl_set_session(&conn->ssl, &conn->saved_session)) != 0) {
+            ESP_LOGW(TAG, "mbedtls_ssl_set_session returned -0x%x", -ret);
+        } else {
+            ESP_LOGI(TAG, "Attempting to resume the previous TLS session");
+            stats.resumption_attempts++;
+        }
+    }
 
+    /* Step through the handshake to find out if the server certificate had to be sent (full handshake) */
     ESP_LOGI(TAG, "Performing the SSL/TLS handshake...");
-    while ((ret = mbedtls_ssl_handshake(&ssl)) != 0) {
-        if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+    data_scraping_phase_begin(DATA_SCRAPING_PHASE_HANDSHAKE, FETCH_HANDSHAKE_TIMEOUT_MS);
+    int64_t start_us = esp_timer_get_time();
+#if TLS_TRUST_MODE == TLS_TRUST_PIN
+    tls_pin_begin(&pin);
+#endif
+    while (conn->ssl.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        uint32_t timeout_ms = data_scraping_timeout_ms();
+        if (timeout_ms == 0) {
+            mbedtls_reset();
+            return data_scraping_timeout();
+        }
+        mbedtls_ssl_conf_read_timeout(&conf, timeout_ms);
+        data_scraping_set_send_timeout(timeout_ms);
+
+        if (conn->ssl.state == MBEDTLS_SSL_SERVER_CERTIFICATE) {
+            full_handshake = true;
+        }
+        ret = mbedtls_ssl_handshake_step(&conn->ssl);
+        data_scraping_heap_sample();
+        if (ret == MBEDTLS_ERR_SSL_TIMEOUT) {
+            mbedtls_reset();
+            return data_scraping_timeout();
+        } else if (ret != 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
             ESP_LOGE(TAG, "mbedtls_ssl_handshake returned -0x%x", -ret);
+            if (ret == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED) {
+                char info[128];
+                mbedtls_x509_crt_verify_info(info, sizeof(info), "", mbedtls_ssl_get_verify_result(&conn->ssl));
+                ESP_LOGE(TAG, "Server certificate rejected: %s", info);
+            }
             mbedtls_reset();
-            return ESP_FAIL;
+            return (data_scraping_timeout_ms() == 0) ? data_scraping_timeout() : ESP_FAIL;
         }
     }
 
-    ESP_LOGI(TAG, "Verifying peer X.509 certificate...");
-    if ((flags = mbedtls_ssl_get_verify_result(&ssl)) != 0) {
-        ESP_LOGW(TAG, "Failed to verify peer certificate!");
+    data_scraping_record(DATA_SCRAPING_TIMING_HANDSHAKE, start_us);
+
+#if TLS_TRUST_MODE == TLS_TRUST_PIN
+    /* A resumed session was pinned when it was established (sessions are only saved after this check) */
+    uint32_t verify_result = mbedtls_ssl_get_verify_result(&conn->ssl);
+    if ((full_handshake || !conn->session_saved) && !tls_pin_accepted(&pin, verify_result)) {
+        char info[128];
+        mbedtls_x509_crt_verify_info(info, sizeof(info), "", verify_result);
+        ESP_LOGE(TAG, "Server certificate rejected: %s", info);
+        mbedtls_reset();
+        return ESP_FAIL;
+    }
+#endif
+
+    if (conn->session_saved && !full_handshake) {
+        ESP_LOGI(TAG, "TLS session resumed");
+        stats.resumption_hits++;
+    }
+
+    if (full_handshake) {
+        ESP_LOGI(TAG, "Certificate verified.");    // Handshake fails otherwise (MBEDTLS_SSL_VERIFY_REQUIRED)
+    }
+
+    ESP_LOGI(TAG, "Cipher suite is %s", mbedtls_ssl_get_ciphersuite(&conn->ssl));
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    if (TLS_PROFILE == TLS_PROFILE_LOW_MEMORY) {
+        if (conn->ssl.session->mfl_code != MBEDTLS_SSL_MAX_FRAG_LEN_NONE) {
+            ESP_LOGI(TAG, "Max fragment length of %d bytes accepted", TLS_MAX_FRAGMENT_LEN);
+            stats.max_frag_negotiated++;
+        } else {
+            ESP_LOGW(TAG, "Max fragment length ignored by the server, records of up to 16 kB");
+        }
+    }
+#endif
+
+    /* Keep the (possibly refreshed) session for the next connection (on the heap, it outlives the arena) */
+    mbedtls_ssl_session_free(&conn->saved_session);
+    mbedtls_ssl_session_init(&conn->saved_session);
+    tls_arena_bypass(true);
+    ret = mbedtls_ssl_get_session(&conn->ssl, &conn->saved_session);
+    tls_arena_bypass(false);
+    if (ret != 0) {
+        ESP_LOGW(TAG, "mbedtls_ssl_get_session returned -0x%x", -ret);
+        conn->session_saved = false;
     } else {
-        ESP_LOGI(TAG, "Certificate verified.");
+        conn->session_saved = true;
     }
 
-    ESP_LOGI(TAG, "Cipher suite is %s", mbedtls_ssl_get_ciphersuite(&ssl));
+    conn->connected = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Send the HTTP request over the open connection and parse the response.
+ *
+ * @param values     Pointer to the structure where the extracted values will be stored.
+ * @param use_range  Request only a byte range around the learned span of values.
+ * @param keep_alive Set to true if the connection can be reused for the next request.
+ * @param retry      Set to true if the request failed before any part of the response was received
+ *                   (i.e. the server closed the idle connection and the request can be safely repeated).
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no value (or not all values expected in the requested
+ *         range) was found,
+ *         another error code otherwise.
+ */
+static esp_err_t data_scraping_request(data_scraping_values_t *values, bool use_range, bool *keep_alive, bool *retry) {
+    esp_err_t err = ESP_OK;
+    int ret, len;
+    char buf[HTTP_BUFFER_SIZE];
+    size_t received_bytes = 0;
+    size_t value_bytes = 0;     // Bytes received when the value was extracted
+    int64_t parse_us = 0;       // Time spent in the parser
+    http_response_t *resp = &exchange.resp;
+
+    *keep_alive = false;
+    *retry = false;
+
+    char request[HTTP_REQUEST_MAX_LEN];
+    http_decoder_t *dec = decoder_ready ? &decoder : NULL;
+    size_t request_len = http_exchange_request(&exchange, request, sizeof(request), use_range, dec);
+
     ESP_LOGI(TAG, "Writing HTTP request...");
+    data_scraping_phase_begin(DATA_SCRAPING_PHASE_WRITE, FETCH_WRITE_TIMEOUT_MS);
 
     size_t written_bytes = 0;
     do {
-        ret = mbedtls_ssl_write(&ssl,
-                                (const unsigned char *)REQUEST + written_bytes,
-                                strlen(REQUEST) - written_bytes);
+        uint32_t timeout_ms = data_scraping_timeout_ms();
+        if (timeout_ms == 0) {
+            return data_scraping_timeout();
+        }
+        data_scraping_set_send_timeout(timeout_ms);
+
+        ret = mbedtls_ssl_write(&conn->ssl,
+                                (const unsigned char *)request + written_bytes,
+                                request_len - written_bytes);
         if (ret >= 0) {
             ESP_LOGI(TAG, "%d bytes written", ret);
             written_bytes += ret;
         } else if (ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_WANT_READ) {
             ESP_LOGE(TAG, "mbedtls_ssl_write returned -0x%x", -ret);
-            mbedtls_reset();
+            if (data_scraping_timeout_ms() == 0) {
+                return data_scraping_timeout();     // Send timed out (SO_SNDTIMEO)
+            }
+            *retry = true;
             return ESP_FAIL;
         }
-    } while (written_bytes < strlen(REQUEST));
+    } while (written_bytes < request_len);
+    data_scraping_record(DATA_SCRAPING_TIMING_WRITE, exchange.request_start_us);
+    int64_t written_us = esp_timer_get_time();
 
     ESP_LOGI(TAG, "Reading HTTP response...");
+    http_exchange_begin(&exchange, dec);
+    data_scraping_phase_begin(DATA_SCRAPING_PHASE_FIRST_BYTE, FETCH_FIRST_BYTE_TIMEOUT_MS);
+
+    while (true) {
+        uint32_t timeout_ms = data_scraping_timeout_ms();
+        if (timeout_ms == 0) {
+            err = data_scraping_timeout();
+            break;
+        }
+        mbedtls_ssl_conf_read_timeout(&conf, timeout_ms);
 
-    while(true) {
-        len = sizeof(buf) - 1;
-        bzero(buf, sizeof(buf));
-        ret = mbedtls_ssl_read(&ssl, (unsigned char *)buf, len);
+        len = sizeof(buf);
+        ret = mbedtls_ssl_read(&conn->ssl, (unsigned char *)buf, len);
+        data_scraping_heap_sample();
 
         if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
             continue;
-        } else if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
-            ret = 0;
+        } else if (ret == MBEDTLS_ERR_SSL_TIMEOUT) {
+            err = data_scraping_timeout();
+            break;
+        } else if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY || ret == 0) {
+            ESP_LOGI(TAG, "connection closed");
+            err = http_response_finish(resp);
             break;
         } else if (ret < 0) {
             ESP_LOGE(TAG, "mbedtls_ssl_read returned -0x%x", -ret);
-            break;
-        } else if (ret == 0) {
-            ESP_LOGI(TAG, "connection closed");
+            err = ESP_FAIL;
             break;
         }
 
+        if (received_bytes == 0) {
+            data_scraping_record(DATA_SCRAPING_TIMING_FIRST_BYTE, written_us);
+            data_scraping_phase_begin(DATA_SCRAPING_PHASE_TOTAL, 0);    // Rest of the response is bounded by the total deadline
+        }
         len = ret;
-        ESP_LOGI(TAG, "%d bytes read", len);
+        received_bytes += len;
+        fetch.bytes_read += len;
+        ESP_LOGD(TAG, "%d bytes read", len);
 
-        err = extract_freq_data(buf, len, freq);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Error 0x%d encountered when extracting frequency data", ret);
-        } else {
-            ESP_LOGI(TAG, "Frequency data extracted sucessfully");
+        int64_t feed_start_us = esp_timer_get_time();
+        err = http_response_feed(resp, buf, len, NULL);
+        parse_us += esp_timer_get_time() - feed_start_us;
+        if (err != ESP_ERR_NOT_FINISHED) {
+            break;
+        }
+
+        if (value_bytes == 0 && http_exchange_is_done(&exchange)) {
+            value_bytes = received_bytes;
+        }
+        if (http_exchange_stop_early(&exchange, received_bytes - value_bytes)) {
+            ESP_LOGI(TAG, "All values extracted, closing the connection without reading the rest");
+            fetch.early_stop = true;
+            err = ESP_OK;
+            break;
+        }
+    }
+
+    if (received_bytes > 0) {
+        fetch.timings_us[DATA_SCRAPING_TIMING_PARSE] = parse_us;
+        latency_histogram_add(&histograms[DATA_SCRAPING_TIMING_PARSE], parse_us);
+    }
+
+    if (received_bytes == 0) {
+        *retry = true;  // Nothing received, the server most likely closed the idle connection (or left it half-open)
+        return (err == ESP_ERR_TIMEOUT) ? err : ESP_FAIL;
+    } else if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error reading HTTP response (%s)", esp_err_to_name(err));
+        if (err == ESP_ERR_NO_MEM && dec != NULL && decoder.window == NULL) {
+            ESP_LOGW(TAG, "No memory for the inflate window, asking for identity responses from now on");
+            decoder_ready = false;
         }
+        return err;
     }
 
-    mbedtls_ssl_close_notify(&ssl);
-    mbedtls_reset(); 
-    return err; 
+    *keep_alive = resp->keep_alive && http_response_is_complete(resp);
+    return http_exchange_evaluate(&exchange, values);
+}
+
+/**
+ * @brief Select the connection of the server of the current source, binding a free (or the least recently used) one.
+ *
+ * Connections stay bound to their server between fetches, so sources on the same host share the keep-alive
+ * connection and the saved TLS session. At most FETCH_MAX_TLS_SESSIONS contexts exist at a time.
+ *
+ * @return ESP_OK on success, ESP_FAIL if the SSL/TLS context could not be set up.
+ */
+static esp_err_t data_scraping_conn_acquire(void) {
+    int ret;
+    data_scraping_conn_t *victim = &conns[0];
+
+    for (int i = 0; i < FETCH_MAX_TLS_SESSIONS; i++) {
+        if (conns[i].host != NULL && strcmp(conns[i].host, source->host) == 0 && strcmp(conns[i].port, source->port) == 0) {
+            conn = &conns[i];
+            conn->last_used_us = esp_timer_get_time();
+            return ESP_OK;
+        }
+        if (victim->host != NULL && (conns[i].host == NULL || conns[i].last_used_us < victim->last_used_us)) {
+            victim = &conns[i];
+        }
+    }
+
+    conn = victim;
+    if (conn->host != NULL) {
+        ESP_LOGI(TAG, "Releasing the connection to %s", conn->host);
+        data_scraping_disconnect(true);
+        mbedtls_ssl_free(&conn->ssl);
+        mbedtls_ssl_session_free(&conn->saved_session);
+        mbedtls_ssl_init(&conn->ssl);
+        mbedtls_ssl_session_init(&conn->saved_session);
+        conn->session_saved = false;
+        conn->host = NULL;
+    }
+
+    /* The context lives as long as the connection slot, so it is allocated from the heap */
+    tls_arena_bypass(true);
+    ret = mbedtls_ssl_setup(&conn->ssl, &conf);
+    tls_arena_bypass(false);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_setup returned -0x%x", -ret);
+        return ESP_FAIL;
+    }
+    /* Set Hostname matching CN in server certificate */
+    tls_arena_bypass(true);
+    ret = mbedtls_ssl_set_hostname(&conn->ssl, source->host);
+    tls_arena_bypass(false);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "mbedtls_ssl_set_hostname returned -0x%x", -ret);
+        mbedtls_ssl_free(&conn->ssl);
+        mbedtls_ssl_init(&conn->ssl);
+        return ESP_FAIL;
+    }
+    conn->host = source->host;
+    conn->port = source->port;
+    conn->last_used_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+/**
+ * @brief Select the state of the current source, assigning a free slot on its first fetch.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if all FETCH_MAX_SOURCES slots are taken.
+ */
+static esp_err_t data_scraping_cache_acquire(void) {
+    for (int i = 0; i < FETCH_MAX_SOURCES; i++) {
+        if (caches[i].source == source) {
+            cache = &caches[i];
+            return ESP_OK;
+        }
+    }
+    for (int i = 0; i < FETCH_MAX_SOURCES; i++) {
+        if (caches[i].source == NULL) {
+            cache = &caches[i];
+            memset(cache, 0, sizeof(*cache));
+            cache->source = source;
+            cache->range_supported = true;  // Until the server ignores a Range header
+            return ESP_OK;
+        }
+    }
+    ESP_LOGE(TAG, "No state left for source %s (FETCH_MAX_SOURCES is %d)", source->name, FETCH_MAX_SOURCES);
+    return ESP_ERR_NO_MEM;
+}
+
+/**
+ * @brief Perform one request over the keep-alive connection, (re)connecting only when necessary.
+ *
+ * @param values    Pointer to the structure where the extracted values will be stored.
+ * @param use_range Request only a byte range around the learned span of values.
+ * @param reused    Set to true if the request was served over an existing connection.
+ * @return ESP_OK on success, an error code otherwise.
+ */
+static esp_err_t data_scraping_exchange(data_scraping_values_t *values, bool use_range, bool *reused) {
+    esp_err_t err;
+    bool keep_alive, retry;
+
+    if (conn->connected && !data_scraping_connection_alive()) {
+        ESP_LOGI(TAG, "Keep-alive connection closed by the server");
+        data_scraping_disconnect(false);
+    }
+
+    *reused = conn->connected;
+    if (!conn->connected && (err = data_scraping_connect()) != ESP_OK) {
+        return err;
+    }
+
+    err = data_scraping_request(values, use_range, &keep_alive, &retry);
+    if (err != ESP_OK && retry && *reused) {
+        ESP_LOGW(TAG, "Request on the reused connection failed, reconnecting...");
+        data_scraping_disconnect(false);
+        *reused = false;
+        if ((err = data_scraping_connect()) != ESP_OK) {
+            return err;
+        }
+        err = data_scraping_request(values, use_range, &keep_alive, &retry);
+    }
+
+    if (err != ESP_OK || !keep_alive) {
+        data_scraping_disconnect(err != ESP_ERR_TIMEOUT);  // A stalled peer would block the close_notify
+    } else {
+        ESP_LOGI(TAG, "Keeping the connection open");
+    }
+    return err;
+}
+
+/**
+ * @brief Fetch all values of a source over a persistent HTTP/1.1 connection, requesting only the part of the page
+ *        around the last known values when possible and falling back to the whole page.
+ */
+esp_err_t data_scraping_fetch(const data_scraping_source_t *src, data_scraping_values_t *values) {
+    esp_err_t err;
+    bool reused;
+
+    if (src == NULL || values == NULL || src->value_count > DATA_SCRAPING_MAX_VALUES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    source = src;
+    if ((err = data_scraping_cache_acquire()) != ESP_OK) {
+        return err;
+    } else if ((err = http_exchange_bind(&exchange, source, cache)) != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid keys of source %s", source->name);
+        return err;
+    } else if ((err = data_scraping_conn_acquire()) != ESP_OK) {
+        return err;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    tls_arena_set_owner();  // mbedtls allocations of the fetching task come from the arena
+    heap_free_start = heap_free_min = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    memset(&fetch, 0, sizeof(fetch));
+    fetch.time_to_value_us = -1;
+    fetch.max_age_s = -1;
+    for (int i = 0; i < DATA_SCRAPING_TIMING_COUNT; i++) {
+        fetch.timings_us[i] = -1;
+    }
+    stats.fetches++;
+    total_deadline_us = start_us + (int64_t)FETCH_TOTAL_TIMEOUT_MS * 1000;
+
+    bool use_range = FETCH_RANGE_MODE && cache->range_supported && cache->span_known;
+    if (use_range) {
+        stats.range_requests++;
+    }
+
+    err = data_scraping_exchange(values, use_range, &reused);
+    if (reused) {
+        stats.reused++;
+    }
+
+    if (use_range && err == ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "Values not found in the requested range, fetching the whole page");
+        stats.range_fallbacks++;
+        fetch.fallback = true;
+        cache->span_known = false;
+        fetch.time_to_value_us = -1;
+        err = data_scraping_exchange(values, false, &reused);
+    }
+
+    values->max_age_s = (err == ESP_OK) ? fetch.max_age_s : -1;
+    data_scraping_record(DATA_SCRAPING_TIMING_TOTAL, start_us);
+    fetch.total_us = fetch.timings_us[DATA_SCRAPING_TIMING_TOTAL];
+    fetch.heap_peak_bytes = heap_free_start - heap_free_min;
+    if (fetch.heap_peak_bytes > stats.heap_peak_bytes) {
+        stats.heap_peak_bytes = fetch.heap_peak_bytes;
+    }
+    phase = DATA_SCRAPING_PHASE_NONE;
+    ESP_LOGI(TAG, "Fetch: %" PRIu32 " bytes read%s, %" PRIu32 " bytes parsed, time to value %" PRId64 " us, total %" PRId64 " us%s%s",
+             fetch.bytes_read, fetch.compressed ? " (compressed)" : "", fetch.bytes_parsed,
+             fetch.time_to_value_us, fetch.total_us, fetch.early_stop ? " (stopped early)" : "",
+             fetch.range ? " (range)" : (fetch.fallback ? " (range fallback)" : ""));
+    ESP_LOGI(TAG, "Heap: %" PRIu32 " bytes peak in this fetch, %" PRIu32 " bytes max, %u bytes free, largest block %u bytes",
+             fetch.heap_peak_bytes, stats.heap_peak_bytes, (unsigned)heap_free_min,
+             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+    if (TLS_ARENA_SIZE > 0) {
+        tls_arena_stats_t arena;
+        tls_arena_get_stats(&arena);
+        ESP_LOGI(TAG, "TLS arena: %" PRIu32 " allocs (%" PRIu32 " to heap), %" PRIu32 " live, peak %" PRIu32 " bytes, "
+                 "%" PRIu32 "/%d bytes carved, largest free %" PRIu32 " bytes, fragmentation %u%%, %" PRIu32 " resets",
+                 arena.allocs, arena.heap_allocs, arena.live_count, arena.peak_bytes, arena.used_bytes, TLS_ARENA_SIZE,
+                 arena.largest_free, arena.fragmentation, arena.resets);
+    }
+    if (stats.timeouts > 0) {
+        ESP_LOGI(TAG, "Timeouts: %" PRIu32 " of %" PRIu32 " fetches", stats.timeouts, stats.fetches);
+    }
+    dns_cache_stats_t dns;
+    dns_cache_get_stats(&dns);
+    ESP_LOGI(TAG, "DNS cache: %" PRIu32 " hits, %" PRIu32 " misses, %" PRIu32 " stale, %" PRIu32 " prefetches, %" PRIu32 " failures",
+             dns.hits, dns.misses, dns.stale, dns.prefetches, dns.failures);
+    ESP_LOGI(TAG, "Connection reuse: %" PRIu32 "/%" PRIu32 " fetches, session resumption: %" PRIu32 "/%" PRIu32,
+             stats.reused, stats.fetches, stats.resumption_hits, stats.resumption_attempts);
+    if (FETCH_RANGE_MODE) {
+        ESP_LOGI(TAG, "Range requests: %" PRIu32 " hits, %" PRIu32 " fallbacks of %" PRIu32,
+                 stats.range_hits, stats.range_fallbacks, stats.range_requests);
+    }
+    if (FETCH_HISTOGRAM_LOG_EVERY > 0 && stats.fetches % FETCH_HISTOGRAM_LOG_EVERY == 0) {
+        data_scraping_print_histograms();
+    }
+    return err;
+}
+
+/**
+ * @brief Extract the values of a source from a complete document received by other means (e.g. a pushed message),
+ *        with the same keys or paths as a fetch. Must be called from the task running the fetches.
+ */
+esp_err_t data_scraping_extract(const data_scraping_source_t *src, const char *data, size_t len,
+                                data_scraping_values_t *values) {
+    esp_err_t err;
+
+    if (src == NULL || data == NULL || values == NULL || src->value_count > DATA_SCRAPING_MAX_VALUES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    source = src;
+    if ((err = http_exchange_bind(&exchange, source, NULL)) != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid keys of source %s", source->name);
+        return err;
+    }
+
+    err = http_exchange_extract(&exchange, data, len, values);
+    if (err == ESP_ERR_NOT_FOUND) {
+        ESP_LOGE(TAG, "No values found in the message (%s)", esp_err_to_name(err));
+    } else if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Malformed message of source %s", source->name);
+    }
+    return err;
+}
+
+/**
+ * @brief Get all values of the grid source (wrapper of data_scraping_fetch).
+ */
+esp_err_t data_scraping_get_values(data_scraping_values_t *values) {
+    return data_scraping_fetch(&SOURCES[DATA_SCRAPING_SOURCE_GRID], values);
+}
+
+/**
+ * @brief Get the table of sources.
+ */
+uint8_t data_scraping_get_sources(const data_scraping_source_t **sources) {
+    if (sources != NULL) {
+        *sources = SOURCES;
+    }
+    return DATA_SCRAPING_SOURCE_COUNT;
+}
+
+/**
+ * @brief Get frequency data scaled by 10^FREQ_VALUE_SCALE (wrapper of data_scraping_get_values for the frequency only).
+ */
+esp_err_t data_scraping_get_freq(int32_t *freq) {
+    data_scraping_values_t values;
+
+    if (freq == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = data_scraping_get_values(&values);
+    if (err != ESP_OK) {
+        return err;
+    } else if ((values.found & (1u << DATA_SCRAPING_FREQ)) == 0) {
+        ESP_LOGE(TAG, "Frequency data not found in the response");
+        return ESP_ERR_NOT_FOUND;
+    }
+    *freq = values.values[DATA_SCRAPING_FREQ];
+    return ESP_OK;
+}
+
+/**
+ * @brief Get the name of an extracted value.
+ */
+const char *data_scraping_value_name(data_scraping_value_t value) {
+    return (value < DATA_SCRAPING_VALUE_COUNT) ? KEYS[value].name : "unknown";
+}
+
+/**
+ * @brief Get the number of fractional digits of an extracted value.
+ */
+uint8_t data_scraping_value_scale(data_scraping_value_t value) {
+    return (value < DATA_SCRAPING_VALUE_COUNT) ? KEYS[value].scale : 0;
+}
+
+/**
+ * @brief Get the name of a fetch phase.
+ */
+const char *data_scraping_phase_name(data_scraping_phase_t phase) {
+    switch (phase) {
+        case DATA_SCRAPING_PHASE_CONNECT:
+            return "connect";
+        case DATA_SCRAPING_PHASE_HANDSHAKE:
+            return "handshake";
+        case DATA_SCRAPING_PHASE_WRITE:
+            return "write";
+        case DATA_SCRAPING_PHASE_FIRST_BYTE:
+            return "first byte";
+        case DATA_SCRAPING_PHASE_TOTAL:
+            return "total";
+        default:
+            return "none";
+    }
+}
+
+/**
+ * @brief Get the name of a timed part of the fetch.
+ */
+const char *data_scraping_timing_name(data_scraping_timing_t timing) {
+    static const char *NAMES[DATA_SCRAPING_TIMING_COUNT] = {
+        [DATA_SCRAPING_TIMING_DNS] = "dns",
+        [DATA_SCRAPING_TIMING_TCP] = "tcp",
+        [DATA_SCRAPING_TIMING_HANDSHAKE] = "handshake",
+        [DATA_SCRAPING_TIMING_WRITE] = "write",
+        [DATA_SCRAPING_TIMING_FIRST_BYTE] = "first byte",
+        [DATA_SCRAPING_TIMING_PARSE] = "parse",
+        [DATA_SCRAPING_TIMING_TOTAL] = "total",
+    };
+    return (timing < DATA_SCRAPING_TIMING_COUNT) ? NAMES[timing] : "unknown";
+}
+
+/**
+ * @brief Get the latency histogram of a timed part of the fetch (accumulated since boot or the last reset).
+ */
+esp_err_t data_scraping_get_histogram(data_scraping_timing_t timing, latency_histogram_t *histogram) {
+    if (timing >= DATA_SCRAPING_TIMING_COUNT || histogram == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *histogram = histograms[timing];
+    return ESP_OK;
+}
+
+/**
+ * @brief Clear all latency histograms (e.g. before comparing access points).
+ */
+void data_scraping_reset_histograms(void) {
+    for (int i = 0; i < DATA_SCRAPING_TIMING_COUNT; i++) {
+        latency_histogram_reset(&histograms[i]);
+    }
+}
+
+/**
+ * @brief Print a summary of the latency histograms.
+ */
+void data_scraping_print_histograms(void) {
+    char buckets[LATENCY_HISTOGRAM_BUCKETS * 16];
+
+    ESP_LOGI(TAG, "Latency summary (ms, percentiles are bucket upper bounds):");
+    for (int i = 0; i < DATA_SCRAPING_TIMING_COUNT; i++) {
+        const latency_histogram_t *h = &histograms[i];
+        if (h->count == 0) {
+            ESP_LOGI(TAG, "  %-10s n=0", data_scraping_timing_name(i));
+            continue;
+        }
+        latency_histogram_format(h, buckets, sizeof(buckets));
+        ESP_LOGI(TAG, "  %-10s n=%" PRIu32 " min %.1f avg %.1f p50 %.1f p90 %.1f p99 %.1f max %.1f [%s]",
+                 data_scraping_timing_name(i), h->count, h->min_us / 1000.0, h->sum_us / 1000.0 / h->count,
+                 latency_histogram_percentile(h, 50) / 1000.0, latency_histogram_percentile(h, 90) / 1000.0,
+                 latency_histogram_percentile(h, 99) / 1000.0, h->max_us / 1000.0, buckets);
+    }
+}
+
+/**
+ * @brief Get measurements of the last fetch.
+ */
+esp_err_t data_scraping_get_last_fetch(data_scraping_fetch_t *out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = fetch;
+    return ESP_OK;
+}
+
+/**
+ * @brief Get connection reuse and TLS session resumption counters.
+ */
+esp_err_t data_scraping_get_stats(data_scraping_stats_t *out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = stats;
+    return ESP_OK;
 }
 
 /**
@@ -175,7 +1026,25 @@ esp_err_t data_scraping_get_freq(float* freq) {
 esp_err_t data_scraping_init(void) {
     int ret;
 
-    mbedtls_ssl_init(&ssl);             // Initialize SSL/TLS context
+    exchange.stats = &stats;    // Counters and measurements updated while evaluating responses
+    exchange.fetch = &fetch;
+
+    if (dns_cache_init(NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialise the DNS cache");
+        return ESP_FAIL;
+    }
+
+    decoder_ready = HTTP_ACCEPT_COMPRESSION;     // Window allocated by the first compressed response
+
+    if (tls_arena_init() != ESP_OK) {
+        ESP_LOGW(TAG, "mbedtls allocations will use the heap");
+    }
+
+    for (int i = 0; i < FETCH_MAX_TLS_SESSIONS; i++) {
+        mbedtls_ssl_init(&conns[i].ssl);                // Initialize SSL/TLS context (set up when bound to a server)
+        mbedtls_net_init(&conns[i].server_fd);          // Initialize network context
+        mbedtls_ssl_session_init(&conns[i].saved_session);  // Initialize session kept for resumption
+    }
     mbedtls_x509_crt_init(&cacert);     // Initialize certificate structure
     mbedtls_ctr_drbg_init(&ctr_drbg);   // Initialize deterministic random bit generator
     ESP_LOGI(TAG, "Seeding the random number generator");
@@ -187,21 +1056,6 @@ esp_err_t data_scraping_init(void) {
         ESP_LOGE(TAG, "mbedtls_ctr_drbg_seed returned %d", ret);
         return ESP_FAIL;
     }
-    
-    ESP_LOGI(TAG, "Attaching the certificate bundle...");
-    ESP_ERROR_CHECK(esp_crt_bundle_attach(&conf));  // Attach the certificate bundle
-
-    if (ret < 0) {
-        ESP_LOGE(TAG, "esp_crt_bundle_attach returned -0x%x\n\n", -ret);
-        return ESP_FAIL;
-    }
-
-    /* Set Hostname matching CN in server certificate */
-    ESP_LOGI(TAG, "Setting hostname for TLS session...");
-    if ((ret = mbedtls_ssl_set_hostname(&ssl, WEB_SERVER)) != 0) {
-        ESP_LOGE(TAG, "mbedtls_ssl_set_hostname returned -0x%x", -ret);
-        return ESP_FAIL;
-    }
 
     ESP_LOGI(TAG, "Setting up the SSL/TLS structure...");
 
@@ -210,18 +1064,15 @@ esp_err_t data_scraping_init(void) {
                                            MBEDTLS_SSL_TRANSPORT_STREAM,
                                            MBEDTLS_SSL_PRESET_DEFAULT)) != 0) {
         ESP_LOGE(TAG, "mbedtls_ssl_config_defaults returned %d", ret);
-        mbedtls_reset();
         return ESP_FAIL;
     }
 
-    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_OPTIONAL);      // Set authentication mode
-    mbedtls_ssl_conf_ca_chain(&conf, &cacert, NULL);                    // Set CA chain
-    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);    // Set random number generator
-
-    if ((ret = mbedtls_ssl_setup(&ssl, &conf)) != 0) {
-        ESP_LOGE(TAG, "mbedtls_ssl_setup returned -0x%x\n\n", -ret);
-        mbedtls_reset();
+    if (data_scraping_trust_init() != ESP_OK || data_scraping_tls_profile() != ESP_OK) {
         return ESP_FAIL;
     }
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &ctr_drbg);    // Set random number generator
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);  // Resume with tickets if offered
+#endif
     return ESP_OK; 
 }
@@ -7,6 +7,118 @@
 #pragma once
 
 #include "config_macros.h"
+#include "json_extractor.h"
+#include "latency_histogram.h"
+#include "stream_extractor.h"
+
+#define DATA_SCRAPING_MAX_VALUES 8  // Max number of values extracted from one source
+
+/* Data scraping connection statistics */
+typedef struct {
+    uint32_t fetches;               // Number of data_scraping_get_freq calls
+    uint32_t connections;           // Number of new TCP/TLS connections
+    uint32_t reused;                // Fetches served over an existing keep-alive connection
+    uint32_t resumption_attempts;   // Handshakes offering a saved TLS session (ID or ticket)
+    uint32_t resumption_hits;       // Handshakes in which the server accepted the saved session
+    uint32_t not_modified;          // Fetches answered with 304 Not Modified (body not parsed)
+    uint32_t extractor_runs;        // Fetches whose values were taken from the extractor (not served from cache)
+    uint32_t fingerprint_hits;      // Fetches whose value window was identical to the previous one
+    uint32_t range_requests;        // Requests limited to a byte range around the learned value offset
+    uint32_t range_hits;            // Range requests answered with 206 Partial Content containing the value
+    uint32_t range_fallbacks;       // Range requests followed by a full fetch (value not in range or Range ignored)
+    uint32_t timeouts;              // Fetches aborted because a phase overran its deadline
+    uint32_t heap_peak_bytes;       // Largest heap usage of a single fetch so far
+    uint32_t max_frag_negotiated;   // Handshakes in which the server accepted the max fragment length
+} data_scraping_stats_t;
+
+/* Phase of a fetch (each one bounded by its own deadline, all of them by FETCH_TOTAL_TIMEOUT_MS) */
+typedef enum {
+    DATA_SCRAPING_PHASE_NONE = 0x00,        // No phase (fetch not started or finished without a timeout)
+    DATA_SCRAPING_PHASE_CONNECT = 0x01,     // DNS lookup and TCP connect (FETCH_CONNECT_TIMEOUT_MS)
+    DATA_SCRAPING_PHASE_HANDSHAKE = 0x02,   // TLS handshake (FETCH_HANDSHAKE_TIMEOUT_MS)
+    DATA_SCRAPING_PHASE_WRITE = 0x03,       // Sending the request (FETCH_WRITE_TIMEOUT_MS)
+    DATA_SCRAPING_PHASE_FIRST_BYTE = 0x04,  // Waiting for the first byte of the response (FETCH_FIRST_BYTE_TIMEOUT_MS)
+    DATA_SCRAPING_PHASE_TOTAL = 0x05        // Rest of the response, or the whole fetch (FETCH_TOTAL_TIMEOUT_MS)
+} data_scraping_phase_t;
+
+/* Timed parts of a fetch (each one has its own latency histogram) */
+typedef enum {
+    DATA_SCRAPING_TIMING_DNS = 0x00,        // DNS lookup
+    DATA_SCRAPING_TIMING_TCP = 0x01,        // TCP connect
+    DATA_SCRAPING_TIMING_HANDSHAKE = 0x02,  // TLS handshake
+    DATA_SCRAPING_TIMING_WRITE = 0x03,      // Sending the request
+    DATA_SCRAPING_TIMING_FIRST_BYTE = 0x04, // From the request sent to the first byte of the response
+    DATA_SCRAPING_TIMING_PARSE = 0x05,      // Time spent parsing the response (decoding and extraction)
+    DATA_SCRAPING_TIMING_TOTAL = 0x06,      // Whole fetch
+    DATA_SCRAPING_TIMING_COUNT
+} data_scraping_timing_t;
+
+/* Measurements of a single fetch */
+typedef struct {
+    uint32_t bytes_read;            // Bytes of the HTTP response read from the TLS connection
+    uint32_t bytes_parsed;          // Body bytes passed through the extractor (after decompression)
+    int64_t time_to_value_us;       // Time from sending the request to extracting the value (-1 if not found)
+    int64_t total_us;               // Duration of the whole fetch (including connecting)
+    bool early_stop;                // Reading stopped once the value was extracted (see FETCH_EARLY_STOP)
+    bool unchanged;                 // Value served from cache (304 Not Modified or identical value window)
+    bool compressed;                // Response body was gzip / deflate encoded
+    bool range;                     // Value was served by a byte-range request
+    bool fallback;                  // Range request failed and the whole page was fetched
+    data_scraping_phase_t timeout_phase;    // Phase that overran its deadline (DATA_SCRAPING_PHASE_NONE if none)
+    uint32_t heap_peak_bytes;       // Peak internal heap usage during the fetch (sampled at each TLS step and record)
+    int32_t max_age_s;              // Remaining freshness lifetime from Cache-Control max-age and Age (-1 if not sent)
+    int64_t timings_us[DATA_SCRAPING_TIMING_COUNT];  // Duration of each timed part (-1 if it did not run, e.g. on a reused connection)
+} data_scraping_fetch_t;
+
+/* Sources polled by the fetch scheduler (defined in data_scraping.c) */
+typedef enum {
+    DATA_SCRAPING_SOURCE_GRID = 0x00,   // Grid frequency page (WEB_SERVER, WEB_URL)
+    DATA_SCRAPING_SOURCE_COUNT
+} data_scraping_source_id_t;
+
+/* Values extracted from the grid source in a single pass (keys are defined in data_scraping.c) */
+typedef enum {
+    DATA_SCRAPING_FREQ = 0x00,      // Grid frequency [Hz]
+    DATA_SCRAPING_VALUE_COUNT
+} data_scraping_value_t;
+
+/* Source definition (usually an entry of a static const table) */
+typedef struct {
+    const char *name;                       // Name of the source (for logs)
+    const char *host;                       // Server host name (sources on the same host share the connection)
+    const char *port;                       // Server port
+    const char *url;                        // Request target
+    uint8_t format;                         // SOURCE_FORMAT_HTML or SOURCE_FORMAT_JSON
+    const stream_extractor_key_t *keys;     // SOURCE_FORMAT_HTML: markers of the values
+    const json_extractor_path_t *paths;     // SOURCE_FORMAT_JSON: paths of the values
+    uint8_t value_count;                    // Number of keys / paths (up to DATA_SCRAPING_MAX_VALUES)
+    uint32_t interval_ms;                   // Poll interval (initial one with FETCH_ADAPTIVE)
+    uint32_t min_interval_ms;               // Shortest interval when the values change quickly (FETCH_ADAPTIVE)
+    uint32_t max_interval_ms;               // Longest interval when the values are stable (FETCH_ADAPTIVE)
+    uint8_t priority;                       // Order of sources due at the same time (lower first)
+    const char *topic;                      // MQTT topic publishing the same document (NULL to poll only, FETCH_PUSH)
+} data_scraping_source_t;
+
+/* Result of a fetch */
+typedef struct {
+    uint32_t found;                             // Bit mask of values found (bit n = value n of the source)
+    int32_t values[DATA_SCRAPING_MAX_VALUES];   // Extracted values scaled by 10^scale (valid if the bit is set)
+    int32_t max_age_s;                          // Seconds the server declared the values fresh for (-1 if it did not)
+} data_scraping_values_t;
 
 esp_err_t data_scraping_init(void);
-esp_err_t data_scraping_get_freq(float* freq);
+esp_err_t data_scraping_fetch(const data_scraping_source_t *source, data_scraping_values_t *values);
+esp_err_t data_scraping_extract(const data_scraping_source_t *source, const char *data, size_t len,
+                                data_scraping_values_t *values);
+esp_err_t data_scraping_get_values(data_scraping_values_t *values);
+uint8_t data_scraping_get_sources(const data_scraping_source_t **sources);
+const char *data_scraping_value_name(data_scraping_value_t value);
+uint8_t data_scraping_value_scale(data_scraping_value_t value);
+const char *data_scraping_phase_name(data_scraping_phase_t phase);
+esp_err_t data_scraping_get_freq(int32_t *freq);
+esp_err_t data_scraping_get_stats(data_scraping_stats_t *stats);
+esp_err_t data_scraping_get_last_fetch(data_scraping_fetch_t *fetch);
+const char *data_scraping_timing_name(data_scraping_timing_t timing);
+esp_err_t data_scraping_get_histogram(data_scraping_timing_t timing, latency_histogram_t *histogram);
+void data_scraping_reset_histograms(void);
+void data_scraping_print_histograms(void);
@@ -0,0 +1,156 @@
+/**
+ * @file    decimal_parser.c
+ * @brief   Incremental conversion of decimal numbers to scaled integers with explicit rounding
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "decimal_parser.h"
+
+#define TAG "decimal_parser"
+
+#define DECIMAL_MAX_DIGITS 19       // Significant digits that fit in the 64-bit mantissa
+#define DECIMAL_MAX_SCALE 9         // Max scale (10^9 still fits in int32_t)
+#define DECIMAL_EXPONENT_MAX 999    // Larger exponents are clamped (the value overflows or rounds to 0 anyway)
+/* Digits beyond the precision (or fractional zeros) move the exponent at most this far: past it no explicit
+   exponent or scale brings the shift back within 19 digits, so the value overflows or rounds to 0 anyway */
+#define DECIMAL_DIGITS_EXPONENT_MAX (DECIMAL_EXPONENT_MAX + DECIMAL_MAX_SCALE + DECIMAL_MAX_DIGITS + 1)
+
+/* Powers of 10 representable in uint64_t */
+static const uint64_t POW10[DECIMAL_MAX_DIGITS + 1] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+    1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+    1000000000000000000ull, 10000000000000000000ull
+};
+
+void decimal_parser_start(decimal_parser_t *p, uint8_t scale, decimal_rounding_t rounding, bool allow_exponent) {
+    p->scale = (scale > DECIMAL_MAX_SCALE) ? DECIMAL_MAX_SCALE : scale;
+    p->rounding = rounding;
+    p->allow_exponent = allow_exponent;
+    p->started = false;
+    p->negative = false;
+    p->has_digits = false;
+    p->has_point = false;
+    p->sticky = false;
+    p->in_exponent = false;
+    p->exp_started = false;
+    p->exp_negative = false;
+    p->exp_digits = false;
+    p->digits = 0;
+    p->exponent = 0;
+    p->exp_value = 0;
+    p->mantissa = 0;
+}
+
+bool decimal_parser_char(decimal_parser_t *p, char c) {
+    if (p->in_exponent) {
+        if (c >= '0' && c <= '9') {
+            p->exp_started = true;
+            p->exp_digits = true;
+            if (p->exp_value < DECIMAL_EXPONENT_MAX) {
+                p->exp_value = p->exp_value * 10 + (c - '0');
+            }
+            return true;
+        } else if ((c == '-' || c == '+') && !p->exp_started) {
+            p->exp_started = true;
+            p->exp_negative = (c == '-');
+            return true;
+        }
+        return false;
+    }
+
+    if (c >= '0' && c <= '9') {
+        uint8_t digit = (uint8_t)(c - '0');
+        p->started = true;
+        p->has_digits = true;
+        if (p->digits < DECIMAL_MAX_DIGITS) {
+            p->mantissa = p->mantissa * 10 + digit;
+            if (p->mantissa != 0) {
+                p->digits++;  // Leading zeros do not use the precision
+            }
+            if (p->has_point && p->exponent > -DECIMAL_DIGITS_EXPONENT_MAX) {
+                p->exponent--;
+            }
+        } else {
+            p->sticky |= (digit != 0);  // Out of precision: only needed for rounding ties
+            if (!p->has_point && p->exponent < DECIMAL_DIGITS_EXPONENT_MAX) {
+                p->exponent++;
+            }
+        }
+        return true;
+    } else if (c == '.' && !p->has_point) {
+        p->started = true;
+        p->has_point = true;
+        return true;
+    } else if ((c == '-' || c == '+') && !p->started) {
+        p->started = true;
+        p->negative = (c == '-');
+        return true;
+    } else if ((c == 'e' || c == 'E') && p->allow_exponent && p->has_digits) {
+        p->in_exponent = true;
+        return true;
+    }
+    return false;
+}
+
+esp_err_t decimal_parser_result(const decimal_parser_t *p, int32_t *value) {
+    if (p == NULL || value == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (!p->has_digits) {
+        return ESP_ERR_NOT_FOUND;
+    } else if (p->in_exponent && !p->exp_digits) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* value = mantissa * 10^shift, rounded to an integer */
+    int32_t shift = p->exponent + (p->exp_negative ? -p->exp_value : p->exp_value) + p->scale;
+    uint64_t result;
+
+    if (p->mantissa == 0) {
+        result = 0;
+    } else if (shift >= 0) {
+        if (shift > DECIMAL_MAX_DIGITS || p->mantissa > INT32_MAX / POW10[shift]) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        result = p->mantissa * POW10[shift];
+    } else if (-shift > DECIMAL_MAX_DIGITS) {
+        result = 0;  // At most 19 digits below the unit: less than 0.1, always rounded down
+    } else {
+        uint64_t divisor = POW10[-shift];
+        uint64_t half = divisor / 2;
+        uint64_t remainder = p->mantissa % divisor;
+        bool round_up = false;
+
+        result = p->mantissa / divisor;
+        if (p->rounding != DECIMAL_ROUND_TRUNCATE) {
+            if (remainder > half || (remainder == half && p->sticky)) {
+                round_up = true;
+            } else if (remainder == half) {
+                round_up = (p->rounding == DECIMAL_ROUND_HALF_UP) || (result & 1);  // Tie
+            }
+        }
+        result += round_up ? 1 : 0;
+    }
+
+    if (result > INT32_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *value = p->negative ? -(int32_t)result : (int32_t)result;
+    return ESP_OK;
+}
+
+esp_err_t decimal_parse(const char *str, size_t len, uint8_t scale, decimal_rounding_t rounding, int32_t *value) {
+    decimal_parser_t p;
+
+    if (str == NULL || value == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    decimal_parser_start(&p, scale, rounding, true);
+    for (size_t i = 0; i < len; i++) {
+        if (!decimal_parser_char(&p, str[i])) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return decimal_parser_result(&p, value);
+}
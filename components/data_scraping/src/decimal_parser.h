@@ -0,0 +1,82 @@
+/**
+ * @file    decimal_parser.h
+ * @brief   Incremental conversion of decimal numbers to scaled integers with explicit rounding
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+
+/* Rounding of digits beyond the scale */
+typedef enum {
+    DECIMAL_ROUND_TRUNCATE = 0x00,  // Drop the digits (towards zero)
+    DECIMAL_ROUND_HALF_UP = 0x01,   // Round to nearest, ties away from zero
+    DECIMAL_ROUND_HALF_EVEN = 0x02  // Round to nearest, ties to even
+} decimal_rounding_t;
+
+/* Decimal parser context (fed one character at a time, so numbers may be split across chunks) */
+typedef struct {
+    uint8_t scale;                  // Number of fractional digits kept (value = number * 10^scale)
+    decimal_rounding_t rounding;    // Rounding of the remaining digits
+    bool allow_exponent;            // Accept an exponent part (e.g. "3.12e4")
+    bool started;                   // Sign, digit or point seen
+    bool negative;                  // Sign
+    bool has_digits;                // At least one digit of the mantissa seen
+    bool has_point;                 // Decimal point seen
+    bool sticky;                    // Non-zero digits dropped beyond the mantissa precision
+    bool in_exponent;               // Exponent part
+    bool exp_started;               // Sign or digit of the exponent seen (a sign is only accepted first)
+    bool exp_negative;              // Sign of the exponent
+    bool exp_digits;                // At least one digit of the exponent seen
+    uint8_t digits;                 // Significant digits in the mantissa
+    int16_t exponent;               // Power of 10 applied to the mantissa (from the digits, clamped)
+    int16_t exp_value;              // Explicit exponent
+    uint64_t mantissa;              // Significant digits (up to 19)
+} decimal_parser_t;
+
+/**
+ * @brief Prepare the parser for a new number.
+ *
+ * @param p              Pointer to the parser context. Must not be NULL.
+ * @param scale          Number of fractional digits kept in the result (0 to 9).
+ * @param rounding       Rounding of the remaining digits.
+ * @param allow_exponent Accept an exponent part (JSON numbers).
+ */
+void decimal_parser_start(decimal_parser_t *p, uint8_t scale, decimal_rounding_t rounding, bool allow_exponent);
+
+/**
+ * @brief Process the next character.
+ *
+ * @param p Pointer to the parser context. Must not be NULL.
+ * @param c Character to process.
+ * @return true if the character belongs to the number, false if it cannot (the number ends before it).
+ */
+bool decimal_parser_char(decimal_parser_t *p, char c);
+
+/**
+ * @brief Get the number as a scaled integer (e.g. "49.987" with scale 2 and DECIMAL_ROUND_HALF_UP gives 4999).
+ *
+ * @param p     Pointer to the parser context. Must not be NULL.
+ * @param value Pointer to the variable where the scaled value will be stored.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no digits were seen, ESP_ERR_INVALID_ARG if the exponent
+ *         has no digits, ESP_ERR_INVALID_SIZE if the value does not fit in int32_t.
+ */
+esp_err_t decimal_parser_result(const decimal_parser_t *p, int32_t *value);
+
+/**
+ * @brief Convert a complete decimal string to a scaled integer.
+ *
+ * @param str      Number (does not have to be null-terminated). Must not be NULL.
+ * @param len      Length of the number.
+ * @param scale    Number of fractional digits kept in the result (0 to 9).
+ * @param rounding Rounding of the remaining digits.
+ * @param value    Pointer to the variable where the scaled value will be stored.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the string is not a number,
+ *         or an error returned by decimal_parser_result.
+ */
+esp_err_t decimal_parse(const char *str, size_t len, uint8_t scale, decimal_rounding_t rounding, int32_t *value);
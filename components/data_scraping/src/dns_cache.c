@@ -0,0 +1,242 @@
+/**
+ * @file    dns_cache.c
+ * @brief   Resolver cache with TTL, background prefetch and stale answers on failure
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "dns_cache.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "lwip/netdb.h"
+
+#define TAG "dns_cache"
+
+/* Cached answer */
+typedef struct {
+    char host[DNS_CACHE_HOST_MAX_LEN];  // Host name (empty if the entry is unused)
+    char port[DNS_CACHE_PORT_MAX_LEN];  // Port number
+    struct sockaddr_storage addr;       // Resolved address
+    socklen_t addr_len;                 // Length of the resolved address
+    int64_t expires_us;                 // End of the TTL (esp_timer_get_time)
+    bool prefetch;                      // Entry waits for a background refresh
+} dns_cache_entry_t;
+
+static dns_cache_entry_t entries[DNS_CACHE_ENTRIES];   // Cached answers
+static dns_cache_resolver_t resolve_fn = NULL;          // Resolver
+static SemaphoreHandle_t lock = NULL;                   // Protects entries and stats
+static TaskHandle_t prefetch_task = NULL;               // Task refreshing entries close to expiry
+static dns_cache_stats_t stats;                         // Cache counters
+
+/**
+ * @brief Default resolver: first address returned by getaddrinfo.
+ */
+static esp_err_t dns_cache_getaddrinfo(const char *host, const char *port, struct sockaddr_storage *addr,
+                                       socklen_t *addr_len, uint32_t *ttl_s) {
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_protocol = IPPROTO_TCP};
+    struct addrinfo *list;
+
+    int ret = getaddrinfo(host, port, &hints, &list);
+    if (ret != 0 || list == NULL) {
+        ESP_LOGE(TAG, "DNS lookup of %s failed (%d)", host, ret);
+        return ESP_FAIL;
+    }
+    memcpy(addr, list->ai_addr, list->ai_addrlen);
+    *addr_len = list->ai_addrlen;
+    freeaddrinfo(list);
+    return ESP_OK;
+}
+
+/**
+ * @brief Find the entry of a host (the lock must be held).
+ *
+ * @return Pointer to the entry, NULL if the host is not cached.
+ */
+static dns_cache_entry_t *dns_cache_find(const char *host, const char *port) {
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        if (entries[i].host[0] != '\0' && strcmp(entries[i].host, host) == 0 && strcmp(entries[i].port, port) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Store a resolved address, replacing the entry that expires first if the cache is full (the lock must be held).
+ */
+static void dns_cache_store(const char *host, const char *port, const struct sockaddr_storage *addr,
+                            socklen_t addr_len, uint32_t ttl_s) {
+    dns_cache_entry_t *entry = dns_cache_find(host, port);
+
+    if (entry == NULL) {
+        entry = &entries[0];
+        for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+            if (entries[i].host[0] == '\0') {
+                entry = &entries[i];
+                break;
+            } else if (entries[i].expires_us < entry->expires_us) {
+                entry = &entries[i];
+            }
+        }
+        strlcpy(entry->host, host, sizeof(entry->host));
+        strlcpy(entry->port, port, sizeof(entry->port));
+    }
+    entry->addr = *addr;
+    entry->addr_len = addr_len;
+    entry->expires_us = esp_timer_get_time() + (int64_t)ttl_s * 1000000;
+    entry->prefetch = false;
+}
+
+/**
+ * @brief Prefetch task: refresh the entries marked by dns_cache_resolve, outside of the fetch.
+ */
+static void dns_cache_prefetch_task(void *arg) {
+    char host[DNS_CACHE_HOST_MAX_LEN];
+    char port[DNS_CACHE_PORT_MAX_LEN];
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+            xSemaphoreTake(lock, portMAX_DELAY);
+            bool pending = entries[i].prefetch;
+            strlcpy(host, entries[i].host, sizeof(host));
+            strlcpy(port, entries[i].port, sizeof(port));
+            xSemaphoreGive(lock);
+            if (!pending) {
+                continue;
+            }
+
+            uint32_t ttl_s = DNS_CACHE_TTL_S;
+            esp_err_t err = resolve_fn(host, port, &addr, &addr_len, &ttl_s);  // Without the lock (may take seconds)
+
+            xSemaphoreTake(lock, portMAX_DELAY);
+            stats.prefetches++;
+            if (err == ESP_OK) {
+                dns_cache_store(host, port, &addr, addr_len, ttl_s);
+                ESP_LOGI(TAG, "Refreshed %s (TTL %u s)", host, (unsigned)ttl_s);
+            } else if (strcmp(entries[i].host, host) == 0) {
+                entries[i].prefetch = false;    // Retried by the next lookup once the entry expires
+            }
+            xSemaphoreGive(lock);
+        }
+    }
+}
+
+esp_err_t dns_cache_init(dns_cache_resolver_t resolver) {
+    resolve_fn = (resolver != NULL) ? resolver : dns_cache_getaddrinfo;
+    if (lock != NULL) {
+        return ESP_OK;  // Already initialised (only the resolver is replaced)
+    }
+
+    memset(entries, 0, sizeof(entries));
+    memset(&stats, 0, sizeof(stats));
+    lock = xSemaphoreCreateMutex();
+    if (lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create the mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (DNS_CACHE_PREFETCH_S > 0 &&
+        xTaskCreate(dns_cache_prefetch_task, "dns_prefetch", DNS_CACHE_TASK_STACK_SIZE, NULL,
+                    tskIDLE_PRIORITY + 1, &prefetch_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the prefetch task");
+        vSemaphoreDelete(lock);
+        lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dns_cache_resolve(const char *host, const char *port, struct sockaddr_storage *addr, socklen_t *addr_len) {
+    if (host == NULL || port == NULL || addr == NULL || addr_len == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    bool notify = false;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    dns_cache_entry_t *entry = dns_cache_find(host, port);
+    if (entry != NULL && now_us < entry->expires_us) {
+        *addr = entry->addr;
+        *addr_len = entry->addr_len;
+        if (prefetch_task != NULL && !entry->prefetch && entry->expires_us - now_us < (int64_t)DNS_CACHE_PREFETCH_S * 1000000) {
+            entry->prefetch = true;
+            notify = true;
+        }
+        stats.hits++;
+        xSemaphoreGive(lock);
+        if (notify) {
+            xTaskNotifyGive(prefetch_task);
+        }
+        return ESP_OK;
+    }
+    xSemaphoreGive(lock);
+
+    /* Missing or expired: resolve now (without the lock) */
+    struct sockaddr_storage resolved;
+    socklen_t resolved_len;
+    uint32_t ttl_s = DNS_CACHE_TTL_S;
+    esp_err_t err = resolve_fn(host, port, &resolved, &resolved_len, &ttl_s);
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    if (err == ESP_OK) {
+        dns_cache_store(host, port, &resolved, resolved_len, ttl_s);
+        *addr = resolved;
+        *addr_len = resolved_len;
+        stats.misses++;
+    } else if ((entry = dns_cache_find(host, port)) != NULL &&
+               now_us < entry->expires_us + (int64_t)DNS_CACHE_STALE_MAX_S * 1000000) {
+        ESP_LOGW(TAG, "Resolving %s failed, using the expired address", host);
+        *addr = entry->addr;
+        *addr_len = entry->addr_len;
+        stats.stale++;
+        err = ESP_OK;
+    } else {
+        stats.failures++;
+    }
+    xSemaphoreGive(lock);
+    return err;
+}
+
+void dns_cache_expire(const char *host) {
+    if (host == NULL || lock == NULL) {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    xSemaphoreTake(lock, portMAX_DELAY);
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        if (entries[i].host[0] != '\0' && strcmp(entries[i].host, host) == 0) {
+            if (entries[i].expires_us > now_us) {
+                entries[i].expires_us = now_us;     // Address kept as the stale answer if resolving fails
+            }
+            entries[i].prefetch = false;
+        }
+    }
+    xSemaphoreGive(lock);
+}
+
+esp_err_t dns_cache_get_stats(dns_cache_stats_t *out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (lock == NULL) {
+        memset(out, 0, sizeof(*out));
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(lock);
+    return ESP_OK;
+}
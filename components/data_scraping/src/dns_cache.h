@@ -0,0 +1,77 @@
+/**
+ * @file    dns_cache.h
+ * @brief   Resolver cache with TTL, background prefetch and stale answers on failure
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "lwip/sockets.h"
+
+#define DNS_CACHE_HOST_MAX_LEN 64   // Max length of a cached host name (including the terminator)
+#define DNS_CACHE_PORT_MAX_LEN 6    // Max length of a cached port (including the terminator)
+
+/**
+ * Resolver used by the cache (getaddrinfo by default, or a stand-in for testing).
+ *
+ * @param host     Host name.
+ * @param port     Port number (as a string).
+ * @param addr     Resolved address.
+ * @param addr_len Length of the resolved address.
+ * @param ttl_s    TTL of the answer in seconds (left unchanged to use DNS_CACHE_TTL_S).
+ * @return ESP_OK on success, an error code otherwise.
+ */
+typedef esp_err_t (*dns_cache_resolver_t)(const char *host, const char *port, struct sockaddr_storage *addr,
+                                          socklen_t *addr_len, uint32_t *ttl_s);
+
+/* Cache counters */
+typedef struct {
+    uint32_t hits;          // Lookups answered from a fresh entry
+    uint32_t misses;        // Lookups that had to wait for the resolver
+    uint32_t stale;         // Lookups answered from an expired entry because the resolver failed
+    uint32_t prefetches;    // Background refreshes of entries close to expiry
+    uint32_t failures;      // Lookups that failed (resolver failed and no usable entry)
+} dns_cache_stats_t;
+
+/**
+ * @brief Initialise the cache and start the prefetch task.
+ *
+ * @param resolver Resolver function (NULL for getaddrinfo).
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the mutex or the task could not be created.
+ */
+esp_err_t dns_cache_init(dns_cache_resolver_t resolver);
+
+/**
+ * @brief Resolve a host, using the cached address if it has not expired.
+ *
+ * An entry that expires within DNS_CACHE_PREFETCH_S is refreshed by the prefetch task. If the resolver
+ * fails, an expired entry is used for up to DNS_CACHE_STALE_MAX_S.
+ *
+ * @param host     Host name. Must not be NULL.
+ * @param port     Port number (as a string). Must not be NULL.
+ * @param addr     Resolved address. Must not be NULL.
+ * @param addr_len Length of the resolved address. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if not initialised, an error of the resolver otherwise.
+ */
+esp_err_t dns_cache_resolve(const char *host, const char *port, struct sockaddr_storage *addr, socklen_t *addr_len);
+
+/**
+ * @brief Expire the cached address of a host (e.g. after connecting to it failed), so that the next lookup
+ *        resolves it again. The address is kept, and still served for up to DNS_CACHE_STALE_MAX_S if the
+ *        resolver fails.
+ *
+ * @param host Host name. Must not be NULL.
+ */
+void dns_cache_expire(const char *host);
+
+/**
+ * @brief Get the cache counters.
+ *
+ * @param stats Pointer to the structure where the counters will be copied. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL.
+ */
+esp_err_t dns_cache_get_stats(dns_cache_stats_t *stats);
@@ -0,0 +1,237 @@
+/**
+ * @file    http_decoder.c
+ * @brief   Streaming Content-Encoding (gzip / deflate) decoder with a fixed inflate window
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "http_decoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp32/rom/miniz.h"
+
+#define TAG "http_decoder"
+
+#define GZIP_FHCRC 0x02
+#define GZIP_FEXTRA 0x04
+#define GZIP_FNAME 0x08
+#define GZIP_FCOMMENT 0x10
+
+_Static_assert((HTTP_INFLATE_WINDOW_SIZE & (HTTP_INFLATE_WINDOW_SIZE - 1)) == 0 &&
+                   HTTP_INFLATE_WINDOW_SIZE >= TINFL_LZ_DICT_SIZE,
+               "Inflate window must be a power of two of at least 32 KB (deflate dictionary size)");
+
+/**
+ * @brief Move on to the next optional gzip header field (or to the compressed data).
+ *
+ * @param dec Pointer to the decoder context.
+ */
+static void http_decoder_next_gzip_field(http_decoder_t *dec) {
+    dec->header_len = 0;
+    if (dec->gzip_flags & GZIP_FEXTRA) {
+        dec->gzip_flags &= ~GZIP_FEXTRA;
+        dec->state = HTTP_DECODER_GZIP_EXTRA_LEN;
+    } else if (dec->gzip_flags & GZIP_FNAME) {
+        dec->gzip_flags &= ~GZIP_FNAME;
+        dec->state = HTTP_DECODER_GZIP_NAME;
+    } else if (dec->gzip_flags & GZIP_FCOMMENT) {
+        dec->gzip_flags &= ~GZIP_FCOMMENT;
+        dec->state = HTTP_DECODER_GZIP_COMMENT;
+    } else if (dec->gzip_flags & GZIP_FHCRC) {
+        dec->gzip_flags &= ~GZIP_FHCRC;
+        dec->skip = 2;
+        dec->state = HTTP_DECODER_GZIP_HCRC;
+    } else {
+        dec->flags = 0;  // Raw deflate stream follows the gzip header
+        dec->state = HTTP_DECODER_INFLATE;
+    }
+}
+
+/**
+ * @brief Consume header bytes (gzip header fields or zlib detection) one at a time.
+ *
+ * @param dec Pointer to the decoder context.
+ * @param c   Next byte of the body.
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the header is invalid.
+ */
+static esp_err_t http_decoder_header_byte(http_decoder_t *dec, uint8_t c) {
+    switch (dec->state) {
+        case HTTP_DECODER_GZIP_HEADER:
+            dec->header[dec->header_len++] = c;
+            if (dec->header_len == 10) {
+                if (dec->header[0] != 0x1f || dec->header[1] != 0x8b || dec->header[2] != 8) {
+                    ESP_LOGE(TAG, "Invalid gzip header");
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                dec->gzip_flags = dec->header[3];
+                http_decoder_next_gzip_field(dec);
+            }
+            break;
+
+        case HTTP_DECODER_GZIP_EXTRA_LEN:
+            dec->header[dec->header_len++] = c;
+            if (dec->header_len == 2) {
+                dec->skip = dec->header[0] | (dec->header[1] << 8);
+                dec->state = HTTP_DECODER_GZIP_EXTRA;
+                if (dec->skip == 0) {
+                    http_decoder_next_gzip_field(dec);
+                }
+            }
+            break;
+
+        case HTTP_DECODER_GZIP_EXTRA:
+        case HTTP_DECODER_GZIP_HCRC:
+            if (--dec->skip == 0) {
+                http_decoder_next_gzip_field(dec);
+            }
+            break;
+
+        case HTTP_DECODER_GZIP_NAME:
+        case HTTP_DECODER_GZIP_COMMENT:
+            if (c == 0) {
+                http_decoder_next_gzip_field(dec);
+            }
+            break;
+
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Inflate compressed bytes through the circular window and pass the output to the callback.
+ *
+ * @param dec  Pointer to the decoder context.
+ * @param in   Compressed bytes.
+ * @param len  Number of compressed bytes.
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the stream is corrupted,
+ *         or the error returned by the output callback.
+ */
+static esp_err_t http_decoder_inflate(http_decoder_t *dec, const uint8_t *in, size_t len) {
+    tinfl_status status;
+
+    do {
+        size_t in_size = len;
+        size_t out_size = HTTP_INFLATE_WINDOW_SIZE - dec->window_pos;
+
+        status = tinfl_decompress((tinfl_decompressor *)dec->inflator, in, &in_size, dec->window,
+                                  dec->window + dec->window_pos, &out_size, dec->flags | TINFL_FLAG_HAS_MORE_INPUT);
+        in += in_size;
+        len -= in_size;
+        dec->bytes_in += in_size;
+
+        if (out_size > 0) {
+            esp_err_t err = dec->out_cb(dec->out_ctx, (const char *)dec->window + dec->window_pos, out_size);
+            dec->bytes_out += out_size;
+            dec->window_pos = (dec->window_pos + out_size) & (HTTP_INFLATE_WINDOW_SIZE - 1);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+
+        if (status < TINFL_STATUS_DONE) {
+            ESP_LOGE(TAG, "Inflate failed (%d)", status);
+            return ESP_ERR_INVALID_RESPONSE;
+        } else if (status == TINFL_STATUS_DONE) {
+            dec->state = HTTP_DECODER_DONE;  // Trailer (CRC32 / ISIZE) is not verified
+            break;
+        } else if (in_size == 0 && out_size == 0) {
+            break;  // No progress possible without more input
+        }
+    } while (len > 0 || status == TINFL_STATUS_HAS_MORE_OUTPUT);
+
+    return ESP_OK;
+}
+
+esp_err_t http_decoder_init(http_decoder_t *dec) {
+    if (dec == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (dec->inflator != NULL) {
+        return ESP_OK;
+    }
+
+    memset(dec, 0, sizeof(http_decoder_t));
+    dec->inflator = malloc(sizeof(tinfl_decompressor));
+    dec->window = malloc(HTTP_INFLATE_WINDOW_SIZE);
+    if (dec->inflator == NULL || dec->window == NULL) {
+        ESP_LOGW(TAG, "Not enough memory for the inflate window");
+        free(dec->inflator);
+        free(dec->window);
+        dec->inflator = NULL;
+        dec->window = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t http_decoder_start(http_decoder_t *dec, http_coding_t coding, http_decoder_cb_t out_cb, void *out_ctx) {
+    esp_err_t err = http_decoder_init(dec);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    dec->out_cb = out_cb;
+    dec->out_ctx = out_ctx;
+    tinfl_init((tinfl_decompressor *)dec->inflator);
+    dec->window_pos = 0;
+    dec->header_len = 0;
+    dec->gzip_flags = 0;
+    dec->skip = 0;
+    dec->bytes_in = 0;
+    dec->bytes_out = 0;
+    dec->state = (coding == HTTP_CODING_GZIP) ? HTTP_DECODER_GZIP_HEADER : HTTP_DECODER_ZLIB_DETECT;
+    return ESP_OK;
+}
+
+esp_err_t http_decoder_feed(void *ctx, const char *data, size_t len) {
+    http_decoder_t *dec = (http_decoder_t *)ctx;
+    const uint8_t *in = (const uint8_t *)data;
+    esp_err_t err = ESP_OK;
+
+    while (len > 0 && dec->state < HTTP_DECODER_ZLIB_DETECT) {
+        err = http_decoder_header_byte(dec, *in++);
+        len--;
+        dec->bytes_in++;
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (dec->state == HTTP_DECODER_ZLIB_DETECT) {
+        /* "deflate" should be zlib-wrapped (RFC 9110), but some servers send a raw deflate stream */
+        while (len > 0 && dec->header_len < 2) {
+            dec->header[dec->header_len++] = *in++;
+            len--;
+        }
+        if (dec->header_len < 2) {
+            return ESP_OK;
+        }
+        uint16_t cmf_flg = (dec->header[0] << 8) | dec->header[1];
+        bool zlib = ((dec->header[0] & 0x0F) == 8) && ((dec->header[0] >> 4) <= 7) && (cmf_flg % 31 == 0);
+        dec->flags = zlib ? TINFL_FLAG_PARSE_ZLIB_HEADER : 0;
+        dec->state = HTTP_DECODER_INFLATE;
+        err = http_decoder_inflate(dec, dec->header, 2);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    if (dec->state == HTTP_DECODER_INFLATE && len > 0) {
+        err = http_decoder_inflate(dec, in, len);
+    }
+    return err;
+}
+
+http_coding_t http_decoder_parse_coding(const char *value) {
+    if (value[0] == '\0' || strcasecmp(value, "identity") == 0) {
+        return HTTP_CODING_IDENTITY;
+    } else if (strcasecmp(value, "gzip") == 0 || strcasecmp(value, "x-gzip") == 0) {
+        return HTTP_CODING_GZIP;
+    } else if (strcasecmp(value, "deflate") == 0) {
+        return HTTP_CODING_DEFLATE;
+    }
+    return HTTP_CODING_UNSUPPORTED;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file    http_decoder.h
+ * @brief   Streaming Content-Encoding (gzip / deflate) decoder with a fixed inflate window
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+
+/* Callback receiving consecutive fragments of the decoded body (same signature as http_body_cb_t) */
+typedef esp_err_t (*http_decoder_cb_t)(void *ctx, const char *data, size_t len);
+
+/* Content coding of the HTTP body */
+typedef enum {
+    HTTP_CODING_IDENTITY = 0x00,    // No Content-Encoding
+    HTTP_CODING_GZIP = 0x01,        // Content-Encoding: gzip (or x-gzip)
+    HTTP_CODING_DEFLATE = 0x02,     // Content-Encoding: deflate (zlib-wrapped or raw)
+    HTTP_CODING_UNSUPPORTED = 0x03  // Any other coding
+} http_coding_t;
+
+/* Decoder state */
+typedef enum {
+    HTTP_DECODER_GZIP_HEADER = 0x00,    // Fixed 10-byte gzip header
+    HTTP_DECODER_GZIP_EXTRA_LEN = 0x01, // Length of the FEXTRA field
+    HTTP_DECODER_GZIP_EXTRA = 0x02,     // FEXTRA field
+    HTTP_DECODER_GZIP_NAME = 0x03,      // Zero-terminated FNAME field
+    HTTP_DECODER_GZIP_COMMENT = 0x04,   // Zero-terminated FCOMMENT field
+    HTTP_DECODER_GZIP_HCRC = 0x05,      // FHCRC field
+    HTTP_DECODER_ZLIB_DETECT = 0x06,    // First two bytes of a deflate body (zlib header or raw deflate)
+    HTTP_DECODER_INFLATE = 0x07,        // Compressed data
+    HTTP_DECODER_DONE = 0x08            // End of compressed stream (trailer is ignored)
+} http_decoder_state_t;
+
+/* Streaming decoder context */
+typedef struct {
+    void *inflator;                 // tinfl_decompressor (allocated on the first compressed body, then kept)
+    uint8_t *window;                // Circular output window (HTTP_INFLATE_WINDOW_SIZE bytes, allocated with it)
+    size_t window_pos;              // Write position in the window
+    uint32_t flags;                 // Inflate flags
+    http_decoder_state_t state;     // Current state
+    uint8_t header[10];             // Bytes of the gzip header / zlib detection collected so far
+    uint8_t header_len;             // Number of bytes in header
+    uint8_t gzip_flags;             // FLG byte of the gzip header
+    uint16_t skip;                  // Bytes left in the current gzip header field
+    uint32_t bytes_in;              // Compressed bytes consumed
+    uint32_t bytes_out;             // Decoded bytes produced
+    http_decoder_cb_t out_cb;       // Output callback
+    void *out_ctx;                  // Output callback context
+} http_decoder_t;
+
+/**
+ * @brief Allocate the inflate state and window (about 43 kB) unless already allocated. The buffers are kept,
+ *        so decoding allocates at most once.
+ *
+ * @param dec Pointer to the decoder context (zero-initialised before the first call). Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the buffers could not be allocated.
+ */
+esp_err_t http_decoder_init(http_decoder_t *dec);
+
+/**
+ * @brief Prepare the decoder for a new response body, allocating its buffers on the first one.
+ *
+ * @param dec     Pointer to the decoder context. Must not be NULL.
+ * @param coding  Content coding of the body (HTTP_CODING_GZIP or HTTP_CODING_DEFLATE).
+ * @param out_cb  Callback receiving the decoded body.
+ * @param out_ctx Context passed to the callback.
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the buffers could not be allocated.
+ */
+esp_err_t http_decoder_start(http_decoder_t *dec, http_coding_t coding, http_decoder_cb_t out_cb, void *out_ctx);
+
+/**
+ * @brief Decode the next fragment of the body and pass the output to the callback.
+ *
+ * @param ctx  Pointer to the decoder context (http_decoder_t).
+ * @param data Compressed fragment.
+ * @param len  Length of the fragment.
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the stream is corrupted,
+ *         or the error returned by the output callback.
+ */
+esp_err_t http_decoder_feed(void *ctx, const char *data, size_t len);
+
+/**
+ * @brief Parse a Content-Encoding header value.
+ *
+ * @param value Null-terminated header value.
+ * @return Content coding.
+ */
+http_coding_t http_decoder_parse_coding(const char *value);
@@ -0,0 +1,247 @@
+/**
+ * @file    http_exchange.c
+ * @brief   HTTP request and response handling of a fetch, independent of the transport: builds the (conditional,
+ *          range) request, passes the body to the extractor of the source and decides where the values come from
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "http_exchange.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define TAG "http_exchange"
+
+esp_err_t http_exchange_bind(http_exchange_t *ex, const data_scraping_source_t *source, http_exchange_cache_t *cache) {
+    ex->source = source;
+    ex->cache = cache;
+    if (source->format == SOURCE_FORMAT_JSON) {
+        if (ex->json_extractor.paths == source->paths && ex->json_extractor.path_count == source->value_count) {
+            return ESP_OK;
+        }
+        return json_extractor_init(&ex->json_extractor, source->paths, source->value_count);
+    }
+    if (ex->extractor.keys == source->keys && ex->extractor.key_count == source->value_count) {
+        return ESP_OK;
+    }
+    return stream_extractor_init(&ex->extractor, source->keys, source->value_count);
+}
+
+size_t http_exchange_request(http_exchange_t *ex, char *buf, size_t size, bool use_range, http_decoder_t *decoder) {
+    const http_exchange_cache_t *cache = ex->cache;
+    size_t len = snprintf(buf, size,
+                          "GET %s HTTP/1.1\r\n"
+                          "Host: %s\r\n"
+                          "User-Agent: esp-idf/1.0 esp32\r\n"
+                          "Connection: keep-alive\r\n",
+                          ex->source->url, ex->source->host);
+
+    ex->use_range = use_range;
+    ex->request_start_us = esp_timer_get_time();
+    if (use_range && len < size) {
+        uint32_t first = (cache->span_start > FETCH_RANGE_MARGIN) ? cache->span_start - FETCH_RANGE_MARGIN : 0;
+        uint32_t last = cache->span_end + FETCH_RANGE_MARGIN - 1;
+        len += snprintf(buf + len, size - len, "Range: bytes=%" PRIu32 "-%" PRIu32 "\r\n", first, last);
+    } else if (decoder != NULL && len < size) {
+        len += snprintf(buf + len, size - len, "Accept-Encoding: gzip, deflate\r\n");
+    }
+    len = response_cache_add_validators(&cache->response, buf, len, size);
+    if (len < size) {
+        len += snprintf(buf + len, size - len, "\r\n");
+    }
+    return (len < size) ? len : size - 1;
+}
+
+bool http_exchange_is_done(const http_exchange_t *ex) {
+    if (ex->source->format == SOURCE_FORMAT_JSON) {
+        return json_extractor_is_done(&ex->json_extractor);
+    }
+    return stream_extractor_is_done(&ex->extractor);
+}
+
+/**
+ * @brief Reset the extractor of the source format for a new response.
+ */
+static void http_exchange_extractor_reset(http_exchange_t *ex) {
+    if (ex->source->format == SOURCE_FORMAT_JSON) {
+        json_extractor_reset(&ex->json_extractor);
+    } else {
+        stream_extractor_reset(&ex->extractor);
+    }
+}
+
+/**
+ * @brief Pass a fragment of a document to the extractor of the source format.
+ */
+static esp_err_t http_exchange_extractor_feed(http_exchange_t *ex, const char *data, size_t len) {
+    if (ex->source->format == SOURCE_FORMAT_JSON) {
+        return json_extractor_feed(&ex->json_extractor, data, len);
+    }
+    return stream_extractor_feed(&ex->extractor, data, len);
+}
+
+/**
+ * @brief Get the fingerprint of the values seen by the selected extractor.
+ */
+static uint32_t http_exchange_extractor_fingerprint(const http_exchange_t *ex) {
+    if (ex->source->format == SOURCE_FORMAT_JSON) {
+        return json_extractor_fingerprint(&ex->json_extractor);
+    }
+    return stream_extractor_fingerprint(&ex->extractor);
+}
+
+/**
+ * @brief Finish the extraction and copy the values found by the selected extractor.
+ *
+ * @return ESP_OK if at least one value was found, ESP_ERR_NOT_FOUND otherwise.
+ */
+static esp_err_t http_exchange_extractor_finish(http_exchange_t *ex, data_scraping_values_t *values) {
+    esp_err_t err;
+
+    if (ex->source->format == SOURCE_FORMAT_JSON) {
+        json_extractor_result_t result;
+        err = json_extractor_finish(&ex->json_extractor, &result);
+        values->found = result.found;
+        memcpy(values->values, result.values, sizeof(values->values));
+    } else {
+        stream_extractor_result_t result;
+        err = stream_extractor_finish(&ex->extractor, &result);
+        values->found = result.found;
+        memcpy(values->values, result.values, sizeof(values->values));
+    }
+    return err;
+}
+
+/**
+ * @brief Pass a fragment of the response body to the extractor (until all values are found).
+ */
+static esp_err_t http_exchange_body_cb(void *ctx, const char *data, size_t len) {
+    http_exchange_t *ex = (http_exchange_t *)ctx;
+
+    if (http_exchange_is_done(ex)) {
+        return ESP_OK;  // Nothing left to extract, the rest of the body is discarded
+    }
+
+    ex->fetch->bytes_parsed += len;
+    esp_err_t err = http_exchange_extractor_feed(ex, data, len);
+    if (err == ESP_OK) {
+        ex->fetch->time_to_value_us = esp_timer_get_time() - ex->request_start_us;
+    } else if (err != ESP_ERR_NOT_FINISHED) {
+        return err;  // Malformed document
+    }
+    return ESP_OK;
+}
+
+void http_exchange_begin(http_exchange_t *ex, http_decoder_t *decoder) {
+    http_exchange_extractor_reset(ex);
+    http_response_init(&ex->resp, http_exchange_body_cb, ex);
+    http_response_set_decoder(&ex->resp, decoder);
+}
+
+bool http_exchange_stop_early(const http_exchange_t *ex, size_t drained_bytes) {
+    const http_response_t *resp = &ex->resp;
+
+    if (FETCH_EARLY_STOP == EARLY_STOP_OFF || !http_exchange_is_done(ex)) {
+        return false;
+    } else if (FETCH_EARLY_STOP == EARLY_STOP_CLOSE) {
+        return true;
+    }
+
+    /* EARLY_STOP_DRAIN: read the rest without parsing to keep the connection, unless it is too long */
+    if (resp->state == HTTP_RESPONSE_BODY && resp->remaining != UINT64_MAX) {
+        return resp->remaining > FETCH_DRAIN_MAX_BYTES;
+    }
+    return drained_bytes > FETCH_DRAIN_MAX_BYTES;
+}
+
+esp_err_t http_exchange_evaluate(http_exchange_t *ex, data_scraping_values_t *values) {
+    esp_err_t err;
+    http_exchange_cache_t *cache = ex->cache;
+    const http_response_t *resp = &ex->resp;
+    bool use_range = ex->use_range;
+
+    int64_t freshness_s = http_response_freshness(resp);
+    ex->fetch->max_age_s = (freshness_s > INT32_MAX) ? INT32_MAX : (int32_t)freshness_s;
+    ex->fetch->compressed = (resp->coding != HTTP_CODING_IDENTITY);
+    if (response_cache_not_modified(&cache->response, resp)) {
+        ESP_LOGI(TAG, "Not modified, using the cached values");
+        ex->stats->not_modified++;
+        ex->fetch->unchanged = true;
+        *values = cache->last_values;
+        return ESP_OK;
+    } else if (use_range && resp->status == 416) {
+        ESP_LOGW(TAG, "Requested range not satisfiable");
+        return ESP_ERR_NOT_FOUND;
+    } else if (use_range && resp->status == 206 && resp->range_start < 0) {
+        ESP_LOGW(TAG, "Partial response without a usable Content-Range");
+        return ESP_ERR_NOT_FOUND;
+    } else if (use_range && resp->status == 200) {
+        ESP_LOGW(TAG, "Server ignored the Range header, disabling range requests");
+        cache->range_supported = false;
+        ex->stats->range_fallbacks++;
+        ex->fetch->fallback = true;
+    } else if (resp->status != 200 && !(use_range && resp->status == 206)) {
+        ESP_LOGE(TAG, "HTTP status %d", resp->status);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    /* The numbers were converted as their windows closed; an unchanged fingerprint only means that the stored
+       values are reused, and reading has already stopped (or skips parsing) at the end of the last window
+       through FETCH_EARLY_STOP */
+    uint32_t fingerprint = http_exchange_extractor_fingerprint(ex);
+    if (response_cache_same_windows(&cache->response, http_exchange_is_done(ex), fingerprint)) {
+        ESP_LOGI(TAG, "Value windows unchanged, using the cached values");
+        ex->stats->fingerprint_hits++;
+        ex->fetch->unchanged = true;
+        *values = cache->last_values;
+    } else {
+        ex->stats->extractor_runs++;
+        if ((err = http_exchange_extractor_finish(ex, values)) != ESP_OK) {
+            ESP_LOGE(TAG, "No values found in the response (%s)", esp_err_to_name(err));
+            return err;
+        } else if (resp->status == 206 && (values->found & cache->span_keys) != cache->span_keys) {
+            ESP_LOGW(TAG, "Not all values found in the requested range");
+            return ESP_ERR_NOT_FOUND;
+        }
+        fingerprint = http_exchange_extractor_fingerprint(ex);
+        ESP_LOGI(TAG, "Values extracted sucessfully (found 0x%" PRIx32 ")", values->found);
+    }
+
+    /* Remember where the values were found, so that the next fetch can request only that part of the page
+       (a fragment of a JSON document cannot be parsed on its own) */
+    uint32_t start, end;
+    if (ex->source->format == SOURCE_FORMAT_HTML && stream_extractor_get_span(&ex->extractor, &start, &end) == ESP_OK) {
+        uint32_t base = (resp->status == 206) ? (uint32_t)resp->range_start : 0;
+        cache->span_start = base + start;
+        cache->span_end = base + end;
+        cache->span_keys = ex->extractor.done;
+        cache->span_known = true;
+    }
+    if (resp->status == 206) {
+        ex->stats->range_hits++;
+        ex->fetch->range = true;
+    }
+
+    /* Remember the values and the validators for the next conditional request */
+    cache->last_values = *values;
+    response_cache_store(&cache->response, resp, fingerprint);
+    return ESP_OK;
+}
+
+esp_err_t http_exchange_extract(http_exchange_t *ex, const char *data, size_t len, data_scraping_values_t *values) {
+    esp_err_t err;
+
+    http_exchange_extractor_reset(ex);
+    err = http_exchange_extractor_feed(ex, data, len);
+    if (err != ESP_OK && err != ESP_ERR_NOT_FINISHED) {
+        return err;
+    }
+
+    memset(values, 0, sizeof(*values));
+    values->max_age_s = -1;
+    return http_exchange_extractor_finish(ex, values);
+}
@@ -0,0 +1,117 @@
+/**
+ * @file    http_exchange.h
+ * @brief   HTTP request and response handling of a fetch, independent of the transport: builds the (conditional,
+ *          range) request, passes the body to the extractor of the source and decides where the values come from
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "data_scraping.h"
+#include "http_response.h"
+#include "json_extractor.h"
+#include "response_cache.h"
+#include "stream_extractor.h"
+
+/* Per-source state kept between fetches */
+typedef struct {
+    const data_scraping_source_t *source;       // Source the state belongs to (NULL if unused)
+    response_cache_t response;                  // Validators and fingerprint of the last parsed response
+    data_scraping_values_t last_values;         // Last extracted values (served on 304 / unchanged windows)
+    uint32_t span_start;                        // Offset of the first marker in the page (learned)
+    uint32_t span_end;                          // Offset after the last value window in the page (learned)
+    uint32_t span_keys;                         // Values found within the learned span
+    bool span_known;                            // Span is valid (a range request can be sent)
+    bool range_supported;                       // Server has not ignored a Range header so far
+} http_exchange_cache_t;
+
+/* Request / response of the current fetch */
+typedef struct {
+    const data_scraping_source_t *source;   // Source of the current fetch
+    http_exchange_cache_t *cache;           // State of the source
+    stream_extractor_t extractor;           // Value extractor for HTML pages (keeps its state across response chunks)
+    json_extractor_t json_extractor;        // Value extractor for JSON documents
+    http_response_t resp;                   // Parser of the current response
+    bool use_range;                         // Current request asks for a byte range around the learned span
+    int64_t request_start_us;               // Timestamp of building the current request
+    data_scraping_stats_t *stats;           // Counters updated by the exchange (not_modified, extractor_runs, ...)
+    data_scraping_fetch_t *fetch;           // Measurements of the current fetch updated by the exchange
+} http_exchange_t;
+
+/**
+ * @brief Select the source of the next exchanges, compiling its keys (or paths) unless the extractor already
+ *        holds them.
+ *
+ * @param ex     Pointer to the exchange. Its stats and fetch pointers must be set.
+ * @param source Source to fetch. Must not be NULL.
+ * @param cache  State of the source (NULL for data_scraping_extract, which does not use it).
+ * @return ESP_OK on success, the error of the extractor if the keys or paths of the source are invalid.
+ */
+esp_err_t http_exchange_bind(http_exchange_t *ex, const data_scraping_source_t *source, http_exchange_cache_t *cache);
+
+/**
+ * @brief Build the request, adding conditional GET headers if validators of the last response are known.
+ *
+ * A range request asks only for the bytes around the learned span of values. It does not accept compression,
+ * since byte ranges of an encoded body refer to the compressed stream.
+ *
+ * @param ex        Pointer to the bound exchange.
+ * @param buf       Buffer for the request.
+ * @param size      Size of the buffer.
+ * @param use_range Request a byte range around the learned span instead of the whole page.
+ * @param decoder   Decoder for compressed responses (NULL to accept identity only).
+ * @return Length of the request.
+ */
+size_t http_exchange_request(http_exchange_t *ex, char *buf, size_t size, bool use_range, http_decoder_t *decoder);
+
+/**
+ * @brief Prepare the parser and the extractor for the response to the last request.
+ *
+ * The response is then passed to http_response_feed / http_response_finish on ex->resp.
+ *
+ * @param ex      Pointer to the exchange.
+ * @param decoder Decoder given to http_exchange_request.
+ */
+void http_exchange_begin(http_exchange_t *ex, http_decoder_t *decoder);
+
+/**
+ * @brief Check if the extractor has found all values.
+ */
+bool http_exchange_is_done(const http_exchange_t *ex);
+
+/**
+ * @brief Decide if reading of the response can stop before its end (see FETCH_EARLY_STOP).
+ *
+ * @param ex            Pointer to the exchange.
+ * @param drained_bytes Bytes read since all values were extracted.
+ * @return true if the connection should be closed now, false to keep reading.
+ */
+bool http_exchange_stop_early(const http_exchange_t *ex, size_t drained_bytes);
+
+/**
+ * @brief Take the values from the completely read response: from the cache if the server answered 304 or the value
+ *        windows are unchanged, from the extractor otherwise. Learns the span of values and stores the validators.
+ *
+ * @param ex     Pointer to the exchange.
+ * @param values Pointer to the structure where the values will be stored.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no value (or not all values expected in the requested range)
+ *         was found, ESP_ERR_INVALID_RESPONSE on an unexpected status.
+ */
+esp_err_t http_exchange_evaluate(http_exchange_t *ex, data_scraping_values_t *values);
+
+/**
+ * @brief Extract the values of the bound source from a complete document (no request, no cache).
+ *
+ * @param ex     Pointer to the bound exchange.
+ * @param data   Document.
+ * @param len    Length of the document.
+ * @param values Pointer to the structure where the values will be stored.
+ * @return ESP_OK if at least one value was found, ESP_ERR_NOT_FOUND if none, the error of the extractor if the
+ *         document is malformed.
+ */
+esp_err_t http_exchange_extract(http_exchange_t *ex, const char *data, size_t len, data_scraping_values_t *values);
@@ -0,0 +1,353 @@
+/**
+ * @file    http_response.c
+ * @brief   Incremental HTTP/1.1 response parser (status line, headers, message framing)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "http_response.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define TAG "http_response"
+
+/**
+ * @brief Check if a comma-separated header value contains a given token (case-insensitive).
+ *
+ * @param value Null-terminated header value.
+ * @param token Null-terminated token to look for.
+ * @return true if the token is present, false otherwise.
+ */
+static bool http_header_has_token(const char *value, const char *token) {
+    size_t token_len = strlen(token);
+    const char *p = value;
+
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        const char *end = p;
+        while (*end != '\0' && *end != ',') {
+            end++;
+        }
+        const char *tok_end = end;
+        while (tok_end > p && (tok_end[-1] == ' ' || tok_end[-1] == '\t')) {
+            tok_end--;
+        }
+        if ((size_t)(tok_end - p) == token_len && strncasecmp(p, token, token_len) == 0) {
+            return true;
+        }
+        p = end;
+    }
+    return false;
+}
+
+/**
+ * @brief Store a header value used for cache validation. Values that do not fit are dropped, since
+ *        a truncated validator would never match.
+ *
+ * @param dst       Destination buffer (HTTP_VALIDATOR_MAX_LEN bytes).
+ * @param value     Null-terminated header value.
+ * @param truncated Header line was truncated (value is incomplete).
+ */
+static void http_response_store_validator(char *dst, const char *value, bool truncated) {
+    size_t len = strlen(value);
+    if (truncated || len >= HTTP_VALIDATOR_MAX_LEN) {
+        dst[0] = '\0';
+    } else {
+        memcpy(dst, value, len + 1);
+    }
+}
+
+/**
+ * @brief Parse the freshness lifetime from a Cache-Control header value (a private cache, so s-maxage is ignored).
+ *
+ * @param value Null-terminated header value.
+ * @return max-age in seconds, 0 if the response must not be reused (no-cache / no-store), -1 if not present.
+ */
+static int64_t http_response_parse_max_age(const char *value) {
+    if (http_header_has_token(value, "no-cache") || http_header_has_token(value, "no-store")) {
+        return 0;
+    }
+
+    const char *p = value;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (strncasecmp(p, "max-age=", 8) == 0) {
+            p += 8;
+            if (*p == '"') {
+                p++;    // Quoted form is not allowed but seen in the wild
+            }
+            return isdigit((unsigned char)*p) ? strtoll(p, NULL, 10) : -1;
+        }
+        while (*p != '\0' && *p != ',') {
+            p++;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Process the status line.
+ *
+ * @param resp Pointer to the parser context.
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the line is malformed.
+ */
+static esp_err_t http_response_status_line(http_response_t *resp) {
+    const char *line = resp->line;
+
+    if (resp->line_len < 12 || strncmp(line, "HTTP/1.", 7) != 0 || line[8] != ' ' ||
+        !isdigit((unsigned char)line[9]) || !isdigit((unsigned char)line[10]) || !isdigit((unsigned char)line[11])) {
+        ESP_LOGE(TAG, "Malformed status line: %s", line);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    resp->keep_alive = (line[7] != '0');  // HTTP/1.1 connections are persistent by default
+    resp->status = (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+    ESP_LOGD(TAG, "Status %d", resp->status);
+    return ESP_OK;
+}
+
+/**
+ * @brief Process a single header line.
+ *
+ * @param resp Pointer to the parser context.
+ */
+static void http_response_header_line(http_response_t *resp) {
+    bool truncated = (resp->line_len >= sizeof(resp->line) - 1);
+    char *colon = strchr(resp->line, ':');
+    if (colon == NULL) {
+        return;  // Not a header (or truncated beyond recognition), ignore
+    }
+
+    *colon = '\0';
+    const char *name = resp->line;
+    char *value = colon + 1;
+    while (*value == ' ' || *value == '\t') {
+        value++;
+    }
+    size_t value_len = strlen(value);
+    while (value_len > 0 && (value[value_len - 1] == ' ' || value[value_len - 1] == '\t')) {
+        value[--value_len] = '\0';
+    }
+
+    if (strcasecmp(name, "Content-Length") == 0) {
+        resp->content_length = strtoll(value, NULL, 10);
+    } else if (strcasecmp(name, "Transfer-Encoding") == 0) {
+        resp->chunked = http_header_has_token(value, "chunked");
+    } else if (strcasecmp(name, "Content-Range") == 0) {
+        if (strncasecmp(value, "bytes ", 6) == 0 && isdigit((unsigned char)value[6])) {
+            resp->range_start = strtoll(value + 6, NULL, 10);
+        }
+    } else if (strcasecmp(name, "Content-Encoding") == 0) {
+        resp->coding = http_decoder_parse_coding(value);
+    } else if (strcasecmp(name, "ETag") == 0) {
+        http_response_store_validator(resp->etag, value, truncated);
+    } else if (strcasecmp(name, "Last-Modified") == 0) {
+        http_response_store_validator(resp->last_modified, value, truncated);
+    } else if (strcasecmp(name, "Cache-Control") == 0) {
+        resp->max_age_s = http_response_parse_max_age(value);
+    } else if (strcasecmp(name, "Age") == 0) {
+        resp->age_s = strtoll(value, NULL, 10);
+    } else if (strcasecmp(name, "Connection") == 0) {
+        if (http_header_has_token(value, "close")) {
+            resp->keep_alive = false;
+        } else if (http_header_has_token(value, "keep-alive")) {
+            resp->keep_alive = true;
+        }
+    }
+}
+
+/**
+ * @brief Decide how the body is delimited and decoded once all headers have been received.
+ *
+ * @param resp Pointer to the parser context.
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the body uses a content coding that cannot be decoded,
+ *         ESP_ERR_NO_MEM if the decoder could not allocate its window.
+ */
+static esp_err_t http_response_headers_done(http_response_t *resp) {
+    if (resp->status >= 100 && resp->status < 200) {
+        http_decoder_t *decoder = resp->decoder;
+        http_response_init(resp, resp->body_cb, resp->cb_ctx);  // Interim response, the real one follows
+        resp->decoder = decoder;
+        return ESP_OK;
+    }
+
+    if (resp->status == 204 || resp->status == 304) {
+        resp->state = HTTP_RESPONSE_COMPLETE;
+    } else if (resp->chunked) {
+        resp->state = HTTP_RESPONSE_CHUNK_SIZE;
+    } else if (resp->content_length >= 0) {
+        resp->remaining = (uint64_t)resp->content_length;
+        resp->state = (resp->remaining == 0) ? HTTP_RESPONSE_COMPLETE : HTTP_RESPONSE_BODY;
+    } else {
+        resp->keep_alive = false;  // Body delimited by connection close
+        resp->remaining = UINT64_MAX;
+        resp->state = HTTP_RESPONSE_BODY;
+    }
+
+    if (resp->state != HTTP_RESPONSE_COMPLETE && resp->coding != HTTP_CODING_IDENTITY) {
+        if (resp->coding == HTTP_CODING_UNSUPPORTED || resp->decoder == NULL) {
+            ESP_LOGE(TAG, "Unsupported Content-Encoding");
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        return http_decoder_start(resp->decoder, resp->coding, resp->body_cb, resp->cb_ctx);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Process a complete line in one of the line-oriented states.
+ *
+ * @param resp Pointer to the parser context.
+ * @return ESP_OK on success, ESP_ERR_INVALID_RESPONSE if the line is malformed.
+ */
+static esp_err_t http_response_line(http_response_t *resp) {
+    esp_err_t err = ESP_OK;
+
+    switch (resp->state) {
+        case HTTP_RESPONSE_STATUS:
+            err = http_response_status_line(resp);
+            if (err == ESP_OK) {
+                resp->state = HTTP_RESPONSE_HEADERS;
+            }
+            break;
+
+        case HTTP_RESPONSE_HEADERS:
+            if (resp->line_len == 0) {
+                err = http_response_headers_done(resp);
+            } else {
+                http_response_header_line(resp);
+            }
+            break;
+
+        case HTTP_RESPONSE_CHUNK_SIZE: {
+            char *end = NULL;
+            unsigned long long size = strtoull(resp->line, &end, 16);
+            if (end == resp->line) {
+                ESP_LOGE(TAG, "Malformed chunk size: %s", resp->line);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            resp->remaining = size;
+            resp->state = (size == 0) ? HTTP_RESPONSE_TRAILER : HTTP_RESPONSE_CHUNK_DATA;
+            break;
+        }
+
+        case HTTP_RESPONSE_CHUNK_END:
+            if (resp->line_len != 0) {
+                ESP_LOGE(TAG, "Missing CRLF after chunk data");
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            resp->state = HTTP_RESPONSE_CHUNK_SIZE;
+            break;
+
+        case HTTP_RESPONSE_TRAILER:
+            if (resp->line_len == 0) {
+                resp->state = HTTP_RESPONSE_COMPLETE;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    resp->line_len = 0;
+    return err;
+}
+
+void http_response_set_decoder(http_response_t *resp, http_decoder_t *decoder) {
+    resp->decoder = decoder;
+}
+
+void http_response_init(http_response_t *resp, http_body_cb_t body_cb, void *cb_ctx) {
+    memset(resp, 0, sizeof(http_response_t));
+    resp->state = HTTP_RESPONSE_STATUS;
+    resp->content_length = -1;
+    resp->range_start = -1;
+    resp->max_age_s = -1;
+    resp->body_cb = body_cb;
+    resp->cb_ctx = cb_ctx;
+}
+
+esp_err_t http_response_feed(http_response_t *resp, const char *data, size_t len, size_t *consumed) {
+    esp_err_t err = ESP_OK;
+    size_t i = 0;
+
+    if (resp == NULL || (data == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (i < len && resp->state != HTTP_RESPONSE_COMPLETE && err == ESP_OK) {
+        if (resp->state == HTTP_RESPONSE_BODY || resp->state == HTTP_RESPONSE_CHUNK_DATA) {
+            size_t span = len - i;
+            if ((uint64_t)span > resp->remaining) {
+                span = (size_t)resp->remaining;
+            }
+            if (resp->coding != HTTP_CODING_IDENTITY) {
+                err = http_decoder_feed(resp->decoder, data + i, span);
+            } else if (resp->body_cb != NULL) {
+                err = resp->body_cb(resp->cb_ctx, data + i, span);
+            }
+            i += span;
+            resp->body_received += span;
+            if (resp->remaining != UINT64_MAX) {
+                resp->remaining -= span;
+            }
+            if (resp->remaining == 0) {
+                resp->state = (resp->state == HTTP_RESPONSE_BODY) ? HTTP_RESPONSE_COMPLETE : HTTP_RESPONSE_CHUNK_END;
+            }
+            continue;
+        }
+
+        char c = data[i++];
+        if (c == '\n') {
+            if (resp->line_len > 0 && resp->line[resp->line_len - 1] == '\r') {
+                resp->line_len--;
+            }
+            resp->line[resp->line_len] = '\0';
+            err = http_response_line(resp);
+        } else if (resp->line_len < sizeof(resp->line) - 1) {
+            resp->line[resp->line_len++] = c;
+        }
+    }
+
+    if (consumed != NULL) {
+        *consumed = i;
+    }
+
+    if (err != ESP_OK) {
+        return err;
+    }
+    return (resp->state == HTTP_RESPONSE_COMPLETE) ? ESP_OK : ESP_ERR_NOT_FINISHED;
+}
+
+esp_err_t http_response_finish(http_response_t *resp) {
+    if (resp == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (resp->state == HTTP_RESPONSE_BODY && resp->remaining == UINT64_MAX) {
+        resp->state = HTTP_RESPONSE_COMPLETE;  // Body delimited by connection close
+    }
+
+    if (resp->state != HTTP_RESPONSE_COMPLETE) {
+        ESP_LOGW(TAG, "Connection closed before the response was complete");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
+
+bool http_response_is_complete(const http_response_t *resp) {
+    return resp->state == HTTP_RESPONSE_COMPLETE;
+}
+
+int64_t http_response_freshness(const http_response_t *resp) {
+    if (resp->max_age_s < 0) {
+        return -1;
+    }
+    return (resp->max_age_s > resp->age_s) ? resp->max_age_s - resp->age_s : 0;
+}
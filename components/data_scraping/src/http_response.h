@@ -0,0 +1,108 @@
+/**
+ * @file    http_response.h
+ * @brief   Incremental HTTP/1.1 response parser (status line, headers, message framing)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "http_decoder.h"
+
+/* Callback receiving consecutive fragments of the (de-chunked and decoded) response body */
+typedef esp_err_t (*http_body_cb_t)(void *ctx, const char *data, size_t len);
+
+/* HTTP response parser state */
+typedef enum {
+    HTTP_RESPONSE_STATUS = 0x00,        // Reading the status line
+    HTTP_RESPONSE_HEADERS = 0x01,       // Reading header lines
+    HTTP_RESPONSE_BODY = 0x02,          // Reading a body delimited by Content-Length or connection close
+    HTTP_RESPONSE_CHUNK_SIZE = 0x03,    // Reading a chunk-size line
+    HTTP_RESPONSE_CHUNK_DATA = 0x04,    // Reading chunk data
+    HTTP_RESPONSE_CHUNK_END = 0x05,     // Reading CRLF after chunk data
+    HTTP_RESPONSE_TRAILER = 0x06,       // Reading trailer lines after the last chunk
+    HTTP_RESPONSE_COMPLETE = 0x07       // Whole response received
+} http_response_state_t;
+
+/* HTTP response parser context */
+typedef struct {
+    http_response_state_t state;    // Current state
+    int status;                     // Status code (e.g. 200)
+    bool keep_alive;                // Connection can be reused after this response
+    bool chunked;                   // Transfer-Encoding: chunked
+    http_coding_t coding;           // Content-Encoding of the body
+    int64_t content_length;         // Content-Length (-1 if not present)
+    int64_t range_start;            // First byte position from Content-Range (-1 if not present)
+    uint64_t remaining;             // Bytes left in the body / current chunk
+    uint64_t body_received;         // Body bytes received so far (before content decoding)
+    char etag[HTTP_VALIDATOR_MAX_LEN];          // ETag header value (empty if not present or too long)
+    char last_modified[HTTP_VALIDATOR_MAX_LEN]; // Last-Modified header value (empty if not present or too long)
+    int64_t max_age_s;              // Cache-Control max-age (-1 if not present, 0 for no-cache / no-store)
+    int64_t age_s;                  // Age header (0 if not present)
+    char line[HTTP_LINE_MAX_LEN];   // Current status/header/chunk-size line (truncated if longer)
+    size_t line_len;                // Length of the current line
+    http_body_cb_t body_cb;         // Body callback
+    void *cb_ctx;                   // Body callback context
+    http_decoder_t *decoder;        // Decoder for compressed bodies (NULL if compression is not accepted)
+} http_response_t;
+
+/**
+ * @brief Initialise the parser for a new response.
+ *
+ * @param resp    Pointer to the parser context. Must not be NULL.
+ * @param body_cb Callback receiving the body (may be NULL if the body is not needed).
+ * @param cb_ctx  Context passed to the callback.
+ */
+void http_response_init(http_response_t *resp, http_body_cb_t body_cb, void *cb_ctx);
+
+/**
+ * @brief Attach a content decoder, so that gzip / deflate encoded bodies are decoded before the body callback.
+ *
+ * @param resp    Pointer to the parser context. Must not be NULL.
+ * @param decoder Pointer to a decoder (its buffers are allocated on the first compressed body), or NULL to reject
+ *                compressed bodies.
+ */
+void http_response_set_decoder(http_response_t *resp, http_decoder_t *decoder);
+
+/**
+ * @brief Feed the next fragment of the response stream.
+ *
+ * @param resp     Pointer to the parser context. Must not be NULL.
+ * @param data     Response fragment.
+ * @param len      Length of the fragment.
+ * @param consumed Optional pointer where the number of consumed bytes is stored (less than `len` only
+ *                 if the response completed inside the fragment).
+ * @return ESP_OK once the response is complete, ESP_ERR_NOT_FINISHED if more data is needed,
+ *         ESP_ERR_INVALID_RESPONSE if the response is malformed, ESP_ERR_NO_MEM if the decoder of a compressed
+ *         body could not be allocated, or the error returned by the body callback.
+ */
+esp_err_t http_response_feed(http_response_t *resp, const char *data, size_t len, size_t *consumed);
+
+/**
+ * @brief Signal that the peer closed the connection.
+ *
+ * @param resp Pointer to the parser context. Must not be NULL.
+ * @return ESP_OK if the response is complete (including bodies delimited by connection close),
+ *         ESP_ERR_INVALID_RESPONSE if the response was truncated.
+ */
+esp_err_t http_response_finish(http_response_t *resp);
+
+/**
+ * @brief Check if the response has been received completely.
+ *
+ * @param resp Pointer to the parser context. Must not be NULL.
+ * @return true if complete, false otherwise.
+ */
+bool http_response_is_complete(const http_response_t *resp);
+
+/**
+ * @brief Get the remaining freshness lifetime of the response (Cache-Control max-age minus Age).
+ *
+ * @param resp Pointer to the parser context. Must not be NULL.
+ * @return Seconds the response stays fresh (0 if already stale or not cacheable), -1 if the server did not say.
+ */
+int64_t http_response_freshness(const http_response_t *resp);
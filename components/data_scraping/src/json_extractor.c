@@ -0,0 +1,443 @@
+/**
+ * @file    json_extractor.c
+ * @brief   Incremental (SAX-style) extraction of numeric values addressed by JSON paths
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "json_extractor.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#define TAG "json_extractor"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+ * @brief Compile a path expression into steps.
+ *
+ * @param ex Pointer to the extractor context.
+ * @param p  Path index.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the path is malformed,
+ *         ESP_ERR_INVALID_SIZE if it has too many steps.
+ */
+static esp_err_t json_extractor_compile(json_extractor_t *ex, uint8_t p) {
+    const char *c = ex->paths[p].path;
+    uint8_t count = 0;
+
+    while (*c != '\0') {
+        if (count == JSON_EXTRACTOR_MAX_STEPS) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        json_extractor_step_t *step = &ex->steps[p][count++];
+
+        if (*c == '[') {
+            uint32_t index = 0;
+            const char *digits = ++c;
+            while (isdigit((unsigned char)*c) && index <= UINT16_MAX) {
+                index = index * 10 + (uint32_t)(*c++ - '0');
+            }
+            if (c == digits || *c != ']' || index > UINT16_MAX) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            c++;
+            step->key = NULL;
+            step->key_len = 0;
+            step->index = (uint16_t)index;
+        } else {
+            const char *key = c;
+            while (*c != '\0' && *c != '.' && *c != '[') {
+                c++;
+            }
+            if (c == key || c - key > UINT8_MAX) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            step->key = key;
+            step->key_len = (uint8_t)(c - key);
+            step->index = 0;
+        }
+
+        if (*c == '.') {
+            c++;
+            if (*c == '\0' || *c == '.' || *c == '[') {
+                return ESP_ERR_INVALID_ARG;
+            }
+        }
+    }
+
+    if (count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    ex->step_count[p] = count;
+    return ESP_OK;
+}
+
+/**
+ * @brief Get the paths that select a given element of the array at a given level.
+ *
+ * @param ex    Pointer to the extractor context.
+ * @param level Index of the array level.
+ * @return Bit mask of paths.
+ */
+static uint32_t json_extractor_element_mask(const json_extractor_t *ex, uint8_t level) {
+    if (level >= JSON_EXTRACTOR_MAX_STEPS) {
+        return 0;
+    }
+
+    uint32_t mask = ex->levels[level].mask;
+    for (uint32_t m = mask; m != 0; m &= m - 1) {
+        uint8_t p = (uint8_t)__builtin_ctz(m);
+        if (ex->steps[p][level].index != ex->levels[level].index) {
+            mask &= ~(1u << p);
+        }
+    }
+    return mask;
+}
+
+/**
+ * @brief Process one character of a number (or of a string holding a number).
+ *
+ * @param ex Pointer to the extractor context.
+ * @param c  Character to process.
+ */
+static void json_extractor_number_char(json_extractor_t *ex, char c) {
+    ex->fingerprint = (ex->fingerprint ^ (uint8_t)c) * FNV_PRIME;
+    if (!decimal_parser_char(&ex->number, c)) {
+        ex->invalid = true;
+    }
+}
+
+/**
+ * @brief End a scalar value and store it for all paths that selected it.
+ *
+ * @param ex Pointer to the extractor context.
+ */
+static void json_extractor_end_scalar(json_extractor_t *ex) {
+    for (uint32_t m = ex->invalid ? 0 : ex->capture; m != 0; m &= m - 1) {
+        uint8_t p = (uint8_t)__builtin_ctz(m);
+        decimal_parser_t number = ex->number;
+        number.scale = ex->paths[p].scale;  // Paths selecting the same value may use different scales
+        number.rounding = ex->paths[p].rounding;
+        if (decimal_parser_result(&number, &ex->values[p]) == ESP_OK) {
+            ex->found |= (1u << p);
+            ex->fingerprint = (ex->fingerprint ^ (1u << p)) * FNV_PRIME;
+        }
+    }
+    ex->capture = 0;
+
+    if (ex->found == ex->all_mask) {
+        ex->state = JSON_EXTRACTOR_DONE;
+    } else {
+        ex->state = (ex->depth == 0) ? JSON_EXTRACTOR_DONE : JSON_EXTRACTOR_AFTER_VALUE;
+    }
+}
+
+/**
+ * @brief Open an object or array.
+ *
+ * @param ex    Pointer to the extractor context.
+ * @param array true for an array, false for an object.
+ */
+static void json_extractor_open(json_extractor_t *ex, bool array) {
+    uint8_t level = ex->depth;
+
+    if (level == JSON_EXTRACTOR_MAX_NESTING) {
+        ESP_LOGE(TAG, "Document nested too deeply");
+        ex->state = JSON_EXTRACTOR_ERROR;
+        return;
+    }
+
+    if (level < JSON_EXTRACTOR_MAX_STEPS) {
+        uint32_t mask = ex->value_mask;
+        for (uint32_t m = mask; m != 0; m &= m - 1) {
+            uint8_t p = (uint8_t)__builtin_ctz(m);
+            if (ex->step_count[p] <= level || (ex->steps[p][level].key_len == 0) != array) {
+                mask &= ~(1u << p);
+            }
+        }
+        ex->levels[level].mask = mask;
+        ex->levels[level].index = 0;
+    }
+
+    if (array) {
+        ex->arrays |= (1ull << level);
+    } else {
+        ex->arrays &= ~(1ull << level);
+    }
+    ex->depth++;
+
+    if (array) {
+        ex->value_mask = json_extractor_element_mask(ex, level);
+        ex->state = JSON_EXTRACTOR_VALUE;
+    } else {
+        ex->state = JSON_EXTRACTOR_KEY_START;
+    }
+}
+
+/**
+ * @brief Close the innermost object or array.
+ *
+ * @param ex Pointer to the extractor context.
+ * @param c  Closing bracket.
+ */
+static void json_extractor_close(json_extractor_t *ex, char c) {
+    bool array = (ex->depth > 0) && (ex->arrays & (1ull << (ex->depth - 1)));
+
+    if (ex->depth == 0 || (c == ']') != array) {
+        ESP_LOGE(TAG, "Unexpected '%c'", c);
+        ex->state = JSON_EXTRACTOR_ERROR;
+        return;
+    }
+
+    ex->depth--;
+    ex->state = (ex->depth == 0) ? JSON_EXTRACTOR_DONE : JSON_EXTRACTOR_AFTER_VALUE;
+}
+
+/**
+ * @brief Start a value.
+ *
+ * @param ex Pointer to the extractor context.
+ * @param c  First character of the value.
+ * @return true if the character was consumed, false if it has to be processed again in the new state.
+ */
+static bool json_extractor_value(json_extractor_t *ex, char c) {
+    ex->capture = 0;
+    for (uint32_t m = ex->value_mask; m != 0; m &= m - 1) {
+        uint8_t p = (uint8_t)__builtin_ctz(m);
+        if (ex->step_count[p] == ex->depth) {
+            ex->capture |= (1u << p);
+        }
+    }
+    decimal_parser_start(&ex->number, 0, DECIMAL_ROUND_TRUNCATE, true);  // Scale is applied per path at the end
+    ex->invalid = false;
+
+    if (c == '{' || c == '[') {
+        json_extractor_open(ex, c == '[');
+    } else if (c == ']') {
+        json_extractor_close(ex, c);  // Empty array
+    } else if (c == '"') {
+        ex->state = JSON_EXTRACTOR_STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        ex->state = JSON_EXTRACTOR_NUMBER;
+        return false;
+    } else if (c == 't' || c == 'f' || c == 'n') {
+        ex->state = JSON_EXTRACTOR_LITERAL;
+    } else {
+        ESP_LOGE(TAG, "Unexpected '%c'", c);
+        ex->state = JSON_EXTRACTOR_ERROR;
+    }
+    return true;
+}
+
+/**
+ * @brief Process one character of an object key, dropping paths whose key no longer matches.
+ *
+ * @param ex Pointer to the extractor context.
+ * @param c  Character of the key.
+ */
+static void json_extractor_key_char(json_extractor_t *ex, char c) {
+    uint8_t level = ex->depth - 1;
+    for (uint32_t m = ex->key_mask; m != 0; m &= m - 1) {
+        uint8_t p = (uint8_t)__builtin_ctz(m);
+        const json_extractor_step_t *step = &ex->steps[p][level];
+        if (ex->key_len >= step->key_len || step->key[ex->key_len] != c) {
+            ex->key_mask &= ~(1u << p);
+        }
+    }
+    if (ex->key_len < UINT8_MAX) {
+        ex->key_len++;
+    }
+}
+
+esp_err_t json_extractor_init(json_extractor_t *ex, const json_extractor_path_t *paths, uint8_t count) {
+    esp_err_t err;
+
+    if (ex == NULL || paths == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (count == 0 || count > JSON_EXTRACTOR_MAX_PATHS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memset(ex, 0, sizeof(json_extractor_t));
+    ex->paths = paths;
+    ex->path_count = count;
+    ex->all_mask = (1u << count) - 1;
+    for (uint8_t p = 0; p < count; p++) {
+        if (paths[p].path == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        } else if ((err = json_extractor_compile(ex, p)) != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid path \"%s\"", paths[p].path);
+            return err;
+        }
+    }
+
+    json_extractor_reset(ex);
+    return ESP_OK;
+}
+
+void json_extractor_reset(json_extractor_t *ex) {
+    ex->state = JSON_EXTRACTOR_VALUE;
+    ex->depth = 0;
+    ex->arrays = 0;
+    ex->value_mask = ex->all_mask;
+    ex->key_mask = 0;
+    ex->key_len = 0;
+    ex->capture = 0;
+    ex->fingerprint = FNV_OFFSET_BASIS;
+    ex->found = 0;
+    ex->invalid = false;
+    memset(ex->values, 0, sizeof(ex->values));
+}
+
+esp_err_t json_extractor_feed(json_extractor_t *ex, const char *data, size_t len) {
+    if (ex == NULL || (data == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t i = 0;
+    while (i < len && ex->state < JSON_EXTRACTOR_DONE) {
+        char c = data[i];
+        bool ws = (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+
+        switch (ex->state) {
+            case JSON_EXTRACTOR_VALUE:
+                if (!ws && !json_extractor_value(ex, c)) {
+                    continue;  // First character of a number
+                }
+                break;
+
+            case JSON_EXTRACTOR_KEY_START:
+                if (c == '"') {
+                    uint8_t level = ex->depth - 1;
+                    ex->key_mask = (level < JSON_EXTRACTOR_MAX_STEPS) ? ex->levels[level].mask : 0;
+                    ex->key_len = 0;
+                    ex->state = JSON_EXTRACTOR_KEY;
+                } else if (c == '}') {
+                    json_extractor_close(ex, c);
+                } else if (!ws) {
+                    ESP_LOGE(TAG, "Expected an object key, got '%c'", c);
+                    ex->state = JSON_EXTRACTOR_ERROR;
+                }
+                break;
+
+            case JSON_EXTRACTOR_KEY:
+                if (c == '"') {
+                    uint8_t level = ex->depth - 1;
+                    for (uint32_t m = ex->key_mask; m != 0; m &= m - 1) {
+                        uint8_t p = (uint8_t)__builtin_ctz(m);
+                        if (ex->steps[p][level].key_len != ex->key_len) {
+                            ex->key_mask &= ~(1u << p);
+                        }
+                    }
+                    ex->state = JSON_EXTRACTOR_COLON;
+                } else if (c == '\\') {
+                    ex->key_mask = 0;  // Escaped keys are never matched
+                    ex->state = JSON_EXTRACTOR_KEY_ESCAPE;
+                } else if (ex->key_mask != 0) {
+                    json_extractor_key_char(ex, c);
+                }
+                break;
+
+            case JSON_EXTRACTOR_KEY_ESCAPE:
+                ex->state = JSON_EXTRACTOR_KEY;
+                break;
+
+            case JSON_EXTRACTOR_COLON:
+                if (c == ':') {
+                    ex->value_mask = ex->key_mask;
+                    ex->state = JSON_EXTRACTOR_VALUE;
+                } else if (!ws) {
+                    ESP_LOGE(TAG, "Expected ':', got '%c'", c);
+                    ex->state = JSON_EXTRACTOR_ERROR;
+                }
+                break;
+
+            case JSON_EXTRACTOR_AFTER_VALUE:
+                if (c == ',') {
+                    uint8_t level = ex->depth - 1;
+                    if (ex->arrays & (1ull << level)) {
+                        if (level < JSON_EXTRACTOR_MAX_STEPS && ex->levels[level].index < UINT16_MAX) {
+                            ex->levels[level].index++;
+                        }
+                        ex->value_mask = json_extractor_element_mask(ex, level);
+                        ex->state = JSON_EXTRACTOR_VALUE;
+                    } else {
+                        ex->state = JSON_EXTRACTOR_KEY_START;
+                    }
+                } else if (c == '}' || c == ']') {
+                    json_extractor_close(ex, c);
+                } else if (!ws) {
+                    ESP_LOGE(TAG, "Expected ',' or end of container, got '%c'", c);
+                    ex->state = JSON_EXTRACTOR_ERROR;
+                }
+                break;
+
+            case JSON_EXTRACTOR_STRING:
+                if (c == '"') {
+                    json_extractor_end_scalar(ex);
+                } else if (c == '\\') {
+                    ex->invalid = true;
+                    ex->state = JSON_EXTRACTOR_STRING_ESCAPE;
+                } else if (ex->capture != 0) {
+                    json_extractor_number_char(ex, c);  // Numbers are often sent as strings
+                }
+                break;
+
+            case JSON_EXTRACTOR_STRING_ESCAPE:
+                ex->state = JSON_EXTRACTOR_STRING;
+                break;
+
+            case JSON_EXTRACTOR_NUMBER:
+                if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                    if (ex->capture != 0) {
+                        json_extractor_number_char(ex, c);
+                    }
+                } else {
+                    json_extractor_end_scalar(ex);
+                    continue;  // The terminating character belongs to the enclosing container
+                }
+                break;
+
+            case JSON_EXTRACTOR_LITERAL:
+                if (!isalpha((unsigned char)c)) {
+                    json_extractor_end_scalar(ex);
+                    continue;
+                }
+                break;
+
+            default:
+                break;
+        }
+        i++;
+    }
+
+    if (ex->state == JSON_EXTRACTOR_ERROR) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return (ex->found == ex->all_mask) ? ESP_OK : ESP_ERR_NOT_FINISHED;
+}
+
+bool json_extractor_is_done(const json_extractor_t *ex) {
+    return ex->found == ex->all_mask;
+}
+
+esp_err_t json_extractor_finish(json_extractor_t *ex, json_extractor_result_t *result) {
+    if (ex == NULL || result == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (ex->state == JSON_EXTRACTOR_NUMBER && ex->depth == 0) {
+        json_extractor_end_scalar(ex);  // Document is a single number without a trailing newline
+    }
+
+    result->found = ex->found;
+    memcpy(result->values, ex->values, sizeof(result->values));
+    return (ex->found != 0) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+uint32_t json_extractor_fingerprint(const json_extractor_t *ex) {
+    return (ex->fingerprint ^ ex->found) * FNV_PRIME;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file    json_extractor.h
+ * @brief   Incremental (SAX-style) extraction of numeric values addressed by JSON paths
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "decimal_parser.h"
+
+#define JSON_EXTRACTOR_MAX_PATHS 8      // Max number of paths extracted in one pass
+#define JSON_EXTRACTOR_MAX_STEPS 8      // Max number of steps (keys / indices) in a path
+#define JSON_EXTRACTOR_MAX_NESTING 64   // Max nesting of objects / arrays in the document
+
+/* Path definition (kept by the caller for the lifetime of the extractor, usually a static const table) */
+typedef struct {
+    const char *name;                   // Name of the value (e.g. "freq")
+    const char *path;                   // Path to the value (e.g. "data.items[0].freq")
+    uint8_t scale;                      // Fractional digits kept in the scaled integer value
+    decimal_rounding_t rounding;        // Rounding of the digits beyond the scale
+} json_extractor_path_t;
+
+/* Compiled path step */
+typedef struct {
+    const char *key;                    // Object key (points into the path string, not null-terminated)
+    uint8_t key_len;                    // Length of the key (0 for an array index)
+    uint16_t index;                     // Array index
+} json_extractor_step_t;
+
+/* Tokenizer state */
+typedef enum {
+    JSON_EXTRACTOR_VALUE = 0x00,        // Expecting a value
+    JSON_EXTRACTOR_KEY_START = 0x01,    // Expecting an object key (or the end of the object)
+    JSON_EXTRACTOR_KEY = 0x02,          // Inside an object key
+    JSON_EXTRACTOR_KEY_ESCAPE = 0x03,   // After a backslash in an object key
+    JSON_EXTRACTOR_COLON = 0x04,        // Expecting the colon after a key
+    JSON_EXTRACTOR_AFTER_VALUE = 0x05,  // Expecting a comma or the end of the container
+    JSON_EXTRACTOR_STRING = 0x06,       // Inside a string value
+    JSON_EXTRACTOR_STRING_ESCAPE = 0x07,    // After a backslash in a string value
+    JSON_EXTRACTOR_NUMBER = 0x08,       // Inside a number
+    JSON_EXTRACTOR_LITERAL = 0x09,      // Inside true / false / null
+    JSON_EXTRACTOR_DONE = 0x0A,         // All values extracted or end of the document
+    JSON_EXTRACTOR_ERROR = 0x0B         // Malformed document
+} json_extractor_state_t;
+
+/* Open container */
+typedef struct {
+    uint32_t mask;                      // Paths that may continue inside this container
+    uint16_t index;                     // Index of the current element (arrays)
+} json_extractor_level_t;
+
+/* JSON extractor context (keeps its state between consecutive chunks, never holds the document) */
+typedef struct {
+    const json_extractor_path_t *paths;                     // Path definitions
+    uint8_t path_count;                                     // Number of paths
+    uint32_t all_mask;                                      // Bit mask of all paths
+    json_extractor_step_t steps[JSON_EXTRACTOR_MAX_PATHS][JSON_EXTRACTOR_MAX_STEPS];   // Compiled paths
+    uint8_t step_count[JSON_EXTRACTOR_MAX_PATHS];           // Number of steps of each path
+    json_extractor_state_t state;                           // Current state
+    uint8_t depth;                                          // Number of open containers
+    uint64_t arrays;                                        // Bit n set if container at depth n+1 is an array
+    json_extractor_level_t levels[JSON_EXTRACTOR_MAX_STEPS];    // Open containers that can still match
+    uint32_t value_mask;                                    // Paths matching the value that follows
+    uint32_t key_mask;                                      // Paths whose key matches the key read so far
+    uint8_t key_len;                                        // Length of the key read so far
+    uint32_t capture;                                       // Paths fully matched by the current value
+    decimal_parser_t number;                                // Number accumulator
+    bool invalid;                                           // Captured value is not a valid number
+    uint32_t fingerprint;                                   // FNV-1a hash of the captured value tokens
+    uint32_t found;                                         // Paths whose value was extracted
+    int32_t values[JSON_EXTRACTOR_MAX_PATHS];               // Extracted scaled values (valid if the bit is set)
+} json_extractor_t;
+
+/* Values extracted from one document */
+typedef struct {
+    uint32_t found;                                         // Bit mask of paths whose value was extracted
+    int32_t values[JSON_EXTRACTOR_MAX_PATHS];               // Scaled values in path order (valid if the bit is set)
+} json_extractor_result_t;
+
+/**
+ * @brief Initialise the JSON extractor and compile the paths.
+ *
+ * Paths are object keys separated by dots, with array indices in brackets (e.g. "data.items[0].freq").
+ *
+ * @param ex    Pointer to the extractor context. Must not be NULL.
+ * @param paths Path definitions (not copied, must outlive the extractor). Must not be NULL.
+ * @param count Number of paths.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a path is malformed,
+ *         ESP_ERR_INVALID_SIZE if there are too many paths or steps.
+ */
+esp_err_t json_extractor_init(json_extractor_t *ex, const json_extractor_path_t *paths, uint8_t count);
+
+/**
+ * @brief Reset the extractor state so that a new document can be fed (compiled paths are kept).
+ *
+ * @param ex Pointer to the extractor context. Must not be NULL.
+ */
+void json_extractor_reset(json_extractor_t *ex);
+
+/**
+ * @brief Feed the next chunk of the document.
+ *
+ * @param ex   Pointer to the extractor context. Must not be NULL.
+ * @param data Chunk of the document (does not have to be null-terminated).
+ * @param len  Length of the chunk.
+ * @return ESP_OK once all values have been extracted, ESP_ERR_NOT_FINISHED if more data is needed,
+ *         ESP_ERR_INVALID_RESPONSE if the document is malformed.
+ */
+esp_err_t json_extractor_feed(json_extractor_t *ex, const char *data, size_t len);
+
+/**
+ * @brief Check if all values have already been extracted (the rest of the document can be skipped).
+ *
+ * @param ex Pointer to the extractor context. Must not be NULL.
+ * @return true if all values have been extracted, false otherwise.
+ */
+bool json_extractor_is_done(const json_extractor_t *ex);
+
+/**
+ * @brief Finish the extraction (e.g. on connection close) and retrieve the values.
+ *
+ * @param ex     Pointer to the extractor context. Must not be NULL.
+ * @param result Pointer to the result structure.
+ * @return ESP_OK if at least one value was extracted, ESP_ERR_NOT_FOUND otherwise.
+ */
+esp_err_t json_extractor_finish(json_extractor_t *ex, json_extractor_result_t *result);
+
+/**
+ * @brief Get a combined fingerprint of the tokens of all extracted values.
+ *
+ * @param ex Pointer to the extractor context. Must not be NULL.
+ * @return Fingerprint (equal for documents with identical values).
+ */
+uint32_t json_extractor_fingerprint(const json_extractor_t *ex);
@@ -0,0 +1,97 @@
+/**
+ * @file    latency_histogram.c
+ * @brief   Fixed-bucket log-scale latency histograms
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "latency_histogram.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TAG "latency_histogram"
+
+void latency_histogram_reset(latency_histogram_t *h) {
+    memset(h, 0, sizeof(*h));
+}
+
+/**
+ * @brief Find the bucket of a sample (bucket n holds samples below LATENCY_HISTOGRAM_BASE_US * 2^n).
+ */
+static uint8_t latency_histogram_bucket(int64_t us) {
+    uint8_t bucket = 0;
+    int64_t limit = LATENCY_HISTOGRAM_BASE_US;
+
+    while (us >= limit && bucket < LATENCY_HISTOGRAM_BUCKETS - 1) {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void latency_histogram_add(latency_histogram_t *h, int64_t us) {
+    if (us < 0) {
+        us = 0;
+    }
+    if (h->count == 0 || us < h->min_us) {
+        h->min_us = us;
+    }
+    if (h->count == 0 || us > h->max_us) {
+        h->max_us = us;
+    }
+    h->count++;
+    h->sum_us += us;
+    h->buckets[latency_histogram_bucket(us)]++;
+}
+
+int64_t latency_histogram_bucket_limit(uint8_t bucket) {
+    if (bucket >= LATENCY_HISTOGRAM_BUCKETS - 1) {
+        return INT64_MAX;
+    }
+    return (int64_t)LATENCY_HISTOGRAM_BASE_US << bucket;
+}
+
+int64_t latency_histogram_percentile(const latency_histogram_t *h, uint8_t percent) {
+    if (h->count == 0) {
+        return -1;
+    }
+
+    /* Rank of the sample (1-based, rounded up) */
+    uint32_t rank = (uint32_t)(((uint64_t)h->count * (percent > 100 ? 100 : percent) + 99) / 100);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            int64_t limit = latency_histogram_bucket_limit(i);
+            return (limit < h->max_us) ? limit : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+size_t latency_histogram_format(const latency_histogram_t *h, char *buf, size_t size) {
+    size_t len = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    for (uint8_t i = 0; i < LATENCY_HISTOGRAM_BUCKETS && len < size; i++) {
+        if (h->buckets[i] == 0) {
+            continue;
+        }
+        if (i == LATENCY_HISTOGRAM_BUCKETS - 1) {
+            len += snprintf(buf + len, size - len, "%s>=%" PRId64 "ms:%" PRIu32, (len > 0) ? " " : "",
+                            latency_histogram_bucket_limit(i - 1) / 1000, h->buckets[i]);
+        } else {
+            len += snprintf(buf + len, size - len, "%s<%" PRId64 "ms:%" PRIu32, (len > 0) ? " " : "",
+                            latency_histogram_bucket_limit(i) / 1000, h->buckets[i]);
+        }
+    }
+    return (len < size) ? len : size - 1;
+}
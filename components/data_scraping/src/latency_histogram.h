@@ -0,0 +1,66 @@
+/**
+ * @file    latency_histogram.h
+ * @brief   Fixed-bucket log-scale latency histograms
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+
+#define LATENCY_HISTOGRAM_BUCKETS 16        // Bucket 0: < 1 ms, bucket n: [2^(n-1), 2^n) ms, last bucket open-ended
+#define LATENCY_HISTOGRAM_BASE_US 1000      // Upper bound of bucket 0
+
+/* Latency histogram (fixed size, no allocation) */
+typedef struct {
+    uint32_t count;                                 // Number of samples
+    int64_t sum_us;                                 // Sum of the samples
+    int64_t min_us;                                 // Smallest sample (valid if count > 0)
+    int64_t max_us;                                 // Largest sample (valid if count > 0)
+    uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];    // Samples per bucket
+} latency_histogram_t;
+
+/**
+ * @brief Clear the histogram.
+ *
+ * @param h Pointer to the histogram. Must not be NULL.
+ */
+void latency_histogram_reset(latency_histogram_t *h);
+
+/**
+ * @brief Add a sample to the histogram.
+ *
+ * @param h  Pointer to the histogram. Must not be NULL.
+ * @param us Sample in microseconds (negative values are counted as 0).
+ */
+void latency_histogram_add(latency_histogram_t *h, int64_t us);
+
+/**
+ * @brief Get the upper bound of a bucket.
+ *
+ * @param bucket Bucket index.
+ * @return Upper bound in microseconds (INT64_MAX for the last bucket).
+ */
+int64_t latency_histogram_bucket_limit(uint8_t bucket);
+
+/**
+ * @brief Estimate a percentile as the upper bound of the bucket containing it (capped at the max sample).
+ *
+ * @param h       Pointer to the histogram. Must not be NULL.
+ * @param percent Percentile (0-100).
+ * @return Estimated percentile in microseconds, -1 if the histogram is empty.
+ */
+int64_t latency_histogram_percentile(const latency_histogram_t *h, uint8_t percent);
+
+/**
+ * @brief Format the non-empty buckets as "<1ms:3 <2ms:5 ...".
+ *
+ * @param h    Pointer to the histogram. Must not be NULL.
+ * @param buf  Output buffer.
+ * @param size Size of the buffer.
+ * @return Length of the formatted string.
+ */
+size_t latency_histogram_format(const latency_histogram_t *h, char *buf, size_t size);
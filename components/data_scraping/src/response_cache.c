@@ -0,0 +1,38 @@
+/**
+ * @file    response_cache.c
+ * @brief   Validators and value-window fingerprint of the last parsed response (conditional GET)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "response_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+size_t response_cache_add_validators(const response_cache_t *rc, char *buf, size_t len, size_t size) {
+    if (!FETCH_CONDITIONAL_GET || !rc->valid) {
+        return len;
+    }
+    if (rc->etag[0] != '\0' && len < size) {
+        len += snprintf(buf + len, size - len, "If-None-Match: %s\r\n", rc->etag);
+    }
+    if (rc->last_modified[0] != '\0' && len < size) {
+        len += snprintf(buf + len, size - len, "If-Modified-Since: %s\r\n", rc->last_modified);
+    }
+    return len;
+}
+
+bool response_cache_not_modified(const response_cache_t *rc, const http_response_t *resp) {
+    return rc->valid && resp->status == 304;
+}
+
+bool response_cache_same_windows(const response_cache_t *rc, bool done, uint32_t fingerprint) {
+    return rc->valid && done && fingerprint == rc->fingerprint;
+}
+
+void response_cache_store(response_cache_t *rc, const http_response_t *resp, uint32_t fingerprint) {
+    strlcpy(rc->etag, resp->etag, sizeof(rc->etag));
+    strlcpy(rc->last_modified, resp->last_modified, sizeof(rc->last_modified));
+    rc->fingerprint = fingerprint;
+    rc->valid = true;
+}
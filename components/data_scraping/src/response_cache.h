@@ -0,0 +1,61 @@
+/**
+ * @file    response_cache.h
+ * @brief   Validators and value-window fingerprint of the last parsed response (conditional GET)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "http_response.h"
+
+/* State of the last successfully parsed response of a source */
+typedef struct {
+    char etag[HTTP_VALIDATOR_MAX_LEN];          // ETag of the response
+    char last_modified[HTTP_VALIDATOR_MAX_LEN]; // Last-Modified of the response
+    uint32_t fingerprint;                       // Fingerprint of its value windows
+    bool valid;                                 // A response has been stored
+} response_cache_t;
+
+/**
+ * @brief Append If-None-Match / If-Modified-Since with the stored validators (if FETCH_CONDITIONAL_GET is set).
+ *
+ * @param rc   Pointer to the cache. Must not be NULL.
+ * @param buf  Request being built.
+ * @param len  Length of the request so far.
+ * @param size Size of the buffer.
+ * @return New length of the request.
+ */
+size_t response_cache_add_validators(const response_cache_t *rc, char *buf, size_t len, size_t size);
+
+/**
+ * @brief Check if the server confirmed that the stored response is still current (304 Not Modified).
+ *
+ * @param rc   Pointer to the cache. Must not be NULL.
+ * @param resp Pointer to the parsed response. Must not be NULL.
+ * @return true if the stored values can be used without parsing the body.
+ */
+bool response_cache_not_modified(const response_cache_t *rc, const http_response_t *resp);
+
+/**
+ * @brief Check if all value windows of the response are identical to the stored ones (servers without validators).
+ *
+ * @param rc          Pointer to the cache. Must not be NULL.
+ * @param done        All values of the response were extracted.
+ * @param fingerprint Fingerprint of the value windows of the response.
+ * @return true if the stored values can be used.
+ */
+bool response_cache_same_windows(const response_cache_t *rc, bool done, uint32_t fingerprint);
+
+/**
+ * @brief Store the validators and the fingerprint of a successfully parsed response.
+ *
+ * @param rc          Pointer to the cache. Must not be NULL.
+ * @param resp        Pointer to the parsed response. Must not be NULL.
+ * @param fingerprint Fingerprint of the value windows of the response.
+ */
+void response_cache_store(response_cache_t *rc, const http_response_t *resp, uint32_t fingerprint);
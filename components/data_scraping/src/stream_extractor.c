@@ -0,0 +1,344 @@
+/**
+ * @file    stream_extractor.c
+ * @brief   Incremental (chunk-boundary-safe) extraction of numeric values that follow text markers
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "stream_extractor.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#define TAG "stream_extractor"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+
+/**
+ * @brief Find the child of a node reached by a given byte.
+ *
+ * @param ex   Pointer to the extractor context.
+ * @param node Parent node.
+ * @param c    Byte on the edge.
+ * @return Child node, 0 if there is none.
+ */
+static uint16_t stream_extractor_child(const stream_extractor_t *ex, uint16_t node, char c) {
+    for (uint16_t child = ex->nodes[node].child; child != 0; child = ex->nodes[child].sibling) {
+        if (ex->nodes[child].c == c) {
+            return child;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Advance the automaton by one byte, following failure links until a transition exists.
+ *
+ * @param ex   Pointer to the extractor context.
+ * @param node Current node.
+ * @param c    Next byte.
+ * @return Next node.
+ */
+static uint16_t stream_extractor_next(const stream_extractor_t *ex, uint16_t node, char c) {
+    while (true) {
+        uint16_t child = stream_extractor_child(ex, node, c);
+        if (child != 0 || node == 0) {
+            return child;
+        }
+        node = ex->nodes[node].fail;
+    }
+}
+
+/**
+ * @brief Build the Aho-Corasick automaton for all markers, so that every byte of the response is examined
+ *        once regardless of the number of keys, and partial matches split across chunks are never lost.
+ *
+ * @param ex Pointer to the extractor context with keys set.
+ */
+static void stream_extractor_build_automaton(stream_extractor_t *ex) {
+    uint16_t queue[STREAM_EXTRACTOR_MAX_NODES];
+    uint16_t head = 0, tail = 0;
+
+    memset(ex->nodes, 0, sizeof(ex->nodes));
+    memset(ex->first, 0, sizeof(ex->first));
+    ex->node_count = 1;
+
+    /* Trie of the markers */
+    for (uint8_t k = 0; k < ex->key_count; k++) {
+        uint16_t node = 0;
+        for (const char *p = ex->keys[k].marker; *p != '\0'; p++) {
+            uint16_t child = stream_extractor_child(ex, node, *p);
+            if (child == 0) {
+                child = ex->node_count++;
+                ex->nodes[child].c = *p;
+                ex->nodes[child].sibling = ex->nodes[node].child;
+                ex->nodes[node].child = child;
+            }
+            node = child;
+        }
+        ex->nodes[node].output |= (1u << k);
+    }
+
+    /* Failure links in breadth-first order (outputs of suffixes are merged into each node) */
+    for (uint16_t child = ex->nodes[0].child; child != 0; child = ex->nodes[child].sibling) {
+        uint8_t c = (uint8_t)ex->nodes[child].c;
+        ex->first[c >> 3] |= (uint8_t)(1u << (c & 7));
+        queue[tail++] = child;
+    }
+    while (head < tail) {
+        uint16_t node = queue[head++];
+        for (uint16_t child = ex->nodes[node].child; child != 0; child = ex->nodes[child].sibling) {
+            uint16_t fail = stream_extractor_next(ex, ex->nodes[node].fail, ex->nodes[child].c);
+            ex->nodes[child].fail = fail;
+            ex->nodes[child].output |= ex->nodes[fail].output;
+            queue[tail++] = child;
+        }
+    }
+}
+
+/**
+ * @brief Enter the value window of a key.
+ *
+ * @param ex Pointer to the extractor context.
+ * @param k  Key index.
+ */
+static void stream_extractor_open_value(stream_extractor_t *ex, uint8_t k) {
+    stream_extractor_slot_t *slot = &ex->slots[k];
+    slot->remaining = ex->keys[k].window;
+    slot->state = STREAM_EXTRACTOR_VALUE;
+    decimal_parser_start(&slot->number, ex->keys[k].scale, ex->keys[k].rounding, false);
+}
+
+/**
+ * @brief Give up the current match of a key and resume the search.
+ *
+ * @param ex Pointer to the extractor context.
+ * @param k  Key index.
+ */
+static void stream_extractor_abandon(stream_extractor_t *ex, uint8_t k) {
+    ESP_LOGD(TAG, "No value after marker \"%s\", searching further", ex->keys[k].marker);
+    ex->slots[k].state = STREAM_EXTRACTOR_SEARCH;
+    ex->slots[k].fingerprint = FNV_OFFSET_BASIS;
+    ex->active &= ~(1u << k);
+}
+
+/**
+ * @brief Close the value window. Convert the accumulated digits if any were found, otherwise resume the search.
+ *
+ * @param ex  Pointer to the extractor context.
+ * @param k   Key index.
+ * @param end Offset of the first byte after the value.
+ */
+static void stream_extractor_close_value(stream_extractor_t *ex, uint8_t k, uint32_t end) {
+    stream_extractor_slot_t *slot = &ex->slots[k];
+    esp_err_t err = decimal_parser_result(&slot->number, &slot->value);
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_INVALID_SIZE) {
+            ESP_LOGW(TAG, "Value after marker \"%s\" out of range", ex->keys[k].marker);
+        }
+        stream_extractor_abandon(ex, k);
+        return;
+    }
+
+    slot->end_offset = end;
+    slot->state = STREAM_EXTRACTOR_DONE;
+    ex->active &= ~(1u << k);
+    ex->done |= (1u << k);
+}
+
+/**
+ * @brief Process one byte of the value window.
+ *
+ * @param slot Pointer to the key state.
+ * @param c    Byte to process.
+ * @return true if the byte belongs to the number (or to the leading whitespace), false if it terminates it.
+ */
+static bool stream_extractor_value_byte(stream_extractor_slot_t *slot, char c) {
+    if (!slot->number.started && isspace((unsigned char)c)) {
+        return true;  // Leading whitespace (as skipped by sscanf(" %f"))
+    }
+    return decimal_parser_char(&slot->number, c);
+}
+
+/**
+ * @brief Process one byte following the marker of a key (SKIP or VALUE state).
+ *
+ * @param ex Pointer to the extractor context.
+ * @param k  Key index.
+ * @param c  Byte to process.
+ */
+static void stream_extractor_key_byte(stream_extractor_t *ex, uint8_t k, char c) {
+    const stream_extractor_key_t *key = &ex->keys[k];
+    stream_extractor_slot_t *slot = &ex->slots[k];
+
+    slot->fingerprint = (slot->fingerprint ^ (uint8_t)c) * FNV_PRIME;
+    if (slot->state == STREAM_EXTRACTOR_SKIP) {
+        if (key->rule == STREAM_RULE_DELIMITER && c == key->delimiter) {
+            stream_extractor_open_value(ex, k);
+        } else if (--slot->remaining == 0) {
+            if (key->rule == STREAM_RULE_OFFSET) {
+                stream_extractor_open_value(ex, k);
+            } else {
+                stream_extractor_abandon(ex, k);  // No delimiter within the allowed distance
+            }
+        }
+    } else if (!stream_extractor_value_byte(slot, c)) {
+        stream_extractor_close_value(ex, k, ex->position);
+    } else if (--slot->remaining == 0) {
+        stream_extractor_close_value(ex, k, ex->position + 1);
+    }
+}
+
+/**
+ * @brief Start processing a key whose marker has just been matched.
+ *
+ * @param ex Pointer to the extractor context.
+ * @param k  Key index.
+ */
+static void stream_extractor_key_matched(stream_extractor_t *ex, uint8_t k) {
+    const stream_extractor_key_t *key = &ex->keys[k];
+    stream_extractor_slot_t *slot = &ex->slots[k];
+    uint8_t marker_len = (uint8_t)strlen(key->marker);
+
+    slot->match_offset = ex->position + 1 - marker_len;
+    slot->fingerprint = FNV_OFFSET_BASIS;
+    slot->state = STREAM_EXTRACTOR_SKIP;
+    slot->remaining = (key->rule == STREAM_RULE_OFFSET) ? key->offset - marker_len : key->offset;
+    ex->active |= (1u << k);
+    if (slot->remaining == 0) {
+        stream_extractor_open_value(ex, k);
+    }
+}
+
+esp_err_t stream_extractor_init(stream_extractor_t *ex, const stream_extractor_key_t *keys, uint8_t count) {
+    if (ex == NULL || keys == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (count == 0 || count > STREAM_EXTRACTOR_MAX_KEYS) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (uint8_t k = 0; k < count; k++) {
+        if (keys[k].marker == NULL) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        size_t marker_len = strlen(keys[k].marker);
+        if (marker_len == 0 || marker_len > STREAM_EXTRACTOR_MARKER_MAX_LEN || keys[k].window == 0 ||
+            (keys[k].rule == STREAM_RULE_OFFSET && keys[k].offset < marker_len) ||
+            (keys[k].rule == STREAM_RULE_DELIMITER && keys[k].offset == 0)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    ex->keys = keys;
+    ex->key_count = count;
+    ex->all_mask = (count == 32) ? UINT32_MAX : ((1u << count) - 1);
+    stream_extractor_build_automaton(ex);
+    stream_extractor_reset(ex);
+    return ESP_OK;
+}
+
+void stream_extractor_reset(stream_extractor_t *ex) {
+    ex->node = 0;
+    ex->active = 0;
+    ex->done = 0;
+    ex->position = 0;
+    memset(ex->slots, 0, sizeof(ex->slots));
+    for (uint8_t k = 0; k < ex->key_count; k++) {
+        ex->slots[k].state = STREAM_EXTRACTOR_SEARCH;
+        ex->slots[k].fingerprint = FNV_OFFSET_BASIS;
+    }
+}
+
+esp_err_t stream_extractor_feed(stream_extractor_t *ex, const char *data, size_t len) {
+    if (ex == NULL || (data == NULL && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t i = 0; i < len && ex->done != ex->all_mask; i++) {
+        char c = data[i];
+        uint8_t u = (uint8_t)c;
+
+        /* Keys between their marker and the end of their value window */
+        for (uint32_t active = ex->active; active != 0; active &= active - 1) {
+            stream_extractor_key_byte(ex, (uint8_t)__builtin_ctz(active), c);
+        }
+
+        /* Markers (fast path: at the root, most bytes cannot start any marker) */
+        if (ex->node != 0 || (ex->first[u >> 3] & (1u << (u & 7)))) {
+            ex->node = stream_extractor_next(ex, ex->node, c);
+            uint32_t matched = ex->nodes[ex->node].output & ~(ex->active | ex->done);
+            for (; matched != 0; matched &= matched - 1) {
+                stream_extractor_key_matched(ex, (uint8_t)__builtin_ctz(matched));
+            }
+        }
+        ex->position++;
+    }
+
+    return (ex->done == ex->all_mask) ? ESP_OK : ESP_ERR_NOT_FINISHED;
+}
+
+bool stream_extractor_is_done(const stream_extractor_t *ex) {
+    return ex->done == ex->all_mask;
+}
+
+esp_err_t stream_extractor_finish(stream_extractor_t *ex, stream_extractor_result_t *result) {
+    if (ex == NULL || result == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Response ended inside value windows */
+    for (uint32_t active = ex->active; active != 0; active &= active - 1) {
+        uint8_t k = (uint8_t)__builtin_ctz(active);
+        if (ex->slots[k].state == STREAM_EXTRACTOR_VALUE) {
+            stream_extractor_close_value(ex, k, ex->position);
+        }
+    }
+
+    memset(result, 0, sizeof(stream_extractor_result_t));
+    result->found = ex->done;
+    for (uint8_t k = 0; k < ex->key_count; k++) {
+        if (ex->done & (1u << k)) {
+            result->values[k] = ex->slots[k].value;
+        }
+    }
+    return (ex->done != 0) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+uint32_t stream_extractor_fingerprint(const stream_extractor_t *ex) {
+    uint32_t fingerprint = (FNV_OFFSET_BASIS ^ ex->done) * FNV_PRIME;
+    for (uint8_t k = 0; k < ex->key_count; k++) {
+        if (ex->done & (1u << k)) {
+            fingerprint = (fingerprint ^ ex->slots[k].fingerprint) * FNV_PRIME;
+        }
+    }
+    return fingerprint;
+}
+
+esp_err_t stream_extractor_get_span(const stream_extractor_t *ex, uint32_t *start, uint32_t *end) {
+    if (ex == NULL || start == NULL || end == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (ex->done == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *start = UINT32_MAX;
+    *end = 0;
+    for (uint8_t k = 0; k < ex->key_count; k++) {
+        if ((ex->done & (1u << k)) == 0) {
+            continue;
+        }
+        const stream_extractor_slot_t *slot = &ex->slots[k];
+        uint32_t key_end = slot->end_offset;
+        if (ex->keys[k].rule == STREAM_RULE_OFFSET) {
+            key_end = slot->match_offset + ex->keys[k].offset + ex->keys[k].window;  // Whole window
+        }
+        if (slot->match_offset < *start) {
+            *start = slot->match_offset;
+        }
+        if (key_end > *end) {
+            *end = key_end;
+        }
+    }
+    return ESP_OK;
+}
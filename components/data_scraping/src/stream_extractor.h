@@ -0,0 +1,152 @@
+/**
+ * @file    stream_extractor.h
+ * @brief   Incremental (chunk-boundary-safe) extraction of numeric values that follow text markers
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "decimal_parser.h"
+
+#define STREAM_EXTRACTOR_MARKER_MAX_LEN 16  // Max length of a marker string
+#ifndef STREAM_EXTRACTOR_MAX_KEYS
+#define STREAM_EXTRACTOR_MAX_KEYS 8         // Max number of keys extracted in one pass (up to 32)
+#endif
+#define STREAM_EXTRACTOR_MAX_NODES (STREAM_EXTRACTOR_MAX_KEYS * STREAM_EXTRACTOR_MARKER_MAX_LEN + 1)
+
+_Static_assert(STREAM_EXTRACTOR_MAX_KEYS <= 32, "Keys are tracked in a 32-bit mask");
+
+/* Rule locating the value window relative to the marker */
+typedef enum {
+    STREAM_RULE_OFFSET = 0x00,      // Value window starts a fixed number of bytes from the marker start
+    STREAM_RULE_DELIMITER = 0x01    // Value window starts after the first delimiter following the marker
+} stream_extractor_rule_t;
+
+/* Key state */
+typedef enum {
+    STREAM_EXTRACTOR_SEARCH = 0x00,  // Looking for the marker
+    STREAM_EXTRACTOR_SKIP = 0x01,    // Marker found, skipping bytes up to the value window
+    STREAM_EXTRACTOR_VALUE = 0x02,   // Inside the value window, accumulating the number
+    STREAM_EXTRACTOR_DONE = 0x03     // Value extracted, remaining bytes are ignored
+} stream_extractor_state_t;
+
+/* Key definition (kept by the caller for the lifetime of the extractor, usually a static const table) */
+typedef struct {
+    const char *name;                   // Name of the value (e.g. "freq")
+    const char *marker;                 // Marker preceding the value (e.g. "Freq")
+    stream_extractor_rule_t rule;       // How the value window is located
+    uint8_t offset;                     // OFFSET: bytes from marker start to window start,
+                                        // DELIMITER: max bytes after the marker searched for the delimiter
+    uint8_t window;                     // Size of the value window (leading whitespace is skipped)
+    char delimiter;                     // DELIMITER: byte preceding the value window (e.g. ':')
+    uint8_t scale;                      // Fractional digits kept in the scaled integer value
+    decimal_rounding_t rounding;        // Rounding of the digits beyond the scale
+} stream_extractor_key_t;
+
+/* Automaton node (trie with first-child / next-sibling links) */
+typedef struct {
+    char c;                             // Byte on the edge from the parent
+    uint16_t child;                     // First child (0 if none)
+    uint16_t sibling;                   // Next sibling (0 if none)
+    uint16_t fail;                      // Longest proper suffix that is also a trie node
+    uint32_t output;                    // Keys whose marker ends here (including markers that are suffixes)
+} stream_extractor_node_t;
+
+/* Per-key extraction state */
+typedef struct {
+    stream_extractor_state_t state;     // Current state
+    uint8_t remaining;                  // Bytes left to skip / left in the value window
+    decimal_parser_t number;            // Value accumulator
+    int32_t value;                      // Extracted value scaled by 10^scale (valid in STREAM_EXTRACTOR_DONE)
+    uint32_t fingerprint;               // FNV-1a hash of the bytes between the marker and the value end
+    uint32_t match_offset;              // Offset of the first marker character of the match
+    uint32_t end_offset;                // Offset of the first byte after the value
+} stream_extractor_slot_t;
+
+/* Stream extractor context (keeps its state between consecutive chunks) */
+typedef struct {
+    const stream_extractor_key_t *keys;                     // Key definitions
+    uint8_t key_count;                                      // Number of keys
+    uint32_t all_mask;                                      // Bit mask of all keys
+    uint16_t node_count;                                    // Number of automaton nodes (including the root)
+    uint8_t first[32];                                      // Bitmap of bytes starting any marker
+    stream_extractor_node_t nodes[STREAM_EXTRACTOR_MAX_NODES];  // Marker automaton (node 0 is the root)
+    uint16_t node;                                          // Current automaton node
+    uint32_t active;                                        // Keys in SKIP or VALUE state
+    uint32_t done;                                          // Keys in DONE state
+    uint32_t position;                                      // Number of bytes fed since the last reset
+    stream_extractor_slot_t slots[STREAM_EXTRACTOR_MAX_KEYS];   // Per-key state
+} stream_extractor_t;
+
+/* Values extracted from one response */
+typedef struct {
+    uint32_t found;                                         // Bit mask of keys whose value was extracted
+    int32_t values[STREAM_EXTRACTOR_MAX_KEYS];              // Scaled values in key order (valid if the bit is set)
+} stream_extractor_result_t;
+
+/**
+ * @brief Initialise the stream extractor and build the marker automaton.
+ *
+ * @param ex    Pointer to the extractor context. Must not be NULL.
+ * @param keys  Key definitions (not copied, must outlive the extractor). Must not be NULL.
+ * @param count Number of keys.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG or ESP_ERR_INVALID_SIZE if the arguments are invalid.
+ */
+esp_err_t stream_extractor_init(stream_extractor_t *ex, const stream_extractor_key_t *keys, uint8_t count);
+
+/**
+ * @brief Reset the extractor state so that a new response can be fed (configuration is kept).
+ *
+ * @param ex Pointer to the extractor context. Must not be NULL.
+ */
+void stream_extractor_reset(stream_extractor_t *ex);
+
+/**
+ * @brief Feed the next chunk of the response. Every byte is examined exactly once for all keys.
+ *
+ * @param ex   Pointer to the extractor context. Must not be NULL.
+ * @param data Chunk of the response (does not have to be null-terminated).
+ * @param len  Length of the chunk.
+ * @return ESP_OK once all values have been extracted, ESP_ERR_NOT_FINISHED if more data is needed.
+ */
+esp_err_t stream_extractor_feed(stream_extractor_t *ex, const char *data, size_t len);
+
+/**
+ * @brief Check if all values have already been extracted (the rest of the response can be skipped).
+ *
+ * @param ex Pointer to the extractor context. Must not be NULL.
+ * @return true if all values have been extracted, false otherwise.
+ */
+bool stream_extractor_is_done(const stream_extractor_t *ex);
+
+/**
+ * @brief Finish the extraction (e.g. on connection close) and retrieve the values.
+ *
+ * @param ex     Pointer to the extractor context. Must not be NULL.
+ * @param result Pointer to the result structure.
+ * @return ESP_OK if at least one value was extracted, ESP_ERR_NOT_FOUND otherwise.
+ */
+esp_err_t stream_extractor_finish(stream_extractor_t *ex, stream_extractor_result_t *result);
+
+/**
+ * @brief Get a combined fingerprint of the value windows of all extracted keys.
+ *
+ * @param ex Pointer to the extractor context. Must not be NULL.
+ * @return Fingerprint (equal for responses with identical value windows).
+ */
+uint32_t stream_extractor_fingerprint(const stream_extractor_t *ex);
+
+/**
+ * @brief Get the part of the response covering the markers and value windows of all extracted keys.
+ *
+ * @param ex    Pointer to the extractor context. Must not be NULL.
+ * @param start Offset of the first marker.
+ * @param end   Offset of the first byte after the last value window.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no value has been extracted.
+ */
+esp_err_t stream_extractor_get_span(const stream_extractor_t *ex, uint32_t *start, uint32_t *end);
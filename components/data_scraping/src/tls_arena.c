@@ -0,0 +1,178 @@
+/**
+ * @file    tls_arena.c
+ * @brief   Size-class arena serving mbedtls allocations of the fetch task
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "tls_arena.h"
+
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mbedtls/platform.h"
+
+#define TAG "tls_arena"
+
+#define TLS_ARENA_CLASSES 16                        // Max number of size classes (up to TLS_ARENA_MIN_BLOCK << 15)
+#define TLS_ARENA_HEADER sizeof(tls_arena_header_t) // Bytes preceding each block returned to mbedtls
+#define TLS_ARENA_HEAP_CAPS (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)    // Same as CONFIG_MBEDTLS_INTERNAL_MEM_ALLOC
+
+/* Block header (the first bytes of a free block hold the free list link instead of the user data) */
+typedef struct {
+    uint32_t size_class;    // Size class (block size is TLS_ARENA_MIN_BLOCK << size_class)
+    uint32_t requested;     // Bytes requested by mbedtls
+} tls_arena_header_t;
+
+static uint8_t *region = NULL;                      // Arena region (allocated once)
+static size_t top = 0;                              // Bytes of the region carved into blocks
+static uint8_t *free_lists[TLS_ARENA_CLASSES];      // Free blocks of each size class
+static uint8_t class_count = 0;                     // Number of size classes served by the arena
+static TaskHandle_t owner = NULL;                   // Task whose allocations are served by the arena
+static bool bypassed = false;                       // Allocations of the owner go to the heap
+static tls_arena_stats_t stats;                     // Arena counters
+
+/**
+ * @brief Get the smallest size class holding the given number of bytes (header included).
+ */
+static uint8_t tls_arena_class(size_t bytes) {
+    uint8_t size_class = 0;
+    while (((size_t)TLS_ARENA_MIN_BLOCK << size_class) < bytes) {
+        size_class++;
+    }
+    return size_class;
+}
+
+/**
+ * @brief calloc replacement installed in mbedtls.
+ */
+static void *tls_arena_calloc(size_t n, size_t size) {
+    if (size != 0 && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    size_t bytes = n * size;
+
+    if (region != NULL && bytes + TLS_ARENA_HEADER <= TLS_ARENA_MAX_BLOCK && !bypassed &&
+        xTaskGetCurrentTaskHandle() == owner) {
+        uint8_t size_class = tls_arena_class(bytes + TLS_ARENA_HEADER);
+        size_t block_size = (size_t)TLS_ARENA_MIN_BLOCK << size_class;
+        uint8_t *block = free_lists[size_class];
+
+        if (block != NULL) {
+            memcpy(&free_lists[size_class], block + TLS_ARENA_HEADER, sizeof(uint8_t *));   // Pop the free list
+        } else if (top + block_size <= TLS_ARENA_SIZE) {
+            block = region + top;   // Carve a new block
+            top += block_size;
+        }
+
+        if (block != NULL) {
+            tls_arena_header_t header = {.size_class = size_class, .requested = bytes};
+            memcpy(block, &header, sizeof(header));
+            memset(block + TLS_ARENA_HEADER, 0, block_size - TLS_ARENA_HEADER);
+            stats.allocs++;
+            stats.live_count++;
+            stats.live_bytes += bytes;
+            if (stats.live_bytes > stats.peak_bytes) {
+                stats.peak_bytes = stats.live_bytes;
+            }
+            return block + TLS_ARENA_HEADER;
+        }
+    }
+
+    stats.heap_allocs++;
+    return heap_caps_calloc(n, size, TLS_ARENA_HEAP_CAPS);
+}
+
+/**
+ * @brief free replacement installed in mbedtls.
+ */
+static void tls_arena_free(void *ptr) {
+    uint8_t *p = (uint8_t *)ptr;
+
+    if (p == NULL) {
+        return;
+    } else if (region == NULL || p < region || p >= region + TLS_ARENA_SIZE) {
+        heap_caps_free(ptr);    // Allocated by the heap (before the arena, by another task or as a fallback)
+        return;
+    }
+
+    uint8_t *block = p - TLS_ARENA_HEADER;
+    tls_arena_header_t header;
+    memcpy(&header, block, sizeof(header));
+    memcpy(block + TLS_ARENA_HEADER, &free_lists[header.size_class], sizeof(uint8_t *));     // Push to the free list
+    free_lists[header.size_class] = block;
+    stats.frees++;
+    stats.live_count--;
+    stats.live_bytes -= header.requested;
+}
+
+esp_err_t tls_arena_init(void) {
+    if (TLS_ARENA_SIZE == 0 || region != NULL) {
+        return ESP_OK;
+    }
+
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)
+    region = heap_caps_malloc(TLS_ARENA_SIZE, TLS_ARENA_HEAP_CAPS);
+    if (region == NULL) {
+        ESP_LOGE(TAG, "Failed to reserve %d bytes for the arena", TLS_ARENA_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+    class_count = tls_arena_class(TLS_ARENA_MAX_BLOCK) + 1;
+    if (class_count > TLS_ARENA_CLASSES) {
+        class_count = TLS_ARENA_CLASSES;
+    }
+    memset(free_lists, 0, sizeof(free_lists));
+    memset(&stats, 0, sizeof(stats));
+    mbedtls_platform_set_calloc_free(tls_arena_calloc, tls_arena_free);
+    ESP_LOGI(TAG, "Arena of %d bytes, %d size classes up to %d bytes", TLS_ARENA_SIZE, class_count, TLS_ARENA_MAX_BLOCK);
+    return ESP_OK;
+#else
+    ESP_LOGW(TAG, "mbedtls allocator cannot be replaced at runtime, arena disabled");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void tls_arena_set_owner(void) {
+    owner = xTaskGetCurrentTaskHandle();
+}
+
+void tls_arena_bypass(bool bypass) {
+    bypassed = bypass;
+}
+
+bool tls_arena_reset(void) {
+    if (region == NULL || stats.live_count > 0) {
+        return false;
+    }
+    top = 0;
+    memset(free_lists, 0, sizeof(free_lists));
+    stats.resets++;
+    return true;
+}
+
+esp_err_t tls_arena_get_stats(tls_arena_stats_t *out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t free_bytes = (region != NULL) ? TLS_ARENA_SIZE - top : 0;
+    size_t largest = free_bytes;
+    for (uint8_t i = 0; i < class_count; i++) {
+        size_t block_size = (size_t)TLS_ARENA_MIN_BLOCK << i;
+        for (uint8_t *block = free_lists[i]; block != NULL; memcpy(&block, block + TLS_ARENA_HEADER, sizeof(block))) {
+            free_bytes += block_size;
+            if (block_size > largest) {
+                largest = block_size;
+            }
+        }
+    }
+
+    stats.used_bytes = top;
+    stats.free_bytes = free_bytes;
+    stats.largest_free = largest;
+    stats.fragmentation = (free_bytes > 0) ? (uint8_t)(100 - (100 * largest) / free_bytes) : 0;
+    *out = stats;
+    return ESP_OK;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file    tls_arena.h
+ * @brief   Size-class arena serving mbedtls allocations of the fetch task
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+
+#define TLS_ARENA_MIN_BLOCK 16      // Smallest size class (classes are powers of two up to TLS_ARENA_MAX_BLOCK)
+
+/* Arena counters */
+typedef struct {
+    uint32_t allocs;                // Allocations served by the arena
+    uint32_t frees;                 // Arena blocks freed
+    uint32_t heap_allocs;           // Allocations passed to the heap (other task, bypassed, too large or arena full)
+    uint32_t resets;                // Times the arena was emptied in one step
+    uint32_t live_count;            // Arena blocks currently in use
+    uint32_t live_bytes;            // Bytes requested by the blocks currently in use
+    uint32_t peak_bytes;            // Largest live_bytes seen
+    uint32_t used_bytes;            // Bytes of the region carved into blocks so far
+    uint32_t free_bytes;            // Bytes available (uncarved region and blocks on the free lists)
+    uint32_t largest_free;          // Largest block that can be served without carving past the region
+    uint8_t fragmentation;          // 100 * (1 - largest_free / free_bytes) [%]
+} tls_arena_stats_t;
+
+/**
+ * @brief Reserve the arena region and route mbedtls allocations through it.
+ *
+ * Must be called before any mbedtls object is initialised, since blocks allocated by the previous
+ * allocator cannot be freed by the arena (and vice versa).
+ *
+ * @return ESP_OK on success (also if the arena is disabled with TLS_ARENA_SIZE 0), ESP_ERR_NO_MEM if the
+ *         region could not be allocated, ESP_ERR_NOT_SUPPORTED if mbedtls has a fixed allocator.
+ */
+esp_err_t tls_arena_init(void);
+
+/**
+ * @brief Serve allocations of the calling task from the arena (allocations of other tasks go to the heap).
+ */
+void tls_arena_set_owner(void);
+
+/**
+ * @brief Pass allocations of the owner task to the heap while set.
+ *
+ * Used for mbedtls objects that outlive the connection (the saved session, the context prepared for the next
+ * handshake), which would otherwise keep blocks in use and prevent the arena from being reset.
+ *
+ * @param bypass true to allocate from the heap, false to allocate from the arena again.
+ */
+void tls_arena_bypass(bool bypass);
+
+/**
+ * @brief Empty the arena in one step if no block is in use (e.g. when the connection is closed).
+ *
+ * @return true if the arena was reset, false if blocks are still in use.
+ */
+bool tls_arena_reset(void);
+
+/**
+ * @brief Get the arena counters.
+ *
+ * @param stats Pointer to the structure where the counters will be copied. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if stats is NULL.
+ */
+esp_err_t tls_arena_get_stats(tls_arena_stats_t *stats);
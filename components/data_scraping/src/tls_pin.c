@@ -0,0 +1,67 @@
+/**
+ * @file    tls_pin.c
+ * @brief   Pinned SubjectPublicKeyInfo as the trust anchor of the server certificate (TLS_TRUST_PIN)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "tls_pin.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+
+#define TAG "tls_pin"
+
+esp_err_t tls_pin_init(tls_pin_t *pin, const char *hex) {
+    memset(pin, 0, sizeof(*pin));
+    if (hex == NULL || strlen(hex) != 2 * TLS_PIN_LEN) {
+        ESP_LOGE(TAG, "Pin must be %d hex digits", 2 * TLS_PIN_LEN);
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < TLS_PIN_LEN; i++) {
+        char digits[3] = {hex[2 * i], hex[2 * i + 1], '\0'};
+        if (!isxdigit((unsigned char)digits[0]) || !isxdigit((unsigned char)digits[1])) {
+            ESP_LOGE(TAG, "Pin is not a hex string");
+            return ESP_ERR_INVALID_ARG;
+        }
+        pin->hash[i] = (uint8_t)strtoul(digits, NULL, 16);
+    }
+    return ESP_OK;
+}
+
+void tls_pin_begin(tls_pin_t *pin) {
+    pin->found = false;
+    pin->path_valid = false;
+    pin->verified = false;
+}
+
+int tls_pin_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags) {
+    tls_pin_t *pin = (tls_pin_t *)ctx;
+    uint8_t hash[TLS_PIN_LEN];
+    bool pinned = mbedtls_sha256_ret(crt->pk_raw.p, crt->pk_raw.len, hash, 0) == 0 &&
+                  memcmp(hash, pin->hash, sizeof(hash)) == 0;
+
+    if (pinned) {
+        pin->found = true;
+        pin->path_valid = (*flags & ~MBEDTLS_X509_BADCERT_NOT_TRUSTED) == 0;
+    } else if (pin->found) {
+        pin->path_valid = pin->path_valid && (*flags == 0);     // NOT_TRUSTED here means a bad signature of the parent
+    }
+    if (depth > 0) {
+        return 0;
+    }
+
+    pin->verified = pin->found && pin->path_valid && (*flags & MBEDTLS_X509_BADCERT_CN_MISMATCH) == 0;
+    if (!pin->verified) {
+        ESP_LOGE(TAG, "Server certificate is not covered by the pinned key");
+        *flags |= MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+    }
+    return 0;
+}
+
+bool tls_pin_accepted(const tls_pin_t *pin, uint32_t verify_result) {
+    return pin->verified && (verify_result & TLS_PIN_LEAF_FLAGS) == 0;
+}
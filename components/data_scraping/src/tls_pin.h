@@ -0,0 +1,68 @@
+/**
+ * @file    tls_pin.h
+ * @brief   Pinned SubjectPublicKeyInfo as the trust anchor of the server certificate (TLS_TRUST_PIN)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "mbedtls/x509_crt.h"
+
+#define TLS_PIN_LEN 32      // SHA-256 of the SubjectPublicKeyInfo
+
+/* Server certificate problems that MBEDTLS_SSL_VERIFY_OPTIONAL would let through without a callback verdict */
+#define TLS_PIN_LEAF_FLAGS (MBEDTLS_X509_BADCERT_CN_MISMATCH | MBEDTLS_X509_BADCERT_KEY_USAGE | \
+                            MBEDTLS_X509_BADCERT_EXT_KEY_USAGE | MBEDTLS_X509_BADCERT_BAD_KEY)
+
+/* Pin and the verdict of the current handshake */
+typedef struct {
+    uint8_t hash[TLS_PIN_LEN];  // SHA-256 of the pinned SubjectPublicKeyInfo
+    bool found;                 // Pinned key found in the verified path above the current certificate
+    bool path_valid;            // Every certificate from the pinned one down to the current one verified
+    bool verified;              // Chain of the current handshake accepted by the pin (decided at depth 0)
+} tls_pin_t;
+
+/**
+ * @brief Set the pin from its hex string (e.g. TLS_TRUST_PIN_SHA256).
+ *
+ * @param pin Pointer to the pin. Must not be NULL.
+ * @param hex 64 hex digits.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if hex is NULL, not 64 digits long or not hex.
+ */
+esp_err_t tls_pin_init(tls_pin_t *pin, const char *hex);
+
+/**
+ * @brief Clear the verdict before a handshake.
+ */
+void tls_pin_begin(tls_pin_t *pin);
+
+/**
+ * @brief Certificate verification callback (mbedtls_ssl_conf_verify, with the pin as its context).
+ *
+ * Called by mbedtls for each certificate of the path it built from the server certificate up through the
+ * issuers it found, from the top down to the server certificate (depth 0), with the flags of that certificate.
+ * The pinned key takes the place of a trusted root: the chain is accepted if the server certificate itself has
+ * the pinned key, or if the certificate with the pinned key is one of its issuers and every certificate below it
+ * is signed by its parent, within its validity period and otherwise unflagged. The hostname must always match.
+ * Only a missing trust anchor is excused, and only on the pinned certificate.
+ *
+ * The flags of the issuers are left as mbedtls set them. Since the top of the path never has a trusted root
+ * in this mode, the handshake runs with MBEDTLS_SSL_VERIFY_OPTIONAL and the connection must be rejected unless
+ * tls_pin_accepted confirms the verdict made here at depth 0.
+ *
+ * @return 0 (the verdict is given through the flags of the server certificate).
+ */
+int tls_pin_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags);
+
+/**
+ * @brief Check the verdict of the last handshake.
+ *
+ * @param pin           Pointer to the pin. Must not be NULL.
+ * @param verify_result Result of the handshake (mbedtls_ssl_get_verify_result).
+ * @return true if the server certificate is covered by the pin and has no problem left to VERIFY_OPTIONAL.
+ */
+bool tls_pin_accepted(const tls_pin_t *pin, uint32_t verify_result);
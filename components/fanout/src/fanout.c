@@ -0,0 +1,286 @@
+/**
+ * @file    fanout.c
+ * @brief   Local fan-out: the elected device shares fetched samples with the others over UDP multicast
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fanout.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "fanout_election.h"
+#include "fanout_packet.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "nvs.h"
+
+#define TAG "fanout"
+
+#define FANOUT_NVS_NAMESPACE "fanout"   // NVS namespace of the boot counter
+#define FANOUT_NVS_EPOCH_KEY "epoch"    // NVS key of the boot counter
+
+static int sock = -1;                           // UDP socket joined to FANOUT_GROUP
+static struct sockaddr_in group;                // Destination of the packets
+static fanout_election_t election;              // Devices heard (used by the fan-out task only)
+static fanout_sample_cb_t sample_cb = NULL;     // Callback receiving the samples of the leader
+static uint64_t leader_id = 0;                  // Current leader (0 until the first election)
+static volatile bool is_leader = false;         // This device is the leader
+static uint32_t epoch;                          // Boot counter identifying this boot (higher is newer)
+static uint32_t seq = 0;                        // Sequence number of the last packet sent
+static portMUX_TYPE seq_lock = portMUX_INITIALIZER_UNLOCKED;   // Protects seq and stats.sent (two sending tasks)
+static fanout_stats_t stats;                    // Fan-out counters
+static TaskHandle_t task = NULL;                // Fan-out task
+
+/**
+ * @brief Get the election clock.
+ */
+static int64_t fanout_now_ms(void) {
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * @brief Increment the boot counter kept in NVS and use it as the epoch of this boot.
+ *
+ * The receivers reject packets of earlier epochs, so the epoch must grow across reboots (a random epoch would
+ * let packets recorded during an earlier boot be replayed).
+ */
+static esp_err_t fanout_next_epoch(void) {
+    nvs_handle_t handle;
+    uint32_t counter = 0;
+
+    esp_err_t err = nvs_open(FANOUT_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open the NVS namespace (%s)", esp_err_to_name(err));
+        return err;
+    }
+    err = nvs_get_u32(handle, FANOUT_NVS_EPOCH_KEY, &counter);
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+        err = nvs_set_u32(handle, FANOUT_NVS_EPOCH_KEY, counter + 1);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to update the boot counter (%s)", esp_err_to_name(err));
+        return err;
+    }
+    epoch = counter + 1;
+    return ESP_OK;
+}
+
+/**
+ * @brief Sign and send a packet to the group.
+ */
+static esp_err_t fanout_send(fanout_packet_t *pkt) {
+    uint8_t buf[FANOUT_PACKET_MAX_LEN];
+
+    taskENTER_CRITICAL(&seq_lock);
+    pkt->seq = ++seq;
+    taskEXIT_CRITICAL(&seq_lock);
+    pkt->sender = election.self_id;
+    pkt->epoch = epoch;
+
+    size_t len = fanout_packet_encode(pkt, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), buf, sizeof(buf));
+    if (len == 0 || sendto(sock, buf, len, 0, (struct sockaddr *)&group, sizeof(group)) != (int)len) {
+        ESP_LOGW(TAG, "Failed to send a packet (errno %d)", errno);
+        return ESP_FAIL;
+    }
+    taskENTER_CRITICAL(&seq_lock);
+    stats.sent++;
+    taskEXIT_CRITICAL(&seq_lock);
+    return ESP_OK;
+}
+
+/**
+ * @brief Run the election and log a change of the leader.
+ */
+static void fanout_elect(int64_t now_ms, int64_t started_ms) {
+    if (now_ms - started_ms < FANOUT_LEADER_TIMEOUT_MS) {
+        return;  // Listening for the other devices first
+    }
+
+    uint64_t leader = fanout_election_leader(&election, now_ms);
+    if (leader != leader_id) {
+        ESP_LOGI(TAG, "Leader is %012llx%s", (unsigned long long)leader, (leader == election.self_id) ? " (this device)" : "");
+        if (leader_id != 0) {
+            stats.leader_changes++;
+        }
+        leader_id = leader;
+        is_leader = (leader == election.self_id);
+    }
+}
+
+/**
+ * @brief Challenge a device heard for the first time to echo a fresh nonce (unless a challenge is pending).
+ */
+static void fanout_challenge(uint64_t id, int64_t now_ms) {
+    uint64_t nonce = ((uint64_t)esp_random() << 32) | esp_random();
+
+    nonce = (nonce != 0) ? nonce : 1;
+    if (fanout_election_challenge(&election, id, nonce, now_ms)) {
+        fanout_packet_t challenge = {.type = FANOUT_PACKET_CHALLENGE, .target = id, .nonce = nonce};
+        if (fanout_send(&challenge) == ESP_OK) {
+            stats.challenges++;
+        }
+    }
+}
+
+/**
+ * @brief Verify a received datagram, answer the challenges of this device and pass the samples of the leader to
+ *        the callback.
+ */
+static void fanout_receive(const uint8_t *buf, size_t len, int64_t now_ms, int64_t started_ms) {
+    fanout_packet_t pkt;
+
+    esp_err_t err = fanout_packet_decode(buf, len, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), &pkt);
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "Rejected a packet of %u bytes (%s)", (unsigned)len, esp_err_to_name(err));
+        stats.rejected++;
+        return;
+    } else if (pkt.sender == election.self_id) {
+        return;  // Own packet looped back
+    } else if (pkt.type == FANOUT_PACKET_CHALLENGE) {
+        if (pkt.target == election.self_id) {
+            fanout_packet_t answer = {.type = FANOUT_PACKET_HELLO, .nonce = pkt.nonce};
+            fanout_send(&answer);   // A replayed challenge only costs a hello, its nonce is stale
+        }
+        return;
+    }
+
+    uint64_t echo = (pkt.type == FANOUT_PACKET_HELLO) ? pkt.nonce : 0;
+    switch (fanout_election_heard(&election, pkt.sender, pkt.epoch, pkt.seq, echo, now_ms)) {
+        case FANOUT_HEARD_ACCEPTED:
+            break;
+        case FANOUT_HEARD_UNVERIFIED:
+            stats.unverified++;
+            fanout_challenge(pkt.sender, now_ms);
+            return;
+        default:
+            stats.replayed++;
+            return;
+    }
+    stats.received++;
+
+    fanout_elect(now_ms, started_ms);   // A device with a lower ID takes over at once
+    if (pkt.type == FANOUT_PACKET_SAMPLE && pkt.sender == leader_id) {
+        sample_cb(pkt.source, &pkt.values);
+    }
+}
+
+/**
+ * @brief Fan-out task: announce this device, receive the packets of the others and follow the leader.
+ */
+static void fanout_task(void *arg) {
+    uint8_t buf[FANOUT_PACKET_MAX_LEN + 1];     // One more byte to detect oversized datagrams
+    int64_t started_ms = fanout_now_ms();
+    int64_t next_hello_ms = started_ms;
+
+    while (true) {
+        int64_t now_ms = fanout_now_ms();
+        if (now_ms >= next_hello_ms) {
+            fanout_packet_t hello = {.type = FANOUT_PACKET_HELLO};
+            fanout_send(&hello);
+            fanout_elect(now_ms, started_ms);   // Also notices a silent leader
+            next_hello_ms = now_ms + FANOUT_HELLO_MS;
+        }
+
+        int64_t wait_ms = next_hello_ms - now_ms;
+        struct timeval tv = {.tv_sec = wait_ms / 1000, .tv_usec = (wait_ms % 1000) * 1000};
+        fd_set readset;
+        FD_ZERO(&readset);
+        FD_SET(sock, &readset);
+        if (select(sock + 1, &readset, NULL, NULL, &tv) <= 0) {
+            continue;
+        }
+
+        int len = recvfrom(sock, buf, sizeof(buf), 0, NULL, NULL);
+        if (len > 0) {
+            fanout_receive(buf, (size_t)len, fanout_now_ms(), started_ms);
+        }
+    }
+}
+
+esp_err_t fanout_init(uint64_t self_id, fanout_sample_cb_t cb) {
+    if (self_id == 0 || cb == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    } else if (fanout_next_epoch() != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Failed to create the socket (errno %d)", errno);
+        return ESP_FAIL;
+    }
+
+    int reuse = 1;
+    uint8_t ttl = 1;    // Stay on the LAN
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(FANOUT_PORT), .sin_addr.s_addr = htonl(INADDR_ANY)};
+    struct ip_mreq mreq = {.imr_interface.s_addr = htonl(INADDR_ANY)};
+    memset(&group, 0, sizeof(group));
+    group.sin_family = AF_INET;
+    group.sin_port = htons(FANOUT_PORT);
+    if (inet_aton(FANOUT_GROUP, &group.sin_addr) == 0) {
+        ESP_LOGE(TAG, "Invalid group address %s", FANOUT_GROUP);
+        close(sock);
+        sock = -1;
+        return ESP_FAIL;
+    }
+    mreq.imr_multiaddr = group.sin_addr;
+
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+        bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+        ESP_LOGE(TAG, "Failed to join %s:%d (errno %d)", FANOUT_GROUP, FANOUT_PORT, errno);
+        close(sock);
+        sock = -1;
+        return ESP_FAIL;
+    }
+
+    fanout_election_init(&election, self_id);
+    sample_cb = cb;
+    memset(&stats, 0, sizeof(stats));
+
+    if (xTaskCreate(fanout_task, "fanout", FANOUT_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, &task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the fan-out task");
+        close(sock);
+        sock = -1;
+        task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Device %012llx joined %s:%d", (unsigned long long)self_id, FANOUT_GROUP, FANOUT_PORT);
+    return ESP_OK;
+}
+
+bool fanout_is_leader(void) {
+    return is_leader;
+}
+
+esp_err_t fanout_publish(uint8_t source, const data_scraping_values_t *values) {
+    if (values == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (!is_leader) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    fanout_packet_t pkt = {.type = FANOUT_PACKET_SAMPLE, .source = source, .values = *values};
+    return fanout_send(&pkt);
+}
+
+esp_err_t fanout_get_stats(fanout_stats_t *out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = stats;
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file    fanout.h
+ * @brief   Local fan-out: the elected device shares fetched samples with the others over UDP multicast
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "data_scraping.h"
+
+/* Callback receiving the samples of the leader (called from the fan-out task) */
+typedef void (*fanout_sample_cb_t)(uint8_t source, const data_scraping_values_t *values);
+
+/* Fan-out counters */
+typedef struct {
+    uint32_t sent;              // Packets sent (hello and samples)
+    uint32_t received;          // Packets accepted
+    uint32_t rejected;          // Packets with a wrong size, version or signature
+    uint32_t replayed;          // Duplicate or replayed packets
+    uint32_t unverified;        // Packets of devices that have not answered a challenge yet
+    uint32_t challenges;        // Challenges sent to devices heard for the first time
+    uint32_t leader_changes;    // Changes of the leader (failovers included)
+} fanout_stats_t;
+
+/**
+ * @brief Join FANOUT_GROUP and start the fan-out task.
+ *
+ * Every device announces itself every FANOUT_HELLO_MS. The device with the lowest ID heard within
+ * FANOUT_LEADER_TIMEOUT_MS is the leader; no device leads during the first timeout after start, so that
+ * the others are heard first. All packets are signed with FANOUT_KEY and carry a boot counter kept in NVS
+ * (initialised by the caller), so that packets of earlier boots cannot be replayed. A device heard for the first
+ * time (e.g. after this one reboots) is challenged with a random nonce and ignored until it echoes it.
+ *
+ * @param self_id ID of this device (non-zero, unique on the LAN).
+ * @param cb      Callback receiving the samples of the leader. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if already started, ESP_FAIL if the boot counter could not be
+ *         updated or the socket could not be set up, ESP_ERR_NO_MEM if the task could not be created.
+ */
+esp_err_t fanout_init(uint64_t self_id, fanout_sample_cb_t cb);
+
+/**
+ * @brief Check if this device is the leader (the one fetching the sources).
+ */
+bool fanout_is_leader(void);
+
+/**
+ * @brief Send the values of a source to the other devices (leader only).
+ *
+ * @param source Index of the source.
+ * @param values Values to send. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if this device is not the leader, ESP_FAIL if sending failed.
+ */
+esp_err_t fanout_publish(uint8_t source, const data_scraping_values_t *values);
+
+/**
+ * @brief Get the fan-out counters.
+ *
+ * @param out Pointer to the structure where the counters will be copied. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL.
+ */
+esp_err_t fanout_get_stats(fanout_stats_t *out);
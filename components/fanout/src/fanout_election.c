@@ -0,0 +1,83 @@
+/**
+ * @file    fanout_election.c
+ * @brief   Leader election of the local fan-out: the live device with the lowest ID fetches (no RTOS calls)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fanout_election.h"
+
+#include <string.h>
+
+void fanout_election_init(fanout_election_t *e, uint64_t self_id) {
+    memset(e, 0, sizeof(*e));
+    e->self_id = self_id;
+}
+
+fanout_heard_t fanout_election_heard(fanout_election_t *e, uint64_t id, uint32_t epoch, uint32_t seq, uint64_t echo,
+                                     int64_t now_ms) {
+    fanout_peer_t *peer = NULL;
+    fanout_peer_t *oldest = &e->peers[0];
+
+    if (id == 0 || id == e->self_id) {
+        return FANOUT_HEARD_REPLAYED;  // Own packets looped back by the stack
+    }
+
+    for (int i = 0; i < FANOUT_MAX_PEERS; i++) {
+        if (e->peers[i].id == id) {
+            peer = &e->peers[i];
+            break;
+        } else if (oldest->id != 0 && (e->peers[i].id == 0 || e->peers[i].last_seen_ms < oldest->last_seen_ms)) {
+            oldest = &e->peers[i];
+        }
+    }
+
+    if (peer == NULL) {
+        peer = oldest;
+        memset(peer, 0, sizeof(*peer));
+        peer->id = id;
+        peer->last_seen_ms = now_ms;    // Kept while the challenge is pending
+    }
+    if (!peer->verified) {
+        if (peer->nonce == 0 || echo != peer->nonce) {
+            return FANOUT_HEARD_UNVERIFIED;     // Possibly recorded during an earlier boot, the epoch proves nothing
+        }
+        peer->verified = true;  // Fresh answer: its epoch and sequence number are the current ones
+        peer->nonce = 0;
+    } else if (epoch < peer->epoch || (epoch == peer->epoch && seq <= peer->last_seq)) {
+        return FANOUT_HEARD_REPLAYED;   // Duplicate, or replayed from this or an earlier boot
+    }
+    peer->epoch = epoch;
+    peer->last_seq = seq;
+    peer->last_seen_ms = now_ms;
+    return FANOUT_HEARD_ACCEPTED;
+}
+
+bool fanout_election_challenge(fanout_election_t *e, uint64_t id, uint64_t nonce, int64_t now_ms) {
+    for (int i = 0; i < FANOUT_MAX_PEERS; i++) {
+        fanout_peer_t *peer = &e->peers[i];
+        if (peer->id != id || id == 0) {
+            continue;
+        } else if (peer->verified || nonce == 0 ||
+                   (peer->nonce != 0 && now_ms - peer->challenged_ms < FANOUT_HELLO_MS)) {
+            return false;
+        }
+        peer->nonce = nonce;
+        peer->challenged_ms = now_ms;
+        return true;
+    }
+    return false;
+}
+
+uint64_t fanout_election_leader(fanout_election_t *e, int64_t now_ms) {
+    uint64_t leader = e->self_id;
+
+    for (int i = 0; i < FANOUT_MAX_PEERS; i++) {
+        fanout_peer_t *peer = &e->peers[i];
+        if (peer->id == 0 || !peer->verified || now_ms - peer->last_seen_ms > FANOUT_LEADER_TIMEOUT_MS) {
+            continue;   // Unused, not verified yet, or silent for too long (left, rebooting or unreachable)
+        } else if (peer->id < leader) {
+            leader = peer->id;
+        }
+    }
+    return leader;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file    fanout_election.h
+ * @brief   Leader election of the local fan-out: the live device with the lowest ID fetches (no RTOS calls)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+
+/* Result of accounting for a packet */
+typedef enum {
+    FANOUT_HEARD_ACCEPTED,      // Fresh packet of a verified device
+    FANOUT_HEARD_REPLAYED,      // Duplicate, replayed, or sent by this device
+    FANOUT_HEARD_UNVERIFIED     // Device not verified yet: dropped, the device is to be challenged
+} fanout_heard_t;
+
+/* Device heard on the LAN */
+typedef struct {
+    uint64_t id;                // Device ID (0 if the slot is unused)
+    bool verified;              // Device answered a challenge (its epoch and sequence number are trusted)
+    uint32_t epoch;             // Boot epoch of the device (boot counter, newer is higher)
+    uint32_t last_seq;          // Last accepted sequence number within the epoch
+    int64_t last_seen_ms;       // Time of the last accepted packet (of the first contact until verified)
+    uint64_t nonce;             // Pending challenge (0 if none)
+    int64_t challenged_ms;      // Time the pending challenge was sent
+} fanout_peer_t;
+
+/* Election state */
+typedef struct {
+    uint64_t self_id;                       // ID of this device
+    fanout_peer_t peers[FANOUT_MAX_PEERS];  // Devices heard recently
+} fanout_election_t;
+
+/**
+ * @brief Initialise the election.
+ *
+ * @param e       Pointer to the state. Must not be NULL.
+ * @param self_id ID of this device (non-zero, unique on the LAN, e.g. derived from the MAC address).
+ */
+void fanout_election_init(fanout_election_t *e, uint64_t self_id);
+
+/**
+ * @brief Account for a packet of another device whose signature has been verified.
+ *
+ * Epochs are boot counters, so a packet of a verified device is accepted only if its epoch is newer than the
+ * last one of the device, or if it is the same epoch and its sequence number is newer. This drops duplicates and
+ * packets replayed from the current or an earlier boot of the device.
+ *
+ * A device that is not in the table (any device after this one reboots, or one replaced when the table was full)
+ * has no epoch to compare with, so a recording of any of its earlier boots would be accepted. Its packets are
+ * dropped until it echoes the nonce of a challenge (fanout_election_challenge) in a hello: only the device itself
+ * can sign a fresh nonce, and its epoch and sequence number are taken from that answer. If the table is full, the
+ * device heard least recently is replaced.
+ *
+ * @param e      Pointer to the state. Must not be NULL.
+ * @param id     ID of the sender.
+ * @param epoch  Epoch of the sender.
+ * @param seq    Sequence number of the packet.
+ * @param echo   Nonce of the challenge answered by the packet (0 if none).
+ * @param now_ms Current time.
+ * @return FANOUT_HEARD_ACCEPTED if the packet is accepted, FANOUT_HEARD_REPLAYED if it is a duplicate, replayed
+ *         or sent by this device, FANOUT_HEARD_UNVERIFIED if the sender has to be challenged first.
+ */
+fanout_heard_t fanout_election_heard(fanout_election_t *e, uint64_t id, uint32_t epoch, uint32_t seq, uint64_t echo,
+                                     int64_t now_ms);
+
+/**
+ * @brief Record a challenge of a device that is not verified yet.
+ *
+ * A new challenge replaces the pending one only after FANOUT_HELLO_MS (the answer of a lost challenge or of an
+ * unreachable device is not awaited forever, but the device is not flooded either).
+ *
+ * @param e      Pointer to the state. Must not be NULL.
+ * @param id     ID of the device (reported as FANOUT_HEARD_UNVERIFIED).
+ * @param nonce  Random, non-zero nonce the device must echo.
+ * @param now_ms Current time.
+ * @return true if the challenge is to be sent, false if one is pending or the device is not (or no longer) in
+ *         the table.
+ */
+bool fanout_election_challenge(fanout_election_t *e, uint64_t id, uint64_t nonce, int64_t now_ms);
+
+/**
+ * @brief Get the current leader: the verified device with the lowest ID heard within FANOUT_LEADER_TIMEOUT_MS, or
+ *        this one.
+ *
+ * Devices not heard within the timeout are left out, so a silent leader is replaced by the next lowest ID. Their
+ * epoch and sequence number are kept (until the slot is needed) to keep rejecting their replayed packets.
+ *
+ * @param e      Pointer to the state. Must not be NULL.
+ * @param now_ms Current time.
+ * @return ID of the leader.
+ */
+uint64_t fanout_election_leader(fanout_election_t *e, int64_t now_ms);
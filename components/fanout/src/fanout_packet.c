@@ -0,0 +1,147 @@
+/**
+ * @file    fanout_packet.c
+ * @brief   Signed, sequence-numbered packets of the local fan-out (no RTOS or socket calls)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fanout_packet.h"
+
+#include <string.h>
+
+#include "mbedtls/md.h"
+
+/**
+ * @brief Store a little-endian integer of n bytes.
+ */
+static void fanout_put(uint8_t *p, uint64_t value, int n) {
+    for (int i = 0; i < n; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Load a little-endian integer of n bytes.
+ */
+static uint64_t fanout_get(const uint8_t *p, int n) {
+    uint64_t value = 0;
+    for (int i = n - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Get the length of the body of a packet type (after the header).
+ *
+ * @return Length, 0 if the type is unknown.
+ */
+static size_t fanout_body_len(uint8_t type) {
+    switch (type) {
+        case FANOUT_PACKET_HELLO:
+            return FANOUT_PACKET_HELLO_LEN;
+        case FANOUT_PACKET_SAMPLE:
+            return FANOUT_PACKET_SAMPLE_LEN;
+        case FANOUT_PACKET_CHALLENGE:
+            return FANOUT_PACKET_CHALLENGE_LEN;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Compute the truncated HMAC-SHA256 of a packet body.
+ */
+static esp_err_t fanout_mac(const uint8_t *key, size_t key_len, const uint8_t *data, size_t len,
+                            uint8_t mac[FANOUT_PACKET_MAC_LEN]) {
+    uint8_t full[32];
+    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+
+    if (info == NULL || mbedtls_md_hmac(info, key, key_len, data, len, full) != 0) {
+        return ESP_FAIL;
+    }
+    memcpy(mac, full, FANOUT_PACKET_MAC_LEN);
+    return ESP_OK;
+}
+
+size_t fanout_packet_encode(const fanout_packet_t *pkt, const uint8_t *key, size_t key_len, uint8_t *buf, size_t size) {
+    size_t len = FANOUT_PACKET_HEADER_LEN + fanout_body_len(pkt->type);
+
+    if (len == FANOUT_PACKET_HEADER_LEN || size < len + FANOUT_PACKET_MAC_LEN) {
+        return 0;
+    }
+
+    fanout_put(&buf[0], FANOUT_PACKET_MAGIC, 4);
+    buf[4] = FANOUT_PACKET_VERSION;
+    buf[5] = (uint8_t)pkt->type;
+    buf[6] = pkt->source;
+    buf[7] = 0;
+    fanout_put(&buf[8], pkt->sender, 8);
+    fanout_put(&buf[16], pkt->epoch, 4);
+    fanout_put(&buf[20], pkt->seq, 4);
+    uint8_t *p = &buf[FANOUT_PACKET_HEADER_LEN];
+    if (pkt->type == FANOUT_PACKET_HELLO) {
+        fanout_put(&p[0], pkt->nonce, 8);
+    } else if (pkt->type == FANOUT_PACKET_SAMPLE) {
+        fanout_put(&p[0], pkt->values.found, 4);
+        fanout_put(&p[4], (uint32_t)pkt->values.max_age_s, 4);
+        for (int i = 0; i < DATA_SCRAPING_MAX_VALUES; i++) {
+            fanout_put(&p[8 + 4 * i], (uint32_t)pkt->values.values[i], 4);
+        }
+    } else {
+        fanout_put(&p[0], pkt->target, 8);
+        fanout_put(&p[8], pkt->nonce, 8);
+    }
+
+    if (fanout_mac(key, key_len, buf, len, &buf[len]) != ESP_OK) {
+        return 0;
+    }
+    return len + FANOUT_PACKET_MAC_LEN;
+}
+
+esp_err_t fanout_packet_decode(const uint8_t *buf, size_t len, const uint8_t *key, size_t key_len, fanout_packet_t *pkt) {
+    uint8_t mac[FANOUT_PACKET_MAC_LEN];
+    uint8_t diff = 0;
+
+    if (len < FANOUT_PACKET_HEADER_LEN + FANOUT_PACKET_MAC_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    } else if (fanout_get(&buf[0], 4) != FANOUT_PACKET_MAGIC || buf[4] != FANOUT_PACKET_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    size_t body_len = FANOUT_PACKET_HEADER_LEN + fanout_body_len(buf[5]);
+    if (body_len == FANOUT_PACKET_HEADER_LEN || len != body_len + FANOUT_PACKET_MAC_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (fanout_mac(key, key_len, buf, body_len, mac) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < FANOUT_PACKET_MAC_LEN; i++) {
+        diff |= mac[i] ^ buf[body_len + i];    // Constant time
+    }
+    if (diff != 0) {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->type = (fanout_packet_type_t)buf[5];
+    pkt->source = buf[6];
+    pkt->sender = fanout_get(&buf[8], 8);
+    pkt->epoch = (uint32_t)fanout_get(&buf[16], 4);
+    pkt->seq = (uint32_t)fanout_get(&buf[20], 4);
+    pkt->values.max_age_s = -1;
+    const uint8_t *p = &buf[FANOUT_PACKET_HEADER_LEN];
+    if (pkt->type == FANOUT_PACKET_HELLO) {
+        pkt->nonce = fanout_get(&p[0], 8);
+    } else if (pkt->type == FANOUT_PACKET_CHALLENGE) {
+        pkt->target = fanout_get(&p[0], 8);
+        pkt->nonce = fanout_get(&p[8], 8);
+    } else {
+        pkt->values.found = (uint32_t)fanout_get(&p[0], 4);
+        pkt->values.max_age_s = (int32_t)(uint32_t)fanout_get(&p[4], 4);
+        for (int i = 0; i < DATA_SCRAPING_MAX_VALUES; i++) {
+            pkt->values.values[i] = (int32_t)(uint32_t)fanout_get(&p[8 + 4 * i], 4);
+        }
+    }
+    return ESP_OK;
+}
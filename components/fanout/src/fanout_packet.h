@@ -0,0 +1,68 @@
+/**
+ * @file    fanout_packet.h
+ * @brief   Signed, sequence-numbered packets of the local fan-out (no RTOS or socket calls)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "data_scraping.h"
+#include "esp_err.h"
+
+#define FANOUT_PACKET_MAGIC 0x31464647u     // "GFF1" (little-endian)
+#define FANOUT_PACKET_VERSION 2             // Layout version (2: challenge of devices heard for the first time)
+#define FANOUT_PACKET_HEADER_LEN 24         // Magic, version, type, source, reserved, sender, epoch, seq
+#define FANOUT_PACKET_HELLO_LEN 8           // Nonce of the challenge answered
+#define FANOUT_PACKET_SAMPLE_LEN (8 + 4 * DATA_SCRAPING_MAX_VALUES)    // Found mask, max-age, values
+#define FANOUT_PACKET_CHALLENGE_LEN 16      // Challenged device, nonce
+#define FANOUT_PACKET_MAC_LEN 16            // Truncated HMAC-SHA256 of the rest of the packet
+#define FANOUT_PACKET_MAX_LEN (FANOUT_PACKET_HEADER_LEN + FANOUT_PACKET_SAMPLE_LEN + FANOUT_PACKET_MAC_LEN)
+
+/* Packet type */
+typedef enum {
+    FANOUT_PACKET_HELLO = 0x01,     // Presence of a device (sent by every device, drives the election)
+    FANOUT_PACKET_SAMPLE = 0x02,    // Values of a source fetched by the leader
+    FANOUT_PACKET_CHALLENGE = 0x03  // Nonce a device heard for the first time must echo in a hello
+} fanout_packet_type_t;
+
+/* Decoded packet (fields are serialised little-endian) */
+typedef struct {
+    fanout_packet_type_t type;      // Packet type
+    uint8_t source;                 // Index of the source (FANOUT_PACKET_SAMPLE)
+    uint64_t sender;                // ID of the sending device
+    uint32_t epoch;                 // Boot counter of the sender (seq restarts with it)
+    uint32_t seq;                   // Sequence number of the packet within the epoch
+    data_scraping_values_t values;  // Values (FANOUT_PACKET_SAMPLE)
+    uint64_t target;                // Challenged device (FANOUT_PACKET_CHALLENGE)
+    uint64_t nonce;                 // Challenge (FANOUT_PACKET_CHALLENGE), or the one answered (FANOUT_PACKET_HELLO,
+                                    // 0 if none)
+} fanout_packet_t;
+
+/**
+ * @brief Serialise and sign a packet.
+ *
+ * @param pkt     Packet. Must not be NULL.
+ * @param key     HMAC key.
+ * @param key_len Length of the key.
+ * @param buf     Output buffer.
+ * @param size    Size of the output buffer (FANOUT_PACKET_MAX_LEN is always enough).
+ * @return Length of the packet, 0 if the type is unknown, the buffer is too small or signing failed.
+ */
+size_t fanout_packet_encode(const fanout_packet_t *pkt, const uint8_t *key, size_t key_len, uint8_t *buf, size_t size);
+
+/**
+ * @brief Verify and deserialise a packet.
+ *
+ * @param buf     Received datagram.
+ * @param len     Length of the datagram.
+ * @param key     HMAC key.
+ * @param key_len Length of the key.
+ * @param pkt     Pointer where the packet will be stored. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if the length does not match the type,
+ *         ESP_ERR_INVALID_VERSION for a foreign or newer packet, ESP_ERR_INVALID_CRC if the signature is wrong.
+ */
+esp_err_t fanout_packet_decode(const uint8_t *buf, size_t len, const uint8_t *key, size_t key_len, fanout_packet_t *pkt);
@@ -0,0 +1,289 @@
+/**
+ * @file    fetch.c
+ * @brief   Fetch task polling each source at its own interval and publishing the latest sample of each
+ *          through a single-value mailbox
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fetch.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "fanout.h"
+#include "fetch_adaptive.h"
+#include "fetch_push.h"
+#include "fetch_scheduler.h"
+
+#define TAG "fetch"
+
+static QueueHandle_t mailboxes[FETCH_MAX_SOURCES];  // Length-1 queues holding the latest sample of each source
+static const data_scraping_source_t *table = NULL;  // Sources
+static uint8_t table_count = 0;                     // Number of sources
+static fetch_source_t fetch_fn = NULL;              // Function fetching the values
+static fetch_scheduler_t scheduler;                 // Next poll of each source
+static fetch_adaptive_t adaptive[FETCH_MAX_SOURCES]; // Poll interval of each source (FETCH_ADAPTIVE)
+static QueueHandle_t push_queue = NULL;             // Messages of the subscribed sources (FETCH_PUSH)
+static fetch_push_msg_t push_msg;                   // Message being processed by the fetch task
+static uint32_t seq[FETCH_MAX_SOURCES];             // Sequence number of the last sample of each source
+static portMUX_TYPE seq_lock = portMUX_INITIALIZER_UNLOCKED;   // Protects seq (samples also come from the fan-out task)
+static bool fanout_active = false;                  // Fan-out started, only the leader polls (FETCH_FANOUT)
+static TaskHandle_t task = NULL;                    // Fetch task
+
+/**
+ * @brief Get the scheduler clock.
+ */
+static int64_t fetch_now_ms(void) {
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * @brief Get the sequence number of the next sample of a source.
+ */
+static uint32_t fetch_next_seq(uint8_t index) {
+    taskENTER_CRITICAL(&seq_lock);
+    uint32_t next = ++seq[index];
+    taskEXIT_CRITICAL(&seq_lock);
+    return next;
+}
+
+/**
+ * @brief Adapt the interval of the polled source to its new sample and log the decision.
+ *
+ * The log line holds the inputs of the decision, so that recorded logs can be replayed through
+ * fetch_adaptive_update to tune the thresholds.
+ */
+static void fetch_adapt_interval(uint8_t index, const fetch_sample_t *sample) {
+    fetch_adaptive_t *a = &adaptive[index];
+    uint32_t previous_ms = a->interval_ms;
+
+    fetch_adaptive_reason_t reason = fetch_adaptive_update(a, sample->err, &sample->values);
+    fetch_scheduler_set_interval(&scheduler, a->interval_ms);
+    ESP_LOGI(TAG, "Adapt %s: t=%lld ms, found 0x%x, value %ld, max-age %ld s, volatility %u/%u -> %u ms (%s, was %u ms)",
+             table[index].name, (long long)(sample->timestamp_us / 1000), (unsigned)sample->values.found,
+             (long)sample->values.values[0], (long)sample->values.max_age_s, (unsigned)a->volatility,
+             1u << FETCH_ADAPTIVE_FRAC_BITS, (unsigned)a->interval_ms,
+             fetch_adaptive_reason_name(reason), (unsigned)previous_ms);
+}
+
+/**
+ * @brief Extract the values of a pushed message with the rules of its source and publish them.
+ *
+ * The duration of the sample is the time from receiving the whole message to publishing the values.
+ */
+static void fetch_push_publish(const fetch_push_msg_t *msg) {
+    const data_scraping_source_t *source = &table[msg->source];
+    fetch_sample_t sample = {0};
+
+    sample.source = msg->source;
+    sample.seq = fetch_next_seq(msg->source);
+    sample.pushed = true;
+    sample.timestamp_us = msg->received_us;
+    sample.err = data_scraping_extract(source, msg->data, msg->len, &sample.values);
+    if (sample.err != ESP_OK) {
+        return;  // Keep the last good sample, a malformed message says nothing about the source
+    }
+    sample.duration_us = esp_timer_get_time() - sample.timestamp_us;   // Set before the sample is visible to readers
+    xQueueOverwrite(mailboxes[msg->source], &sample);
+    ESP_LOGI(TAG, "Push %u of %s published %lld us after arrival", (unsigned)sample.seq, source->name,
+             (long long)sample.duration_us);
+}
+
+/**
+ * @brief Publish the values received from the fan-out leader (called from the fan-out task).
+ */
+static void fetch_fanout_sample(uint8_t source, const data_scraping_values_t *values) {
+    fetch_sample_t sample = {0};
+
+    if (source >= table_count) {
+        return;  // Leader runs a firmware with more sources
+    }
+    sample.source = source;
+    sample.seq = fetch_next_seq(source);
+    sample.pushed = true;
+    sample.timestamp_us = esp_timer_get_time();
+    sample.values = *values;
+    xQueueOverwrite(mailboxes[source], &sample);
+    ESP_LOGI(TAG, "Sample %u of %s received from the leader", (unsigned)sample.seq, table[source].name);
+}
+
+/**
+ * @brief Get the fan-out ID of this device (its station MAC address).
+ */
+static uint64_t fetch_device_id(void) {
+    uint8_t mac[6];
+    uint64_t id = 0;
+
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    for (int i = 0; i < 6; i++) {
+        id = (id << 8) | mac[i];
+    }
+    return id;
+}
+
+/**
+ * @brief Wait until a time, processing the pushed messages arriving in the meantime.
+ */
+static void fetch_wait_until(int64_t due_ms) {
+    int64_t now_ms;
+
+    while ((now_ms = fetch_now_ms()) < due_ms) {
+        TickType_t wait = pdMS_TO_TICKS(due_ms - now_ms) + 1;  // Rounded up so the source is due on wake-up
+        if (push_queue == NULL) {
+            vTaskDelay(wait);
+        } else if (xQueueReceive(push_queue, &push_msg, wait) == pdTRUE) {
+            fetch_push_publish(&push_msg);
+        }
+    }
+}
+
+/**
+ * @brief Fetch task: poll the source due first and publish the result, then sleep until the next one is due.
+ *
+ * Sources delivered by an active subscription are not polled (FETCH_PUSH), nor are any sources on devices
+ * following a fan-out leader (FETCH_FANOUT). Polling takes over as soon as the subscription is lost or this
+ * device is elected. The task waits for fetch_init to start the fan-out and the subscription first.
+ */
+static void fetch_task(void *arg) {
+    fetch_sample_t sample;
+    uint8_t index;
+    int64_t due_ms;
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while (fetch_scheduler_next(&scheduler, &index, &due_ms)) {
+        if (due_ms > fetch_now_ms()) {
+            fetch_wait_until(due_ms);
+            continue;
+        }
+
+        const data_scraping_source_t *source = &table[index];
+        if (push_queue != NULL && fetch_push_is_live(index)) {
+            ESP_LOGD(TAG, "Poll of %s skipped, values are pushed", source->name);
+            fetch_scheduler_done(&scheduler, fetch_now_ms());
+            continue;
+        } else if (fanout_active && !fanout_is_leader()) {
+            ESP_LOGD(TAG, "Poll of %s skipped, the fan-out leader fetches", source->name);
+            fetch_scheduler_done(&scheduler, fetch_now_ms());
+            continue;
+        }
+
+        memset(&sample, 0, sizeof(sample));
+        sample.source = index;
+        sample.seq = fetch_next_seq(index);
+        sample.timestamp_us = esp_timer_get_time();
+        sample.err = fetch_fn(source, &sample.values);
+        sample.duration_us = esp_timer_get_time() - sample.timestamp_us;
+        if (sample.err != ESP_OK) {
+            ESP_LOGW(TAG, "Fetch %u of %s failed (%s)", (unsigned)sample.seq, source->name, esp_err_to_name(sample.err));
+            memset(&sample.values, 0, sizeof(sample.values));
+        } else {
+            ESP_LOGI(TAG, "Fetch %u of %s done in %lld ms", (unsigned)sample.seq, source->name,
+                     (long long)(sample.duration_us / 1000));
+        }
+
+        xQueueOverwrite(mailboxes[index], &sample);  // Readers always see the latest sample, never block the task
+        if (fanout_active && sample.err == ESP_OK) {
+            fanout_publish(index, &sample.values);
+        }
+
+        if (FETCH_ADAPTIVE) {
+            fetch_adapt_interval(index, &sample);
+        }
+
+        /* Next poll measured from the scheduled time; a source behind by a whole interval skips the missed polls */
+        fetch_scheduler_done(&scheduler, sample.timestamp_us / 1000);
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t fetch_init(const data_scraping_source_t *sources, uint8_t count, fetch_source_t fetch) {
+    if (sources == NULL || count == 0 || count > FETCH_MAX_SOURCES || fetch == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t now_ms = fetch_now_ms();
+    fetch_scheduler_init(&scheduler);
+    for (uint8_t i = 0; i < count; i++) {
+        fetch_adaptive_init(&adaptive[i], sources[i].interval_ms, sources[i].min_interval_ms, sources[i].max_interval_ms);
+        if (fetch_scheduler_add(&scheduler, i, sources[i].interval_ms, sources[i].priority, now_ms) != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid interval of source %s", sources[i].name);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        mailboxes[i] = xQueueCreate(1, sizeof(fetch_sample_t));
+        if (mailboxes[i] == NULL) {
+            ESP_LOGE(TAG, "Failed to create the mailbox of source %s", sources[i].name);
+            while (i-- > 0) {
+                vQueueDelete(mailboxes[i]);
+                mailboxes[i] = NULL;
+            }
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    table = sources;
+    table_count = count;
+    fetch_fn = fetch;
+    memset(seq, 0, sizeof(seq));
+
+    /* The task is created first and waits: the fan-out and the MQTT client publish into the mailboxes and cannot
+       be stopped, so they are only started once nothing can fail anymore */
+    if (xTaskCreate(fetch_task, "fetch", FETCH_TASK_STACK_SIZE, NULL, FETCH_TASK_PRIORITY, &task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the fetch task");
+        for (uint8_t i = 0; i < count; i++) {
+            vQueueDelete(mailboxes[i]);
+            mailboxes[i] = NULL;
+        }
+        table_count = 0;
+        task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (FETCH_FANOUT) {
+        fanout_active = (fanout_init(fetch_device_id(), fetch_fanout_sample) == ESP_OK);
+        if (!fanout_active) {
+            ESP_LOGW(TAG, "Fan-out not available, fetching locally");
+        }
+    }
+
+    if (FETCH_PUSH) {
+        push_queue = xQueueCreate(FETCH_PUSH_QUEUE_LEN, sizeof(fetch_push_msg_t));
+        if (push_queue == NULL || fetch_push_init(sources, count, push_queue) != ESP_OK) {
+            ESP_LOGW(TAG, "Push updates not available, polling only");
+            if (push_queue != NULL) {
+                vQueueDelete(push_queue);
+                push_queue = NULL;
+            }
+        }
+    }
+    xTaskNotifyGive(task);
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (FETCH_ADAPTIVE) {
+            ESP_LOGI(TAG, "Polling %s every %u ms (adaptive, %u to %u ms)", sources[i].name,
+                     (unsigned)adaptive[i].interval_ms, (unsigned)adaptive[i].min_ms, (unsigned)adaptive[i].max_ms);
+        } else {
+            ESP_LOGI(TAG, "Polling %s every %u ms", sources[i].name, (unsigned)sources[i].interval_ms);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t fetch_get_latest(uint8_t source, fetch_sample_t *sample, TickType_t wait) {
+    if (sample == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    } else if (source >= table_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return (xQueuePeek(mailboxes[source], sample, wait) == pdTRUE) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
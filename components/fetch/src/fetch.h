@@ -0,0 +1,53 @@
+/**
+ * @file    fetch.h
+ * @brief   Fetch task polling each source at its own interval and publishing the latest sample of each
+ *          through a single-value mailbox
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include "config_macros.h"
+#include "data_scraping.h"
+#include "freertos/FreeRTOS.h"
+
+/* Function fetching the values of a source (data_scraping_fetch, or a stand-in for testing) */
+typedef esp_err_t (*fetch_source_t)(const data_scraping_source_t *source, data_scraping_values_t *values);
+
+/* Result of a single fetch */
+typedef struct {
+    uint8_t source;                 // Index of the source in the table passed to fetch_init
+    uint32_t seq;                   // Sequence number of the fetch of this source (starting from 1)
+    bool pushed;                    // Values arrived in a message (FETCH_PUSH) or from the fan-out leader, not from a poll
+    esp_err_t err;                  // Result of the fetch
+    int64_t timestamp_us;           // Time of the fetch start or of the message arrival (esp_timer_get_time)
+    int64_t duration_us;            // Duration of the fetch (0 for a pushed message)
+    data_scraping_values_t values;  // Extracted values (valid if err is ESP_OK)
+} fetch_sample_t;
+
+/**
+ * @brief Create the mailboxes and start the fetch task.
+ *
+ * The task polls each source every interval_ms (measured from the scheduled time, so slow fetches do not make
+ * the period drift). Sources due at the same time are polled in the order of their priority, one at a time,
+ * and each result overwrites the mailbox of its source. With FETCH_PUSH, the values of sources with a topic are
+ * published as soon as a message arrives, and those sources are polled only while the subscription is down.
+ *
+ * @param sources Table of sources (not copied, must outlive the task). Must not be NULL.
+ * @param count   Number of sources (1 to FETCH_MAX_SOURCES).
+ * @param fetch   Function fetching the values. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if an argument or a source interval is invalid,
+ *         ESP_ERR_INVALID_STATE if already started, ESP_ERR_NO_MEM if the task or a mailbox could not be created.
+ */
+esp_err_t fetch_init(const data_scraping_source_t *sources, uint8_t count, fetch_source_t fetch);
+
+/**
+ * @brief Get the latest sample of a source without removing it from its mailbox.
+ *
+ * @param source Index of the source in the table passed to fetch_init.
+ * @param sample Pointer to the structure where the sample will be copied. Must not be NULL.
+ * @param wait   Max time to wait for the first sample (0 to return immediately).
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no fetch of the source has finished yet,
+ *         ESP_ERR_INVALID_ARG if the source does not exist, ESP_ERR_INVALID_STATE if the task was not started.
+ */
+esp_err_t fetch_get_latest(uint8_t source, fetch_sample_t *sample, TickType_t wait);
@@ -0,0 +1,121 @@
+/**
+ * @file    fetch_adaptive.c
+ * @brief   Poll interval adapting to the changes of the values and to the server freshness lifetime
+ *          (no RTOS calls, can be replayed against recorded samples)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fetch_adaptive.h"
+
+#include <string.h>
+
+/**
+ * @brief Clamp an interval to the bounds of the source.
+ */
+static uint32_t fetch_adaptive_clamp(const fetch_adaptive_t *a, uint64_t interval_ms) {
+    if (interval_ms < a->min_ms) {
+        return a->min_ms;
+    } else if (interval_ms > a->max_ms) {
+        return a->max_ms;
+    }
+    return (uint32_t)interval_ms;
+}
+
+/**
+ * @brief Get the largest change of a value found in both samples.
+ */
+static uint32_t fetch_adaptive_change(const fetch_adaptive_t *a, const data_scraping_values_t *values) {
+    uint32_t common = values->found & a->last.found;
+    uint64_t largest = 0;
+
+    for (int i = 0; i < DATA_SCRAPING_MAX_VALUES; i++) {
+        if ((common & (1u << i)) == 0) {
+            continue;
+        }
+        int64_t delta = (int64_t)values->values[i] - a->last.values[i];
+        uint64_t change = (uint64_t)((delta < 0) ? -delta : delta);
+        if (change > largest) {
+            largest = change;
+        }
+    }
+    return (largest > UINT32_MAX) ? UINT32_MAX : (uint32_t)largest;
+}
+
+/**
+ * @brief Move the smoothed volatility towards a new change by 1/2^FETCH_VOLATILITY_SHIFT of the difference.
+ *
+ * The step is rounded half away from zero, so the EWMA does not stop short of the change on either side.
+ */
+static uint32_t fetch_adaptive_smooth(uint32_t volatility, uint32_t change) {
+    int64_t target = (int64_t)change << FETCH_ADAPTIVE_FRAC_BITS;
+    int64_t diff = target - volatility;
+    int64_t half = (1 << FETCH_VOLATILITY_SHIFT) >> 1;
+    int64_t step = (diff >= 0) ? (diff + half) >> FETCH_VOLATILITY_SHIFT : -((-diff + half) >> FETCH_VOLATILITY_SHIFT);
+    int64_t smoothed = volatility + step;
+
+    return (smoothed > UINT32_MAX) ? UINT32_MAX : (uint32_t)smoothed;
+}
+
+void fetch_adaptive_init(fetch_adaptive_t *a, uint32_t interval_ms, uint32_t min_ms, uint32_t max_ms) {
+    memset(a, 0, sizeof(*a));
+    a->min_ms = (min_ms > 0) ? min_ms : 1;
+    a->max_ms = (max_ms > a->min_ms) ? max_ms : a->min_ms;
+    a->interval_ms = fetch_adaptive_clamp(a, interval_ms);
+    a->base_ms = a->interval_ms;
+}
+
+fetch_adaptive_reason_t fetch_adaptive_update(fetch_adaptive_t *a, esp_err_t err, const data_scraping_values_t *values) {
+    fetch_adaptive_reason_t reason = FETCH_ADAPTIVE_HOLD;
+
+    if (err != ESP_OK) {
+        /* No information about the values: retry at the base interval, backing off while the fetches fail */
+        uint8_t doublings = (a->failures < 16) ? a->failures : 16;
+        a->interval_ms = fetch_adaptive_clamp(a, (uint64_t)a->base_ms << doublings);
+        if (a->failures < UINT8_MAX) {
+            a->failures++;
+        }
+        return FETCH_ADAPTIVE_ERROR;
+    }
+    a->failures = 0;
+
+    if (a->have_last) {
+        a->volatility = fetch_adaptive_smooth(a->volatility, fetch_adaptive_change(a, values));
+
+        if (a->volatility >= ((uint32_t)FETCH_VOLATILITY_HIGH << FETCH_ADAPTIVE_FRAC_BITS)) {
+            a->interval_ms = fetch_adaptive_clamp(a, a->interval_ms / 2);
+            reason = FETCH_ADAPTIVE_VOLATILE;
+        } else if (a->volatility < ((uint32_t)FETCH_VOLATILITY_LOW << FETCH_ADAPTIVE_FRAC_BITS)) {
+            a->interval_ms = fetch_adaptive_clamp(a, (uint64_t)a->interval_ms + a->interval_ms / 2);
+            reason = FETCH_ADAPTIVE_STABLE;
+        }
+    }
+
+    if (values->max_age_s > 0 && (uint64_t)values->max_age_s * 1000 > a->interval_ms) {
+        uint32_t stretched = fetch_adaptive_clamp(a, (uint64_t)values->max_age_s * 1000);
+        if (stretched > a->interval_ms) {
+            a->interval_ms = stretched;
+            reason = FETCH_ADAPTIVE_MAX_AGE;
+        }
+    }
+
+    a->last = *values;
+    a->have_last = true;
+    return reason;
+}
+
+const char *fetch_adaptive_reason_name(fetch_adaptive_reason_t reason) {
+    switch (reason) {
+        case FETCH_ADAPTIVE_HOLD:
+            return "hold";
+        case FETCH_ADAPTIVE_VOLATILE:
+            return "volatile";
+        case FETCH_ADAPTIVE_STABLE:
+            return "stable";
+        case FETCH_ADAPTIVE_MAX_AGE:
+            return "max-age";
+        case FETCH_ADAPTIVE_ERROR:
+            return "error";
+        default:
+            return "unknown";
+    }
+}
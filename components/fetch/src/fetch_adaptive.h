@@ -0,0 +1,80 @@
+/**
+ * @file    fetch_adaptive.h
+ * @brief   Poll interval adapting to the changes of the values and to the server freshness lifetime
+ *          (no RTOS calls, can be replayed against recorded samples)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "data_scraping.h"
+
+#define FETCH_ADAPTIVE_FRAC_BITS 8      // Fractional bits of the smoothed volatility (FETCH_VOLATILITY_SHIFT up to this)
+
+#if FETCH_VOLATILITY_SHIFT > FETCH_ADAPTIVE_FRAC_BITS
+#error "FETCH_VOLATILITY_SHIFT larger than FETCH_ADAPTIVE_FRAC_BITS, the volatility would stop short of small changes"
+#endif
+
+/* Reason of an interval decision */
+typedef enum {
+    FETCH_ADAPTIVE_HOLD = 0x00,         // Volatility between the thresholds (or first sample), interval kept
+    FETCH_ADAPTIVE_VOLATILE = 0x01,     // Volatility of at least FETCH_VOLATILITY_HIGH, interval halved
+    FETCH_ADAPTIVE_STABLE = 0x02,       // Volatility below FETCH_VOLATILITY_LOW, interval grown by half
+    FETCH_ADAPTIVE_MAX_AGE = 0x03,      // Interval stretched to the freshness lifetime declared by the server
+    FETCH_ADAPTIVE_ERROR = 0x04         // Fetch failed, interval back to the base one, doubled for each further failure
+} fetch_adaptive_reason_t;
+
+/* Adaptive interval of a source */
+typedef struct {
+    uint32_t interval_ms;               // Current poll interval
+    uint32_t min_ms;                    // Lower bound of the interval
+    uint32_t max_ms;                    // Upper bound of the interval
+    uint32_t base_ms;                   // Interval the source was configured with (restored after a failed fetch)
+    uint32_t volatility;                // Smoothed change between successive samples [1/2^FETCH_ADAPTIVE_FRAC_BITS scaled units]
+    data_scraping_values_t last;        // Values of the last successful fetch
+    bool have_last;                     // last is valid
+    uint8_t failures;                   // Failed fetches since the last successful one
+} fetch_adaptive_t;
+
+/**
+ * @brief Initialise the adaptive interval.
+ *
+ * @param a           Pointer to the state. Must not be NULL.
+ * @param interval_ms Initial and base interval (clamped to the bounds).
+ * @param min_ms      Lower bound of the interval (greater than 0).
+ * @param max_ms      Upper bound of the interval (not less than min_ms).
+ */
+void fetch_adaptive_init(fetch_adaptive_t *a, uint32_t interval_ms, uint32_t min_ms, uint32_t max_ms);
+
+/**
+ * @brief Update the interval with the result of a fetch.
+ *
+ * The volatility is the largest change of any value found in both samples, smoothed by an EWMA. It is not
+ * divided by the time between the samples: the values (e.g. grid frequency) return to their mean, so a long
+ * interval would hide an event that has already passed. Longer intervals see larger changes, so the interval
+ * settles where the change between polls stays between the thresholds. Volatility of at least FETCH_VOLATILITY_HIGH halves the interval, below FETCH_VOLATILITY_LOW
+ * it grows by half. A freshness lifetime declared by the server longer than the result then stretches it,
+ * since polling earlier would only return the same values. The interval always stays within the bounds.
+ *
+ * The EWMA keeps FETCH_ADAPTIVE_FRAC_BITS fractional bits and rounds its steps symmetrically, so a constant
+ * change is reached within half a unit from above and from below for any FETCH_VOLATILITY_SHIFT up to that.
+ *
+ * A failed fetch says nothing about the values: the interval goes back to the base one (a stretched interval
+ * would delay the retry), then doubles for each further failure so that an unreachable server is not polled
+ * at the shortest interval.
+ *
+ * @param a      Pointer to the state. Must not be NULL.
+ * @param err    Result of the fetch.
+ * @param values Values of the fetch (ignored unless err is ESP_OK). Must not be NULL.
+ * @return Reason of the decision (the new interval is a->interval_ms).
+ */
+fetch_adaptive_reason_t fetch_adaptive_update(fetch_adaptive_t *a, esp_err_t err, const data_scraping_values_t *values);
+
+/**
+ * @brief Get the name of a decision reason.
+ */
+const char *fetch_adaptive_reason_name(fetch_adaptive_reason_t reason);
@@ -0,0 +1,216 @@
+/**
+ * @file    fetch_push.c
+ * @brief   MQTT subscription delivering the documents of the sources as they are published
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fetch_push.h"
+
+#include <string.h>
+
+#if TLS_TRUST_MODE == TLS_TRUST_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+
+#define TAG "fetch_push"
+
+static esp_mqtt_client_handle_t client = NULL;          // MQTT client
+static const data_scraping_source_t *table = NULL;      // Sources
+static uint8_t table_count = 0;                         // Number of sources
+static QueueHandle_t push_queue = NULL;                 // Queue of the fetch task
+static int subscribe_ids[FETCH_MAX_SOURCES];            // Message ID of the pending subscription of each source
+static volatile bool live[FETCH_MAX_SOURCES];           // Subscription of each source is active
+static int64_t last_us[FETCH_MAX_SOURCES];              // Time of the last message (or subscription) of each source
+static bool stale[FETCH_MAX_SOURCES];                   // Source went silent (used by the fetch task only)
+static portMUX_TYPE last_lock = portMUX_INITIALIZER_UNLOCKED;  // Protects last_us (written by the MQTT task)
+static fetch_push_msg_t msg;                            // Message being reassembled (used by the MQTT task only)
+static bool msg_valid = false;                          // msg belongs to a source and fits in the buffer
+static fetch_push_stats_t stats;                        // Subscription counters
+
+/**
+ * @brief Find the source subscribed to a topic.
+ *
+ * @return Index of the source, table_count if none.
+ */
+static uint8_t fetch_push_find(const char *topic, int topic_len) {
+    for (uint8_t i = 0; i < table_count; i++) {
+        const char *t = table[i].topic;
+        if (t != NULL && (int)strlen(t) == topic_len && strncmp(t, topic, topic_len) == 0) {
+            return i;
+        }
+    }
+    return table_count;
+}
+
+/**
+ * @brief Record that a source has just been heard from.
+ */
+static void fetch_push_touch(uint8_t source) {
+    int64_t now_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&last_lock);
+    last_us[source] = now_us;
+    taskEXIT_CRITICAL(&last_lock);
+}
+
+/**
+ * @brief Reassemble a (possibly fragmented) message and queue it for the fetch task.
+ */
+static void fetch_push_data(const esp_mqtt_event_t *event) {
+    if (event->current_data_offset == 0) {  // First fragment (the only one carrying the topic)
+        uint8_t source = fetch_push_find(event->topic, event->topic_len);
+        msg_valid = (source < table_count && event->total_data_len <= FETCH_PUSH_PAYLOAD_MAX);
+        if (!msg_valid) {
+            ESP_LOGW(TAG, "Dropped a message of %d bytes on %.*s", event->total_data_len, event->topic_len, event->topic);
+            stats.dropped++;
+            return;
+        }
+        msg.source = source;
+        msg.len = 0;
+    }
+    if (!msg_valid || event->current_data_offset != msg.len) {
+        return;
+    }
+
+    memcpy(msg.data + msg.len, event->data, event->data_len);
+    msg.len += event->data_len;
+    if (msg.len < event->total_data_len) {
+        return;  // More fragments follow
+    }
+
+    msg.received_us = esp_timer_get_time();
+    msg_valid = false;
+    fetch_push_touch(msg.source);
+    if (xQueueSend(push_queue, &msg, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Fetch task busy, message of %s dropped", table[msg.source].name);
+        stats.dropped++;
+        return;
+    }
+    stats.messages++;
+}
+
+/**
+ * @brief MQTT event handler (runs in the MQTT task, must not block).
+ */
+static void fetch_push_event_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data) {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "Connected to the broker");
+            stats.connects++;
+            for (uint8_t i = 0; i < table_count; i++) {
+                if (table[i].topic != NULL) {
+                    subscribe_ids[i] = esp_mqtt_client_subscribe(client, table[i].topic, 0);
+                }
+            }
+            break;
+        case MQTT_EVENT_SUBSCRIBED:
+            for (uint8_t i = 0; i < table_count; i++) {
+                if (table[i].topic != NULL && subscribe_ids[i] == event->msg_id) {
+                    ESP_LOGI(TAG, "Subscribed to %s, polling of %s suspended", table[i].topic, table[i].name);
+                    fetch_push_touch(i);    // The first message is expected within the stale time
+                    live[i] = true;
+                }
+            }
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            ESP_LOGW(TAG, "Disconnected from the broker, polling resumed");
+            stats.disconnects++;
+            for (uint8_t i = 0; i < table_count; i++) {
+                live[i] = false;
+                subscribe_ids[i] = -1;
+            }
+            msg_valid = false;
+            break;
+        case MQTT_EVENT_DATA:
+            fetch_push_data(event);
+            break;
+        case MQTT_EVENT_ERROR:
+            ESP_LOGW(TAG, "MQTT error (type %d)", (int)event->error_handle->error_type);
+            break;
+        default:
+            break;
+    }
+}
+
+esp_err_t fetch_push_init(const data_scraping_source_t *sources, uint8_t count, QueueHandle_t queue) {
+    if (sources == NULL || count > FETCH_MAX_SOURCES || queue == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (client != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_mqtt_client_config_t config = {
+        .uri = FETCH_PUSH_URI,
+        .keepalive = FETCH_PUSH_KEEPALIVE_S,
+    };
+    if (strncmp(FETCH_PUSH_URI, "mqtts://", 8) == 0) {
+#if TLS_TRUST_MODE == TLS_TRUST_BUNDLE
+        config.crt_bundle_attach = esp_crt_bundle_attach;
+#elif TLS_TRUST_MODE == TLS_TRUST_CA
+        config.cert_pem = TLS_TRUST_CA_PEM;
+#else
+        ESP_LOGE(TAG, "Key pinning is not supported by the MQTT client");
+        return ESP_ERR_NOT_SUPPORTED;
+#endif
+    }
+
+    table = sources;
+    table_count = count;
+    push_queue = queue;
+    memset(&stats, 0, sizeof(stats));
+    for (uint8_t i = 0; i < FETCH_MAX_SOURCES; i++) {
+        subscribe_ids[i] = -1;
+        live[i] = false;
+        last_us[i] = 0;
+        stale[i] = false;
+    }
+
+    client = esp_mqtt_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "Failed to create the MQTT client");
+        return ESP_FAIL;
+    }
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, fetch_push_event_handler, NULL);
+    if (esp_mqtt_client_start(client) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the MQTT client");
+        esp_mqtt_client_destroy(client);
+        client = NULL;
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Subscribing at %s", FETCH_PUSH_URI);
+    return ESP_OK;
+}
+
+bool fetch_push_is_live(uint8_t source) {
+    if (source >= table_count || !live[source]) {
+        return false;
+    }
+
+    taskENTER_CRITICAL(&last_lock);
+    int64_t silent_us = esp_timer_get_time() - last_us[source];
+    taskEXIT_CRITICAL(&last_lock);
+
+    bool silent = silent_us > (int64_t)FETCH_PUSH_STALE_INTERVALS * table[source].interval_ms * 1000;
+    if (silent && !stale[source]) {
+        ESP_LOGW(TAG, "No message of %s for %lld ms, polling resumed", table[source].name, (long long)(silent_us / 1000));
+        stats.stale++;
+    } else if (!silent && stale[source]) {
+        ESP_LOGI(TAG, "Messages of %s delivered again, polling suspended", table[source].name);
+    }
+    stale[source] = silent;
+    return !silent;
+}
+
+esp_err_t fetch_push_get_stats(fetch_push_stats_t *out) {
+    if (out == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = stats;
+    return ESP_OK;
+}
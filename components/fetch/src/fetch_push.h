@@ -0,0 +1,66 @@
+/**
+ * @file    fetch_push.h
+ * @brief   MQTT subscription delivering the documents of the sources as they are published
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "data_scraping.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+/* Message received on the topic of a source */
+typedef struct {
+    uint8_t source;                     // Index of the source in the table passed to fetch_push_init
+    int64_t received_us;                // Time the whole message was received (esp_timer_get_time)
+    uint16_t len;                       // Length of the message
+    char data[FETCH_PUSH_PAYLOAD_MAX];  // Message (not null-terminated)
+} fetch_push_msg_t;
+
+/* Subscription counters */
+typedef struct {
+    uint32_t connects;                  // Connections to the broker
+    uint32_t disconnects;               // Lost connections (polling resumes until the next connect)
+    uint32_t messages;                  // Messages queued for the fetch task
+    uint32_t dropped;                   // Messages dropped (too long or queue full)
+    uint32_t stale;                     // Times a subscribed source went silent (polled until its next message)
+} fetch_push_stats_t;
+
+/**
+ * @brief Connect to FETCH_PUSH_URI and subscribe to the topic of each source that has one.
+ *
+ * Messages are copied to the queue (items of fetch_push_msg_t) without blocking the MQTT task. The client
+ * reconnects and subscribes again on its own after a disconnect.
+ *
+ * @param sources Table of sources (not copied, must outlive the client). Must not be NULL.
+ * @param count   Number of sources (up to FETCH_MAX_SOURCES).
+ * @param queue   Queue receiving the messages. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED if the trust mode cannot be used with the MQTT client,
+ *         ESP_FAIL if the client could not be started.
+ */
+esp_err_t fetch_push_init(const data_scraping_source_t *sources, uint8_t count, QueueHandle_t queue);
+
+/**
+ * @brief Check if the messages of a source are being delivered.
+ *
+ * The source must be subscribed and its last message (or the subscription, before the first message) must be
+ * less than FETCH_PUSH_STALE_INTERVALS poll intervals old: a publisher that stopped while the broker stays
+ * connected would otherwise suspend polling for good.
+ *
+ * @param source Index of the source.
+ * @return true if the source does not need to be polled, false otherwise.
+ */
+bool fetch_push_is_live(uint8_t source);
+
+/**
+ * @brief Get the subscription counters.
+ *
+ * @param out Pointer to the structure where the counters will be copied. Must not be NULL.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if out is NULL.
+ */
+esp_err_t fetch_push_get_stats(fetch_push_stats_t *out);
@@ -0,0 +1,112 @@
+/**
+ * @file    fetch_scheduler.c
+ * @brief   Deadline scheduler ordering sources with individual poll intervals (no allocation, no RTOS calls)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fetch_scheduler.h"
+
+#include <string.h>
+
+/**
+ * @brief Check if entry a is due before entry b.
+ */
+static bool fetch_scheduler_before(const fetch_scheduler_entry_t *a, const fetch_scheduler_entry_t *b) {
+    if (a->due_ms != b->due_ms) {
+        return a->due_ms < b->due_ms;
+    } else if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return a->index < b->index;
+}
+
+/**
+ * @brief Swap two heap nodes.
+ */
+static void fetch_scheduler_swap(fetch_scheduler_t *s, uint8_t i, uint8_t j) {
+    fetch_scheduler_entry_t tmp = s->heap[i];
+    s->heap[i] = s->heap[j];
+    s->heap[j] = tmp;
+}
+
+/**
+ * @brief Move a node towards the root until the heap order holds.
+ */
+static void fetch_scheduler_sift_up(fetch_scheduler_t *s, uint8_t i) {
+    while (i > 0) {
+        uint8_t parent = (i - 1) / 2;
+        if (!fetch_scheduler_before(&s->heap[i], &s->heap[parent])) {
+            break;
+        }
+        fetch_scheduler_swap(s, i, parent);
+        i = parent;
+    }
+}
+
+/**
+ * @brief Move a node towards the leaves until the heap order holds.
+ */
+static void fetch_scheduler_sift_down(fetch_scheduler_t *s, uint8_t i) {
+    while (true) {
+        uint8_t first = i;
+        uint8_t left = 2 * i + 1;
+        uint8_t right = 2 * i + 2;
+
+        if (left < s->count && fetch_scheduler_before(&s->heap[left], &s->heap[first])) {
+            first = left;
+        }
+        if (right < s->count && fetch_scheduler_before(&s->heap[right], &s->heap[first])) {
+            first = right;
+        }
+        if (first == i) {
+            break;
+        }
+        fetch_scheduler_swap(s, i, first);
+        i = first;
+    }
+}
+
+void fetch_scheduler_init(fetch_scheduler_t *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+esp_err_t fetch_scheduler_add(fetch_scheduler_t *s, uint8_t index, uint32_t interval_ms, uint8_t priority, int64_t due_ms) {
+    if (interval_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    } else if (s->count >= FETCH_MAX_SOURCES) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    s->heap[s->count] = (fetch_scheduler_entry_t){
+        .due_ms = due_ms, .interval_ms = interval_ms, .priority = priority, .index = index};
+    s->count++;
+    fetch_scheduler_sift_up(s, s->count - 1);
+    return ESP_OK;
+}
+
+bool fetch_scheduler_next(const fetch_scheduler_t *s, uint8_t *index, int64_t *due_ms) {
+    if (s->count == 0) {
+        return false;
+    }
+    *index = s->heap[0].index;
+    *due_ms = s->heap[0].due_ms;
+    return true;
+}
+
+void fetch_scheduler_set_interval(fetch_scheduler_t *s, uint32_t interval_ms) {
+    if (interval_ms > 0) {
+        s->heap[0].interval_ms = interval_ms;
+    }
+}
+
+uint8_t fetch_scheduler_done(fetch_scheduler_t *s, int64_t started_ms) {
+    fetch_scheduler_entry_t *entry = &s->heap[0];
+
+    entry->due_ms += entry->interval_ms;
+    if (entry->due_ms <= started_ms) {
+        entry->due_ms = started_ms + entry->interval_ms;    // Skip the missed polls instead of catching up
+    }
+    uint8_t index = entry->index;
+    fetch_scheduler_sift_down(s, 0);
+    return index;
+}
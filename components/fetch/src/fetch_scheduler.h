@@ -0,0 +1,78 @@
+/**
+ * @file    fetch_scheduler.h
+ * @brief   Deadline scheduler ordering sources with individual poll intervals (no allocation, no RTOS calls)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "config_macros.h"
+#include "esp_err.h"
+
+/* Scheduled source (heap node) */
+typedef struct {
+    int64_t due_ms;         // Time the source is due (same clock as passed to the scheduler)
+    uint32_t interval_ms;   // Poll interval
+    uint8_t priority;       // Order of sources due at the same time (lower first)
+    uint8_t index;          // Index of the source in the caller's table
+} fetch_scheduler_entry_t;
+
+/* Scheduler state (binary min-heap ordered by due time, then priority, then index) */
+typedef struct {
+    fetch_scheduler_entry_t heap[FETCH_MAX_SOURCES];    // Heap of the scheduled sources
+    uint8_t count;                                      // Number of scheduled sources
+} fetch_scheduler_t;
+
+/**
+ * @brief Clear the scheduler.
+ *
+ * @param s Pointer to the scheduler. Must not be NULL.
+ */
+void fetch_scheduler_init(fetch_scheduler_t *s);
+
+/**
+ * @brief Schedule a source.
+ *
+ * @param s           Pointer to the scheduler. Must not be NULL.
+ * @param index       Index of the source in the caller's table.
+ * @param interval_ms Poll interval (greater than 0).
+ * @param priority    Order of sources due at the same time (lower first).
+ * @param due_ms      Time of the first poll.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the interval is 0, ESP_ERR_NO_MEM if FETCH_MAX_SOURCES
+ *         sources are already scheduled.
+ */
+esp_err_t fetch_scheduler_add(fetch_scheduler_t *s, uint8_t index, uint32_t interval_ms, uint8_t priority, int64_t due_ms);
+
+/**
+ * @brief Get the source due first without removing it.
+ *
+ * @param s      Pointer to the scheduler. Must not be NULL.
+ * @param index  Pointer where the index of the source will be stored. Must not be NULL.
+ * @param due_ms Pointer where its due time will be stored. Must not be NULL.
+ * @return true if a source is scheduled, false if the scheduler is empty.
+ */
+bool fetch_scheduler_next(const fetch_scheduler_t *s, uint8_t *index, int64_t *due_ms);
+
+/**
+ * @brief Change the interval of the source due first (takes effect when it is rescheduled by fetch_scheduler_done).
+ *
+ * @param s           Pointer to the scheduler holding at least one source. Must not be NULL.
+ * @param interval_ms New poll interval (greater than 0).
+ */
+void fetch_scheduler_set_interval(fetch_scheduler_t *s, uint32_t interval_ms);
+
+/**
+ * @brief Reschedule the source due first after it has been polled.
+ *
+ * The next due time is the previous one plus the interval, so polls do not drift with the fetch duration.
+ * A source that fell behind by a whole interval (long fetch, busy connection) is rescheduled one interval
+ * after started_ms instead of being polled back to back.
+ *
+ * @param s          Pointer to the scheduler holding at least one source. Must not be NULL.
+ * @param started_ms Time the poll started.
+ * @return Index of the rescheduled source.
+ */
+uint8_t fetch_scheduler_done(fetch_scheduler_t *s, int64_t started_ms);
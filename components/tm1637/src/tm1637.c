@@ -15,9 +15,12 @@
 #include <string.h>
 #include <math.h>
 #include <esp32/rom/ets_sys.h>
+#include <hal/gpio_ll.h>
 
 #define TM1637_ADDR_AUTO  0x40
 #define TM1637_ADDR_FIXED 0x44
+#define TM1637_ADDR_DIGIT 0xc0
+#define TM1637_DISPLAY_ON 0x88
 
 #define MINUS_SIGN_IDX  16
 
@@ -44,8 +47,64 @@ static const int8_t tm1637_symbols[] = {
 
 static void tm1637_start(tm1637_led_t * led);
 static void tm1637_stop(tm1637_led_t * led);
-static void tm1637_send_byte(tm1637_led_t * led, uint8_t byte);
-static void tm1637_delay();
+static bool tm1637_send_byte(tm1637_led_t * led, uint8_t byte);
+static void tm1637_delay(tm1637_led_t * led);
+static bool tm1637_send_brightness(tm1637_led_t * led);
+
+static void tm1637_gpio_setup(gpio_num_t pin, bool readable)
+{
+    gpio_set_direction(pin, GPIO_MODE_OUTPUT);
+}
+
+static void tm1637_gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+    gpio_set_level(pin, level);
+}
+
+static void tm1637_gpio_set_input(gpio_num_t pin, bool input)
+{
+    gpio_set_direction(pin, input ? GPIO_MODE_INPUT : GPIO_MODE_OUTPUT);
+}
+
+const tm1637_pin_ops_t tm1637_pins_gpio = {
+    .setup = tm1637_gpio_setup,
+    .set_level = tm1637_gpio_set_level,
+    .set_input = tm1637_gpio_set_input,
+    .get_level = gpio_get_level,
+};
+
+static void tm1637_reg_setup(gpio_num_t pin, bool readable)
+{
+    // Configured once by the driver; the input buffer of DIO stays on, so the ACK is read by only
+    // disabling the output
+    gpio_set_direction(pin, readable ? GPIO_MODE_INPUT_OUTPUT : GPIO_MODE_OUTPUT);
+}
+
+static void tm1637_reg_set_level(gpio_num_t pin, uint32_t level)
+{
+    gpio_ll_set_level(&GPIO, pin, level);
+}
+
+static void tm1637_reg_set_input(gpio_num_t pin, bool input)
+{
+    if (input) {
+        gpio_ll_output_disable(&GPIO, pin);
+    } else {
+        gpio_ll_output_enable(&GPIO, pin);
+    }
+}
+
+static int tm1637_reg_get_level(gpio_num_t pin)
+{
+    return gpio_ll_get_level(&GPIO, pin);
+}
+
+const tm1637_pin_ops_t tm1637_pins_reg = {
+    .setup = tm1637_reg_setup,
+    .set_level = tm1637_reg_set_level,
+    .set_input = tm1637_reg_set_input,
+    .get_level = tm1637_reg_get_level,
+};
 
 static inline float nearestf(float val,int precision) {
     int scale = pow(10,precision);
@@ -56,80 +115,119 @@ void tm1637_start(tm1637_led_t * led)
 {
     // Send start signal
     // Both outputs are expected to be HIGH beforehand
-    gpio_set_level(led->m_pin_dta, 0);
-    tm1637_delay();
+    led->m_pins->set_level(led->m_pin_dta, 0);
+    tm1637_delay(led);
+    led->m_stats.transactions++;
 }
 
 void tm1637_stop(tm1637_led_t * led)
 {
     // Send stop signal
     // CLK is expected to be LOW beforehand
-    gpio_set_level(led->m_pin_dta, 0);
-    tm1637_delay();
-    gpio_set_level(led->m_pin_clk, 1);
-    tm1637_delay();
-    gpio_set_level(led->m_pin_dta, 1);
-    tm1637_delay();
+    led->m_pins->set_level(led->m_pin_dta, 0);
+    tm1637_delay(led);
+    led->m_pins->set_level(led->m_pin_clk, 1);
+    tm1637_delay(led);
+    led->m_pins->set_level(led->m_pin_dta, 1);
+    tm1637_delay(led);
 }
 
-void tm1637_send_byte(tm1637_led_t * led, uint8_t byte)
+bool tm1637_send_byte(tm1637_led_t * led, uint8_t byte)
 {
+    led->m_stats.bytes++;
     for (uint8_t i=0; i<8; ++i)
     {
-        gpio_set_level(led->m_pin_clk, 0);
-        tm1637_delay();
-        gpio_set_level(led->m_pin_dta, byte & 0x01); // Send current bit
+        led->m_pins->set_level(led->m_pin_clk, 0);
+        tm1637_delay(led);
+        led->m_pins->set_level(led->m_pin_dta, byte & 0x01); // Send current bit
         byte >>= 1;
-        tm1637_delay();
-        gpio_set_level(led->m_pin_clk, 1);
-        tm1637_delay();
+        tm1637_delay(led);
+        led->m_pins->set_level(led->m_pin_clk, 1);
+        tm1637_delay(led);
     }
 
     // The TM1637 signals an ACK by pulling DIO low from the falling edge of
     // CLK after sending the 8th bit, to the next falling edge of CLK.
     // DIO needs to be set as input during this time to avoid having both
     // chips trying to drive DIO at the same time.
-    gpio_set_direction(led->m_pin_dta, GPIO_MODE_INPUT);
-    gpio_set_level(led->m_pin_clk, 0); // TM1637 starts ACK (pulls DIO low)
-    tm1637_delay();
-    gpio_set_level(led->m_pin_clk, 1);
-    tm1637_delay();
-    gpio_set_level(led->m_pin_clk, 0); // TM1637 ends ACK (releasing DIO)
-    tm1637_delay();
-    gpio_set_direction(led->m_pin_dta, GPIO_MODE_OUTPUT);
+    led->m_pins->set_input(led->m_pin_dta, true);
+    led->m_pins->set_level(led->m_pin_clk, 0); // TM1637 starts ACK (pulls DIO low)
+    tm1637_delay(led);
+    bool ack = (led->m_pins->get_level(led->m_pin_dta) == 0);
+    led->m_pins->set_level(led->m_pin_clk, 1);
+    tm1637_delay(led);
+    led->m_pins->set_level(led->m_pin_clk, 0); // TM1637 ends ACK (releasing DIO)
+    tm1637_delay(led);
+    led->m_pins->set_input(led->m_pin_dta, false);
+
+    if (!ack) {
+        led->m_stats.nacks++; // Chip missing, or the bit delay is too short for the wiring
+        led->m_sent_brightness = 0xFF; // Display control register unknown: sent again with the next write
+    }
+    return ack;
+}
+
+void tm1637_delay(tm1637_led_t * led)
+{
+    ets_delay_us(led->m_delay_us);
+    led->m_stats.delay_us += led->m_delay_us;
 }
 
-void tm1637_delay()
+bool tm1637_send_brightness(tm1637_led_t * led)
 {
-    ets_delay_us(3);
+    if (led->m_brightness == led->m_sent_brightness) {
+        return true; // Display control register keeps its value
+    }
+    tm1637_start(led);
+    bool ack = tm1637_send_byte(led, led->m_brightness | TM1637_DISPLAY_ON);
+    tm1637_stop(led);
+    if (ack) {
+        led->m_sent_brightness = led->m_brightness;
+    }
+    return ack;
 }
 
 // PUBLIC PART:
 
 tm1637_led_t * tm1637_init(gpio_num_t pin_clk, gpio_num_t pin_data) {
+    return tm1637_init_pins(pin_clk, pin_data, &tm1637_pins_reg);
+}
+
+tm1637_led_t * tm1637_init_pins(gpio_num_t pin_clk, gpio_num_t pin_data, const tm1637_pin_ops_t * pins) {
     tm1637_led_t * led = (tm1637_led_t *) malloc(sizeof(tm1637_led_t));
     led->m_pin_clk = pin_clk;
     led->m_pin_dta = pin_data;
+    led->m_pins = pins;
+    led->m_delay_us = TM1637_DELAY_US;
     led->m_brightness = 0x07;
+    led->m_sent_brightness = 0xFF;
+    memset(led->m_frame, 0, sizeof(led->m_frame));
+    memset(&led->m_stats, 0, sizeof(led->m_stats));
     // Set CLK to low during DIO initialization to avoid sending a start signal by mistake
-    gpio_set_direction(pin_clk, GPIO_MODE_OUTPUT);
-    gpio_set_level(pin_clk, 0);
-    tm1637_delay();
-    gpio_set_direction(pin_data, GPIO_MODE_OUTPUT);
-    gpio_set_level(pin_data, 1);
-    tm1637_delay();
-    gpio_set_level(pin_clk, 1);
-    tm1637_delay();
+    pins->setup(pin_clk, false);
+    pins->set_level(pin_clk, 0);
+    tm1637_delay(led);
+    pins->setup(pin_data, true);
+    pins->set_level(pin_data, 1);
+    tm1637_delay(led);
+    pins->set_level(pin_clk, 1);
+    tm1637_delay(led);
     return led;
 }
 
+void tm1637_set_bit_delay(tm1637_led_t * led, uint8_t delay_us)
+{
+    if (delay_us < TM1637_DELAY_MIN_US) { delay_us = TM1637_DELAY_MIN_US; } // Check min delay
+    led->m_delay_us = delay_us;
+}
+
 void tm1637_set_brightness(tm1637_led_t * led, uint8_t level)
 {
     if (level > 0x07) { level = 0x07; } // Check max level
     led->m_brightness = level;
 }
 
-void tm1637_set_segment_number(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t num, const bool dot)
+static uint8_t tm1637_segment_data(const uint8_t num, const bool dot)
 {
     uint8_t seg_data = 0x00;
 
@@ -141,21 +239,78 @@ void tm1637_set_segment_number(tm1637_led_t * led, const uint8_t segment_idx, co
         seg_data |= 0x80; // Set DOT segment flag
     }
 
-    tm1637_set_segment_raw(led, segment_idx, seg_data);
+    return seg_data;
+}
+
+void tm1637_set_segment_number(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t num, const bool dot)
+{
+    tm1637_set_segment_raw(led, segment_idx, tm1637_segment_data(num, dot));
 }
 
 void tm1637_set_segment_raw(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t data)
 {
+    if (segment_idx < TM1637_DIGITS) {
+        led->m_frame[segment_idx] = data;
+    }
     tm1637_start(led);
     tm1637_send_byte(led, TM1637_ADDR_FIXED);
     tm1637_stop(led);
     tm1637_start(led);
-    tm1637_send_byte(led, segment_idx | 0xc0);
+    tm1637_send_byte(led, segment_idx | TM1637_ADDR_DIGIT);
     tm1637_send_byte(led, data);
     tm1637_stop(led);
-    tm1637_start(led);
-    tm1637_send_byte(led, led->m_brightness | 0x88);
-    tm1637_stop(led);
+    tm1637_send_brightness(led);
+}
+
+void tm1637_fb_set_segment_raw(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t data)
+{
+    if (segment_idx < TM1637_DIGITS) {
+        led->m_frame[segment_idx] = data;
+    }
+}
+
+void tm1637_fb_set_segment_number(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t num, const bool dot)
+{
+    tm1637_fb_set_segment_raw(led, segment_idx, tm1637_segment_data(num, dot));
+}
+
+bool tm1637_write_segments(tm1637_led_t * led, const uint8_t first, const uint8_t * data, const uint8_t n)
+{
+    bool ack = true;
+
+    if (n > 0 && first < TM1637_DIGITS && n <= TM1637_DIGITS - first)
+    {
+        memmove(&led->m_frame[first], data, n); // data may be the framebuffer itself
+        // Data command with auto-increment, then the first address followed by the digits
+        tm1637_start(led);
+        ack &= tm1637_send_byte(led, TM1637_ADDR_AUTO);
+        tm1637_stop(led);
+        tm1637_start(led);
+        ack &= tm1637_send_byte(led, first | TM1637_ADDR_DIGIT);
+        for (uint8_t i=first; i<first+n; ++i)
+        {
+            ack &= tm1637_send_byte(led, led->m_frame[i]);
+        }
+        tm1637_stop(led);
+        led->m_stats.flushes++;
+    }
+    ack &= tm1637_send_brightness(led);
+    return ack;
+}
+
+bool tm1637_flush(tm1637_led_t * led)
+{
+    return tm1637_write_segments(led, 0, led->m_frame, TM1637_DIGITS);
+}
+
+void tm1637_get_stats(const tm1637_led_t * led, tm1637_stats_t * stats)
+{
+    *stats = led->m_stats;
+}
+
+void tm1637_reset_stats(tm1637_led_t * led)
+{
+    memset(&led->m_stats, 0, sizeof(led->m_stats));
 }
 
 void tm1637_set_number(tm1637_led_t * led, uint16_t number)
@@ -173,52 +328,53 @@ void tm1637_set_number_lead_dot(tm1637_led_t * led, uint16_t number, bool lead_z
     uint8_t lead_number = lead_zero ? 0xFF : tm1637_symbols[0];
 
     if (number < 10) {
-        tm1637_set_segment_number(led, 3, number, dot_mask & 0x01);
-        tm1637_set_segment_number(led, 2, lead_number, dot_mask & 0x02);
-        tm1637_set_segment_number(led, 1, lead_number, dot_mask & 0x04);
-        tm1637_set_segment_number(led, 0, lead_number, dot_mask & 0x08);
+        tm1637_fb_set_segment_number(led, 3, number, dot_mask & 0x01);
+        tm1637_fb_set_segment_number(led, 2, lead_number, dot_mask & 0x02);
+        tm1637_fb_set_segment_number(led, 1, lead_number, dot_mask & 0x04);
+        tm1637_fb_set_segment_number(led, 0, lead_number, dot_mask & 0x08);
     } else if (number < 100) {
-        tm1637_set_segment_number(led, 3, number % 10, dot_mask & 0x01);
-        tm1637_set_segment_number(led, 2, (number / 10) % 10, dot_mask & 0x02);
-        tm1637_set_segment_number(led, 1, lead_number, dot_mask & 0x04);
-        tm1637_set_segment_number(led, 0, lead_number, dot_mask & 0x08);
+        tm1637_fb_set_segment_number(led, 3, number % 10, dot_mask & 0x01);
+        tm1637_fb_set_segment_number(led, 2, (number / 10) % 10, dot_mask & 0x02);
+        tm1637_fb_set_segment_number(led, 1, lead_number, dot_mask & 0x04);
+        tm1637_fb_set_segment_number(led, 0, lead_number, dot_mask & 0x08);
     } else if (number < 1000) {
-        tm1637_set_segment_number(led, 3, number % 10, dot_mask & 0x01);
-        tm1637_set_segment_number(led, 2, (number / 10) % 10, dot_mask & 0x02);
-        tm1637_set_segment_number(led, 1, (number / 100) % 10, dot_mask & 0x04);
-        tm1637_set_segment_number(led, 0, lead_number, dot_mask & 0x08);
+        tm1637_fb_set_segment_number(led, 3, number % 10, dot_mask & 0x01);
+        tm1637_fb_set_segment_number(led, 2, (number / 10) % 10, dot_mask & 0x02);
+        tm1637_fb_set_segment_number(led, 1, (number / 100) % 10, dot_mask & 0x04);
+        tm1637_fb_set_segment_number(led, 0, lead_number, dot_mask & 0x08);
     } else {
-        tm1637_set_segment_number(led, 3, number % 10, dot_mask & 0x01);
-        tm1637_set_segment_number(led, 2, (number / 10) % 10, dot_mask & 0x02);
-        tm1637_set_segment_number(led, 1, (number / 100) % 10, dot_mask & 0x04);
-        tm1637_set_segment_number(led, 0, (number / 1000) % 10, dot_mask & 0x08);
+        tm1637_fb_set_segment_number(led, 3, number % 10, dot_mask & 0x01);
+        tm1637_fb_set_segment_number(led, 2, (number / 10) % 10, dot_mask & 0x02);
+        tm1637_fb_set_segment_number(led, 1, (number / 100) % 10, dot_mask & 0x04);
+        tm1637_fb_set_segment_number(led, 0, (number / 1000) % 10, dot_mask & 0x08);
     }
+    tm1637_flush(led);
 }
 
 void tm1637_set_float(tm1637_led_t * led, float n) {
     if( n < 0 ) {
-        tm1637_set_segment_number(led, 0, MINUS_SIGN_IDX, 0);
+        tm1637_fb_set_segment_number(led, 0, MINUS_SIGN_IDX, 0);
         float absn = nearestf(fabs(n),1);
         int int_part = (int)absn;
         float fx_part = absn - int_part;
         if( absn < 10 ) {
             fx_part *= 100;
-            tm1637_set_segment_number(led, 1, (int)(absn + 0.5), 1 );
-            tm1637_set_segment_number(led, 2, ((int)fx_part/10) % 10, 0 );
-            tm1637_set_segment_number(led, 3, ((int)fx_part) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 1, (int)(absn + 0.5), 1 );
+            tm1637_fb_set_segment_number(led, 2, ((int)fx_part/10) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 3, ((int)fx_part) % 10, 0 );
         }
         else if( n < 100 ) {
             fx_part *= 100;
             uint8_t f = ((int)fx_part % 10);
             
-            tm1637_set_segment_number(led, 1, (int_part/10) % 10, 0 );
-            tm1637_set_segment_number(led, 2, int_part % 10, 1 );
-            tm1637_set_segment_number(led, 3, ((int)fx_part/10) % 10 + ((f > 4)?1:0), 0 );
+            tm1637_fb_set_segment_number(led, 1, (int_part/10) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 2, int_part % 10, 1 );
+            tm1637_fb_set_segment_number(led, 3, ((int)fx_part/10) % 10 + ((f > 4)?1:0), 0 );
         }
         else if( n < 1000 ) {
-            tm1637_set_segment_number(led, 1, (int_part/100) % 10, 0 );
-            tm1637_set_segment_number(led, 2, (int_part/10) % 10, 0 );
-            tm1637_set_segment_number(led, 3, (int_part % 10) + ((fx_part >= 0.5 )?1:0), 0 );
+            tm1637_fb_set_segment_number(led, 1, (int_part/100) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 2, (int_part/10) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 3, (int_part % 10) + ((fx_part >= 0.5 )?1:0), 0 );
         }
     }
     else {
@@ -230,30 +386,31 @@ void tm1637_set_float(tm1637_led_t * led, float n) {
             int_part = (int)n;
             fx_part = 10000 * (n - int_part);
             
-            tm1637_set_segment_number(led, 0, int_part, 1);
-            tm1637_set_segment_number(led, 1, ((int)fx_part/1000) % 10, 0 );
-            tm1637_set_segment_number(led, 2, ((int)fx_part/100) % 10, 0 );
-            tm1637_set_segment_number(led, 3, ((int)fx_part/10) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 0, int_part, 1);
+            tm1637_fb_set_segment_number(led, 1, ((int)fx_part/1000) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 2, ((int)fx_part/100) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 3, ((int)fx_part/10) % 10, 0 );
         }
         else if( n < 100 ) {
             n = nearestf(n,2);
             int_part = (int)n;
             fx_part = 1000 * (n - int_part);
             
-            tm1637_set_segment_number(led, 0, (int_part/10) % 10, 0);
-            tm1637_set_segment_number(led, 1, int_part % 10, 1 );
-            tm1637_set_segment_number(led, 2, ((int)fx_part/100) % 10, 0 );
-            tm1637_set_segment_number(led, 3, ((int)fx_part/10) % 10,0);
+            tm1637_fb_set_segment_number(led, 0, (int_part/10) % 10, 0);
+            tm1637_fb_set_segment_number(led, 1, int_part % 10, 1 );
+            tm1637_fb_set_segment_number(led, 2, ((int)fx_part/100) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 3, ((int)fx_part/10) % 10,0);
         }
         else if( n < 1000 ) {
             n = nearestf(n,2);
             int_part = (int)n;
             fx_part = 100 * (n - int_part);
             
-            tm1637_set_segment_number(led, 0, (int_part/100) % 10, 0);
-            tm1637_set_segment_number(led, 1, (int_part/10) % 10, 0 );
-            tm1637_set_segment_number(led, 2, int_part % 10, 1 );
-            tm1637_set_segment_number(led, 3, ((int)fx_part/10) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 0, (int_part/100) % 10, 0);
+            tm1637_fb_set_segment_number(led, 1, (int_part/10) % 10, 0 );
+            tm1637_fb_set_segment_number(led, 2, int_part % 10, 1 );
+            tm1637_fb_set_segment_number(led, 3, ((int)fx_part/10) % 10, 0 );
         }
     }
+    tm1637_flush(led);
 }
@@ -21,12 +21,42 @@
 extern "C" {
 #endif
 
+#define TM1637_DIGITS 4 // Number of digits held by the framebuffer
+#define TM1637_DELAY_US 3 // Default bit delay
+#define TM1637_DELAY_MIN_US 1 // Shortest bit delay within the datasheet timing (CLK pulse width >= 400 ns, f <= 500 kHz)
+
 struct tm;
 
+typedef struct {
+	uint32_t transactions; // Start/stop sequences sent
+	uint32_t bytes; // Bytes sent (commands and data)
+	uint32_t delay_us; // Time spent busy-waiting in bit delays
+	uint32_t flushes; // Digit data transactions (flushes and partial writes)
+	uint32_t nacks; // Bytes not acknowledged by the chip (DIO high during the ACK clock)
+} tm1637_stats_t;
+
+/**
+ * Pin backend driving CLK and DIO (only DIO is switched to input and read, for the ACK)
+ */
+typedef struct {
+	void (*setup)(gpio_num_t pin, bool readable); // Configure the pin as output (readable once switched to input)
+	void (*set_level)(gpio_num_t pin, uint32_t level);
+	void (*set_input)(gpio_num_t pin, bool input); // Release the pin (input) or drive it again (output)
+	int (*get_level)(gpio_num_t pin);
+} tm1637_pin_ops_t;
+
+extern const tm1637_pin_ops_t tm1637_pins_gpio; // GPIO driver calls (gpio_set_level, gpio_set_direction)
+extern const tm1637_pin_ops_t tm1637_pins_reg; // Direct GPIO register writes (default)
+
 typedef struct {
 	gpio_num_t m_pin_clk;
 	gpio_num_t m_pin_dta;
+	const tm1637_pin_ops_t * m_pins; // Pin backend
+	uint8_t m_delay_us; // Bit delay
 	uint8_t m_brightness;
+	uint8_t m_sent_brightness; // Brightness last sent to the chip (0xFF before the first display control command and after a NACK)
+	uint8_t m_frame[TM1637_DIGITS]; // Framebuffer, bitmask XGFEDCBA per digit
+	tm1637_stats_t m_stats;
 } tm1637_led_t;
 
 /**
@@ -38,6 +68,24 @@ typedef struct {
  */
 tm1637_led_t * tm1637_init(gpio_num_t pin_clk, gpio_num_t pin_data);
 
+/**
+ * @brief Constructs new LED TM1637 object driving the pins through the given backend
+ *
+ * @param pin_clk GPIO pin for CLK input of LED module
+ * @param pin_data GPIO pin for DIO input of LED module
+ * @param pins Pin backend (tm1637_pins_reg, tm1637_pins_gpio, or a recorder for testing)
+ * @return
+ */
+tm1637_led_t * tm1637_init_pins(gpio_num_t pin_clk, gpio_num_t pin_data, const tm1637_pin_ops_t * pins);
+
+/**
+ * @brief Set the delay after each bus edge. Shorter delays speed up the display refresh, longer ones help
+ *        with long wires or large capacitors on the module
+ * @param led LED object
+ * @param delay_us Delay in microseconds (at least TM1637_DELAY_MIN_US)
+ */
+void tm1637_set_bit_delay(tm1637_led_t * led, uint8_t delay_us);
+
 /**
  * @brief Set brightness level. Note - will be set after next display render
  * @param led LED object
@@ -62,6 +110,56 @@ void tm1637_set_segment_number(tm1637_led_t * led, const uint8_t segment_idx, co
  */
 void tm1637_set_segment_raw(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t data);
 
+/**
+ * @brief Set one digit of the framebuffer (the display is updated by tm1637_flush)
+ * @param led LED object
+ * @param segment_idx Segment index (0..3)
+ * @param data Raw data, bitmask is XGFEDCBA
+ */
+void tm1637_fb_set_segment_raw(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t data);
+
+/**
+ * @brief Set one digit of the framebuffer to a number, also controls dot of this segment
+ * @param led LED object
+ * @param segment_idx Segment index (0..3)
+ * @param num Number to set (0x00..0x0F, 0xFF for clear)
+ * @param dot Display dot of this segment
+ */
+void tm1637_fb_set_segment_number(tm1637_led_t * led, const uint8_t segment_idx, const uint8_t num, const bool dot);
+
+/**
+ * @brief Send the whole framebuffer in a single auto-increment transaction. The brightness command is sent
+ *        only if the brightness has changed since it was last sent
+ * @param led LED object
+ * @return true if the chip acknowledged every byte
+ */
+bool tm1637_flush(tm1637_led_t * led);
+
+/**
+ * @brief Write consecutive digits in a single auto-increment transaction (also updates the framebuffer). The
+ *        brightness command is sent only if the brightness has changed, also when no digit is written. After
+ *        a byte is not acknowledged, the brightness is sent again with the next write
+ * @param led LED object
+ * @param first Index of the first digit (0..3)
+ * @param data Raw data of the digits, bitmask is XGFEDCBA
+ * @param n Number of digits (0 to only apply a changed brightness)
+ * @return true if the chip acknowledged every byte (otherwise the digits it shows are unknown)
+ */
+bool tm1637_write_segments(tm1637_led_t * led, const uint8_t first, const uint8_t * data, const uint8_t n);
+
+/**
+ * @brief Get bus counters (transactions, bytes, busy-wait time)
+ * @param led LED object
+ * @param stats Pointer where the counters will be copied
+ */
+void tm1637_get_stats(const tm1637_led_t * led, tm1637_stats_t * stats);
+
+/**
+ * @brief Clear bus counters
+ * @param led LED object
+ */
+void tm1637_reset_stats(tm1637_led_t * led);
+
 /**
  * @brief Set full display number, in decimal encoding
  * @param led LED object
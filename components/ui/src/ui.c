@@ -5,12 +5,25 @@
  */
 
 #include "ui.h"
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
 #include "button.h"
 
 #define TAG "ui"
 
+#define UI_FREQ_MAX 9999    // Largest frequency shown on the 4-digit display (99.99 Hz)
+#define UI_FRAME_BYTES (2 + UI_DIGITS)  // Bus bytes of a full frame (data command, address, digits)
+#define UI_SEG_DOT 0x80     // Dot segment of a digit
+#define UI_STARTUP_BRIGHT 6 // Brightness reached by the startup animation
+#define UI_JITTER_SHIFT 3   // Weight of a new sample in the average jitter (1/8)
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;  // Protects the stats of the display task
+
+_Static_assert(FREQ_VALUE_SCALE == 2, "The display shows the frequency with two decimal places");
+_Static_assert(UI_DIGITS == TM1637_DIGITS, "Frames of the user interface are sent to the display as they are");
+
 /* 7-segment display ASCI digits lookup table */
 const unsigned char seven_seg_digits_decode_gfedcba[75]= {
 /*  0     1     2     3     4     5     6     7     8     9     :     ;     */
@@ -42,33 +55,187 @@ static uint8_t ui_decode_7seg(unsigned char ch) {
 	return seven_seg_digits_decode_gfedcba[ch - '0'];
 }
 
+/**
+ * @brief Display task: every UI_FRAME_PERIOD_MS, render the latest frame posted by the animation engine.
+ *
+ * @param arg Pointer to the ui_config_t structure.
+ */
+static void ui_task(void *arg) {
+    ui_config_t *ui = (ui_config_t *)arg;
+    const ui_frame_t *frame = NULL;     // Frame on the display (NULL until the first one is posted)
+    const ui_frame_t *next;
+    int64_t previous_us = 0;            // Start of the previous cycle
+    const int64_t period_us = (int64_t)UI_FRAME_PERIOD_MS * 1000;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true) {
+        int64_t start_us = esp_timer_get_time();
+        bool taken = ui_mailbox_take(&ui->frames, &next);
+
+        uint8_t written = 0;
+        if (taken) {
+            frame = next;
+        }
+        if (frame != NULL) {
+            tm1637_set_brightness((ui->led), frame->brightness);
+            written = ui_render(&ui->shown, ui->led, frame->segments);
+        }
+        int64_t end_us = esp_timer_get_time();
+
+        taskENTER_CRITICAL(&stats_lock);
+        ui->stats.cycles++;
+        ui->stats.frames_requested += taken ? 1 : 0;
+        ui->stats.frames_flushed += (written > 0) ? 1 : 0;
+        if (taken) {
+            ui->stats.bytes_saved += (written > 0) ? UI_DIGITS - written : UI_FRAME_BYTES;
+        }
+        if ((uint32_t)(end_us - start_us) > ui->stats.render_max_us) {
+            ui->stats.render_max_us = end_us - start_us;
+        }
+        if (previous_us != 0) {
+            int64_t deviation = start_us - previous_us - period_us;
+            uint32_t jitter_us = (deviation < 0) ? -deviation : deviation;
+            if (jitter_us > ui->stats.jitter_max_us) {
+                ui->stats.jitter_max_us = jitter_us;
+            }
+            int32_t diff = (int32_t)jitter_us - (int32_t)ui->stats.jitter_avg_us;
+            ui->stats.jitter_avg_us += (diff + (1 << (UI_JITTER_SHIFT - 1))) >> UI_JITTER_SHIFT;  // Rounded
+            if (end_us > previous_us + 2 * period_us) {
+                ui->stats.deadline_misses++;    // Frame due one period after the previous start, shown a period late
+            }
+        }
+        taskEXIT_CRITICAL(&stats_lock);
+
+        previous_us = start_us;
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(UI_FRAME_PERIOD_MS));
+    }
+}
+
+/**
+ * @brief Animation timer callback: take new content once the current transition has ended, post the frame
+ *        of the current keyframe to the display task, and re-arm the timer for the next keyframe.
+ *
+ * @param arg Pointer to the ui_config_t structure.
+ */
+static void ui_anim_timer_cb(void *arg) {
+    ui_config_t *ui = (ui_config_t *)arg;
+    const ui_frame_t *content;
+    int64_t now_ms = esp_timer_get_time() / 1000;
+
+    if (!ui_anim_busy(&ui->player, now_ms) && ui_mailbox_take(&ui->content, &content)) {
+        ui_anim_play(&ui->player, content, now_ms);
+    }
+
+    ui_frame_t *frame = ui_mailbox_back(&ui->frames);
+    ui_anim_render(&ui->player, now_ms, frame->segments, &frame->brightness);
+    frame->transition = NULL;
+    frame->anim = NULL;
+    ui_mailbox_publish(&ui->frames);
+
+    int64_t next_ms = ui_anim_next_ms(&ui->player, now_ms);
+    if (next_ms >= 0) {
+        int64_t delay_us = next_ms * 1000 - esp_timer_get_time();
+        esp_timer_start_once(ui->anim_timer, (delay_us > 0) ? delay_us : 0);
+    }
+}
+
+/**
+ * @brief Post content to the animation engine and wake it up.
+ *
+ * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL.
+ * @param segments Segments of each digit.
+ * @param brightness Display brightness (0-7).
+ * @param transition Animation played once when the content appears (NULL for none).
+ * @param anim Animation looped afterwards (NULL for static content).
+ */
+static void ui_post(ui_config_t *ui, const uint8_t segments[UI_DIGITS], uint8_t brightness,
+                    const ui_anim_t *transition, const ui_anim_t *anim) {
+    ui_frame_t *content = ui_mailbox_back(&ui->content);
+
+    memcpy(content->segments, segments, sizeof(content->segments));
+    content->brightness = brightness;
+    content->transition = transition;
+    content->anim = anim;
+    ui_mailbox_publish(&ui->content);
+
+    /* Fire now instead of at the next keyframe (retried if the callback re-armed the timer in between) */
+    for (int attempt = 0; attempt < 2; attempt++) {
+        esp_timer_stop(ui->anim_timer);
+        if (esp_timer_start_once(ui->anim_timer, 0) != ESP_ERR_INVALID_STATE) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Encode a number on all digits, blanking leading zeros.
+ *
+ * @param number The number to encode (0-9999).
+ * @param dots Flag for deciding if dots should be on or off.
+ * @param frame Segments of each digit.
+ */
+static void ui_encode_number(uint16_t number, bool dots, uint8_t frame[UI_DIGITS]) {
+    for (int i = UI_DIGITS - 1; i >= 0; i--) {
+        bool leading = (number == 0 && i < UI_DIGITS - 1);
+        frame[i] = leading ? 0x00 : ui_decode_7seg('0' + number % 10);
+        if (dots) {
+            frame[i] |= UI_SEG_DOT;
+        }
+        number /= 10;
+    }
+}
+
 /**
  * @brief Display a string on the user interface.
  *
  * @param str Pointer to a null-terminated string to display on the user interface. Must not be NULL.
  * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL.
- * @return `ESP_OK` if the string was displayed successfully, otherwise an error code.
+ * @param anim Animation looped once the string has slid in (NULL for none).
+ * @return `ESP_OK` if the string was posted successfully, otherwise an error code.
  * 
  * @note String has to be 4 characters long!
  */
-static esp_err_t ui_display_string(char* str, const ui_config_t *ui) {
+static esp_err_t ui_display_string(char* str, ui_config_t *ui, const ui_anim_t *anim) {
+    uint8_t frame[UI_DIGITS];
+
     if(str == NULL) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    tm1637_set_brightness((ui->led), UI_LED_MAX_BRIGHT);
-    
-    for(int i = 0; i < 4; i++){
-        uint8_t data = ui_decode_7seg(*(str+i));
-        tm1637_set_segment_raw((ui->led), i, data);
+    for(int i = 0; i < UI_DIGITS; i++){
+        frame[i] = ui_decode_7seg(*(str+i));
     }
 
+    ui_post(ui, frame, UI_LED_MAX_BRIGHT, &ui_anim_slide_in, anim);
     return ESP_OK;
 }
 
 esp_err_t ui_init(ui_config_t *ui) {
     (ui->led) = tm1637_init(PIN_TM1637_CLK, PIN_TM1637_DIO);
+    tm1637_set_bit_delay((ui->led), UI_TM1637_BIT_DELAY_US);
+    ui_render_init(&ui->shown);
+    memset(&ui->stats, 0, sizeof(ui->stats));
+    ui_mailbox_init(&ui->content);
+    ui_mailbox_init(&ui->frames);
+    ui_anim_init(&ui->player);
     ESP_LOGI(TAG, "tm1637 initialised");
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = ui_anim_timer_cb,
+        .arg = ui,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ui_anim",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &ui->anim_timer);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the animation timer");
+        return err;
+    }
+
+    if (xTaskCreate(ui_task, "ui", UI_TASK_STACK_SIZE, ui, UI_TASK_PRIORITY, &ui->task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the display task");
+        return ESP_ERR_NO_MEM;
+    }
     
     ESP_ERROR_CHECK(button_init());
     ESP_LOGI(TAG, "button initialised");
@@ -76,27 +243,27 @@ esp_err_t ui_init(ui_config_t *ui) {
     return ESP_OK;
 }
 
-esp_err_t ui_startup_animation(const ui_config_t *ui) {
+esp_err_t ui_startup_animation(ui_config_t *ui) {
+    uint8_t frame[UI_DIGITS];
+
     ESP_LOGI(TAG, "Run startup animation");
-    for (int x = 0; x < 7; x++) {
-        tm1637_set_brightness((ui->led), x);
-        tm1637_set_number((ui->led), 8888);
-        vTaskDelay(250 / portTICK_RATE_MS);
-    }
+    ui_encode_number(8888, false, frame);
+    ui_post(ui, frame, UI_STARTUP_BRIGHT, &ui_anim_fade_in, NULL);
     return ESP_OK;
 }
 
-esp_err_t ui_display_freq(const ui_config_t *ui, const float freq_float, const bool dots) {
+esp_err_t ui_display_freq(ui_config_t *ui, const int32_t freq, const bool blink) {
+    uint8_t frame[UI_DIGITS];
+
     ESP_LOGD(TAG, "Display frequency");
-    uint16_t freq_int = (uint16_t)(freq_float * 100);
+    uint16_t freq_int = (freq < 0) ? 0 : (freq > UI_FREQ_MAX) ? UI_FREQ_MAX : (uint16_t)freq;
 
-    tm1637_set_brightness((ui->led), UI_LED_MAX_BRIGHT);
-    tm1637_set_number_lead_dot((ui->led), freq_int, true, dots ? 0xFF : 0x00);
-    
+    ui_encode_number(freq_int, blink, frame);
+    ui_post(ui, frame, UI_LED_MAX_BRIGHT, &ui_anim_morph, blink ? &ui_anim_blink_dots : NULL);
     return ESP_OK;
 }
 
-esp_err_t ui_display_message(const ui_config_t *ui, const ui_message_t message) {  
+esp_err_t ui_display_message(ui_config_t *ui, const ui_message_t message) {  
     if (ui == NULL) {
         return ESP_ERR_INVALID_ARG;
     } else {
@@ -105,28 +272,38 @@ esp_err_t ui_display_message(const ui_config_t *ui, const ui_message_t message)
 
     switch(message){
         case UI_MESSAGE_ERROR:
-            ESP_ERROR_CHECK(ui_display_string("ERR_", ui));
+            ESP_ERROR_CHECK(ui_display_string("ERR_", ui, &ui_anim_blink));
             break;
         case UI_MESSAGE_PROV:
-            ESP_ERROR_CHECK(ui_display_string("PROV", ui));
+            ESP_ERROR_CHECK(ui_display_string("PROV", ui, &ui_anim_spinner));
             break;
         case UI_MESSAGE_CONNECTED:
-            ESP_ERROR_CHECK(ui_display_string("Conn", ui));
+            ESP_ERROR_CHECK(ui_display_string("Conn", ui, &ui_anim_spinner));
             break;
         case UI_MESSAGE_RUNNING:
-            ESP_ERROR_CHECK(ui_display_string("On__", ui));
+            ESP_ERROR_CHECK(ui_display_string("On__", ui, NULL));
             break;
         case UI_MESSAGE_WIFI:
-            ESP_ERROR_CHECK(ui_display_string("UiFi", ui));
+            ESP_ERROR_CHECK(ui_display_string("UiFi", ui, &ui_anim_spinner));
             break;
         default:
-            ESP_ERROR_CHECK(ui_display_string("inv-", ui));
+            ESP_ERROR_CHECK(ui_display_string("inv-", ui, NULL));
             break;
     }
 
     return ESP_OK;
 }
 
+esp_err_t ui_get_stats(const ui_config_t *ui, ui_stats_t *stats) {
+    if (ui == NULL || stats == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    taskENTER_CRITICAL(&stats_lock);
+    *stats = ui->stats;
+    taskEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
 int ui_get_button_level(ui_config_t *ui) {
     return button_get_level();
 }
@@ -6,11 +6,36 @@
 
 #pragma once
 #include "config_macros.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
 #include "tm1637.h"
+#include "ui_anim.h"
+#include "ui_mailbox.h"
+#include "ui_render.h"
+
+/* Display counters */
+typedef struct {
+    uint32_t frames_requested;      // Frames taken from the mailbox by the display task
+    uint32_t frames_flushed;        // Cycles that changed at least one digit (sent to the display)
+    uint32_t bytes_saved;           // Bus bytes avoided compared to sending every new frame in full
+    uint32_t cycles;                // Display task cycles
+    uint32_t deadline_misses;       // Cycles finished later than one period after their scheduled start
+    uint32_t jitter_max_us;         // Largest deviation of a cycle start from the period
+    uint32_t jitter_avg_us;         // Average deviation of a cycle start from the period (over the last ~8 cycles)
+    uint32_t render_max_us;         // Longest cycle (frame selection and bus transfer)
+} ui_stats_t;
 
 /* User interface config struct */
 typedef struct {
-    tm1637_led_t *led;
+    tm1637_led_t *led;              // Display (owned by the display task)
+    ui_render_t shown;              // Frame shown by the display (owned by the display task)
+    ui_mailbox_t content;           // Content posted to the animation engine
+    ui_mailbox_t frames;            // Frames posted by the animation engine to the display task
+    ui_anim_player_t player;        // Animation engine state (used by the animation timer)
+    esp_timer_handle_t anim_timer;  // Timer firing at the next keyframe
+    TaskHandle_t task;              // Display task
+    ui_stats_t stats;               // Display counters (written by the display task)
 } ui_config_t;
 
 /* User Interface message type */
@@ -23,9 +48,15 @@ typedef enum {
 } ui_message_t;
 
 /**
- * @brief Initialize the user interface.
+ * @brief Initialize the user interface and start the display task.
  *
- * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL.
+ * The ui_startup_animation and ui_display_ functions only post content and never block. They must be called
+ * from one task at a time (the mailbox has a single producer). An esp_timer plays the animations of the content,
+ * firing only at keyframes, and posts the frames to the display task, which owns the display and refreshes it
+ * every UI_FRAME_PERIOD_MS.
+ *
+ * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL
+ *           and must outlive the display task.
  * @return `ESP_OK` if the user interface was initialized successfully, otherwise an error code.
  */
 esp_err_t ui_init(ui_config_t *ui);
@@ -33,29 +64,41 @@ esp_err_t ui_init(ui_config_t *ui);
 /**
  * @brief Run a startup animation on the user interface.
  *
+ * The animation is played by the animation timer; content posted in the meantime is shown once it ends.
+ *
  * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL.
- * @return `ESP_OK` if the startup animation completed successfully, otherwise an error code.
+ * @return `ESP_OK` if the startup animation was posted successfully, otherwise an error code.
  */
-esp_err_t ui_startup_animation(const ui_config_t *ui);
+esp_err_t ui_startup_animation(ui_config_t *ui);
 
 /**
  * @brief Display a frequency value on the user interface.
  *
  * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL.
- * @param freq_float The frequency value to display on the user interface.
- * @param dots Flag for deciding if dots should be on or off.
- * @return `ESP_OK` if the frequency was displayed successfully, otherwise an error code.
+ * @param freq The frequency to display, scaled by 10^FREQ_VALUE_SCALE (e.g. 4999 for 49.99 Hz).
+ * @param blink Flag for deciding if dots should blink (every UI_BLINK_PERIOD_MS) or stay off. Changed digits
+ *              morph into the new value.
+ * @return `ESP_OK` if the frequency was posted successfully, otherwise an error code.
  */
-esp_err_t ui_display_freq(const ui_config_t *ui, const float freq_float, const bool dots);
+esp_err_t ui_display_freq(ui_config_t *ui, const int32_t freq, const bool blink);
 
 /**
  * @brief Display a message on the user interface.
  *
  * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL.
  * @param message The message to display on the user interface.
- * @return `ESP_OK` if the message was displayed successfully, otherwise an error code.
+ * @return `ESP_OK` if the message was posted successfully, otherwise an error code.
+ */
+esp_err_t ui_display_message(ui_config_t *ui, const ui_message_t message);
+
+/**
+ * @brief Get the display counters.
+ *
+ * @param ui Pointer to a ui_config_t structure representing the user interface configuration. Must not be NULL.
+ * @param stats Pointer to the structure where the counters will be copied. Must not be NULL.
+ * @return `ESP_OK` on success, `ESP_ERR_INVALID_ARG` if an argument is NULL.
  */
-esp_err_t ui_display_message(const ui_config_t *ui, const ui_message_t message);
+esp_err_t ui_get_stats(const ui_config_t *ui, ui_stats_t *stats);
 
 /**
  * @brief Get current button level.
@@ -0,0 +1,178 @@
+/**
+ * @file    ui_anim.c
+ * @brief   Keyframe animation engine for the 7-segment display (no allocation, no RTOS calls)
+ * @author  Karol Wojslaw (karol.wojslaw@student.manchester.ac.uk)
+ */
+
+#include "ui_anim.h"
+
+#include <string.h>
+
+#define UI_ANIM_ALL {0xFF, 0xFF, 0xFF, 0xFF}    // Every segment of every digit
+#define UI_ANIM_NONE {0x00, 0x00, 0x00, 0x00}   // No segment
+#define UI_ANIM_NO_DOTS {0x7F, 0x7F, 0x7F, 0x7F} // Every segment but the dots
+#define UI_ANIM_CONTENT_KEY(at, src, sh, b) \
+    {.at_ms = (at), .source = (src), .shift = (sh), .brightness = (b), .keep = UI_ANIM_ALL, .overlay = UI_ANIM_NONE}
+#define UI_ANIM_SPIN_KEY(step, d0, d1, d2, d3) \
+    {.at_ms = UI_SPINNER_HOLD_MS + (step) * UI_ANIM_STEP_MS, .source = UI_ANIM_SOURCE_NEW, .shift = 0, \
+     .brightness = UI_ANIM_BRIGHTNESS_CONTENT, .keep = UI_ANIM_NONE, .overlay = {d0, d1, d2, d3}}
+
+/* Keyframe tables (const, placed in flash) */
+static const ui_anim_key_t blink_keys[] = {
+    UI_ANIM_CONTENT_KEY(0, UI_ANIM_SOURCE_NEW, 0, UI_ANIM_BRIGHTNESS_CONTENT),
+    {.at_ms = UI_BLINK_PERIOD_MS, .source = UI_ANIM_SOURCE_NEW, .brightness = UI_ANIM_BRIGHTNESS_CONTENT,
+     .keep = UI_ANIM_NONE, .overlay = UI_ANIM_NONE},
+};
+
+static const ui_anim_key_t blink_dots_keys[] = {
+    UI_ANIM_CONTENT_KEY(0, UI_ANIM_SOURCE_NEW, 0, UI_ANIM_BRIGHTNESS_CONTENT),
+    {.at_ms = UI_BLINK_PERIOD_MS, .source = UI_ANIM_SOURCE_NEW, .brightness = UI_ANIM_BRIGHTNESS_CONTENT,
+     .keep = UI_ANIM_NO_DOTS, .overlay = UI_ANIM_NONE},
+};
+
+static const ui_anim_key_t fade_in_keys[] = {
+    UI_ANIM_CONTENT_KEY(0 * UI_STARTUP_STEP_MS, UI_ANIM_SOURCE_NEW, 0, 0),
+    UI_ANIM_CONTENT_KEY(1 * UI_STARTUP_STEP_MS, UI_ANIM_SOURCE_NEW, 0, 1),
+    UI_ANIM_CONTENT_KEY(2 * UI_STARTUP_STEP_MS, UI_ANIM_SOURCE_NEW, 0, 2),
+    UI_ANIM_CONTENT_KEY(3 * UI_STARTUP_STEP_MS, UI_ANIM_SOURCE_NEW, 0, 3),
+    UI_ANIM_CONTENT_KEY(4 * UI_STARTUP_STEP_MS, UI_ANIM_SOURCE_NEW, 0, 4),
+    UI_ANIM_CONTENT_KEY(5 * UI_STARTUP_STEP_MS, UI_ANIM_SOURCE_NEW, 0, 5),
+    UI_ANIM_CONTENT_KEY(6 * UI_STARTUP_STEP_MS, UI_ANIM_SOURCE_NEW, 0, 6),
+};
+
+/* Segment A across the top, down B and C of the last digit, D across the bottom, up E and F of the first */
+static const ui_anim_key_t spinner_keys[] = {
+    UI_ANIM_CONTENT_KEY(0, UI_ANIM_SOURCE_NEW, 0, UI_ANIM_BRIGHTNESS_CONTENT),
+    UI_ANIM_SPIN_KEY(0, 0x01, 0x00, 0x00, 0x00),
+    UI_ANIM_SPIN_KEY(1, 0x00, 0x01, 0x00, 0x00),
+    UI_ANIM_SPIN_KEY(2, 0x00, 0x00, 0x01, 0x00),
+    UI_ANIM_SPIN_KEY(3, 0x00, 0x00, 0x00, 0x01),
+    UI_ANIM_SPIN_KEY(4, 0x00, 0x00, 0x00, 0x02),
+    UI_ANIM_SPIN_KEY(5, 0x00, 0x00, 0x00, 0x04),
+    UI_ANIM_SPIN_KEY(6, 0x00, 0x00, 0x00, 0x08),
+    UI_ANIM_SPIN_KEY(7, 0x00, 0x00, 0x08, 0x00),
+    UI_ANIM_SPIN_KEY(8, 0x00, 0x08, 0x00, 0x00),
+    UI_ANIM_SPIN_KEY(9, 0x08, 0x00, 0x00, 0x00),
+    UI_ANIM_SPIN_KEY(10, 0x10, 0x00, 0x00, 0x00),
+    UI_ANIM_SPIN_KEY(11, 0x20, 0x00, 0x00, 0x00),
+};
+
+static const ui_anim_key_t slide_in_keys[] = {
+    UI_ANIM_CONTENT_KEY(0 * UI_ANIM_STEP_MS, UI_ANIM_SOURCE_NEW, 3, UI_ANIM_BRIGHTNESS_CONTENT),
+    UI_ANIM_CONTENT_KEY(1 * UI_ANIM_STEP_MS, UI_ANIM_SOURCE_NEW, 2, UI_ANIM_BRIGHTNESS_CONTENT),
+    UI_ANIM_CONTENT_KEY(2 * UI_ANIM_STEP_MS, UI_ANIM_SOURCE_NEW, 1, UI_ANIM_BRIGHTNESS_CONTENT),
+};
+
+static const ui_anim_key_t morph_keys[] = {
+    UI_ANIM_CONTENT_KEY(0, UI_ANIM_SOURCE_COMMON, 0, UI_ANIM_BRIGHTNESS_CONTENT),
+};
+
+#define UI_ANIM_TABLE(k, len) {.keys = (k), .count = sizeof(k) / sizeof((k)[0]), .length_ms = (len)}
+
+const ui_anim_t ui_anim_blink = UI_ANIM_TABLE(blink_keys, 2 * UI_BLINK_PERIOD_MS);
+const ui_anim_t ui_anim_blink_dots = UI_ANIM_TABLE(blink_dots_keys, 2 * UI_BLINK_PERIOD_MS);
+const ui_anim_t ui_anim_fade_in = UI_ANIM_TABLE(fade_in_keys, 7 * UI_STARTUP_STEP_MS);
+const ui_anim_t ui_anim_spinner = UI_ANIM_TABLE(spinner_keys, UI_SPINNER_HOLD_MS + 12 * UI_ANIM_STEP_MS);
+const ui_anim_t ui_anim_slide_in = UI_ANIM_TABLE(slide_in_keys, 3 * UI_ANIM_STEP_MS);
+const ui_anim_t ui_anim_morph = UI_ANIM_TABLE(morph_keys, UI_ANIM_STEP_MS);
+
+/**
+ * @brief Get the animation playing at the given time and the time elapsed in it.
+ *
+ * @return Pointer to the transition or the looped animation, NULL if the content is static.
+ */
+static const ui_anim_t *ui_anim_phase(const ui_anim_player_t *p, int64_t now_ms, uint32_t *t_ms) {
+    int64_t elapsed = (now_ms > p->start_ms) ? now_ms - p->start_ms : 0;
+    const ui_anim_t *transition = p->content.transition;
+    const ui_anim_t *anim = p->content.anim;
+
+    if (transition != NULL) {
+        if (elapsed < transition->length_ms) {
+            *t_ms = elapsed;
+            return transition;
+        }
+        elapsed -= transition->length_ms;
+    }
+    if (anim != NULL && anim->length_ms > 0) {
+        *t_ms = elapsed % anim->length_ms;
+        return anim;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Get the index of the keyframe shown at the given time of an animation.
+ */
+static uint8_t ui_anim_key(const ui_anim_t *a, uint32_t t_ms) {
+    uint8_t index = 0;
+    while (index + 1 < a->count && a->keys[index + 1].at_ms <= t_ms) {
+        index++;
+    }
+    return index;
+}
+
+void ui_anim_init(ui_anim_player_t *p) {
+    memset(p, 0, sizeof(*p));
+}
+
+void ui_anim_play(ui_anim_player_t *p, const ui_anim_content_t *content, int64_t now_ms) {
+    if (memcmp(p->content.segments, content->segments, sizeof(p->old)) == 0 &&
+        p->content.brightness == content->brightness && p->content.anim == content->anim) {
+        return; // Same content posted again keeps its timeline (a blink is not restarted)
+    }
+    memcpy(p->old, p->content.segments, sizeof(p->old));
+    p->content = *content;
+    p->start_ms = now_ms;
+}
+
+bool ui_anim_busy(const ui_anim_player_t *p, int64_t now_ms) {
+    const ui_anim_t *transition = p->content.transition;
+    return transition != NULL && now_ms - p->start_ms < transition->length_ms;
+}
+
+void ui_anim_render(const ui_anim_player_t *p, int64_t now_ms, uint8_t segments[UI_DIGITS], uint8_t *brightness) {
+    uint32_t t_ms;
+    const ui_anim_t *a = ui_anim_phase(p, now_ms, &t_ms);
+    uint8_t source[UI_DIGITS];
+
+    *brightness = p->content.brightness;
+    if (a == NULL || a->count == 0) {
+        memcpy(segments, p->content.segments, UI_DIGITS);
+        return;
+    }
+
+    const ui_anim_key_t *key = &a->keys[ui_anim_key(a, t_ms)];
+    for (int i = 0; i < UI_DIGITS; i++) {
+        switch (key->source) {
+            case UI_ANIM_SOURCE_OLD:
+                source[i] = p->old[i];
+                break;
+            case UI_ANIM_SOURCE_COMMON:
+                source[i] = p->old[i] & p->content.segments[i];
+                break;
+            default:
+                source[i] = p->content.segments[i];
+                break;
+        }
+    }
+    for (int i = 0; i < UI_DIGITS; i++) {
+        int j = i - key->shift;
+        uint8_t data = (j >= 0 && j < UI_DIGITS) ? source[j] : 0x00;
+        segments[i] = (data & key->keep[i]) | key->overlay[i];
+    }
+    if (key->brightness < *brightness) {
+        *brightness = key->brightness;  // Keyframes dim the content, never brighten it
+    }
+}
+
+int64_t ui_anim_next_ms(const ui_anim_player_t *p, int64_t now_ms) {
+    uint32_t t_ms;
+    const ui_anim_t *a = ui_anim_phase(p, now_ms, &t_ms);
+
+    if (a == NULL || (a == p->content.anim && a->count <= 1)) {
+        return -1;  // Static content, or a loop with a single keyframe
+    }
+    uint8_t index = ui_anim_key(a, t_ms);
+    uint32_t end_ms = (index + 1 < a->count) ? a->keys[index + 1].at_ms : a->length_ms;
+    return now_ms + (end_ms - t_ms);
+}
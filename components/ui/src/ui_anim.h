@@ -0,0 +1,105 @@
+/**
+ * @file    ui_anim.h
+ * @brief   Keyframe animation engine for the 7-segment display (no allocation, no RTOS calls)
+ * @author  Karol Wojslaw (karol.wojslaw@student.manchester.ac.uk)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ui_timing.h"
+
+#define UI_ANIM_BRIGHTNESS_CONTENT 0xFF     // Keyframe shows the content at its own brightness
+
+/* Content a keyframe is built from */
+typedef enum {
+    UI_ANIM_SOURCE_NEW = 0x00,      // Content being shown
+    UI_ANIM_SOURCE_OLD = 0x01,      // Content shown before it
+    UI_ANIM_SOURCE_COMMON = 0x02    // Segments lit in both (only the changed segments go dark)
+} ui_anim_source_t;
+
+/* Keyframe: out[i] = (source shifted right by shift digits)[i] & keep[i] | overlay[i] */
+typedef struct {
+    uint16_t at_ms;                     // Start of the keyframe from the start of the animation
+    uint8_t source;                     // Content the keyframe is built from (ui_anim_source_t)
+    int8_t shift;                       // Digits the content is shifted right by (negative: left), blank filled
+    uint8_t brightness;                 // Max brightness (0-7), or UI_ANIM_BRIGHTNESS_CONTENT
+    uint8_t keep[UI_DIGITS];        // Segments of the content kept on each digit
+    uint8_t overlay[UI_DIGITS];     // Segments lit on each digit whatever the content
+} ui_anim_key_t;
+
+/* Animation: keyframes ordered by time, the first one at 0 ms */
+typedef struct {
+    const ui_anim_key_t *keys;  // Keyframes
+    uint8_t count;              // Number of keyframes
+    uint16_t length_ms;         // Duration of a transition, or period of a looped animation
+} ui_anim_t;
+
+/* Content to show, with the transition played when it appears and the animation looped afterwards */
+typedef struct {
+    uint8_t segments[UI_DIGITS];    // Segments of each digit (XGFEDCBA)
+    uint8_t brightness;                 // Display brightness (0-7)
+    const ui_anim_t *transition;        // Played once, to the end, before newer content is taken (NULL for none)
+    const ui_anim_t *anim;              // Looped after the transition (NULL for static content)
+} ui_anim_content_t;
+
+/* Player state */
+typedef struct {
+    ui_anim_content_t content;          // Content being shown
+    uint8_t old[UI_DIGITS];         // Segments of the content shown before
+    int64_t start_ms;                   // Time the content appeared
+} ui_anim_player_t;
+
+extern const ui_anim_t ui_anim_blink;       // Whole display on and off every UI_BLINK_PERIOD_MS
+extern const ui_anim_t ui_anim_blink_dots;  // Dots on and off every UI_BLINK_PERIOD_MS
+extern const ui_anim_t ui_anim_fade_in;     // Brightness rising from 0 by one level every UI_STARTUP_STEP_MS
+extern const ui_anim_t ui_anim_spinner;     // Content shown, then one lap of a segment around the display
+extern const ui_anim_t ui_anim_slide_in;    // Content entering from the right
+extern const ui_anim_t ui_anim_morph;       // Changed segments going dark, then the new ones lighting up
+
+/**
+ * @brief Clear the player (blank display).
+ *
+ * @param p Pointer to the player. Must not be NULL.
+ */
+void ui_anim_init(ui_anim_player_t *p);
+
+/**
+ * @brief Show new content, starting its transition. Content equal to the one shown (segments, brightness and
+ *        looped animation) is ignored, so posting it again does not restart the animation.
+ *
+ * @param p       Pointer to the player. Must not be NULL.
+ * @param content Content to show (copied). Must not be NULL.
+ * @param now_ms  Current time.
+ */
+void ui_anim_play(ui_anim_player_t *p, const ui_anim_content_t *content, int64_t now_ms);
+
+/**
+ * @brief Check if the transition of the content is still playing (newer content has to wait).
+ *
+ * @param p      Pointer to the player. Must not be NULL.
+ * @param now_ms Current time.
+ * @return true while the transition plays.
+ */
+bool ui_anim_busy(const ui_anim_player_t *p, int64_t now_ms);
+
+/**
+ * @brief Build the frame shown at the given time.
+ *
+ * @param p          Pointer to the player. Must not be NULL.
+ * @param now_ms     Current time (not before the start of the content).
+ * @param segments   Segments of each digit of the frame.
+ * @param brightness Set to the brightness of the frame. Must not be NULL.
+ */
+void ui_anim_render(const ui_anim_player_t *p, int64_t now_ms, uint8_t segments[UI_DIGITS], uint8_t *brightness);
+
+/**
+ * @brief Get the time of the next keyframe after the given time.
+ *
+ * @param p      Pointer to the player. Must not be NULL.
+ * @param now_ms Current time.
+ * @return Time the frame changes next, -1 if it stays the same.
+ */
+int64_t ui_anim_next_ms(const ui_anim_player_t *p, int64_t now_ms);
@@ -0,0 +1,41 @@
+/**
+ * @file    ui_mailbox.c
+ * @brief   Lock-free single-producer single-consumer frame mailbox (triple buffer, no RTOS calls)
+ * @author  Karol Wojslaw (karol.wojslaw@student.manchester.ac.uk)
+ */
+
+#include "ui_mailbox.h"
+
+#include <string.h>
+
+#define UI_MAILBOX_FRESH 0x4u   // Middle slot holds a frame the consumer has not taken
+#define UI_MAILBOX_INDEX 0x3u   // Slot index bits of the middle value
+
+void ui_mailbox_init(ui_mailbox_t *mb) {
+    memset(mb->slots, 0, sizeof(mb->slots));
+    mb->back = 0;
+    atomic_init(&mb->middle, 1);
+    mb->front = 2;
+}
+
+ui_frame_t *ui_mailbox_back(ui_mailbox_t *mb) {
+    return &mb->slots[mb->back];
+}
+
+void ui_mailbox_publish(ui_mailbox_t *mb) {
+    /* Release: the frame content is visible to the consumer before the slot index */
+    unsigned previous = atomic_exchange_explicit(&mb->middle, mb->back | UI_MAILBOX_FRESH, memory_order_acq_rel);
+    mb->back = previous & UI_MAILBOX_INDEX;
+}
+
+bool ui_mailbox_take(ui_mailbox_t *mb, const ui_frame_t **frame) {
+    bool fresh = false;
+
+    if (atomic_load_explicit(&mb->middle, memory_order_relaxed) & UI_MAILBOX_FRESH) {
+        unsigned previous = atomic_exchange_explicit(&mb->middle, mb->front, memory_order_acq_rel);
+        mb->front = previous & UI_MAILBOX_INDEX;
+        fresh = true;
+    }
+    *frame = &mb->slots[mb->front];
+    return fresh;
+}
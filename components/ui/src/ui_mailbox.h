@@ -0,0 +1,59 @@
+/**
+ * @file    ui_mailbox.h
+ * @brief   Lock-free single-producer single-consumer frame mailbox (triple buffer, no RTOS calls)
+ * @author  Karol Wojslaw (karol.wojslaw@student.manchester.ac.uk)
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ui_anim.h"
+
+/* Mailbox slot: content with its animations (posted to the animation engine), or a rendered frame without any
+ * (posted by the engine to the display task) */
+typedef ui_anim_content_t ui_frame_t;
+
+/*
+ * Mailbox state: the producer writes the back slot, the consumer reads the front slot, and the middle slot
+ * is exchanged atomically between them. Neither side ever waits, and the consumer always gets the latest frame.
+ */
+typedef struct {
+    ui_frame_t slots[3];    // Frame buffers
+    atomic_uint middle;     // Slot between the producer and the consumer (index | UI_MAILBOX_FRESH)
+    uint8_t back;           // Slot owned by the producer
+    uint8_t front;          // Slot owned by the consumer
+} ui_mailbox_t;
+
+/**
+ * @brief Clear the mailbox.
+ *
+ * @param mb Pointer to the mailbox. Must not be NULL.
+ */
+void ui_mailbox_init(ui_mailbox_t *mb);
+
+/**
+ * @brief Get the frame to fill before publishing it (producer side).
+ *
+ * @param mb Pointer to the mailbox. Must not be NULL.
+ * @return Pointer to the back frame (its content is undefined).
+ */
+ui_frame_t *ui_mailbox_back(ui_mailbox_t *mb);
+
+/**
+ * @brief Publish the back frame, replacing any frame the consumer has not taken yet (producer side).
+ *
+ * @param mb Pointer to the mailbox. Must not be NULL.
+ */
+void ui_mailbox_publish(ui_mailbox_t *mb);
+
+/**
+ * @brief Take the latest published frame (consumer side).
+ *
+ * @param mb    Pointer to the mailbox. Must not be NULL.
+ * @param frame Set to the front frame, valid until the next call. Must not be NULL.
+ * @return true if a frame was published since the last call, false if the front frame is unchanged.
+ */
+bool ui_mailbox_take(ui_mailbox_t *mb, const ui_frame_t **frame);
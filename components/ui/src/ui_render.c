@@ -0,0 +1,37 @@
+/**
+ * @file    ui_render.c
+ * @brief   Send frames to the display, writing only the digits that changed (no RTOS calls)
+ * @author  Karol Wojslaw (karol.wojslaw@student.manchester.ac.uk)
+ */
+
+#include "ui_render.h"
+
+#include <string.h>
+
+void ui_render_init(ui_render_t *r) {
+    memset(r->segments, 0, sizeof(r->segments));
+    r->valid = false;   // Content of the display is unknown until the first frame
+}
+
+uint8_t ui_render(ui_render_t *r, tm1637_led_t *led, const uint8_t frame[TM1637_DIGITS]) {
+    uint8_t first = 0;
+    uint8_t last = TM1637_DIGITS - 1;
+
+    if (r->valid) {
+        while (first < TM1637_DIGITS && frame[first] == r->segments[first]) {
+            first++;
+        }
+        if (first == TM1637_DIGITS) {
+            r->valid = tm1637_write_segments(led, 0, NULL, 0);     // Only a changed brightness is sent
+            return 0;
+        }
+        while (frame[last] == r->segments[last]) {
+            last--;
+        }
+    }
+
+    uint8_t count = last - first + 1;
+    memcpy(r->segments, frame, sizeof(r->segments));
+    r->valid = tm1637_write_segments(led, first, &frame[first], count);
+    return count;
+}
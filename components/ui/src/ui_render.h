@@ -0,0 +1,39 @@
+/**
+ * @file    ui_render.h
+ * @brief   Send frames to the display, writing only the digits that changed (no RTOS calls)
+ * @author  Karol Wojslaw (karol.wojslaw@student.manchester.ac.uk)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tm1637.h"
+
+/* What the display shows, as far as the bus transfers tell */
+typedef struct {
+    uint8_t segments[TM1637_DIGITS];    // Last frame sent to the display (segments XGFEDCBA per digit)
+    bool valid;                         // segments holds what the display shows
+} ui_render_t;
+
+/**
+ * @brief Forget what the display shows, so that the next frame is sent in full.
+ *
+ * @param r Pointer to the render state. Must not be NULL.
+ */
+void ui_render_init(ui_render_t *r);
+
+/**
+ * @brief Send a frame to the display, writing only the span of digits that differ from the last frame.
+ *
+ * An unchanged frame costs no bus traffic (unless the brightness has changed). Changed digits are written
+ * in one auto-increment transaction from the first to the last changed digit. If the chip does not acknowledge
+ * a byte, the display content is unknown: the next frame is sent in full, with the brightness.
+ *
+ * @param r Pointer to the render state. Must not be NULL.
+ * @param led Display. Must not be NULL.
+ * @param frame Segments of each digit.
+ * @return Number of digits written (0 if the frame is unchanged).
+ */
+uint8_t ui_render(ui_render_t *r, tm1637_led_t *led, const uint8_t frame[TM1637_DIGITS]);
@@ -0,0 +1,13 @@
+/**
+ * @file    ui_timing.h
+ * @brief   Display size and animation timing of the user interface (plain constants, no dependencies)
+ * @author  Karol Wojslaw (karol.wojslaw@student.manchester.ac.uk)
+ */
+
+#pragma once
+
+#define UI_DIGITS 4                     // Digits of the display
+#define UI_BLINK_PERIOD_MS 1000         // Duration of each blink phase (on, then off)
+#define UI_STARTUP_STEP_MS 250          // Duration of each brightness level of the startup animation
+#define UI_ANIM_STEP_MS 60              // Duration of each step of the spinner, slide-in and morph animations
+#define UI_SPINNER_HOLD_MS 2000         // Time the content is shown between two laps of the spinner
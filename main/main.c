@@ -4,9 +4,13 @@
  * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
  */
 
+#include <inttypes.h>
+
 #include "data_scraping.h"
 #include "esp_event.h"
+#include "fetch.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "nvs_flash.h"
 #include "provisioning.h"
 #include "ui.h"
@@ -16,8 +20,11 @@
 void app_main(void) {
     esp_err_t err = ESP_OK;
     ui_config_t ui;  // User interface config struct
-    float freq_hz;   // Frequency in Hz
+    int32_t freq;    // Frequency in 0.01 Hz (scaled by 10^FREQ_VALUE_SCALE)
     int8_t rssi;     // WiFi AP RSSI
+    fetch_sample_t sample;  // Latest sample published by the fetch task
+    uint32_t shown_seq = 0; // Sequence number of the sample currently displayed
+    ui_stats_t ui_stats;    // Display task counters
 
     ESP_ERROR_CHECK(ui_init(&ui));               // Initialise User Interface
     ESP_ERROR_CHECK(ui_startup_animation(&ui));  // Run startup animation
@@ -46,18 +53,41 @@ void app_main(void) {
     ESP_ERROR_CHECK(ui_display_message(&ui, UI_MESSAGE_CONNECTED));
 
     ESP_ERROR_CHECK(data_scraping_init());  // Initialise data scraping component
+    const data_scraping_source_t *sources;
+    uint8_t source_count = data_scraping_get_sources(&sources);
+    ESP_ERROR_CHECK(fetch_init(sources, source_count, data_scraping_fetch));  // Start fetching in the background
 
-    /* Main app loop */
+    /* Main app loop (never blocks on the network, only reads the latest sample from the mailbox) */
+    TickType_t last_wake = xTaskGetTickCount();
     while (true) {
-        ESP_ERROR_CHECK(provisioning_get_rssi(&rssi));
-        ESP_LOGI(TAG, "WiFi RSSI: %d dBm", rssi);
+        if (fetch_get_latest(DATA_SCRAPING_SOURCE_GRID, &sample, 0) == ESP_OK) {
+            bool valid = (sample.err == ESP_OK) && (sample.values.found & (1u << DATA_SCRAPING_FREQ)) != 0;
+            freq = sample.values.values[DATA_SCRAPING_FREQ];
+
+            if (sample.seq != shown_seq) {  // New sample published since the last refresh
+                shown_seq = sample.seq;
+                if (provisioning_get_rssi(&rssi) == ESP_OK) {
+                    ESP_LOGI(TAG, "WiFi RSSI: %d dBm", rssi);
+                }
+                if (ui_get_stats(&ui, &ui_stats) == ESP_OK) {
+                    ESP_LOGI(TAG, "Display: %u cycles, %u deadline misses, jitter %u us avg / %u us max, render %u us max",
+                             (unsigned)ui_stats.cycles, (unsigned)ui_stats.deadline_misses, (unsigned)ui_stats.jitter_avg_us,
+                             (unsigned)ui_stats.jitter_max_us, (unsigned)ui_stats.render_max_us);
+                }
+                if (valid == true) {
+                    ESP_LOGI(TAG, "Frequency: %" PRId32 ".%02" PRId32 " Hz", freq / 100, freq % 100);
+                } else {
+                    ESP_LOGE(TAG, "Frequency data not available (%s)", esp_err_to_name(sample.err));
+                }
+            }
 
-        ESP_ERROR_CHECK(data_scraping_get_freq(&freq_hz));
-        ESP_LOGI(TAG, "Frequency: %.2f Hz", freq_hz);
+            if (valid == true) {
+                ESP_ERROR_CHECK(ui_display_freq(&ui, freq, true));  // Dots blink in the display task
+            } else {
+                ESP_ERROR_CHECK(ui_display_message(&ui, UI_MESSAGE_ERROR));
+            }
+        }   // No sample yet: keep the "connected" message until the first fetch finishes
 
-        for(int i = 0; i < 60; i++) {   // Turn the dots on & off for approximately 60 seconds
-            ESP_ERROR_CHECK(ui_display_freq(&ui, freq_hz, (i%2)));
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-        }
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(UI_REFRESH_PERIOD_MS));
     }
 }
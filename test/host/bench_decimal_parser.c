@@ -0,0 +1,91 @@
+/**
+ * @file    bench_decimal_parser.c
+ * @brief   Host micro-benchmark of the decimal parser against sscanf(" %f") and strtof on frequency values,
+ *          with the number of values the float path turns into a different scaled integer
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ *
+ * Usage: bench_decimal_parser [rounds] (each round converts every value from 49.000 to 50.999 once)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "decimal_parser.h"
+
+#define VALUE_COUNT 2000    // 49.000 to 50.999 Hz
+#define WINDOW_LEN 29       // Value window of the page (FREQ_VALUE_WINDOW)
+
+static char windows[VALUE_COUNT][WINDOW_LEN + 1];
+static volatile int32_t sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Value window as the firmware sees it: leading whitespace, the number, then markup.
+ */
+static void make_windows(void) {
+    for (int i = 0; i < VALUE_COUNT; i++) {
+        snprintf(windows[i], sizeof(windows[i]), "  %d.%03d</td></tr><tr><td>", 49 + i / 1000, i % 1000);
+    }
+}
+
+static int32_t convert_parser(const char *w) {
+    decimal_parser_t p;
+    int32_t value = 0;
+    const char *c = w;
+
+    while (*c == ' ') {
+        c++;
+    }
+    decimal_parser_start(&p, 2, DECIMAL_ROUND_HALF_UP, false);
+    while (*c != '\0' && decimal_parser_char(&p, *c)) {
+        c++;
+    }
+    decimal_parser_result(&p, &value);
+    return value;
+}
+
+static int32_t convert_sscanf(const char *w) {
+    float f = 0;
+    sscanf(w, " %f", &f);
+    return (int32_t)(f * 100);  // As the display code did before the parser
+}
+
+static int32_t convert_strtof(const char *w) {
+    return (int32_t)(strtof(w, NULL) * 100);
+}
+
+static void bench(const char *name, int32_t (*convert)(const char *), int rounds) {
+    double start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < VALUE_COUNT; i++) {
+            sink = convert(windows[i]);
+        }
+    }
+    double ns = (now_ns() - start) / ((double)rounds * VALUE_COUNT);
+
+    int differ = 0;
+    for (int i = 0; i < VALUE_COUNT; i++) {
+        int thousandths = 49000 + i;
+        int32_t exact = (thousandths + 5) / 10;  // Half up to hundredths
+        differ += (convert(windows[i]) != exact);
+    }
+    printf("%-8s %8.1f ns/value, %4d of %d values not rounded to the nearest 0.01 Hz\n", name, ns, differ,
+           VALUE_COUNT);
+}
+
+int main(int argc, char **argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 1000;
+
+    make_windows();
+    bench("parser", convert_parser, rounds);
+    bench("sscanf", convert_sscanf, rounds);
+    bench("strtof", convert_strtof, rounds);
+    return 0;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file    bench_http_decoder.c
+ * @brief   Host benchmark of HTTP_ACCEPT_COMPRESSION on and off: wire bytes of the response (in total and up to the
+ *          extracted value) and CPU time of parsing it (decoding and extraction) for a small and a large page
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ *
+ * The host decoder runs zlib in place of the ROM tinfl, so the CPU figures are relative: compare the two columns,
+ * not the absolute numbers with the device.
+ * Usage: bench_http_decoder [rounds] (exits non-zero if a value is not extracted in both modes)
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#include "http_response.h"
+#include "stream_extractor.h"
+
+#define CHUNK_SIZE 1460             // Bytes per feed (one TCP segment)
+#define PAGE_MAX (96 * 1024)
+#define EXPECTED_VALUE 4999         // 49.987 Hz at FREQ_VALUE_SCALE
+
+/* Response of one mode: identity or gzip */
+typedef struct {
+    char data[PAGE_MAX + 512];
+    size_t len;
+} response_t;
+
+/* State of a parse: extractor and the wire bytes read when the value was found */
+typedef struct {
+    stream_extractor_t extractor;
+    size_t wire_bytes;              // Bytes of the response fed so far
+    size_t value_wire_bytes;        // Bytes of the response fed when all values were extracted
+} parse_t;
+
+static const stream_extractor_key_t KEYS[] = {
+    {"freq", FREQ_MARKER, STREAM_RULE_OFFSET, FREQ_VALUE_OFFSET, FREQ_VALUE_WINDOW, '\0',
+     FREQ_VALUE_SCALE, FREQ_VALUE_ROUNDING},
+};
+
+static char page[PAGE_MAX];
+static response_t identity, gzipped;
+static http_decoder_t decoder;
+static parse_t state;
+static volatile int32_t sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Grid page: rows of the generation table, the frequency row at 70% of the rows, then the rest.
+ */
+static size_t make_page(int rows) {
+    static const char *const FUELS[] = {"Gas", "Coal", "Nuclear", "Wind", "Hydro", "Solar", "Biomass", "Other"};
+    size_t len = snprintf(page, sizeof(page), "<!DOCTYPE html>\n<html><head><title>Grid</title></head><body>\n"
+                                              "<table class=\"generation\">\n");
+
+    for (int i = 0; i < rows; i++) {
+        if (i == rows * 7 / 10) {
+            len += snprintf(page + len, sizeof(page) - len, "<tr><th>Freq (Hz):  49.987</td></tr>\n");
+        }
+        len += snprintf(page + len, sizeof(page) - len,
+                        "<tr><td class=\"fuel\">%s</td><td class=\"mw\">%d</td><td class=\"pct\">%d.%d%%</td>"
+                        "<td class=\"time\">2026-10-17 10:%02d:%02d</td></tr>\n",
+                        FUELS[i % 8], 1000 + (i * 37) % 9000, (i * 7) % 40, i % 10, (i / 60) % 60, i % 60);
+    }
+    len += snprintf(page + len, sizeof(page) - len, "</table>\n</body></html>\n");
+    return len;
+}
+
+/**
+ * @brief Build the response to a request with (gzip) or without Accept-Encoding.
+ */
+static void make_response(response_t *resp, size_t page_len, bool gzip) {
+    char body[PAGE_MAX + 256];
+    size_t body_len = page_len;
+
+    if (gzip) {
+        z_stream zs = {0};
+        deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);   // Level of a typical web server
+        zs.next_in = (Bytef *)page;
+        zs.avail_in = page_len;
+        zs.next_out = (Bytef *)body;
+        zs.avail_out = sizeof(body);
+        deflate(&zs, Z_FINISH);
+        body_len = zs.total_out;
+        deflateEnd(&zs);
+    } else {
+        memcpy(body, page, page_len);
+    }
+
+    resp->len = snprintf(resp->data, sizeof(resp->data),
+                         "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %zu\r\n%s"
+                         "Connection: keep-alive\r\n\r\n",
+                         body_len, gzip ? "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n" : "");
+    memcpy(resp->data + resp->len, body, body_len);
+    resp->len += body_len;
+}
+
+static esp_err_t body_cb(void *ctx, const char *data, size_t len) {
+    parse_t *p = (parse_t *)ctx;
+
+    if (stream_extractor_is_done(&p->extractor)) {
+        return ESP_OK;
+    }
+    esp_err_t err = stream_extractor_feed(&p->extractor, data, len);
+    return (err == ESP_ERR_NOT_FINISHED) ? ESP_OK : err;
+}
+
+/**
+ * @brief Parse the whole response in TCP-sized chunks.
+ *
+ * @return Extracted value (INT32_MIN if not found).
+ */
+static int32_t parse(const response_t *resp) {
+    parse_t *ctx = &state;
+    http_response_t r;
+    stream_extractor_result_t result;
+    esp_err_t err = ESP_ERR_NOT_FINISHED;
+
+    stream_extractor_reset(&ctx->extractor);
+    ctx->wire_bytes = 0;
+    ctx->value_wire_bytes = 0;
+    http_response_init(&r, body_cb, ctx);
+    http_response_set_decoder(&r, &decoder);
+    for (size_t from = 0; from < resp->len && err == ESP_ERR_NOT_FINISHED; from += CHUNK_SIZE) {
+        size_t n = (resp->len - from < CHUNK_SIZE) ? resp->len - from : CHUNK_SIZE;
+        err = http_response_feed(&r, resp->data + from, n, NULL);
+        ctx->wire_bytes += n;
+        if (ctx->value_wire_bytes == 0 && stream_extractor_is_done(&ctx->extractor)) {
+            ctx->value_wire_bytes = ctx->wire_bytes;
+        }
+    }
+    if (err != ESP_OK || stream_extractor_finish(&ctx->extractor, &result) != ESP_OK) {
+        return INT32_MIN;
+    }
+    return result.values[0];
+}
+
+/**
+ * @return Average CPU time of one parse in µs.
+ */
+static double time_parse(const response_t *resp, int rounds) {
+    double start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        sink = parse(resp);
+    }
+    return (now_ns() - start) / rounds / 1e3;
+}
+
+/**
+ * @return true if the value was extracted in both modes.
+ */
+static bool bench(const char *name, int rows, int rounds) {
+    size_t page_len = make_page(rows);
+
+    make_response(&identity, page_len, false);
+    make_response(&gzipped, page_len, true);
+
+    bool ok = (parse(&identity) == EXPECTED_VALUE);
+    bool lazy = (decoder.window == NULL);     // Identity responses never allocate the window
+    size_t identity_value_bytes = state.value_wire_bytes;
+    ok &= (parse(&gzipped) == EXPECTED_VALUE);
+    size_t gzip_value_bytes = state.value_wire_bytes;
+
+    double identity_us = time_parse(&identity, rounds);
+    double gzip_us = time_parse(&gzipped, rounds);
+
+    printf("%-5s page %6zu B | wire: identity %6zu B, gzip %6zu B (%3.0f%%) | to value: identity %6zu B, "
+           "gzip %6zu B | CPU: identity %7.1f us, gzip %7.1f us (x%.1f)%s\n",
+           name, page_len, identity.len, gzipped.len, 100.0 * gzipped.len / identity.len, identity_value_bytes,
+           gzip_value_bytes, identity_us, gzip_us, gzip_us / identity_us, ok ? "" : " WRONG VALUE");
+    if (lazy && decoder.window != NULL) {
+        printf("      inflate window allocated by the first gzip body\n");
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 2000;
+    bool ok = true;
+
+    if (stream_extractor_init(&state.extractor, KEYS, 1) != ESP_OK) {
+        return 1;
+    }
+    printf("Responses fed in %d-byte chunks, %d rounds, inflate window %d B allocated on the first gzip body\n",
+           CHUNK_SIZE, rounds, HTTP_INFLATE_WINDOW_SIZE);
+    ok &= bench("small", 8, rounds);
+    ok &= bench("large", 600, rounds);
+    return ok ? 0 : 1;
+}
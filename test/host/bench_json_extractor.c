@@ -0,0 +1,146 @@
+/**
+ * @file    bench_json_extractor.c
+ * @brief   Host corpus benchmark of the JSON extractor against the substring scanner it replaced (marker search
+ *          and sscanf(" %f") over the buffered response, as extract_freq_data did), with the values each gets right
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ *
+ * A scanner stopping at a wrong early match is also fast: compare the speeds on documents both get right.
+ * Usage: bench_json_extractor [rounds] (exits non-zero if the extractor gets a value of the corpus wrong)
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "json_extractor.h"
+
+#define CHUNK_SIZE 1460         // Bytes per feed (one TCP segment)
+#define SCAN_WINDOW 16          // Bytes copied after the marker for sscanf (TEMP_BUFFER_SIZE of the old scanner)
+#define LARGE_RECORDS 300       // Records before the value in the large document
+
+/* Document of the corpus, the path of its value and the key the scanner looks for */
+typedef struct {
+    const char *name;
+    const char *doc;
+    const char *path;
+    const char *marker;
+    int32_t expected;           // Value scaled by 10^3
+} corpus_doc_t;
+
+static char large_doc[64 * 1024];     // Records holding the key of the value, so the scanner stops early
+static char tail_doc[64 * 1024];      // Records with another key, so the scanner reads up to the value too
+static corpus_doc_t corpus[] = {
+    {"flat", "{\"ts\":1700000000,\"freq\":49.987,\"unit\":\"Hz\"}", "freq", "\"freq\":", 49987},
+    {"pretty", "{\n  \"ts\" : 1700000000,\n  \"freq\" : 49.987\n}\n", "freq", "\"freq\":", 49987},
+    {"string", "{\"freq\":\"49.987\",\"unit\":\"Hz\"}", "freq", "\"freq\":", 49987},
+    {"decoy", "{\"freq_avg\":50.000,\"prev\":{\"freq\":50.101},\"freq\":49.987}", "freq", "\"freq\":", 49987},
+    {"array", "{\"data\":{\"items\":[{\"freq\":50.012},{\"freq\":49.987}]}}", "data.items[1].freq", "\"freq\":",
+     49987},
+    {"large", large_doc, "summary.freq", "\"freq\":", 49987},
+    {"tail", tail_doc, "summary.freq", "\"freq\":", 49987},
+};
+
+static volatile int32_t sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief API response with a long history of records before the summary holding the value.
+ *
+ * @param key Key of the value in the records.
+ */
+static void make_large_doc(char *doc, size_t size, const char *key) {
+    size_t len = snprintf(doc, size, "{\"history\":[");
+
+    for (int i = 0; i < LARGE_RECORDS; i++) {
+        len += snprintf(doc + len, size - len, "%s{\"t\":%d,\"%s\":%d.%03d,\"note\":\"sample \\\"%d\\\"\"}",
+                        (i > 0) ? "," : "", 1700000000 + i, key, 49 + (i & 1), i % 1000, i);
+    }
+    snprintf(doc + len, size - len, "],\"summary\":{\"count\":%d,\"freq\":49.987}}", LARGE_RECORDS);
+}
+
+/**
+ * @brief Old scanner: first occurrence of the marker in the buffered response, then sscanf(" %f") on the
+ *        bytes after it.
+ */
+static int32_t scan_old(const char *doc, size_t len, const char *marker) {
+    char window[SCAN_WINDOW];
+    size_t marker_len = strlen(marker);
+    float value = 0;
+
+    for (size_t i = 0; i + marker_len <= len; i++) {
+        if (memcmp(doc + i, marker, marker_len) == 0) {
+            size_t n = len - i - marker_len;
+            n = (n < SCAN_WINDOW - 1) ? n : SCAN_WINDOW - 1;
+            memcpy(window, doc + i + marker_len, n);
+            window[n] = '\0';
+            sscanf(window, " %f", &value);
+            break;
+        }
+    }
+    return (int32_t)(value * 1000 + (value < 0 ? -0.5f : 0.5f));  // Rounded, so that only the scan is compared
+}
+
+/**
+ * @brief Extractor, fed in TCP-sized chunks.
+ */
+static int32_t extract(json_extractor_t *ex, const char *doc, size_t len) {
+    json_extractor_result_t result;
+
+    json_extractor_reset(ex);
+    for (size_t from = 0; from < len; from += CHUNK_SIZE) {
+        size_t n = (len - from < CHUNK_SIZE) ? len - from : CHUNK_SIZE;
+        if (json_extractor_feed(ex, doc + from, n) != ESP_ERR_NOT_FINISHED) {
+            break;
+        }
+    }
+    json_extractor_finish(ex, &result);
+    return (result.found & 1) ? result.values[0] : INT32_MIN;
+}
+
+int main(int argc, char **argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 20000;
+    static json_extractor_t ex;
+    bool ok = true;
+
+    make_large_doc(large_doc, sizeof(large_doc), "freq");
+    make_large_doc(tail_doc, sizeof(tail_doc), "hz");
+    printf("%-7s %7s  %22s  %22s\n", "doc", "bytes", "extractor", "old scanner");
+    for (size_t d = 0; d < sizeof(corpus) / sizeof(corpus[0]); d++) {
+        const corpus_doc_t *c = &corpus[d];
+        size_t len = strlen(c->doc);
+        json_extractor_path_t path = {"value", c->path, 3, DECIMAL_ROUND_HALF_UP};
+
+        if (json_extractor_init(&ex, &path, 1) != ESP_OK) {
+            printf("%-7s invalid path %s\n", c->name, c->path);
+            ok = false;
+            continue;
+        }
+        int32_t extracted = extract(&ex, c->doc, len);
+        int32_t scanned = scan_old(c->doc, len, c->marker);
+        ok &= (extracted == c->expected);
+
+        double start = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            sink = extract(&ex, c->doc, len);
+        }
+        double extractor_ns = (now_ns() - start) / rounds;
+
+        start = now_ns();
+        for (int r = 0; r < rounds; r++) {
+            sink = scan_old(c->doc, len, c->marker);
+        }
+        double scanner_ns = (now_ns() - start) / rounds;
+
+        printf("%-7s %7zu  %9.0f ns %5.0f MB/s %s  %9.0f ns %5.0f MB/s %s\n", c->name, len, extractor_ns,
+               len / extractor_ns * 1e3, (extracted == c->expected) ? "ok   " : "WRONG", scanner_ns,
+               len / scanner_ns * 1e3, (scanned == c->expected) ? "ok" : "WRONG");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file    bench_stream_extractor.c
+ * @brief   Host benchmark of the stream extractor throughput with 1, 8 and 32 keys on a generated page, against
+ *          a separate memmem scan per key (the cost of one pass per value)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ *
+ * Built with STREAM_EXTRACTOR_MAX_KEYS=32 (the firmware default is 8).
+ * Usage: bench_stream_extractor [rounds] (exits non-zero if a value is not extracted correctly)
+ */
+
+#define _GNU_SOURCE     // memmem
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stream_extractor.h"
+
+#define PAGE_SIZE 65536     // Generated page (values at the end, so the whole page is scanned)
+#define CHUNK_SIZE 1460     // Bytes per feed (one TCP segment)
+#define MAX_KEYS 32
+
+_Static_assert(STREAM_EXTRACTOR_MAX_KEYS >= MAX_KEYS, "Build with STREAM_EXTRACTOR_MAX_KEYS=32");
+
+static char page[PAGE_SIZE];
+static size_t page_len;
+static char markers[MAX_KEYS][STREAM_EXTRACTOR_MARKER_MAX_LEN + 1];
+static stream_extractor_key_t keys[MAX_KEYS];
+static stream_extractor_t extractor;
+static volatile uint32_t sink;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Page of table rows whose labels share prefixes with the markers, then one value row per key.
+ */
+static void make_page(void) {
+    static const char *const LABELS[] = {"Generation", "Gen", "Demand", "Import", "Interconn", "Freq"};
+    size_t len = 0;
+    int row = 0;
+
+    for (int k = 0; k < MAX_KEYS; k++) {
+        snprintf(markers[k], sizeof(markers[k]), "%s_%02d", LABELS[k % 6], k);
+        keys[k] = (stream_extractor_key_t){markers[k], markers[k], STREAM_RULE_DELIMITER, 8, 12, ':', 2,
+                                            DECIMAL_ROUND_HALF_UP};
+    }
+
+    /* Filler: near misses of the markers (same labels, no underscore) */
+    while (len < PAGE_SIZE - 4096) {
+        len += snprintf(page + len, PAGE_SIZE - len, "<tr><td class=\"l\">%s%03d</td><td>%d.%02d MW</td></tr>\n",
+                        LABELS[row % 6], 100 + row % 900, row % 5000, row % 100);
+        row++;
+    }
+    for (int k = 0; k < MAX_KEYS; k++) {
+        len += snprintf(page + len, PAGE_SIZE - len, "<tr><td>%s: %d.%02d</td></tr>\n", markers[k], 1000 + k, k);
+    }
+    page_len = len;
+}
+
+/**
+ * @brief Extract the values of the keys in one pass, fed in TCP-sized chunks.
+ */
+static void extract(stream_extractor_result_t *result) {
+    stream_extractor_reset(&extractor);
+    for (size_t from = 0; from < page_len; from += CHUNK_SIZE) {
+        size_t len = (page_len - from < CHUNK_SIZE) ? page_len - from : CHUNK_SIZE;
+        if (stream_extractor_feed(&extractor, page + from, len) == ESP_OK) {
+            break;
+        }
+    }
+    stream_extractor_finish(&extractor, result);
+    sink = result->found;
+}
+
+/**
+ * @brief Reference: one scan of the whole page per key.
+ */
+static void scan_per_key(int count) {
+    for (int k = 0; k < count; k++) {
+        const char *found = memmem(page, page_len, markers[k], strlen(markers[k]));
+        sink = (uint32_t)(found - page);
+    }
+}
+
+/**
+ * @return true if all values were extracted correctly.
+ */
+static bool bench(int count, int rounds) {
+    if (stream_extractor_init(&extractor, keys, (uint8_t)count) != ESP_OK) {
+        printf("%2d keys: init failed\n", count);
+        return false;
+    }
+
+    /* Check the values before timing */
+    stream_extractor_result_t result;
+    extract(&result);
+    int correct = 0;
+    for (int k = 0; k < count; k++) {
+        correct += ((result.found & (1u << k)) && result.values[k] == (1000 + k) * 100 + k);
+    }
+
+    double start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        extract(&result);
+    }
+    double extractor_s = (now_ns() - start) / 1e9;
+
+    start = now_ns();
+    for (int r = 0; r < rounds; r++) {
+        scan_per_key(count);
+    }
+    double scan_s = (now_ns() - start) / 1e9;
+
+    double mb = (double)page_len * rounds / 1e6;
+    printf("%2d keys: %7.1f MB/s single pass, %7.1f MB/s page scanned per key, %2d/%d values correct\n", count,
+           mb / extractor_s, mb / scan_s, correct, count);
+    return correct == count;
+}
+
+int main(int argc, char **argv) {
+    int rounds = (argc > 1) ? atoi(argv[1]) : 2000;
+    static const int COUNTS[] = {1, 8, 32};
+    bool ok = true;
+
+    make_page();
+    printf("Page of %zu bytes fed in %d-byte chunks, %d rounds\n", page_len, CHUNK_SIZE, rounds);
+    for (size_t i = 0; i < sizeof(COUNTS) / sizeof(COUNTS[0]); i++) {
+        ok &= bench(COUNTS[i], rounds);
+    }
+    return ok ? 0 : 1;
+}
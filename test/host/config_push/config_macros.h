@@ -0,0 +1,18 @@
+/**
+ * @file    config_macros.h
+ * @brief   Project configuration of the host tests of the MQTT subscription: the configuration of the firmware with
+ *          FETCH_PUSH and FETCH_FANOUT on and a broker on loopback without TLS (the port is set at run time through
+ *          host_mqtt_port)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include_next "config_macros.h"
+
+#undef FETCH_PUSH
+#define FETCH_PUSH 1
+#undef FETCH_PUSH_URI
+#define FETCH_PUSH_URI "mqtt://127.0.0.1:1883"
+#undef FETCH_FANOUT
+#define FETCH_FANOUT 1
@@ -0,0 +1,31 @@
+/**
+ * @file    config_macros.h
+ * @brief   Project configuration of the host tests of the TLS fetch: the configuration of the firmware with the server
+ *          verified against a CA generated at run time (host_tls_ca_pem), full-page requests and deadlines short enough
+ *          to let a stalled server overrun each of them in a fraction of a second
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include_next "config_macros.h"
+
+#define HOST_TLS_CA_PEM_SIZE 4096
+extern char host_tls_ca_pem[HOST_TLS_CA_PEM_SIZE];  // PEM of the CA of the stand-in server (set before the init)
+
+#undef TLS_TRUST_MODE
+#define TLS_TRUST_MODE TLS_TRUST_CA
+#undef TLS_TRUST_CA_PEM
+#define TLS_TRUST_CA_PEM host_tls_ca_pem
+#undef FETCH_RANGE_MODE
+#define FETCH_RANGE_MODE 0          // Ranges are covered by test_conditional_get
+#undef FETCH_CONNECT_TIMEOUT_MS
+#define FETCH_CONNECT_TIMEOUT_MS 300
+#undef FETCH_HANDSHAKE_TIMEOUT_MS
+#define FETCH_HANDSHAKE_TIMEOUT_MS 300
+#undef FETCH_WRITE_TIMEOUT_MS
+#define FETCH_WRITE_TIMEOUT_MS 300
+#undef FETCH_FIRST_BYTE_TIMEOUT_MS
+#define FETCH_FIRST_BYTE_TIMEOUT_MS 300
+#undef FETCH_TOTAL_TIMEOUT_MS
+#define FETCH_TOTAL_TIMEOUT_MS 900  // Longer than each phase: a stall before the body overruns its phase
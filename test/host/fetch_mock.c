@@ -0,0 +1,54 @@
+/**
+ * @file    fetch_mock.c
+ * @brief   Stand-ins for the fan-out and the extraction of pushed messages (a message is a plain decimal integer)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fetch_mock.h"
+
+#include <stdio.h>
+#include <string.h>
+
+fetch_mock_t fetch_mock = {.fanout_leader = true};
+
+void fetch_mock_reset(void) {
+    memset(&fetch_mock, 0, sizeof(fetch_mock));
+    fetch_mock.fanout_leader = true;
+}
+
+esp_err_t fanout_init(uint64_t self_id, fanout_sample_cb_t cb) {
+    fetch_mock.fanout_inits++;
+    fetch_mock.fanout_id = self_id;
+    fetch_mock.fanout_cb = cb;
+    return ESP_OK;
+}
+
+bool fanout_is_leader(void) {
+    return fetch_mock.fanout_leader;
+}
+
+esp_err_t fanout_publish(uint8_t source, const data_scraping_values_t *values) {
+    fetch_mock.fanout_published++;
+    return ESP_OK;
+}
+
+esp_err_t data_scraping_extract(const data_scraping_source_t *source, const char *data, size_t len,
+                                data_scraping_values_t *values) {
+    char text[32];
+    int value, end = 0;
+
+    fetch_mock.extracts++;
+    memset(values, 0, sizeof(*values));
+    values->max_age_s = -1;
+    if (len == 0 || len >= sizeof(text)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memcpy(text, data, len);
+    text[len] = '\0';
+    if (sscanf(text, "%d%n", &value, &end) != 1 || end != (int)len) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    values->found = 1;
+    values->values[0] = value;
+    return ESP_OK;
+}
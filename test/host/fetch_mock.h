@@ -0,0 +1,34 @@
+/**
+ * @file    fetch_mock.h
+ * @brief   Stand-ins for the modules around the fetch task (fan-out, MQTT subscription, extraction of pushed
+ *          messages) recording how the fetch task uses them
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fanout.h"
+#include "fetch_push.h"
+
+/* Calls recorded by the stand-ins, and their answers */
+typedef struct {
+    uint32_t fanout_inits;          // fanout_init calls
+    uint64_t fanout_id;             // ID passed to fanout_init
+    fanout_sample_cb_t fanout_cb;   // Callback passed to fanout_init (the test plays the leader through it)
+    bool fanout_leader;             // Answer of fanout_is_leader
+    uint32_t fanout_published;      // fanout_publish calls
+    uint32_t push_inits;            // fetch_push_init calls (stand-in of fetch_push_mock.c)
+    QueueHandle_t push_queue;       // Queue passed to fetch_push_init
+    bool push_live;                 // Answer of fetch_push_is_live
+    uint32_t extracts;              // data_scraping_extract calls
+} fetch_mock_t;
+
+extern fetch_mock_t fetch_mock;
+
+/**
+ * @brief Clear the recorded calls (this device leads, pushed sources are not live).
+ */
+void fetch_mock_reset(void);
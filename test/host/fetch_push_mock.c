@@ -0,0 +1,17 @@
+/**
+ * @file    fetch_push_mock.c
+ * @brief   Stand-in for the MQTT subscription (tests of the fetch task that do not run the MQTT client)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "fetch_mock.h"
+
+esp_err_t fetch_push_init(const data_scraping_source_t *sources, uint8_t count, QueueHandle_t queue) {
+    fetch_mock.push_inits++;
+    fetch_mock.push_queue = queue;
+    return ESP_OK;
+}
+
+bool fetch_push_is_live(uint8_t source) {
+    return fetch_mock.push_live;
+}
@@ -0,0 +1,11 @@
+/**
+ * @file    ets_sys.h
+ * @brief   Host stand-in for the ROM busy-wait (defined by the test, which advances its simulated clock)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+void ets_delay_us(uint32_t us);
@@ -0,0 +1,13 @@
+/**
+ * @file    esp_check.h
+ * @brief   Host stand-in for the ESP-IDF error checking macros
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdlib.h>
+
+#include "esp_err.h"
+
+#define ESP_ERROR_CHECK(x) do { if ((x) != ESP_OK) { abort(); } } while (0)
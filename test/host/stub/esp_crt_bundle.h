@@ -0,0 +1,12 @@
+/**
+ * @file    esp_crt_bundle.h
+ * @brief   Host stand-in for the ESP x509 certificate bundle (only referenced by mqtts:// configurations, which the
+ *          MQTT client stand-in does not support)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+esp_err_t esp_crt_bundle_attach(void *conf);
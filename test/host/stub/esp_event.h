@@ -0,0 +1,14 @@
+/**
+ * @file    esp_event.h
+ * @brief   Host stand-in for the ESP-IDF event types used by the MQTT client stand-in
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t base, int32_t id, void *data);
+
+#define ESP_EVENT_ANY_ID (-1)
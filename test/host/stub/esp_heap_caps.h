@@ -0,0 +1,39 @@
+/**
+ * @file    esp_heap_caps.h
+ * @brief   Host stand-in for the ESP-IDF capability-based heap (the host heap, capabilities ignored, free size
+ *          reported as HOST_HEAP_SIZE less the bytes in use)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <malloc.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+#define HOST_HEAP_SIZE (256 * 1024 * 1024)
+
+static inline void *heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    return calloc(n, size);
+}
+
+static inline void heap_caps_free(void *ptr) {
+    free(ptr);
+}
+
+static inline size_t heap_caps_get_free_size(uint32_t caps) {
+    size_t used = mallinfo2().uordblks;
+    return (used < HOST_HEAP_SIZE) ? HOST_HEAP_SIZE - used : 0;
+}
+
+static inline size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return heap_caps_get_free_size(caps);
+}
@@ -0,0 +1,22 @@
+/**
+ * @file    esp_log.h
+ * @brief   Host stand-in for the ESP-IDF logging macros (errors and warnings only)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+/* Not printed, but the arguments are still type-checked and count as used */
+#define ESP_LOG_QUIET(tag, format, ...)                          \
+    do {                                                         \
+        if (0) {                                                 \
+            fprintf(stderr, "%s: " format "\n", tag, ##__VA_ARGS__); \
+        }                                                        \
+    } while (0)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_QUIET(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_QUIET(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_QUIET(tag, format, ##__VA_ARGS__)
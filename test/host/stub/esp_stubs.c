@@ -0,0 +1,72 @@
+/**
+ * @file    esp_stubs.c
+ * @brief   Host implementations of the ESP-IDF helpers used by the tested modules
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_FAIL:
+            return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:
+            return "ESP_ERR_INVALID_RESPONSE";
+        default:
+            return "ESP_ERR";
+    }
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t n = (len < size - 1) ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type) {
+    static const uint8_t BASE[6] = {0x24, 0x0a, 0xc4, 0x00, 0x00, 0x01};
+
+    memcpy(mac, BASE, sizeof(BASE));
+    mac[5] += (uint8_t)type;
+    return ESP_OK;
+}
+
+static struct timespec start;      // Start of the test process
+static int64_t skipped_us = 0;      // Time skipped by host_timer_advance
+
+__attribute__((constructor)) static void esp_timer_start(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 +
+           __atomic_load_n(&skipped_us, __ATOMIC_RELAXED);
+}
+
+void host_timer_advance(int64_t us) {
+    __atomic_add_fetch(&skipped_us, us, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,23 @@
+/**
+ * @file    esp_system.h
+ * @brief   Host stand-in for the ESP-IDF system API used by the tested modules (MAC address)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH
+} esp_mac_type_t;
+
+/**
+ * @brief Fixed MAC address (24:0a:c4:00:00:01 plus the type), so that device IDs are stable across test runs.
+ */
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
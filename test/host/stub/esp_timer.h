@@ -0,0 +1,19 @@
+/**
+ * @file    esp_timer.h
+ * @brief   Host stand-in for the ESP-IDF high-resolution timer (monotonic clock, which tests may move forward)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Microseconds since the start of the test (plus any time skipped by host_timer_advance).
+ */
+int64_t esp_timer_get_time(void);
+
+/**
+ * @brief Move the clock forward (host only, e.g. to expire a TTL without waiting for it).
+ */
+void host_timer_advance(int64_t us);
@@ -0,0 +1,18 @@
+/**
+ * @file    semphr.h
+ * @brief   Host stand-in for the FreeRTOS semaphores (queues of empty items, as in FreeRTOS)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+
+#define xSemaphoreTake(sem, wait) xQueueReceive((sem), NULL, (wait))
+#define xSemaphoreGive(sem) xQueueSend((sem), NULL, 0)
+#define vSemaphoreDelete(sem) vQueueDelete(sem)
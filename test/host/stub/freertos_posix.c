@@ -0,0 +1,314 @@
+/**
+ * @file    freertos_posix.c
+ * @brief   Host implementation of the FreeRTOS stand-in on POSIX threads: tasks, queues, semaphores and task
+ *          notifications, with 1 ms ticks of the esp_timer clock
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+/* Task (thread) with its notification value */
+typedef struct {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify;
+} host_task_t;
+
+/* Queue of fixed-size items (semaphores hold empty items) */
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t items[];
+};
+
+int host_task_create_failures = 0;
+
+static __thread host_task_t *current = NULL;   // Task of the calling thread
+static host_task_t main_task;                   // Task of the test process itself
+static pthread_once_t main_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Initialise a condition variable on the monotonic clock (waits are not affected by clock changes).
+ */
+static void host_cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/**
+ * @brief Absolute monotonic time a number of ticks from now.
+ */
+static struct timespec host_deadline(TickType_t ticks) {
+    struct timespec ts;
+    uint64_t ms = (uint64_t)ticks * portTICK_PERIOD_MS;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+/**
+ * @brief Wait on a condition for up to a number of ticks (the lock must be held).
+ *
+ * @return false if the wait timed out.
+ */
+static bool host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks, const struct timespec *deadline) {
+    if (ticks == 0) {
+        return false;
+    } else if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+static void host_task_init(host_task_t *task) {
+    pthread_mutex_init(&task->lock, NULL);
+    host_cond_init(&task->notified);
+    task->notify = 0;
+}
+
+static void host_main_task_init(void) {
+    host_task_init(&main_task);
+    main_task.thread = pthread_self();
+}
+
+static void *host_task_entry(void *arg) {
+    host_task_t *task = arg;
+
+    current = task;
+    task->fn(task->arg);
+    return NULL;    // A FreeRTOS task must not return, but a returning thread simply ends
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg, UBaseType_t priority,
+                       TaskHandle_t *handle) {
+    if (host_task_create_failures > 0) {
+        host_task_create_failures--;
+        return pdFAIL;
+    }
+
+    host_task_t *task = calloc(1, sizeof(host_task_t));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    host_task_init(task);
+    task->fn = fn;
+    task->arg = arg;
+    if (handle != NULL) {
+        *handle = task;     // Set before the task runs, as the task may use it
+    }
+    if (pthread_create(&task->thread, NULL, host_task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+    host_task_t *task = (handle != NULL) ? handle : xTaskGetCurrentTaskHandle();
+
+    if (task == current) {
+        pthread_exit(NULL);     // Task structure leaked on purpose: other tasks may still notify it
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec ts = {.tv_sec = ticks / configTICK_RATE_HZ, .tv_nsec = (long)(ticks % configTICK_RATE_HZ) * 1000000};
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment) {
+    TickType_t wake = *previous_wake + increment;
+    TickType_t now = xTaskGetTickCount();
+
+    if ((int32_t)(wake - now) > 0) {
+        vTaskDelay(wake - now);
+    }
+    *previous_wake = wake;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / (1000 * portTICK_PERIOD_MS));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (current == NULL) {
+        pthread_once(&main_once, host_main_task_init);
+        current = &main_task;   // Threads not created by xTaskCreate all count as the main task
+    }
+    return current;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    host_task_t *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = host_deadline(wait);
+    uint32_t value;
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify == 0 && host_wait(&task->notified, &task->lock, wait, &deadline)) {
+    }
+    value = task->notify;
+    if (value > 0) {
+        task->notify = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+    host_task_t *task = handle;
+
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    if (length == 0) {
+        return NULL;
+    }
+
+    QueueHandle_t queue = calloc(1, sizeof(struct host_queue) + (size_t)length * item_size);
+    if (queue == NULL) {
+        return NULL;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    host_cond_init(&queue->not_empty);
+    host_cond_init(&queue->not_full);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    memset(queue, 0xA5, sizeof(struct host_queue));     // Poisoned, so that a use after delete is noticed
+    free(queue);
+}
+
+/**
+ * @brief Append an item (the lock must be held and the queue must not be full).
+ */
+static void host_queue_push(QueueHandle_t queue, const void *item) {
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+
+    if (queue->item_size > 0) {
+        memcpy(&queue->items[(size_t)tail * queue->item_size], item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait) {
+    struct timespec deadline = host_deadline(wait);
+    BaseType_t ret = pdFAIL;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && host_wait(&queue->not_full, &queue->lock, wait, &deadline)) {
+    }
+    if (queue->count < queue->length) {
+        host_queue_push(queue, item);
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;   // Only meant for queues of length 1
+    queue->head = 0;
+    host_queue_push(queue, item);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+/**
+ * @brief Copy the first item, removing it from the queue if remove is set.
+ */
+static BaseType_t host_queue_get(QueueHandle_t queue, void *item, TickType_t wait, bool remove) {
+    struct timespec deadline = host_deadline(wait);
+    BaseType_t ret = pdFAIL;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && host_wait(&queue->not_empty, &queue->lock, wait, &deadline)) {
+    }
+    if (queue->count > 0) {
+        if (queue->item_size > 0) {
+            memcpy(item, &queue->items[(size_t)queue->head * queue->item_size], queue->item_size);
+        }
+        if (remove) {
+            queue->head = (queue->head + 1) % queue->length;
+            queue->count--;
+            pthread_cond_signal(&queue->not_full);
+        } else {
+            pthread_cond_signal(&queue->not_empty);     // Let other readers peek too
+        }
+        ret = pdPASS;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait) {
+    return host_queue_get(queue, item, wait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t wait) {
+    return host_queue_get(queue, item, wait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    SemaphoreHandle_t sem = xQueueCreate(1, 0);
+    if (sem != NULL) {
+        xSemaphoreGive(sem);    // A mutex is created available
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
@@ -0,0 +1,34 @@
+/**
+ * @file    gpio_stubs.c
+ * @brief   Host no-op GPIO driver and registers (the tests drive the display through a recording pin backend)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "hal/gpio_ll.h"
+
+gpio_dev_t GPIO;
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return 1;
+}
+
+void gpio_ll_set_level(gpio_dev_t *hw, gpio_num_t gpio_num, uint32_t level) {
+}
+
+int gpio_ll_get_level(gpio_dev_t *hw, gpio_num_t gpio_num) {
+    return 1;
+}
+
+void gpio_ll_output_enable(gpio_dev_t *hw, gpio_num_t gpio_num) {
+}
+
+void gpio_ll_output_disable(gpio_dev_t *hw, gpio_num_t gpio_num) {
+}
@@ -0,0 +1,20 @@
+/**
+ * @file    gpio_ll.h
+ * @brief   Host stand-in for the GPIO register layer used by the display driver
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include "driver/gpio.h"
+
+typedef struct {
+    uint32_t out;   // Output levels (unused on the host)
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+void gpio_ll_set_level(gpio_dev_t *hw, gpio_num_t gpio_num, uint32_t level);
+int gpio_ll_get_level(gpio_dev_t *hw, gpio_num_t gpio_num);
+void gpio_ll_output_enable(gpio_dev_t *hw, gpio_num_t gpio_num);
+void gpio_ll_output_disable(gpio_dev_t *hw, gpio_num_t gpio_num);
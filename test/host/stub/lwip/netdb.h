@@ -0,0 +1,9 @@
+/**
+ * @file    netdb.h
+ * @brief   Host stand-in for the lwIP resolver (getaddrinfo of the development machine)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <netdb.h>
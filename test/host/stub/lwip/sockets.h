@@ -0,0 +1,15 @@
+/**
+ * @file    sockets.h
+ * @brief   Host stand-in for the lwIP socket API (the POSIX sockets of the development machine)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,7 @@
+/**
+ * @file    certs.h
+ * @brief   Host stand-in for the mbedtls test certificates (none are used)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
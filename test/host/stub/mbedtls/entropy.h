@@ -0,0 +1,16 @@
+/**
+ * @file    entropy.h
+ * @brief   Host stand-in for the mbedtls entropy pool (random bytes of OpenSSL)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+typedef struct {
+    int unused;
+} mbedtls_entropy_context;
+
+void mbedtls_entropy_init(mbedtls_entropy_context *ctx);
+int mbedtls_entropy_func(void *data, unsigned char *output, size_t len);
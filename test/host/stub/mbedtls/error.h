@@ -0,0 +1,7 @@
+/**
+ * @file    error.h
+ * @brief   Host stand-in for the mbedtls error strings (errors are logged as codes)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
@@ -0,0 +1,7 @@
+/**
+ * @file    esp_debug.h
+ * @brief   Host stand-in for the ESP-IDF mbedtls debug hooks (debug output is not enabled)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
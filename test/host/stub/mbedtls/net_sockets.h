@@ -0,0 +1,33 @@
+/**
+ * @file    net_sockets.h
+ * @brief   Host stand-in for the mbedtls network layer (POSIX sockets, same return codes as mbedtls 2.28)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_ERR_NET_SOCKET_FAILED -0x0042
+#define MBEDTLS_ERR_NET_INVALID_CONTEXT -0x0045
+#define MBEDTLS_ERR_NET_POLL_FAILED -0x0047
+#define MBEDTLS_ERR_NET_RECV_FAILED -0x004C
+#define MBEDTLS_ERR_NET_SEND_FAILED -0x004E
+#define MBEDTLS_ERR_NET_CONN_RESET -0x0050
+
+#define MBEDTLS_NET_POLL_READ 1
+#define MBEDTLS_NET_POLL_WRITE 2
+
+typedef struct {
+    int fd;                 // Socket (-1 if closed)
+} mbedtls_net_context;
+
+void mbedtls_net_init(mbedtls_net_context *ctx);
+void mbedtls_net_free(mbedtls_net_context *ctx);
+int mbedtls_net_set_block(mbedtls_net_context *ctx);
+int mbedtls_net_set_nonblock(mbedtls_net_context *ctx);
+int mbedtls_net_poll(mbedtls_net_context *ctx, uint32_t rw, uint32_t timeout);
+int mbedtls_net_send(void *ctx, const unsigned char *buf, size_t len);
+int mbedtls_net_recv(void *ctx, unsigned char *buf, size_t len);
+int mbedtls_net_recv_timeout(void *ctx, unsigned char *buf, size_t len, uint32_t timeout);
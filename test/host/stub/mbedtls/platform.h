@@ -0,0 +1,17 @@
+/**
+ * @file    platform.h
+ * @brief   Host stand-in for the mbedtls platform layer: the allocator installed at runtime is called by the tests
+ *          through mbedtls_calloc and mbedtls_free, as the library does
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#define MBEDTLS_PLATFORM_MEMORY
+
+extern void *(*mbedtls_calloc)(size_t n, size_t size);
+extern void (*mbedtls_free)(void *ptr);
+
+int mbedtls_platform_set_calloc_free(void *(*calloc_func)(size_t, size_t), void (*free_func)(void *));
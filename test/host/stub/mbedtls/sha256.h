@@ -0,0 +1,11 @@
+/**
+ * @file    sha256.h
+ * @brief   Host stand-in for the mbedtls one-shot SHA-256 (computed by OpenSSL)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+int mbedtls_sha256_ret(const unsigned char *input, size_t ilen, unsigned char output[32], int is224);
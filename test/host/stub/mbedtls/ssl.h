@@ -0,0 +1,151 @@
+/**
+ * @file    ssl.h
+ * @brief   Host stand-in for the mbedtls 2.28 SSL/TLS client API on top of the OpenSSL of the development machine
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ *
+ * TLS 1.2 only (as mbedtls 2.28), certificates verified against the CA chain of the configuration and the hostname,
+ * sessions resumed by ID or ticket. Records go through the bio callbacks of mbedtls_ssl_set_bio, so read timeouts,
+ * EOF and send errors surface with the codes of mbedtls.
+ *
+ * OpenSSL runs the whole handshake in the step that leaves MBEDTLS_SSL_CLIENT_HELLO. A full handshake then passes
+ * through MBEDTLS_SSL_SERVER_CERTIFICATE, a resumed one goes straight to MBEDTLS_SSL_HANDSHAKE_OVER, which is what a
+ * caller stepping through mbedtls observes. Custom verification callbacks and the max fragment length extension are
+ * not available (MBEDTLS_SSL_MAX_FRAGMENT_LENGTH is left undefined).
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/x509_crt.h"
+
+#define MBEDTLS_SSL_SESSION_TICKETS
+
+#define MBEDTLS_ERR_SSL_BAD_INPUT_DATA -0x7100
+#define MBEDTLS_ERR_SSL_CONN_EOF -0x7280
+#define MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE -0x7780
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY -0x7880
+#define MBEDTLS_ERR_SSL_ALLOC_FAILED -0x7F00
+#define MBEDTLS_ERR_SSL_TIMEOUT -0x6800
+#define MBEDTLS_ERR_SSL_WANT_WRITE -0x6880
+#define MBEDTLS_ERR_SSL_WANT_READ -0x6900
+
+#define MBEDTLS_SSL_IS_CLIENT 0
+#define MBEDTLS_SSL_TRANSPORT_STREAM 0
+#define MBEDTLS_SSL_PRESET_DEFAULT 0
+
+#define MBEDTLS_SSL_VERIFY_NONE 0
+#define MBEDTLS_SSL_VERIFY_OPTIONAL 1
+#define MBEDTLS_SSL_VERIFY_REQUIRED 2
+
+#define MBEDTLS_SSL_SESSION_TICKETS_DISABLED 0
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED 1
+
+#define MBEDTLS_SSL_MAX_FRAG_LEN_NONE 0
+#define MBEDTLS_SSL_MAX_FRAG_LEN_512 1
+#define MBEDTLS_SSL_MAX_FRAG_LEN_1024 2
+#define MBEDTLS_SSL_MAX_FRAG_LEN_2048 3
+#define MBEDTLS_SSL_MAX_FRAG_LEN_4096 4
+
+/* Ciphersuites (ssl_ciphersuites.h) */
+#define MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256 0xC02B
+#define MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384 0xC02C
+#define MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 0xC02F
+#define MBEDTLS_TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384 0xC030
+
+/* Curves (ecp.h) */
+typedef enum {
+    MBEDTLS_ECP_DP_NONE = 0,
+    MBEDTLS_ECP_DP_SECP192R1,
+    MBEDTLS_ECP_DP_SECP224R1,
+    MBEDTLS_ECP_DP_SECP256R1,
+    MBEDTLS_ECP_DP_SECP384R1,
+    MBEDTLS_ECP_DP_SECP521R1,
+} mbedtls_ecp_group_id;
+
+typedef enum {
+    MBEDTLS_SSL_HELLO_REQUEST,
+    MBEDTLS_SSL_CLIENT_HELLO,
+    MBEDTLS_SSL_SERVER_HELLO,
+    MBEDTLS_SSL_SERVER_CERTIFICATE,
+    MBEDTLS_SSL_SERVER_KEY_EXCHANGE,
+    MBEDTLS_SSL_CERTIFICATE_REQUEST,
+    MBEDTLS_SSL_SERVER_HELLO_DONE,
+    MBEDTLS_SSL_CLIENT_CERTIFICATE,
+    MBEDTLS_SSL_CLIENT_KEY_EXCHANGE,
+    MBEDTLS_SSL_CERTIFICATE_VERIFY,
+    MBEDTLS_SSL_CLIENT_CHANGE_CIPHER_SPEC,
+    MBEDTLS_SSL_CLIENT_FINISHED,
+    MBEDTLS_SSL_SERVER_CHANGE_CIPHER_SPEC,
+    MBEDTLS_SSL_SERVER_FINISHED,
+    MBEDTLS_SSL_FLUSH_BUFFERS,
+    MBEDTLS_SSL_HANDSHAKE_WRAPUP,
+    MBEDTLS_SSL_HANDSHAKE_OVER,
+} mbedtls_ssl_states;
+
+typedef int mbedtls_ssl_send_t(void *ctx, const unsigned char *buf, size_t len);
+typedef int mbedtls_ssl_recv_t(void *ctx, unsigned char *buf, size_t len);
+typedef int mbedtls_ssl_recv_timeout_t(void *ctx, unsigned char *buf, size_t len, uint32_t timeout);
+
+struct ssl_ctx_st;
+struct ssl_st;
+struct ssl_session_st;
+
+typedef struct {
+    struct ssl_session_st *handle;      // OpenSSL session (NULL if none)
+} mbedtls_ssl_session;
+
+typedef struct {
+    struct ssl_ctx_st *handle;          // OpenSSL context shared by the connections
+    int authmode;
+    uint32_t read_timeout;              // Timeout of each read in ms (0 to wait forever)
+    mbedtls_x509_crt *ca_chain;
+    int (*f_rng)(void *, unsigned char *, size_t);
+    void *p_rng;
+} mbedtls_ssl_config;
+
+typedef struct {
+    int state;                          // mbedtls_ssl_states
+    const mbedtls_ssl_config *conf;
+    struct ssl_st *handle;              // OpenSSL connection (NULL before mbedtls_ssl_setup)
+    char *hostname;
+    uint32_t verify_result;             // MBEDTLS_X509_BADCERT_* flags of the server certificate
+    void *p_bio;
+    mbedtls_ssl_send_t *f_send;
+    mbedtls_ssl_recv_t *f_recv;
+    mbedtls_ssl_recv_timeout_t *f_recv_timeout;
+    int bio_err;                        // Error returned by a bio callback during the last operation (0 if none)
+    int bio_eof;                        // The bio callback reported the end of the stream
+} mbedtls_ssl_context;
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config *conf);
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config *conf, int endpoint, int transport, int preset);
+void mbedtls_ssl_config_free(mbedtls_ssl_config *conf);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config *conf, int authmode);
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config *conf, mbedtls_x509_crt *ca_chain, void *ca_crl);
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config *conf, int (*f_rng)(void *, unsigned char *, size_t), void *p_rng);
+void mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config *conf, uint32_t timeout);
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config *conf, int use_tickets);
+void mbedtls_ssl_conf_ciphersuites(mbedtls_ssl_config *conf, const int *ciphersuites);
+void mbedtls_ssl_conf_curves(mbedtls_ssl_config *conf, const mbedtls_ecp_group_id *curves);
+
+void mbedtls_ssl_init(mbedtls_ssl_context *ssl);
+int mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config *conf);
+int mbedtls_ssl_session_reset(mbedtls_ssl_context *ssl);
+void mbedtls_ssl_free(mbedtls_ssl_context *ssl);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context *ssl, const char *hostname);
+void mbedtls_ssl_set_bio(mbedtls_ssl_context *ssl, void *p_bio, mbedtls_ssl_send_t *f_send, mbedtls_ssl_recv_t *f_recv,
+                         mbedtls_ssl_recv_timeout_t *f_recv_timeout);
+int mbedtls_ssl_handshake_step(mbedtls_ssl_context *ssl);
+int mbedtls_ssl_read(mbedtls_ssl_context *ssl, unsigned char *buf, size_t len);
+int mbedtls_ssl_write(mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len);
+int mbedtls_ssl_close_notify(mbedtls_ssl_context *ssl);
+uint32_t mbedtls_ssl_get_verify_result(const mbedtls_ssl_context *ssl);
+const char *mbedtls_ssl_get_ciphersuite(const mbedtls_ssl_context *ssl);
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session *session);
+void mbedtls_ssl_session_free(mbedtls_ssl_session *session);
+int mbedtls_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *session);
+int mbedtls_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session);
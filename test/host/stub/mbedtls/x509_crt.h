@@ -0,0 +1,47 @@
+/**
+ * @file    x509_crt.h
+ * @brief   Host stand-in for the mbedtls X.509 certificate chain (the raw certificates and their public keys only,
+ *          parsed by OpenSSL) and the verification flags of mbedtls 2.28
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_ERR_X509_INVALID_FORMAT -0x2180
+#define MBEDTLS_ERR_X509_CERT_VERIFY_FAILED -0x2700
+#define MBEDTLS_ERR_X509_ALLOC_FAILED -0x2880
+
+#define MBEDTLS_X509_BADCERT_EXPIRED 0x01
+#define MBEDTLS_X509_BADCERT_REVOKED 0x02
+#define MBEDTLS_X509_BADCERT_CN_MISMATCH 0x04
+#define MBEDTLS_X509_BADCERT_NOT_TRUSTED 0x08
+#define MBEDTLS_X509_BADCERT_MISSING 0x40
+#define MBEDTLS_X509_BADCERT_SKIP_VERIFY 0x80
+#define MBEDTLS_X509_BADCERT_OTHER 0x0100
+#define MBEDTLS_X509_BADCERT_FUTURE 0x0200
+#define MBEDTLS_X509_BADCERT_KEY_USAGE 0x0800
+#define MBEDTLS_X509_BADCERT_EXT_KEY_USAGE 0x1000
+#define MBEDTLS_X509_BADCERT_NS_CERT_TYPE 0x2000
+#define MBEDTLS_X509_BADCERT_BAD_MD 0x4000
+#define MBEDTLS_X509_BADCERT_BAD_PK 0x8000
+#define MBEDTLS_X509_BADCERT_BAD_KEY 0x010000
+
+typedef struct {
+    int tag;
+    size_t len;
+    unsigned char *p;
+} mbedtls_x509_buf;
+
+typedef struct mbedtls_x509_crt {
+    mbedtls_x509_buf raw;               // DER of the whole certificate
+    mbedtls_x509_buf pk_raw;            // DER of the SubjectPublicKeyInfo
+    struct mbedtls_x509_crt *next;
+} mbedtls_x509_crt;
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt *crt);
+void mbedtls_x509_crt_free(mbedtls_x509_crt *crt);
+int mbedtls_x509_crt_parse(mbedtls_x509_crt *chain, const unsigned char *buf, size_t buflen);
+int mbedtls_x509_crt_verify_info(char *buf, size_t size, const char *prefix, uint32_t flags);
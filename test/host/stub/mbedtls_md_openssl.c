@@ -0,0 +1,34 @@
+/**
+ * @file    mbedtls_md_openssl.c
+ * @brief   Host implementation of the mbedtls SHA-256 and HMAC-SHA256 on top of the OpenSSL of the development machine
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "mbedtls/md.h"
+#include "mbedtls/sha256.h"
+
+struct mbedtls_md_info_t {
+    mbedtls_md_type_t type;
+};
+
+static const mbedtls_md_info_t sha256_info = {.type = MBEDTLS_MD_SHA256};
+
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t md_type) {
+    return (md_type == MBEDTLS_MD_SHA256) ? &sha256_info : NULL;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t *md_info, const unsigned char *key, size_t keylen,
+                    const unsigned char *input, size_t ilen, unsigned char *output) {
+    unsigned int len = 0;
+    if (md_info == NULL || HMAC(EVP_sha256(), key, (int)keylen, input, ilen, output, &len) == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+int mbedtls_sha256_ret(const unsigned char *input, size_t ilen, unsigned char output[32], int is224) {
+    return EVP_Digest(input, ilen, output, NULL, is224 ? EVP_sha224() : EVP_sha256(), NULL) ? 0 : -1;
+}
@@ -0,0 +1,18 @@
+/**
+ * @file    mbedtls_platform.c
+ * @brief   Host implementation of the mbedtls platform allocator hooks
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <stdlib.h>
+
+#include "mbedtls/platform.h"
+
+void *(*mbedtls_calloc)(size_t n, size_t size) = calloc;
+void (*mbedtls_free)(void *ptr) = free;
+
+int mbedtls_platform_set_calloc_free(void *(*calloc_func)(size_t, size_t), void (*free_func)(void *)) {
+    mbedtls_calloc = calloc_func;
+    mbedtls_free = free_func;
+    return 0;
+}
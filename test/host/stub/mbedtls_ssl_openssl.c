@@ -0,0 +1,587 @@
+/**
+ * @file    mbedtls_ssl_openssl.c
+ * @brief   Host implementation of the mbedtls 2.28 network layer, SSL/TLS client, X.509 parser and random number
+ *          generator on top of the POSIX sockets and the OpenSSL of the development machine
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+
+static BIO_METHOD *bio_method = NULL;   // Bio forwarding the records to the callbacks of mbedtls_ssl_set_bio
+
+/* Network layer */
+
+void mbedtls_net_init(mbedtls_net_context *ctx) {
+    ctx->fd = -1;
+}
+
+void mbedtls_net_free(mbedtls_net_context *ctx) {
+    if (ctx->fd >= 0) {
+        shutdown(ctx->fd, SHUT_RDWR);
+        close(ctx->fd);
+    }
+    ctx->fd = -1;
+}
+
+int mbedtls_net_set_block(mbedtls_net_context *ctx) {
+    return fcntl(ctx->fd, F_SETFL, fcntl(ctx->fd, F_GETFL) & ~O_NONBLOCK);
+}
+
+int mbedtls_net_set_nonblock(mbedtls_net_context *ctx) {
+    return fcntl(ctx->fd, F_SETFL, fcntl(ctx->fd, F_GETFL) | O_NONBLOCK);
+}
+
+/**
+ * @return true if the last call failed only because the non-blocking socket was not ready.
+ */
+static bool net_would_block(const mbedtls_net_context *ctx) {
+    return (fcntl(ctx->fd, F_GETFL) & O_NONBLOCK) != 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+int mbedtls_net_poll(mbedtls_net_context *ctx, uint32_t rw, uint32_t timeout) {
+    struct timeval tv = {.tv_sec = timeout / 1000, .tv_usec = (timeout % 1000) * 1000};
+    fd_set read_fds, write_fds;
+    int ret;
+
+    if (ctx->fd < 0) {
+        return MBEDTLS_ERR_NET_INVALID_CONTEXT;
+    }
+    FD_ZERO(&read_fds);
+    FD_ZERO(&write_fds);
+    if (rw & MBEDTLS_NET_POLL_READ) {
+        FD_SET(ctx->fd, &read_fds);
+    }
+    if (rw & MBEDTLS_NET_POLL_WRITE) {
+        FD_SET(ctx->fd, &write_fds);
+    }
+    do {
+        ret = select(ctx->fd + 1, &read_fds, &write_fds, NULL, (timeout == (uint32_t)-1) ? NULL : &tv);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0) {
+        return MBEDTLS_ERR_NET_POLL_FAILED;
+    }
+    return (FD_ISSET(ctx->fd, &read_fds) ? MBEDTLS_NET_POLL_READ : 0) |
+           (FD_ISSET(ctx->fd, &write_fds) ? MBEDTLS_NET_POLL_WRITE : 0);
+}
+
+int mbedtls_net_send(void *ctx, const unsigned char *buf, size_t len) {
+    mbedtls_net_context *net = (mbedtls_net_context *)ctx;
+
+    if (net->fd < 0) {
+        return MBEDTLS_ERR_NET_INVALID_CONTEXT;
+    }
+    ssize_t ret = send(net->fd, buf, len, MSG_NOSIGNAL);     // lwIP has no SIGPIPE
+    if (ret < 0) {
+        if (net_would_block(net) || errno == EINTR) {
+            return MBEDTLS_ERR_SSL_WANT_WRITE;
+        }
+        return (errno == EPIPE || errno == ECONNRESET) ? MBEDTLS_ERR_NET_CONN_RESET : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return (int)ret;
+}
+
+int mbedtls_net_recv(void *ctx, unsigned char *buf, size_t len) {
+    mbedtls_net_context *net = (mbedtls_net_context *)ctx;
+
+    if (net->fd < 0) {
+        return MBEDTLS_ERR_NET_INVALID_CONTEXT;
+    }
+    ssize_t ret = recv(net->fd, buf, len, 0);
+    if (ret < 0) {
+        if (net_would_block(net) || errno == EINTR) {
+            return MBEDTLS_ERR_SSL_WANT_READ;
+        }
+        return (errno == EPIPE || errno == ECONNRESET) ? MBEDTLS_ERR_NET_CONN_RESET : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    return (int)ret;
+}
+
+int mbedtls_net_recv_timeout(void *ctx, unsigned char *buf, size_t len, uint32_t timeout) {
+    int ret = mbedtls_net_poll((mbedtls_net_context *)ctx, MBEDTLS_NET_POLL_READ, (timeout == 0) ? (uint32_t)-1 : timeout);
+
+    if (ret == 0) {
+        return MBEDTLS_ERR_SSL_TIMEOUT;
+    } else if (ret < 0) {
+        return (ret == MBEDTLS_ERR_NET_POLL_FAILED) ? MBEDTLS_ERR_NET_RECV_FAILED : ret;
+    }
+    return mbedtls_net_recv(ctx, buf, len);
+}
+
+/* Random number generator */
+
+void mbedtls_entropy_init(mbedtls_entropy_context *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_entropy_func(void *data, unsigned char *output, size_t len) {
+    return (RAND_bytes(output, (int)len) == 1) ? 0 : -1;
+}
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context *ctx, int (*f_entropy)(void *, unsigned char *, size_t),
+                          void *p_entropy, const unsigned char *custom, size_t len) {
+    unsigned char seed[32];
+
+    if (f_entropy(p_entropy, seed, sizeof(seed)) != 0) {
+        return -0x0034;     // MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED
+    }
+    ctx->seeded = 1;
+    return 0;
+}
+
+int mbedtls_ctr_drbg_random(void *p_rng, unsigned char *output, size_t output_len) {
+    return (RAND_bytes(output, (int)output_len) == 1) ? 0 : -0x0034;
+}
+
+/* X.509 certificates */
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt *crt) {
+    memset(crt, 0, sizeof(*crt));
+}
+
+void mbedtls_x509_crt_free(mbedtls_x509_crt *crt) {
+    mbedtls_x509_crt *next = crt->next;
+
+    OPENSSL_free(crt->raw.p);
+    OPENSSL_free(crt->pk_raw.p);
+    memset(crt, 0, sizeof(*crt));
+    while (next != NULL) {
+        mbedtls_x509_crt *node = next;
+        next = node->next;
+        OPENSSL_free(node->raw.p);
+        OPENSSL_free(node->pk_raw.p);
+        free(node);
+    }
+}
+
+int mbedtls_x509_crt_parse(mbedtls_x509_crt *chain, const unsigned char *buf, size_t buflen) {
+    BIO *bio = BIO_new_mem_buf(buf, (int)strnlen((const char *)buf, buflen));
+    X509 *x509;
+    int parsed = 0, ret = 0;
+
+    if (bio == NULL) {
+        return MBEDTLS_ERR_X509_ALLOC_FAILED;
+    }
+    while (ret == 0 && (x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL)) != NULL) {
+        mbedtls_x509_crt *crt = chain;
+        while (crt->raw.p != NULL && crt->next != NULL) {
+            crt = crt->next;
+        }
+        if (crt->raw.p != NULL && (crt = crt->next = calloc(1, sizeof(*crt))) == NULL) {
+            ret = MBEDTLS_ERR_X509_ALLOC_FAILED;
+        } else {
+            int raw_len = i2d_X509(x509, &crt->raw.p);
+            int pk_len = i2d_X509_PUBKEY(X509_get_X509_PUBKEY(x509), &crt->pk_raw.p);
+            crt->raw.len = (raw_len > 0) ? (size_t)raw_len : 0;
+            crt->pk_raw.len = (pk_len > 0) ? (size_t)pk_len : 0;
+            ret = (raw_len > 0 && pk_len > 0) ? 0 : MBEDTLS_ERR_X509_ALLOC_FAILED;
+            parsed++;
+        }
+        X509_free(x509);
+    }
+    ERR_clear_error();     // End of the PEM data
+    BIO_free(bio);
+    return (ret == 0 && parsed == 0) ? MBEDTLS_ERR_X509_INVALID_FORMAT : ret;
+}
+
+int mbedtls_x509_crt_verify_info(char *buf, size_t size, const char *prefix, uint32_t flags) {
+    static const struct {
+        uint32_t flag;
+        const char *text;
+    } INFO[] = {
+        {MBEDTLS_X509_BADCERT_EXPIRED, "The certificate validity has expired"},
+        {MBEDTLS_X509_BADCERT_CN_MISMATCH, "The certificate Common Name (CN) does not match with the expected CN"},
+        {MBEDTLS_X509_BADCERT_NOT_TRUSTED, "The certificate is not correctly signed by the trusted CA"},
+        {MBEDTLS_X509_BADCERT_FUTURE, "The certificate validity starts in the future"},
+        {MBEDTLS_X509_BADCERT_OTHER, "Other reason (can be used by verify callback)"},
+    };
+    size_t len = 0;
+
+    buf[0] = '\0';
+    for (size_t i = 0; i < sizeof(INFO) / sizeof(INFO[0]) && len < size; i++) {
+        if (flags & INFO[i].flag) {
+            len += snprintf(buf + len, size - len, "%s%s\n", prefix, INFO[i].text);
+        }
+    }
+    return (int)((len < size) ? len : size - 1);
+}
+
+/**
+ * @return Flags of mbedtls for the result of the OpenSSL certificate verification.
+ */
+static uint32_t verify_flags(long result) {
+    switch (result) {
+        case X509_V_OK:
+            return 0;
+        case X509_V_ERR_CERT_HAS_EXPIRED:
+            return MBEDTLS_X509_BADCERT_EXPIRED;
+        case X509_V_ERR_CERT_NOT_YET_VALID:
+            return MBEDTLS_X509_BADCERT_FUTURE;
+        case X509_V_ERR_HOSTNAME_MISMATCH:
+            return MBEDTLS_X509_BADCERT_CN_MISMATCH;
+        default:
+            return MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+    }
+}
+
+/* SSL/TLS configuration */
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config *conf) {
+    memset(conf, 0, sizeof(*conf));
+}
+
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config *conf, int endpoint, int transport, int preset) {
+    if (endpoint != MBEDTLS_SSL_IS_CLIENT || transport != MBEDTLS_SSL_TRANSPORT_STREAM) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    } else if ((conf->handle = SSL_CTX_new(TLS_client_method())) == NULL) {
+        return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    }
+    SSL_CTX_set_min_proto_version(conf->handle, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(conf->handle, TLS1_2_VERSION);
+    mbedtls_ssl_conf_authmode(conf, MBEDTLS_SSL_VERIFY_REQUIRED);  // Default of a client
+    return 0;
+}
+
+void mbedtls_ssl_config_free(mbedtls_ssl_config *conf) {
+    SSL_CTX_free(conf->handle);
+    memset(conf, 0, sizeof(*conf));
+}
+
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config *conf, int authmode) {
+    conf->authmode = authmode;
+    SSL_CTX_set_verify(conf->handle, (authmode == MBEDTLS_SSL_VERIFY_REQUIRED) ? SSL_VERIFY_PEER : SSL_VERIFY_NONE,
+                       NULL);
+}
+
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config *conf, mbedtls_x509_crt *ca_chain, void *ca_crl) {
+    X509_STORE *store = X509_STORE_new();
+
+    conf->ca_chain = ca_chain;
+    for (const mbedtls_x509_crt *crt = ca_chain; crt != NULL && crt->raw.p != NULL; crt = crt->next) {
+        const unsigned char *p = crt->raw.p;
+        X509 *x509 = d2i_X509(NULL, &p, (long)crt->raw.len);
+        if (x509 != NULL) {
+            X509_STORE_add_cert(store, x509);
+            X509_free(x509);
+        }
+    }
+    SSL_CTX_set_cert_store(conf->handle, store);
+}
+
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config *conf, int (*f_rng)(void *, unsigned char *, size_t), void *p_rng) {
+    conf->f_rng = f_rng;
+    conf->p_rng = p_rng;
+}
+
+void mbedtls_ssl_conf_read_timeout(mbedtls_ssl_config *conf, uint32_t timeout) {
+    conf->read_timeout = timeout;
+}
+
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config *conf, int use_tickets) {
+    if (use_tickets == MBEDTLS_SSL_SESSION_TICKETS_ENABLED) {
+        SSL_CTX_clear_options(conf->handle, SSL_OP_NO_TICKET);
+    } else {
+        SSL_CTX_set_options(conf->handle, SSL_OP_NO_TICKET);
+    }
+}
+
+void mbedtls_ssl_conf_ciphersuites(mbedtls_ssl_config *conf, const int *ciphersuites) {
+    STACK_OF(SSL_CIPHER) *available = SSL_CTX_get_ciphers(conf->handle);
+    char list[512] = "";
+    size_t len = 0;
+
+    for (const int *id = ciphersuites; *id != 0; id++) {
+        for (int i = 0; i < sk_SSL_CIPHER_num(available); i++) {
+            const SSL_CIPHER *cipher = sk_SSL_CIPHER_value(available, i);
+            if (SSL_CIPHER_get_protocol_id(cipher) == (uint16_t)*id && len < sizeof(list)) {
+                len += snprintf(list + len, sizeof(list) - len, "%s%s", (len > 0) ? ":" : "",
+                                SSL_CIPHER_get_name(cipher));
+            }
+        }
+    }
+    SSL_CTX_set_cipher_list(conf->handle, list);
+}
+
+void mbedtls_ssl_conf_curves(mbedtls_ssl_config *conf, const mbedtls_ecp_group_id *curves) {
+    static const int NIDS[] = {
+        [MBEDTLS_ECP_DP_SECP192R1] = NID_X9_62_prime192v1,
+        [MBEDTLS_ECP_DP_SECP224R1] = NID_secp224r1,
+        [MBEDTLS_ECP_DP_SECP256R1] = NID_X9_62_prime256v1,
+        [MBEDTLS_ECP_DP_SECP384R1] = NID_secp384r1,
+        [MBEDTLS_ECP_DP_SECP521R1] = NID_secp521r1,
+    };
+    int groups[sizeof(NIDS) / sizeof(NIDS[0])];
+    size_t count = 0;
+
+    for (const mbedtls_ecp_group_id *c = curves; *c != MBEDTLS_ECP_DP_NONE && count < sizeof(groups) / sizeof(groups[0]);
+         c++) {
+        groups[count++] = NIDS[*c];
+    }
+    SSL_CTX_set1_groups(conf->handle, groups, count);
+}
+
+/* SSL/TLS connection */
+
+static int bio_write(BIO *bio, const char *data, int len) {
+    mbedtls_ssl_context *ssl = (mbedtls_ssl_context *)BIO_get_data(bio);
+    int ret = ssl->f_send(ssl->p_bio, (const unsigned char *)data, (size_t)len);
+
+    BIO_clear_retry_flags(bio);
+    if (ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        BIO_set_retry_write(bio);
+        return -1;
+    } else if (ret < 0) {
+        ssl->bio_err = ret;
+        return -1;
+    }
+    return ret;
+}
+
+static int bio_read(BIO *bio, char *data, int len) {
+    mbedtls_ssl_context *ssl = (mbedtls_ssl_context *)BIO_get_data(bio);
+    int ret = (ssl->f_recv_timeout != NULL)
+                  ? ssl->f_recv_timeout(ssl->p_bio, (unsigned char *)data, (size_t)len, ssl->conf->read_timeout)
+                  : ssl->f_recv(ssl->p_bio, (unsigned char *)data, (size_t)len);
+
+    BIO_clear_retry_flags(bio);
+    if (ret == 0) {
+        ssl->bio_eof = 1;
+    } else if (ret == MBEDTLS_ERR_SSL_WANT_READ) {
+        BIO_set_retry_read(bio);
+        return -1;
+    } else if (ret < 0) {
+        ssl->bio_err = ret;
+        return -1;
+    }
+    return ret;
+}
+
+static long bio_ctrl(BIO *bio, int cmd, long num, void *ptr) {
+    return (cmd == BIO_CTRL_FLUSH) ? 1 : 0;
+}
+
+/**
+ * @brief Create the OpenSSL connection of the context (again after a reset), with the hostname and the bio.
+ */
+static int ssl_new(mbedtls_ssl_context *ssl) {
+    if (bio_method == NULL) {
+        bio_method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "mbedtls bio");
+        BIO_meth_set_write(bio_method, bio_write);
+        BIO_meth_set_read(bio_method, bio_read);
+        BIO_meth_set_ctrl(bio_method, bio_ctrl);
+    }
+
+    BIO *bio = BIO_new(bio_method);
+    if (bio == NULL || (ssl->handle = SSL_new(ssl->conf->handle)) == NULL) {
+        BIO_free(bio);
+        return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    }
+    BIO_set_data(bio, ssl);
+    BIO_set_init(bio, 1);
+    SSL_set_bio(ssl->handle, bio, bio);
+    if (ssl->hostname != NULL) {
+        SSL_set_tlsext_host_name(ssl->handle, ssl->hostname);
+        SSL_set1_host(ssl->handle, ssl->hostname);
+    }
+    ssl->state = MBEDTLS_SSL_HELLO_REQUEST;
+    ssl->verify_result = UINT32_MAX;    // No session yet
+    return 0;
+}
+
+/**
+ * @brief Clear the bio errors before an OpenSSL call.
+ */
+static void ssl_begin(mbedtls_ssl_context *ssl) {
+    ssl->bio_err = 0;
+    ssl->bio_eof = 0;
+    ERR_clear_error();
+}
+
+/**
+ * @return Error code of mbedtls for a failed OpenSSL call.
+ */
+static int ssl_error(mbedtls_ssl_context *ssl, int ret) {
+    int err = SSL_get_error(ssl->handle, ret);
+
+    ERR_clear_error();
+    if (ssl->bio_err != 0) {
+        return ssl->bio_err;
+    } else if (err == SSL_ERROR_WANT_READ) {
+        return MBEDTLS_ERR_SSL_WANT_READ;
+    } else if (err == SSL_ERROR_WANT_WRITE) {
+        return MBEDTLS_ERR_SSL_WANT_WRITE;
+    } else if (err == SSL_ERROR_ZERO_RETURN) {
+        return MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY;
+    } else if (ssl->bio_eof) {
+        return MBEDTLS_ERR_SSL_CONN_EOF;
+    }
+    return MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE;
+}
+
+void mbedtls_ssl_init(mbedtls_ssl_context *ssl) {
+    memset(ssl, 0, sizeof(*ssl));
+    ssl->verify_result = UINT32_MAX;
+}
+
+int mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config *conf) {
+    if (conf->handle == NULL) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    ssl->conf = conf;
+    return ssl_new(ssl);
+}
+
+int mbedtls_ssl_session_reset(mbedtls_ssl_context *ssl) {
+    if (ssl->conf == NULL) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    SSL_free(ssl->handle);
+    ssl->handle = NULL;
+    return ssl_new(ssl);
+}
+
+void mbedtls_ssl_free(mbedtls_ssl_context *ssl) {
+    SSL_free(ssl->handle);
+    free(ssl->hostname);
+    memset(ssl, 0, sizeof(*ssl));
+}
+
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context *ssl, const char *hostname) {
+    free(ssl->hostname);
+    if ((ssl->hostname = strdup(hostname)) == NULL) {
+        return MBEDTLS_ERR_SSL_ALLOC_FAILED;
+    } else if (ssl->handle != NULL) {
+        SSL_set_tlsext_host_name(ssl->handle, ssl->hostname);
+        SSL_set1_host(ssl->handle, ssl->hostname);
+    }
+    return 0;
+}
+
+void mbedtls_ssl_set_bio(mbedtls_ssl_context *ssl, void *p_bio, mbedtls_ssl_send_t *f_send, mbedtls_ssl_recv_t *f_recv,
+                         mbedtls_ssl_recv_timeout_t *f_recv_timeout) {
+    ssl->p_bio = p_bio;
+    ssl->f_send = f_send;
+    ssl->f_recv = f_recv;
+    ssl->f_recv_timeout = f_recv_timeout;
+}
+
+int mbedtls_ssl_handshake_step(mbedtls_ssl_context *ssl) {
+    int ret;
+
+    if (ssl->handle == NULL || ssl->f_send == NULL || (ssl->f_recv == NULL && ssl->f_recv_timeout == NULL)) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+
+    switch (ssl->state) {
+        case MBEDTLS_SSL_HELLO_REQUEST:
+            ssl->state = MBEDTLS_SSL_CLIENT_HELLO;
+            return 0;
+        case MBEDTLS_SSL_CLIENT_HELLO:
+            ssl_begin(ssl);
+            ret = SSL_connect(ssl->handle);
+            ssl->verify_result = verify_flags(SSL_get_verify_result(ssl->handle));
+            if (ret != 1) {
+                ret = ssl_error(ssl, ret);
+                if (ret == MBEDTLS_ERR_SSL_FATAL_ALERT_MESSAGE && ssl->verify_result != 0 &&
+                    ssl->conf->authmode == MBEDTLS_SSL_VERIFY_REQUIRED) {
+                    return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+                }
+                return ret;
+            }
+            ssl->state = SSL_session_reused(ssl->handle) ? MBEDTLS_SSL_HANDSHAKE_OVER : MBEDTLS_SSL_SERVER_CERTIFICATE;
+            return 0;
+        case MBEDTLS_SSL_SERVER_CERTIFICATE:
+            ssl->state = MBEDTLS_SSL_HANDSHAKE_OVER;   // Certificate verified during SSL_connect
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+int mbedtls_ssl_read(mbedtls_ssl_context *ssl, unsigned char *buf, size_t len) {
+    int ret;
+
+    if (ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    ssl_begin(ssl);
+    ret = SSL_read(ssl->handle, buf, (int)len);
+    return (ret > 0) ? ret : ssl_error(ssl, ret);
+}
+
+int mbedtls_ssl_write(mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len) {
+    int ret;
+
+    if (ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    ssl_begin(ssl);
+    ret = SSL_write(ssl->handle, buf, (int)len);
+    return (ret > 0) ? ret : ssl_error(ssl, ret);
+}
+
+int mbedtls_ssl_close_notify(mbedtls_ssl_context *ssl) {
+    if (ssl->handle == NULL || ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+        return 0;
+    }
+    ssl_begin(ssl);
+    int ret = SSL_shutdown(ssl->handle);
+    return (ret >= 0) ? 0 : ssl_error(ssl, ret);
+}
+
+uint32_t mbedtls_ssl_get_verify_result(const mbedtls_ssl_context *ssl) {
+    return ssl->verify_result;
+}
+
+const char *mbedtls_ssl_get_ciphersuite(const mbedtls_ssl_context *ssl) {
+    return (ssl->handle != NULL) ? SSL_get_cipher_name(ssl->handle) : NULL;
+}
+
+/* Sessions */
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session *session) {
+    session->handle = NULL;
+}
+
+void mbedtls_ssl_session_free(mbedtls_ssl_session *session) {
+    SSL_SESSION_free(session->handle);
+    session->handle = NULL;
+}
+
+int mbedtls_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *session) {
+    if (ssl->handle == NULL || ssl->state != MBEDTLS_SSL_HANDSHAKE_OVER || session->handle != NULL) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    /* A copy, as in mbedtls: OpenSSL marks the session of a connection closed without close_notify unresumable */
+    session->handle = SSL_SESSION_dup(SSL_get0_session(ssl->handle));
+    return (session->handle != NULL) ? 0 : MBEDTLS_ERR_SSL_ALLOC_FAILED;
+}
+
+int mbedtls_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session) {
+    if (ssl->handle == NULL || session->handle == NULL || ssl->state != MBEDTLS_SSL_HELLO_REQUEST) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    return (SSL_set_session(ssl->handle, session->handle) == 1) ? 0 : MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file    miniz_zlib.c
+ * @brief   Host stand-in for tinfl_decompress on top of zlib (zlib keeps its own dictionary, so the circular
+ *          output window of the caller only receives the output)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "esp32/rom/miniz.h"
+
+void tinfl_host_init(tinfl_decompressor *r) {
+    if (r->started) {
+        inflateEnd((z_stream *)r->stream);
+    } else {
+        r->stream = calloc(1, sizeof(z_stream));
+    }
+    r->started = false;
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const uint8_t *in_buf_next, size_t *in_buf_size,
+                              uint8_t *out_buf_start, uint8_t *out_buf_next, size_t *out_buf_size,
+                              const uint32_t decomp_flags) {
+    z_stream *zs = (z_stream *)r->stream;
+
+    if (!r->started) {
+        memset(zs, 0, sizeof(*zs));
+        int bits = (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15;
+        if (inflateInit2(zs, bits) != Z_OK) {
+            return TINFL_STATUS_FAILED;
+        }
+        r->started = true;
+    }
+
+    zs->next_in = (Bytef *)in_buf_next;
+    zs->avail_in = (uInt)*in_buf_size;
+    zs->next_out = out_buf_next;
+    zs->avail_out = (uInt)*out_buf_size;
+    int ret = inflate(zs, Z_NO_FLUSH);
+    *in_buf_size -= zs->avail_in;
+    *out_buf_size -= zs->avail_out;
+
+    if (ret == Z_STREAM_END) {
+        return TINFL_STATUS_DONE;
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return TINFL_STATUS_FAILED;
+    }
+    return (zs->avail_out == 0) ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file    mqtt_client.h
+ * @brief   Host stand-in for the ESP-MQTT client: MQTT 3.1.1 over a plain POSIX socket (mqtt:// only), QoS 0
+ *          subscriptions, events delivered from the client thread, reconnect after HOST_MQTT_RECONNECT_MS
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_event.h"
+
+#define HOST_MQTT_RECONNECT_MS 100      // Delay before reconnecting (10 s by default on the device)
+#define HOST_MQTT_BUFFER_SIZE 1024      // Longer messages are delivered in fragments, as on the device
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+    MQTT_EVENT_BEFORE_CONNECT,
+} esp_mqtt_event_id_t;
+
+typedef enum {
+    MQTT_ERROR_TYPE_NONE = 0,
+    MQTT_ERROR_TYPE_TCP_TRANSPORT,
+    MQTT_ERROR_TYPE_CONNECTION_REFUSED,
+} esp_mqtt_error_type_t;
+
+typedef struct {
+    esp_mqtt_error_type_t error_type;
+} esp_mqtt_error_codes_t;
+
+typedef struct {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char *data;                         // Fragment of the message
+    int data_len;                       // Length of the fragment
+    int total_data_len;                 // Length of the whole message
+    int current_data_offset;            // Offset of the fragment in the message
+    char *topic;                        // Topic (first fragment only)
+    int topic_len;
+    int msg_id;                         // Packet ID (SUBSCRIBED)
+    esp_mqtt_error_codes_t *error_handle;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef struct {
+    const char *uri;                    // mqtt://host[:port]
+    int keepalive;                      // Seconds (120 if 0)
+    const char *cert_pem;               // Ignored (no TLS)
+    esp_err_t (*crt_bundle_attach)(void *conf);     // Ignored (no TLS)
+} esp_mqtt_client_config_t;
+
+/* Port used in place of the one of the URI if not 0 (host only: the test broker listens on an ephemeral port) */
+extern uint16_t host_mqtt_port;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *arg);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
+
+/**
+ * @return Packet ID of the SUBSCRIBE (reported by MQTT_EVENT_SUBSCRIBED), -1 if not connected.
+ */
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
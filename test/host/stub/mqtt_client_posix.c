@@ -0,0 +1,372 @@
+/**
+ * @file    mqtt_client_posix.c
+ * @brief   Host implementation of the ESP-MQTT client stand-in: MQTT 3.1.1 (CONNECT, SUBSCRIBE, PUBLISH at QoS 0)
+ *          over a POSIX socket, run by its own thread like the MQTT task of the device. No keep-alive pings are sent:
+ *          the test brokers do not enforce the keep-alive.
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "esp_crt_bundle.h"
+#include "mqtt_client.h"
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_SUBSCRIBE 0x82     // Reserved flags 0010
+#define MQTT_SUBACK 0x90
+#define MQTT_PACKET_MAX (64 * 1024)     // Longer packets close the connection
+
+struct esp_mqtt_client {
+    char host[64];
+    char port[8];
+    int keepalive_s;
+    esp_event_handler_t handler;
+    void *handler_arg;
+    pthread_t thread;
+    bool started;
+    volatile bool running;
+    pthread_mutex_t lock;           // Protects fd and next_id (subscribe is called from the event handler)
+    int fd;                         // Socket of the connection (-1 if not connected)
+    uint16_t next_id;               // Packet ID of the next SUBSCRIBE
+};
+
+uint16_t host_mqtt_port = 0;
+
+esp_err_t esp_crt_bundle_attach(void *conf) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static void mqtt_sleep_ms(int ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * @brief Deliver an event to the registered handler.
+ */
+static void mqtt_event(esp_mqtt_client_handle_t client, esp_mqtt_event_t *event) {
+    static esp_mqtt_error_codes_t no_error = {MQTT_ERROR_TYPE_NONE};
+
+    event->client = client;
+    if (event->error_handle == NULL) {
+        event->error_handle = &no_error;
+    }
+    if (client->handler != NULL) {
+        client->handler(client->handler_arg, "MQTT_EVENTS", event->event_id, event);
+    }
+}
+
+static void mqtt_error(esp_mqtt_client_handle_t client, esp_mqtt_error_type_t type) {
+    esp_mqtt_error_codes_t error = {type};
+    esp_mqtt_event_t event = {.event_id = MQTT_EVENT_ERROR, .error_handle = &error};
+    mqtt_event(client, &event);
+}
+
+/**
+ * @brief Write a whole packet (serialised with the socket lock held).
+ */
+static bool mqtt_send(esp_mqtt_client_handle_t client, const uint8_t *data, size_t len) {
+    bool ok = (client->fd >= 0);
+    for (size_t sent = 0; ok && sent < len;) {
+        ssize_t n = send(client->fd, data + sent, len - sent, MSG_NOSIGNAL);
+        ok = (n > 0);
+        sent += (n > 0) ? (size_t)n : 0;
+    }
+    return ok;
+}
+
+/**
+ * @brief Encode the remaining length of a packet.
+ *
+ * @return Number of bytes written (1 to 4).
+ */
+static size_t mqtt_put_length(uint8_t *out, size_t len) {
+    size_t n = 0;
+    do {
+        uint8_t byte = len % 128;
+        len /= 128;
+        out[n++] = byte | ((len > 0) ? 0x80 : 0);
+    } while (len > 0 && n < 4);
+    return n;
+}
+
+/**
+ * @brief Read exactly len bytes, giving up when the client is stopped.
+ */
+static bool mqtt_read(esp_mqtt_client_handle_t client, uint8_t *buf, size_t len) {
+    for (size_t got = 0; got < len;) {
+        struct pollfd pfd = {.fd = client->fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, 50);
+        if (!client->running || ready < 0) {
+            return false;
+        } else if (ready == 0) {
+            continue;
+        }
+        ssize_t n = recv(client->fd, buf + got, len - got, 0);
+        if (n <= 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+/**
+ * @brief Read the next packet.
+ *
+ * @return Packet (to be freed) or NULL if the connection is lost or the client stopped.
+ */
+static uint8_t *mqtt_read_packet(esp_mqtt_client_handle_t client, uint8_t *type, size_t *len) {
+    uint8_t byte;
+    size_t remaining = 0;
+
+    if (!mqtt_read(client, type, 1)) {
+        return NULL;
+    }
+    for (int shift = 0; shift < 28; shift += 7) {
+        if (!mqtt_read(client, &byte, 1)) {
+            return NULL;
+        }
+        remaining |= (size_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    if (remaining > MQTT_PACKET_MAX) {
+        return NULL;
+    }
+
+    uint8_t *packet = malloc(remaining + 1);
+    if (packet == NULL || !mqtt_read(client, packet, remaining)) {
+        free(packet);
+        return NULL;
+    }
+    *len = remaining;
+    return packet;
+}
+
+/**
+ * @brief Open the TCP connection, send CONNECT and wait for CONNACK.
+ */
+static bool mqtt_connect(esp_mqtt_client_handle_t client) {
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM}, *res = NULL;
+    char port[8];
+    int fd = -1;
+
+    if (host_mqtt_port != 0) {
+        snprintf(port, sizeof(port), "%u", (unsigned)host_mqtt_port);
+    } else {
+        snprintf(port, sizeof(port), "%s", client->port);
+    }
+    if (getaddrinfo(client->host, port, &hints, &res) == 0) {
+        fd = socket(res->ai_family, res->ai_socktype, 0);
+        if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(res);
+    }
+    if (fd < 0) {
+        mqtt_error(client, MQTT_ERROR_TYPE_TCP_TRANSPORT);
+        return false;
+    }
+
+    static const char CLIENT_ID[] = "host";
+    uint8_t connect_packet[] = {
+        MQTT_CONNECT, 12 + sizeof(CLIENT_ID) - 1,
+        0, 4, 'M', 'Q', 'T', 'T', 4, 0x02,                  // Protocol 3.1.1, clean session
+        (uint8_t)(client->keepalive_s >> 8), (uint8_t)client->keepalive_s,
+        0, sizeof(CLIENT_ID) - 1, 'h', 'o', 's', 't',
+    };
+    pthread_mutex_lock(&client->lock);
+    client->fd = fd;
+    bool ok = mqtt_send(client, connect_packet, sizeof(connect_packet));
+    pthread_mutex_unlock(&client->lock);
+
+    uint8_t type;
+    size_t len;
+    uint8_t *connack = ok ? mqtt_read_packet(client, &type, &len) : NULL;
+    ok = (connack != NULL && type == MQTT_CONNACK && len == 2 && connack[1] == 0);
+    free(connack);
+    if (!ok) {
+        pthread_mutex_lock(&client->lock);
+        client->fd = -1;
+        pthread_mutex_unlock(&client->lock);
+        close(fd);
+        mqtt_error(client, MQTT_ERROR_TYPE_CONNECTION_REFUSED);
+    }
+    return ok;
+}
+
+/**
+ * @brief Deliver a QoS 0 PUBLISH as MQTT_EVENT_DATA, fragmented like the device client.
+ */
+static void mqtt_deliver(esp_mqtt_client_handle_t client, uint8_t *packet, size_t len) {
+    if (len < 2) {
+        return;
+    }
+    size_t topic_len = ((size_t)packet[0] << 8) | packet[1];
+    if (2 + topic_len > len) {
+        return;
+    }
+
+    char *payload = (char *)packet + 2 + topic_len;
+    size_t payload_len = len - 2 - topic_len;
+    size_t offset = 0;
+    do {
+        size_t n = payload_len - offset;
+        n = (n > HOST_MQTT_BUFFER_SIZE) ? HOST_MQTT_BUFFER_SIZE : n;
+        esp_mqtt_event_t event = {
+            .event_id = MQTT_EVENT_DATA,
+            .data = payload + offset,
+            .data_len = (int)n,
+            .total_data_len = (int)payload_len,
+            .current_data_offset = (int)offset,
+            .topic = (offset == 0) ? (char *)packet + 2 : NULL,
+            .topic_len = (offset == 0) ? (int)topic_len : 0,
+        };
+        mqtt_event(client, &event);
+        offset += n;
+    } while (offset < payload_len);
+}
+
+/**
+ * @brief Client thread: connect, deliver the packets as events, reconnect after a lost connection.
+ */
+static void *mqtt_task(void *arg) {
+    esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)arg;
+
+    while (client->running) {
+        if (!mqtt_connect(client)) {
+            mqtt_sleep_ms(HOST_MQTT_RECONNECT_MS);
+            continue;
+        }
+        esp_mqtt_event_t connected = {.event_id = MQTT_EVENT_CONNECTED};
+        mqtt_event(client, &connected);
+
+        uint8_t type;
+        size_t len;
+        uint8_t *packet;
+        while ((packet = mqtt_read_packet(client, &type, &len)) != NULL) {
+            if ((type & 0xf0) == MQTT_PUBLISH && (type & 0x06) == 0) {
+                mqtt_deliver(client, packet, len);
+            } else if (type == MQTT_SUBACK && len >= 3) {
+                esp_mqtt_event_t subscribed = {.event_id = MQTT_EVENT_SUBSCRIBED, .msg_id = (packet[0] << 8) | packet[1]};
+                mqtt_event(client, &subscribed);
+            }
+            free(packet);
+        }
+
+        pthread_mutex_lock(&client->lock);
+        close(client->fd);
+        client->fd = -1;
+        pthread_mutex_unlock(&client->lock);
+        esp_mqtt_event_t disconnected = {.event_id = MQTT_EVENT_DISCONNECTED};
+        mqtt_event(client, &disconnected);
+        if (client->running) {
+            mqtt_sleep_ms(HOST_MQTT_RECONNECT_MS);
+        }
+    }
+    return NULL;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config) {
+    const char *uri = config->uri;
+
+    if (uri == NULL || strncmp(uri, "mqtt://", 7) != 0) {
+        return NULL;  // No TLS on the host
+    }
+    esp_mqtt_client_handle_t client = calloc(1, sizeof(*client));
+    if (client == NULL) {
+        return NULL;
+    }
+
+    const char *host = uri + 7;
+    const char *colon = strchr(host, ':');
+    size_t host_len = (colon != NULL) ? (size_t)(colon - host) : strcspn(host, "/");
+    snprintf(client->host, sizeof(client->host), "%.*s", (int)host_len, host);
+    snprintf(client->port, sizeof(client->port), "%.*s", (colon != NULL) ? (int)strcspn(colon + 1, "/") : 4,
+             (colon != NULL) ? colon + 1 : "1883");
+    client->keepalive_s = (config->keepalive > 0) ? config->keepalive : 120;
+    client->fd = -1;
+    client->next_id = 1;
+    pthread_mutex_init(&client->lock, NULL);
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t handler, void *arg) {
+    client->handler = handler;
+    client->handler_arg = arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client) {
+    if (client->started) {
+        return ESP_FAIL;
+    }
+    client->running = true;
+    if (pthread_create(&client->thread, NULL, mqtt_task, client) != 0) {
+        client->running = false;
+        return ESP_FAIL;
+    }
+    client->started = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_stop(esp_mqtt_client_handle_t client) {
+    if (!client->started) {
+        return ESP_FAIL;
+    }
+    client->running = false;
+    pthread_join(client->thread, NULL);
+    client->started = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client) {
+    if (client == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (client->started) {
+        esp_mqtt_client_stop(client);
+    }
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos) {
+    uint8_t packet[8 + 256];
+    size_t topic_len = strlen(topic);
+
+    if (topic_len > 256 || qos != 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&client->lock);
+    int id = client->next_id++;
+    size_t len = 0;
+    packet[len++] = MQTT_SUBSCRIBE;
+    len += mqtt_put_length(packet + len, 2 + 2 + topic_len + 1);
+    packet[len++] = (uint8_t)(id >> 8);
+    packet[len++] = (uint8_t)id;
+    packet[len++] = (uint8_t)(topic_len >> 8);
+    packet[len++] = (uint8_t)topic_len;
+    memcpy(packet + len, topic, topic_len);
+    len += topic_len;
+    packet[len++] = (uint8_t)qos;
+    bool ok = mqtt_send(client, packet, len);
+    pthread_mutex_unlock(&client->lock);
+    return ok ? id : -1;
+}
@@ -0,0 +1,318 @@
+/**
+ * @file    test_conditional_get.c
+ * @brief   Host test of the request / response handling of a fetch (http_exchange) against a stand-in HTTP server
+ *          on the loopback interface: 304 Not Modified, the value-window fingerprint, range requests and the
+ *          counters of the polls whose values came from the extractor
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "http_exchange.h"
+#include "test_util.h"
+
+#define FILLER_LEN 6000     // Page bytes after the value (not needed once the value is extracted)
+#define READ_SIZE 512       // Bytes read from the socket at a time
+
+/* Stand-in server: serves the current page, with or without validators and byte ranges */
+typedef struct {
+    int listen_fd;
+    const char *value;              // Value shown on the page
+    const char *footer;             // Text after the value (e.g. a timestamp)
+    const char *etag;               // ETag of the page (NULL: the server sends no validators)
+    bool ranges;                    // Range headers are honoured (ignored otherwise)
+    char request[1024];             // Last request
+    uint32_t requests;              // Requests served
+    uint32_t not_modified;          // Requests answered with 304
+    uint32_t partial;               // Requests answered with 206
+    size_t body_len;                // Length of the last page
+} server_t;
+
+/* Client: the exchange and the state data_scraping.c keeps around it */
+typedef struct {
+    http_exchange_t ex;
+    http_exchange_cache_t cache;
+    data_scraping_stats_t stats;
+    data_scraping_fetch_t fetch;
+    data_scraping_values_t values;
+} client_t;
+
+static const stream_extractor_key_t KEYS[] = {
+    {"freq", FREQ_MARKER, STREAM_RULE_OFFSET, FREQ_VALUE_OFFSET, FREQ_VALUE_WINDOW, '\0',
+     FREQ_VALUE_SCALE, FREQ_VALUE_ROUNDING},
+};
+
+static const data_scraping_source_t SOURCE = {"grid", "localhost", "80", "/", SOURCE_FORMAT_HTML, KEYS, NULL, 1,
+                                              1000, 1000, 1000, 0, NULL};
+
+static char body[FILLER_LEN + 512];
+
+static void server_start(server_t *srv, uint16_t *port) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0};
+    socklen_t len = sizeof(addr);
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_REQUIRE(srv->listen_fd >= 0);
+    TEST_REQUIRE(bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    TEST_REQUIRE(listen(srv->listen_fd, 1) == 0);
+    TEST_REQUIRE(getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) == 0);
+    *port = ntohs(addr.sin_port);
+}
+
+/**
+ * @brief Accept one connection, read the request and answer it (the response fits in the socket buffers).
+ */
+static void server_serve_one(server_t *srv) {
+    char head[256];
+    size_t len = 0;
+    int fd = accept(srv->listen_fd, NULL, NULL);
+    TEST_REQUIRE(fd >= 0);
+
+    while (len < sizeof(srv->request) - 1) {
+        ssize_t n = recv(fd, srv->request + len, sizeof(srv->request) - 1 - len, 0);
+        TEST_REQUIRE(n > 0);
+        len += n;
+        srv->request[len] = '\0';
+        if (strstr(srv->request, "\r\n\r\n") != NULL) {
+            break;
+        }
+    }
+    srv->requests++;
+
+    const char *match = strstr(srv->request, "If-None-Match: ");
+    if (srv->etag != NULL && match != NULL && strncmp(match + 15, srv->etag, strlen(srv->etag)) == 0) {
+        srv->not_modified++;
+        int n = snprintf(head, sizeof(head), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nConnection: close\r\n\r\n",
+                         srv->etag);
+        TEST_REQUIRE(send(fd, head, n, 0) == n);
+        close(fd);
+        return;
+    }
+
+    int body_len = snprintf(body, sizeof(body), "<table>\r\n<tr><th>Freq (Hz):  %s</td></tr>\r\n%s\r\n<!--",
+                            srv->value, srv->footer);
+    memset(body + body_len, '.', FILLER_LEN);
+    body_len += FILLER_LEN;
+    body_len += snprintf(body + body_len, sizeof(body) - body_len, "-->\r\n</table>\r\n");
+    srv->body_len = body_len;
+
+    int first = 0, last = body_len - 1;
+    const char *range = strstr(srv->request, "Range: bytes=");
+    if (srv->ranges && range != NULL && sscanf(range + 13, "%d-%d", &first, &last) == 2) {
+        last = (last < body_len - 1) ? last : body_len - 1;
+        srv->partial++;
+    } else {
+        range = NULL;
+    }
+
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Length: %d\r\nConnection: close\r\n",
+                     (range != NULL) ? "206 Partial Content" : "200 OK", last - first + 1);
+    if (range != NULL) {
+        n += snprintf(head + n, sizeof(head) - n, "Content-Range: bytes %d-%d/%d\r\n", first, last, body_len);
+    }
+    if (srv->etag != NULL) {
+        n += snprintf(head + n, sizeof(head) - n, "ETag: %s\r\nLast-Modified: Sat, 17 Oct 2026 10:00:00 GMT\r\n",
+                      srv->etag);
+    }
+    n += snprintf(head + n, sizeof(head) - n, "\r\n");
+    TEST_REQUIRE(send(fd, head, n, 0) == n);
+    TEST_REQUIRE(send(fd, body + first, last - first + 1, 0) == last - first + 1);
+    close(fd);
+}
+
+static void client_init(client_t *client) {
+    memset(client, 0, sizeof(*client));
+    client->cache.source = &SOURCE;
+    client->cache.range_supported = true;
+    client->ex.stats = &client->stats;
+    client->ex.fetch = &client->fetch;
+    TEST_REQUIRE(http_exchange_bind(&client->ex, &SOURCE, &client->cache) == ESP_OK);
+}
+
+/**
+ * @brief Poll the stand-in server once over a plain socket (in place of the TLS connection of data_scraping.c).
+ *
+ * @return Result of http_exchange_evaluate.
+ */
+static esp_err_t client_poll(client_t *client, server_t *srv, uint16_t port, bool use_range) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = htons(port)};
+    char request[HTTP_REQUEST_MAX_LEN];
+    char buf[READ_SIZE];
+
+    memset(&client->fetch, 0, sizeof(client->fetch));
+    client->fetch.time_to_value_us = -1;
+    size_t len = http_exchange_request(&client->ex, request, sizeof(request), use_range, NULL);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_REQUIRE(fd >= 0);
+    TEST_REQUIRE(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    TEST_REQUIRE(send(fd, request, len, 0) == (ssize_t)len);
+    server_serve_one(srv);
+
+    http_exchange_begin(&client->ex, NULL);
+    esp_err_t err = ESP_ERR_NOT_FINISHED;
+    while (err == ESP_ERR_NOT_FINISHED) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        TEST_REQUIRE(n >= 0);
+        err = (n == 0) ? http_response_finish(&client->ex.resp) : http_response_feed(&client->ex.resp, buf, n, NULL);
+    }
+    close(fd);
+    TEST_REQUIRE(err == ESP_OK);
+
+    return http_exchange_evaluate(&client->ex, &client->values);
+}
+
+/**
+ * @brief Poll and return the frequency (fails the test if the poll failed).
+ */
+static int32_t client_poll_value(client_t *client, server_t *srv, uint16_t port) {
+    TEST_REQUIRE(client_poll(client, srv, port, false) == ESP_OK);
+    TEST_REQUIRE(client->values.found & 1);
+    return client->values.values[0];
+}
+
+/**
+ * @brief Server with validators: unchanged pages are answered with 304 and nothing is parsed.
+ */
+static void test_validators(void) {
+    server_t srv = {.value = "49.987", .footer = "Updated 10:00:00", .etag = "\"v1\""};
+    client_t client;
+    uint16_t port;
+
+    server_start(&srv, &port);
+    client_init(&client);
+
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 4999);
+    TEST_CHECK(strstr(srv.request, "If-None-Match") == NULL);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 1);
+    TEST_CHECK(!client.fetch.unchanged);
+    TEST_CHECK(client.fetch.time_to_value_us >= 0);
+    TEST_CHECK(client.fetch.bytes_parsed > 0 && client.fetch.bytes_parsed < srv.body_len / 4);  // Parsing stops at the value
+
+    for (int i = 0; i < 3; i++) {
+        TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 4999);
+        TEST_CHECK(strstr(srv.request, "If-None-Match: \"v1\"\r\n") != NULL);
+        TEST_CHECK(strstr(srv.request, "If-Modified-Since: Sat, 17 Oct 2026 10:00:00 GMT\r\n") != NULL);
+        TEST_CHECK(client.fetch.unchanged);
+        TEST_CHECK_EQ(client.fetch.bytes_parsed, 0);
+    }
+    TEST_CHECK_EQ(client.stats.not_modified, 3);
+    TEST_CHECK_EQ(srv.not_modified, 3);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 1);
+
+    srv.value = "50.012";
+    srv.etag = "\"v2\"";
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 5001);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 2);
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 5001);
+    TEST_CHECK_EQ(client.stats.not_modified, 4);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 2);
+    TEST_CHECK_EQ(client.stats.fingerprint_hits, 0);
+    TEST_CHECK_EQ(srv.requests, 6);
+    close(srv.listen_fd);
+}
+
+/**
+ * @brief Server without validators: a page whose value window is unchanged is recognised by its fingerprint,
+ *        even if other parts of the page changed.
+ */
+static void test_fingerprint(void) {
+    server_t srv = {.value = "49.987", .footer = "Updated 10:00:00", .etag = NULL};
+    client_t client;
+    uint16_t port;
+
+    server_start(&srv, &port);
+    client_init(&client);
+
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 4999);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 1);
+    uint32_t first_parsed = client.fetch.bytes_parsed;
+
+    srv.footer = "Updated 10:00:15";   // Outside the value window
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 4999);
+    TEST_CHECK(strstr(srv.request, "If-None-Match") == NULL);
+    TEST_CHECK_EQ(client.stats.fingerprint_hits, 1);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 1);
+    TEST_CHECK(client.fetch.unchanged);
+    TEST_CHECK_EQ(client.fetch.bytes_parsed, first_parsed);
+    TEST_CHECK(client.fetch.bytes_parsed < srv.body_len / 4);
+
+    srv.value = "49.991";
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 4999);     // Same value at the display scale
+    TEST_CHECK_EQ(client.stats.extractor_runs, 2);
+    TEST_CHECK(!client.fetch.unchanged);
+    srv.value = "50.104";
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 5010);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 3);
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 5010);
+    TEST_CHECK_EQ(client.stats.fingerprint_hits, 2);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 3);
+    TEST_CHECK_EQ(client.stats.not_modified, 0);
+    TEST_CHECK_EQ(srv.requests, 5);
+    close(srv.listen_fd);
+}
+
+/**
+ * @brief Range requests around the learned span, and the fallback when the server ignores the Range header.
+ */
+static void test_range(void) {
+    server_t srv = {.value = "49.987", .footer = "Updated 10:00:00", .etag = NULL, .ranges = true};
+    client_t client;
+    uint16_t port;
+
+    server_start(&srv, &port);
+    client_init(&client);
+
+    TEST_CHECK_EQ(client_poll_value(&client, &srv, port), 4999);
+    TEST_CHECK(client.cache.span_known);
+    TEST_CHECK(client.cache.span_end > client.cache.span_start);
+    TEST_CHECK_EQ(client.cache.span_keys, 1);
+
+    srv.value = "50.104";
+    TEST_REQUIRE(client_poll(&client, &srv, port, true) == ESP_OK);
+    TEST_CHECK(strstr(srv.request, "Range: bytes=0-") != NULL);
+    TEST_CHECK(strstr(srv.request, "Accept-Encoding") == NULL);
+    TEST_CHECK_EQ(srv.partial, 1);
+    TEST_CHECK_EQ(client.values.values[0], 5010);
+    TEST_CHECK(client.fetch.range);
+    TEST_CHECK_EQ(client.stats.range_hits, 1);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 2);
+
+    srv.ranges = false;
+    srv.value = "49.950";
+    TEST_REQUIRE(client_poll(&client, &srv, port, true) == ESP_OK);
+    TEST_CHECK_EQ(client.values.values[0], 4995);
+    TEST_CHECK(!client.cache.range_supported);
+    TEST_CHECK(client.fetch.fallback);
+    TEST_CHECK_EQ(client.stats.range_fallbacks, 1);
+    TEST_CHECK_EQ(client.stats.range_hits, 1);
+    close(srv.listen_fd);
+}
+
+/**
+ * @brief Extraction from a complete document (pushed messages) touches neither the cache nor the counters.
+ */
+static void test_extract(void) {
+    client_t client;
+    static const char PAGE[] = "<tr><th>Freq (Hz):  50.003</td></tr>";
+
+    client_init(&client);
+    TEST_CHECK_EQ(http_exchange_extract(&client.ex, PAGE, sizeof(PAGE) - 1, &client.values), ESP_OK);
+    TEST_CHECK_EQ(client.values.values[0], 5000);
+    TEST_CHECK_EQ(client.values.max_age_s, -1);
+    TEST_CHECK_EQ(http_exchange_extract(&client.ex, "no value", 8, &client.values), ESP_ERR_NOT_FOUND);
+    TEST_CHECK_EQ(client.stats.extractor_runs, 0);
+}
+
+int main(void) {
+    test_validators();
+    test_fingerprint();
+    test_range();
+    test_extract();
+    return TEST_RESULT();
+}
@@ -0,0 +1,509 @@
+/**
+ * @file    test_data_scraping.c
+ * @brief   Host test of the TLS fetch of data_scraping.c against a stand-in HTTPS server on loopback (OpenSSL, with a
+ *          CA and a server certificate generated at run time): keep-alive connection reuse, the stale-socket check of
+ *          an idle connection closed by the server, the single retry of a request lost on a reused connection, and
+ *          the reuse and session resumption counters, and the deadline of each phase overrun by a server that stalls
+ *          before accepting, during the handshake, after the request and in the middle of the body
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "data_scraping.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "test_util.h"
+
+#define REQUEST_MAX 2048
+#define DEADLINE_SLACK_US 200000    // Overrun of a deadline tolerated on a loaded machine
+#define FILLER_MAX 8                // Connections tried to fill the accept queue of a listening socket
+
+/* Point where the server stops answering until the client closes the connection */
+typedef enum {
+    SERVER_STALL_NONE = 0x00,       // Answer every request
+    SERVER_STALL_HANDSHAKE = 0x01,  // Accept the TCP connection, never answer the ClientHello
+    SERVER_STALL_RESPONSE = 0x02,   // Read the request, never send the response
+    SERVER_STALL_BODY = 0x03,       // Send the header and a part of the body without the value
+} server_stall_t;
+
+/* Stand-in HTTPS server: one connection at a time, served by its own thread */
+typedef struct {
+    int listen_fd;
+    char port[8];
+    SSL_CTX *ctx;                       // Replaced to forget the sessions
+    pthread_t thread;
+    volatile int32_t value;             // Frequency in the page (scaled by 10^FREQ_VALUE_SCALE)
+    volatile uint32_t drop_requests;    // Next requests closed without an answer
+    volatile bool close_idle;           // Close the connection after each response (left idle by the client)
+    volatile server_stall_t stall;      // Point where the next connections stall
+    volatile uint32_t accepts;          // TCP connections accepted
+    volatile uint32_t handshakes;       // TLS handshakes completed
+    volatile uint32_t resumed;          // Handshakes that resumed a session
+    volatile uint32_t requests;         // Requests read
+} server_t;
+
+static const stream_extractor_key_t KEYS[] = {
+    {"freq", FREQ_MARKER, STREAM_RULE_OFFSET, FREQ_VALUE_OFFSET, FREQ_VALUE_WINDOW, '\0', FREQ_VALUE_SCALE,
+     FREQ_VALUE_ROUNDING},
+};
+
+char host_tls_ca_pem[HOST_TLS_CA_PEM_SIZE];     // TLS_TRUST_CA_PEM of this test
+static EVP_PKEY *server_key;
+static X509 *server_cert;
+
+/**
+ * @brief Issue a certificate for a new P-256 key (self-signed if issuer is NULL).
+ */
+static X509 *make_cert(EVP_PKEY *key, const char *cn, X509 *issuer, EVP_PKEY *issuer_key) {
+    X509 *cert = X509_new();
+    X509V3_CTX ext_ctx;
+    static long serial = 1;
+
+    TEST_REQUIRE(cert != NULL);
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), serial++);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+    X509_set_pubkey(cert, key);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC, (const unsigned char *)cn, -1, -1, 0);
+    X509_set_issuer_name(cert, X509_get_subject_name((issuer != NULL) ? issuer : cert));
+
+    X509V3_set_ctx(&ext_ctx, (issuer != NULL) ? issuer : cert, cert, NULL, NULL, 0);
+    const char *exts[][2] = {
+        {"basicConstraints", (issuer == NULL) ? "critical,CA:TRUE" : "CA:FALSE"},
+        {"keyUsage", (issuer == NULL) ? "critical,keyCertSign" : "critical,digitalSignature"},
+        {"subjectAltName", (issuer == NULL) ? NULL : "DNS:localhost"},
+    };
+    for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+        if (exts[i][1] != NULL) {
+            X509_EXTENSION *ext = X509V3_EXT_conf(NULL, &ext_ctx, exts[i][0], exts[i][1]);
+            TEST_REQUIRE(ext != NULL);
+            X509_add_ext(cert, ext, -1);
+            X509_EXTENSION_free(ext);
+        }
+    }
+    TEST_REQUIRE(X509_sign(cert, (issuer_key != NULL) ? issuer_key : key, EVP_sha256()) > 0);
+    return cert;
+}
+
+/**
+ * @brief Generate the CA (its PEM becomes TLS_TRUST_CA_PEM) and the certificate of the server for localhost.
+ */
+static void make_pki(void) {
+    EVP_PKEY *ca_key = EVP_EC_gen("P-256");
+    TEST_REQUIRE(ca_key != NULL);
+    X509 *ca = make_cert(ca_key, "Host Test CA", NULL, NULL);
+    server_key = EVP_EC_gen("P-256");
+    TEST_REQUIRE(server_key != NULL);
+    server_cert = make_cert(server_key, "localhost", ca, ca_key);
+
+    BIO *bio = BIO_new(BIO_s_mem());
+    TEST_REQUIRE(bio != NULL && PEM_write_bio_X509(bio, ca) == 1);
+    int len = BIO_read(bio, host_tls_ca_pem, sizeof(host_tls_ca_pem) - 1);
+    TEST_REQUIRE(len > 0);
+    host_tls_ca_pem[len] = '\0';
+    BIO_free(bio);
+    X509_free(ca);
+    EVP_PKEY_free(ca_key);
+}
+
+/**
+ * @brief New server context (with an empty session cache and new ticket keys).
+ */
+static SSL_CTX *server_ctx(void) {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+
+    TEST_REQUIRE(ctx != NULL);
+    TEST_REQUIRE(SSL_CTX_use_certificate(ctx, server_cert) == 1 && SSL_CTX_use_PrivateKey(ctx, server_key) == 1);
+    SSL_CTX_set_session_id_context(ctx, (const unsigned char *)"host", 4);
+    return ctx;
+}
+
+/**
+ * @brief Read a request up to the end of its header.
+ *
+ * @return false if the connection was closed.
+ */
+static bool server_read_request(SSL *ssl) {
+    char request[REQUEST_MAX];
+    size_t len = 0;
+
+    while (len < sizeof(request) - 1) {
+        int ret = SSL_read(ssl, request + len, (int)(sizeof(request) - 1 - len));
+        if (ret <= 0) {
+            return false;
+        }
+        len += ret;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Wait until the client closes the connection, discarding what it sends.
+ */
+static void server_wait_close(int fd) {
+    char buf[256];
+
+    while (recv(fd, buf, sizeof(buf), 0) > 0) {
+    }
+}
+
+/**
+ * @brief Send the header of a long page and the part of its body before the value.
+ */
+static void server_respond_partial(SSL *ssl) {
+    char response[512];
+
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 65536\r\n"
+                       "Connection: keep-alive\r\n\r\n<html><body><table>\n");
+    SSL_write(ssl, response, len);
+}
+
+static void server_respond(server_t *s, SSL *ssl) {
+    char body[256], response[512];
+
+    int body_len = snprintf(body, sizeof(body),
+                            "<html><body><table>\n<tr><th>Freq (Hz):  %ld.%02ld</td></tr>\n</table></body></html>\n",
+                            (long)(s->value / 100), (long)(s->value % 100));
+    int len = snprintf(response, sizeof(response),
+                       "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %d\r\n"
+                       "Connection: keep-alive\r\n\r\n%s",
+                       body_len, body);
+    SSL_write(ssl, response, len);
+}
+
+/**
+ * @brief Answer the requests of one connection.
+ */
+static void server_serve(server_t *s, SSL *ssl) {
+    while (server_read_request(ssl)) {
+        bool close_idle = s->close_idle;    // Set by the test before the fetch, changed once the response is read
+        s->requests++;
+        if (s->stall == SERVER_STALL_RESPONSE || s->stall == SERVER_STALL_BODY) {
+            if (s->stall == SERVER_STALL_BODY) {
+                server_respond_partial(ssl);
+            }
+            server_wait_close(SSL_get_fd(ssl));
+            return;
+        }
+        if (s->drop_requests > 0) {
+            s->drop_requests--;
+            return;             // Closed without an answer and without close_notify (server restarted, idle timeout)
+        }
+        server_respond(s, ssl);
+        if (close_idle) {
+            SSL_shutdown(ssl);
+            return;
+        }
+    }
+}
+
+static void *server_task(void *arg) {
+    server_t *s = (server_t *)arg;
+
+    while (true) {
+        int fd = accept(s->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return NULL;
+        }
+        s->accepts++;
+        if (s->stall == SERVER_STALL_HANDSHAKE) {
+            server_wait_close(fd);
+            close(fd);
+            continue;
+        }
+        SSL *ssl = SSL_new(s->ctx);
+        SSL_set_fd(ssl, fd);
+        if (SSL_accept(ssl) == 1) {
+            s->handshakes++;
+            s->resumed += SSL_session_reused(ssl) ? 1 : 0;
+            server_serve(s, ssl);
+        }
+        SSL_free(ssl);
+        close(fd);
+    }
+}
+
+static void server_start(server_t *s) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0};
+    socklen_t len = sizeof(addr);
+
+    memset(s, 0, sizeof(*s));
+    s->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_REQUIRE(s->listen_fd >= 0);
+    TEST_REQUIRE(bind(s->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    TEST_REQUIRE(listen(s->listen_fd, 4) == 0);
+    TEST_REQUIRE(getsockname(s->listen_fd, (struct sockaddr *)&addr, &len) == 0);
+    snprintf(s->port, sizeof(s->port), "%u", ntohs(addr.sin_port));
+    s->ctx = server_ctx();
+    s->value = 4999;
+    TEST_REQUIRE(pthread_create(&s->thread, NULL, server_task, s) == 0);
+}
+
+/**
+ * @brief Open a listening socket whose accept queue is full, so that a further connect is never completed.
+ *
+ * @param port         Port of the socket (set).
+ * @param filler       Connections filling the queue (closed by the caller).
+ * @param filler_count Number of connections (set).
+ * @return Socket.
+ */
+static int stalled_listener(char port[8], int filler[FILLER_MAX], int *filler_count) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0};
+    socklen_t len = sizeof(addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_REQUIRE(fd >= 0);
+    TEST_REQUIRE(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    TEST_REQUIRE(listen(fd, 0) == 0);
+    TEST_REQUIRE(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+    snprintf(port, 8, "%u", ntohs(addr.sin_port));
+
+    /* Connect until one is left pending: the queue is full and the kernel drops the next SYNs */
+    for (*filler_count = 0; *filler_count < FILLER_MAX;) {
+        int c = socket(AF_INET, SOCK_STREAM, 0);
+        TEST_REQUIRE(c >= 0);
+        filler[(*filler_count)++] = c;
+        fcntl(c, F_SETFL, O_NONBLOCK);
+        connect(c, (struct sockaddr *)&addr, sizeof(addr));
+        struct pollfd pfd = {.fd = c, .events = POLLOUT};
+        if (poll(&pfd, 1, 100) == 0) {
+            return fd;
+        }
+    }
+    TEST_REQUIRE(false);    // Queue never full
+    return -1;
+}
+
+/**
+ * @brief Make the server forget the sessions it issued (restart of the server).
+ */
+static void server_forget_sessions(server_t *s) {
+    SSL_CTX *old = s->ctx;
+    s->ctx = server_ctx();
+    SSL_CTX_free(old);      // Kept alive by a connection in progress
+}
+
+/**
+ * @brief Fetch the value of the source and check it against the page of the server.
+ */
+static esp_err_t fetch_value(const data_scraping_source_t *source, server_t *s, int32_t value) {
+    data_scraping_values_t values;
+
+    s->value = value;
+    esp_err_t err = data_scraping_fetch(source, &values);
+    if (err == ESP_OK) {
+        TEST_CHECK_EQ(values.found, 1);
+        TEST_CHECK_EQ(values.values[0], value);
+    }
+    return err;
+}
+
+/**
+ * @brief The second fetch goes over the keep-alive connection of the first one: no new connection or handshake.
+ */
+static void test_reuse(const data_scraping_source_t *source, server_t *s) {
+    data_scraping_stats_t stats;
+    data_scraping_fetch_t fetch;
+
+    TEST_CHECK_EQ(fetch_value(source, s, 4995), ESP_OK);
+    data_scraping_get_last_fetch(&fetch);
+    TEST_CHECK(fetch.timings_us[DATA_SCRAPING_TIMING_HANDSHAKE] >= 0);
+    data_scraping_get_stats(&stats);
+    TEST_CHECK_EQ(stats.connections, 1);
+    TEST_CHECK_EQ(stats.reused, 0);
+    TEST_CHECK_EQ(stats.resumption_attempts, 0);     // No session saved yet
+
+    TEST_CHECK_EQ(fetch_value(source, s, 4996), ESP_OK);
+    data_scraping_get_last_fetch(&fetch);
+    TEST_CHECK_EQ(fetch.timings_us[DATA_SCRAPING_TIMING_TCP], -1);
+    TEST_CHECK_EQ(fetch.timings_us[DATA_SCRAPING_TIMING_HANDSHAKE], -1);
+    data_scraping_get_stats(&stats);
+    TEST_CHECK_EQ(stats.fetches, 2);
+    TEST_CHECK_EQ(stats.connections, 1);
+    TEST_CHECK_EQ(stats.reused, 1);
+    TEST_CHECK_EQ(s->accepts, 1);
+    TEST_CHECK_EQ(s->requests, 2);
+}
+
+/**
+ * @brief An idle connection closed by the server (close_notify and FIN waiting in the socket) is found by the poll
+ *        before the request and replaced by a new one, which resumes the saved session.
+ */
+static void test_stale_socket(const data_scraping_source_t *source, server_t *s) {
+    data_scraping_stats_t before, after;
+
+    data_scraping_get_stats(&before);
+    s->close_idle = true;
+    TEST_CHECK_EQ(fetch_value(source, s, 4997), ESP_OK);     // Served, then closed by the server
+    s->close_idle = false;
+    vTaskDelay(pdMS_TO_TICKS(20));
+
+    uint32_t requests = s->requests;
+    TEST_CHECK_EQ(fetch_value(source, s, 4998), ESP_OK);
+    data_scraping_get_stats(&after);
+    TEST_CHECK_EQ(after.reused, before.reused + 1);          // Only the first fetch
+    TEST_CHECK_EQ(after.connections, before.connections + 1);
+    TEST_CHECK_EQ(after.resumption_attempts, before.resumption_attempts + 1);
+    TEST_CHECK_EQ(after.resumption_hits, before.resumption_hits + 1);
+    TEST_CHECK_EQ(s->requests, requests + 1);                // Nothing sent over the stale connection
+    TEST_CHECK_EQ(s->resumed, 1);
+}
+
+/**
+ * @brief A request lost on a reused connection (closed by the server after the poll) is repeated once over a new
+ *        connection; a request lost on the new connection too is not repeated again.
+ */
+static void test_retry_once(const data_scraping_source_t *source, server_t *s) {
+    data_scraping_stats_t before, after;
+
+    data_scraping_get_stats(&before);
+    uint32_t requests = s->requests, accepts = s->accepts;
+    s->drop_requests = 1;
+    TEST_CHECK_EQ(fetch_value(source, s, 5001), ESP_OK);
+    data_scraping_get_stats(&after);
+    TEST_CHECK_EQ(s->requests, requests + 2);
+    TEST_CHECK_EQ(s->accepts, accepts + 1);
+    TEST_CHECK_EQ(after.reused, before.reused);              // Served by the new connection
+    TEST_CHECK_EQ(after.connections, before.connections + 1);
+    TEST_CHECK_EQ(after.resumption_hits, before.resumption_hits + 1);
+
+    requests = s->requests;
+    s->drop_requests = 2;
+    TEST_CHECK(fetch_value(source, s, 5002) != ESP_OK);
+    TEST_CHECK_EQ(s->requests, requests + 2);                // Reused connection and a single retry
+    TEST_CHECK_EQ(s->drop_requests, 0);
+
+    /* Not retried at all on a new connection */
+    requests = s->requests;
+    s->drop_requests = 1;
+    TEST_CHECK(fetch_value(source, s, 5003) != ESP_OK);
+    TEST_CHECK_EQ(s->requests, requests + 1);
+}
+
+/**
+ * @brief A session the server no longer knows is offered, refused, and replaced by the one of the full handshake.
+ */
+static void test_resumption_miss(const data_scraping_source_t *source, server_t *s) {
+    data_scraping_stats_t before, after;
+    data_scraping_fetch_t fetch;
+
+    server_forget_sessions(s);
+    data_scraping_get_stats(&before);
+    uint32_t handshakes = s->handshakes, resumed = s->resumed;
+    TEST_CHECK_EQ(fetch_value(source, s, 5004), ESP_OK);    // No connection left open by the failed fetch
+    data_scraping_get_stats(&after);
+    TEST_CHECK_EQ(after.resumption_attempts, before.resumption_attempts + 1);
+    TEST_CHECK_EQ(after.resumption_hits, before.resumption_hits);
+    TEST_CHECK_EQ(s->handshakes, handshakes + 1);
+    TEST_CHECK_EQ(s->resumed, resumed);
+    data_scraping_get_last_fetch(&fetch);
+    TEST_CHECK(fetch.timings_us[DATA_SCRAPING_TIMING_HANDSHAKE] >= 0);
+
+    s->close_idle = true;                                   // The new session is resumed by the next connection
+    TEST_CHECK_EQ(fetch_value(source, s, 5005), ESP_OK);
+    s->close_idle = false;
+    vTaskDelay(pdMS_TO_TICKS(20));
+    TEST_CHECK_EQ(fetch_value(source, s, 5006), ESP_OK);
+    data_scraping_get_stats(&after);
+    TEST_CHECK_EQ(after.resumption_hits, before.resumption_hits + 1);
+    TEST_CHECK_EQ(s->resumed, resumed + 1);
+}
+
+/**
+ * @brief Fetch a source that stalls and check that the phase expected overran its deadline in time.
+ *
+ * @param limit_ms Deadline expected to pass, from the start of the fetch.
+ */
+static void check_stall(const data_scraping_source_t *source, data_scraping_phase_t expected, uint32_t limit_ms) {
+    data_scraping_values_t values;
+    data_scraping_stats_t before, after;
+    data_scraping_fetch_t fetch;
+
+    data_scraping_get_stats(&before);
+    int64_t start_us = esp_timer_get_time();
+    TEST_CHECK_EQ(data_scraping_fetch(source, &values), ESP_ERR_TIMEOUT);
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    data_scraping_get_stats(&after);
+    data_scraping_get_last_fetch(&fetch);
+
+    TEST_CHECK_EQ(fetch.timeout_phase, expected);
+    TEST_CHECK_EQ(after.timeouts, before.timeouts + 1);
+    TEST_CHECK(elapsed_us >= (int64_t)limit_ms * 1000);
+    TEST_CHECK(elapsed_us < (int64_t)limit_ms * 1000 + DEADLINE_SLACK_US);
+    TEST_CHECK(fetch.total_us <= elapsed_us);
+}
+
+/**
+ * @brief A server that stalls at each point of the fetch makes it fail with ESP_ERR_TIMEOUT once the deadline of
+ *        that phase passes: connect (never accepted), handshake, first byte (request read, never answered), and the
+ *        total deadline in the middle of the body.
+ */
+static void test_stalls(server_t *s) {
+    int filler[FILLER_MAX], filler_count;
+    char port[8];
+
+    int listen_fd = stalled_listener(port, filler, &filler_count);
+    const data_scraping_source_t unaccepted = {"unaccepted", "localhost", port, "/", SOURCE_FORMAT_HTML, KEYS, NULL,
+                                               1, 1000, 1000, 1000, 0, NULL};
+    check_stall(&unaccepted, DATA_SCRAPING_PHASE_CONNECT, FETCH_CONNECT_TIMEOUT_MS);
+    for (int i = 0; i < filler_count; i++) {
+        close(filler[i]);
+    }
+    close(listen_fd);
+
+    const data_scraping_source_t stalling = {"stalling", "localhost", s->port, "/", SOURCE_FORMAT_HTML, KEYS, NULL,
+                                             1, 1000, 1000, 1000, 0, NULL};
+    s->stall = SERVER_STALL_HANDSHAKE;
+    check_stall(&stalling, DATA_SCRAPING_PHASE_HANDSHAKE, FETCH_HANDSHAKE_TIMEOUT_MS);
+    TEST_CHECK_EQ(s->handshakes, 0);
+
+    s->stall = SERVER_STALL_RESPONSE;
+    check_stall(&stalling, DATA_SCRAPING_PHASE_FIRST_BYTE, FETCH_FIRST_BYTE_TIMEOUT_MS);
+    TEST_CHECK_EQ(s->requests, 1);
+
+    s->stall = SERVER_STALL_BODY;
+    check_stall(&stalling, DATA_SCRAPING_PHASE_TOTAL, FETCH_TOTAL_TIMEOUT_MS);
+    TEST_CHECK_EQ(s->requests, 2);
+
+    s->stall = SERVER_STALL_NONE;
+    TEST_CHECK_EQ(fetch_value(&stalling, s, 5007), ESP_OK);    // Timed out connections are not reused
+    TEST_CHECK_EQ(s->accepts, 4);
+}
+
+int main(void) {
+    static server_t server, stalling;
+
+    make_pki();
+    server_start(&server);
+    TEST_REQUIRE(data_scraping_init() == ESP_OK);
+
+    const data_scraping_source_t source = {"loopback", "localhost", server.port, "/", SOURCE_FORMAT_HTML, KEYS, NULL,
+                                           1, 1000, 1000, 1000, 0, NULL};
+    test_reuse(&source, &server);
+    test_stale_socket(&source, &server);
+    test_retry_once(&source, &server);
+    test_resumption_miss(&source, &server);
+
+    server_start(&stalling);
+    test_stalls(&stalling);
+    return TEST_RESULT();
+}
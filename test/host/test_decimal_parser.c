@@ -0,0 +1,242 @@
+/**
+ * @file    test_decimal_parser.c
+ * @brief   Host tests of the decimal parser: exhaustive comparison with exact integer rounding, round trips of
+ *          scaled integers through their decimal text, exponent forms and malformed numbers
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "decimal_parser.h"
+#include "test_util.h"
+
+#define RANGE 100000    // Scaled numbers from -RANGE to RANGE are checked exhaustively
+#define MAX_DIGITS 4    // Fractional digits of the text checked exhaustively (and scales up to the same)
+
+static const decimal_rounding_t ROUNDINGS[] = {DECIMAL_ROUND_TRUNCATE, DECIMAL_ROUND_HALF_UP, DECIMAL_ROUND_HALF_EVEN};
+
+static const int64_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 1000000000};
+
+/**
+ * @brief Exact result of rounding n / 10^frac to scale digits (reference for the parser).
+ */
+static int64_t reference(int64_t n, int frac, int scale, decimal_rounding_t rounding) {
+    if (scale >= frac) {
+        return n * POW10[scale - frac];
+    }
+    int64_t divisor = POW10[frac - scale];
+    int64_t mag = (n < 0) ? -n : n;
+    int64_t q = mag / divisor, rem = mag % divisor;
+    if (rounding == DECIMAL_ROUND_HALF_UP && rem * 2 >= divisor) {
+        q++;
+    } else if (rounding == DECIMAL_ROUND_HALF_EVEN && (rem * 2 > divisor || (rem * 2 == divisor && (q & 1)))) {
+        q++;
+    }
+    return (n < 0) ? -q : q;
+}
+
+/**
+ * @brief Write n / 10^frac as decimal text (e.g. -5, 2 gives "-0.05").
+ */
+static int format_fixed(char *buf, size_t size, int64_t n, int frac) {
+    int64_t mag = (n < 0) ? -n : n;
+    if (frac == 0) {
+        return snprintf(buf, size, "%s%lld", (n < 0) ? "-" : "", (long long)mag);
+    }
+    return snprintf(buf, size, "%s%lld.%0*lld", (n < 0) ? "-" : "", (long long)(mag / POW10[frac]), frac,
+                    (long long)(mag % POW10[frac]));
+}
+
+/**
+ * @brief Every number of up to MAX_DIGITS fractional digits in the range, at every scale and rounding.
+ */
+static void test_exhaustive_rounding(void) {
+    char text[32];
+    int mismatches = 0;
+
+    for (int frac = 0; frac <= MAX_DIGITS; frac++) {
+        for (int64_t n = -RANGE; n <= RANGE; n++) {
+            int len = format_fixed(text, sizeof(text), n, frac);
+            for (int scale = 0; scale <= MAX_DIGITS; scale++) {
+                for (size_t r = 0; r < sizeof(ROUNDINGS) / sizeof(ROUNDINGS[0]); r++) {
+                    int32_t value;
+                    esp_err_t err = decimal_parse(text, len, scale, ROUNDINGS[r], &value);
+                    if (err != ESP_OK || value != reference(n, frac, scale, ROUNDINGS[r])) {
+                        if (mismatches++ < 10) {
+                            fprintf(stderr, "\"%s\" scale %d rounding %d: %ld (err %d), expected %lld\n", text, scale,
+                                    (int)ROUNDINGS[r], (long)value, err,
+                                    (long long)reference(n, frac, scale, ROUNDINGS[r]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+    TEST_CHECK_EQ(mismatches, 0);
+}
+
+/**
+ * @brief Scaled integers written as text and parsed back at the same scale are unchanged (including padded
+ *        and exponent forms of the same number).
+ */
+static void test_round_trip(void) {
+    char text[48];
+    int mismatches = 0;
+
+    for (int scale = 0; scale <= 9; scale++) {
+        int64_t step = (scale < 6) ? 1 : 997;   // Dense for the scales used by the sources, sampled above
+        for (int64_t n = -3 * RANGE; n <= 3 * RANGE; n += step) {
+            int32_t value;
+            int len = format_fixed(text, sizeof(text), n, (scale > 7) ? 7 : scale);
+            int64_t expected = (scale > 7) ? n * POW10[scale - 7] : n;
+            if (decimal_parse(text, len, scale, DECIMAL_ROUND_HALF_EVEN, &value) != ESP_OK || value != expected) {
+                mismatches++;
+            }
+            len = snprintf(text, sizeof(text), "%s000%lld0000e-%d", (n < 0) ? "-" : "+", (long long)(n < 0 ? -n : n),
+                           ((scale > 7) ? 7 : scale) + 4);
+            if (decimal_parse(text, len, scale, DECIMAL_ROUND_TRUNCATE, &value) != ESP_OK || value != expected) {
+                if (mismatches++ < 10) {
+                    fprintf(stderr, "\"%s\" scale %d: %ld, expected %lld\n", text, scale, (long)value,
+                            (long long)expected);
+                }
+            }
+        }
+    }
+    TEST_CHECK_EQ(mismatches, 0);
+}
+
+/**
+ * @brief Ties, digits beyond the mantissa precision and the limits of int32_t.
+ */
+static void test_edges(void) {
+    static const struct {
+        const char *text;
+        uint8_t scale;
+        decimal_rounding_t rounding;
+        esp_err_t err;
+        int32_t value;
+    } CASES[] = {
+        {"49.995", 2, DECIMAL_ROUND_HALF_UP, ESP_OK, 5000},
+        {"49.995", 2, DECIMAL_ROUND_HALF_EVEN, ESP_OK, 5000},
+        {"49.985", 2, DECIMAL_ROUND_HALF_EVEN, ESP_OK, 4998},
+        {"49.995", 2, DECIMAL_ROUND_TRUNCATE, ESP_OK, 4999},
+        {"-0.005", 2, DECIMAL_ROUND_HALF_UP, ESP_OK, -1},
+        {"-0.005", 2, DECIMAL_ROUND_HALF_EVEN, ESP_OK, 0},
+        {"0.12500000000000000000001", 2, DECIMAL_ROUND_HALF_EVEN, ESP_OK, 13},
+        {"0.12500000000000000000000", 2, DECIMAL_ROUND_HALF_EVEN, ESP_OK, 12},
+        {"12345678901234567890123e-20", 2, DECIMAL_ROUND_HALF_UP, ESP_OK, 12346},
+        {"2147483647", 0, DECIMAL_ROUND_TRUNCATE, ESP_OK, INT32_MAX},
+        {"-2147483647", 0, DECIMAL_ROUND_TRUNCATE, ESP_OK, -INT32_MAX},
+        {"2147483648", 0, DECIMAL_ROUND_TRUNCATE, ESP_ERR_INVALID_SIZE, 0},
+        {"21474836.47", 2, DECIMAL_ROUND_TRUNCATE, ESP_OK, INT32_MAX},
+        {"21474836.475", 2, DECIMAL_ROUND_HALF_UP, ESP_ERR_INVALID_SIZE, 0},
+        {"1e999999", 0, DECIMAL_ROUND_TRUNCATE, ESP_ERR_INVALID_SIZE, 0},
+        {"1e-999999", 9, DECIMAL_ROUND_HALF_UP, ESP_OK, 0},
+        {"0e999999", 0, DECIMAL_ROUND_TRUNCATE, ESP_OK, 0},
+        {"1e+5", 0, DECIMAL_ROUND_TRUNCATE, ESP_OK, 100000},
+        {"1E-2", 2, DECIMAL_ROUND_TRUNCATE, ESP_OK, 1},
+        {".5", 0, DECIMAL_ROUND_HALF_UP, ESP_OK, 1},
+        {"5.", 1, DECIMAL_ROUND_HALF_UP, ESP_OK, 50},
+    };
+
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        int32_t value = 0;
+        esp_err_t err = decimal_parse(CASES[i].text, strlen(CASES[i].text), CASES[i].scale, CASES[i].rounding, &value);
+        if (err != CASES[i].err || (err == ESP_OK && value != CASES[i].value)) {
+            fprintf(stderr, "\"%s\": %ld (err %d)\n", CASES[i].text, (long)value, err);
+            test_failures++;
+        }
+    }
+}
+
+/**
+ * @brief Malformed numbers are rejected (a sign of the exponent is only accepted right after e/E).
+ */
+static void test_malformed(void) {
+    static const char *CASES[] = {
+        "1e+-5", "1e-+5", "1e--5", "1e++5", "1e5-", "1e5+", "1e-", "1e", "e5", ".", "-", "+", "",
+        "1.2.3", "+-1", "-+1", "1-", "1e5e5", "1e5.5", "--1",
+    };
+
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        int32_t value;
+        if (decimal_parse(CASES[i], strlen(CASES[i]), 2, DECIMAL_ROUND_HALF_UP, &value) == ESP_OK) {
+            fprintf(stderr, "\"%s\" accepted as %ld\n", CASES[i], (long)value);
+            test_failures++;
+        }
+    }
+}
+
+/**
+ * @brief Incremental parsing ends at the first character that cannot belong to the number.
+ */
+static void test_stream_end(void) {
+    decimal_parser_t p;
+    const char *text = "-49.987e1-5";
+    size_t i = 0;
+    int32_t value;
+
+    decimal_parser_start(&p, 2, DECIMAL_ROUND_HALF_UP, true);
+    while (text[i] != '\0' && decimal_parser_char(&p, text[i])) {
+        i++;
+    }
+    TEST_CHECK_EQ(i, 9);    // Stops at the second sign
+    TEST_CHECK_EQ(decimal_parser_result(&p, &value), ESP_OK);
+    TEST_CHECK_EQ(value, -49987);
+
+    decimal_parser_start(&p, 2, DECIMAL_ROUND_HALF_UP, false);
+    for (i = 0; text[i] != '\0' && decimal_parser_char(&p, text[i]); i++) {
+    }
+    TEST_CHECK_EQ(i, 7);    // HTML values take no exponent
+    TEST_CHECK_EQ(decimal_parser_result(&p, &value), ESP_OK);
+    TEST_CHECK_EQ(value, -4999);
+}
+
+/**
+ * @brief Numbers with more digits than the exponent of the digits could count (over 32767) keep their magnitude.
+ */
+static void test_long_numbers(void) {
+    static const struct {
+        const char *head;
+        char fill;
+        const char *tail;
+        esp_err_t err;
+        int32_t value;
+    } CASES[] = {
+        {"0.", '0', "5", ESP_OK, 0},                    // Tiny fraction, rounds to 0
+        {"1", '0', "", ESP_ERR_INVALID_SIZE, 0},        // Huge integer
+        {"1", '0', ".5", ESP_ERR_INVALID_SIZE, 0},
+        {"-0.", '0', "1e999", ESP_OK, 0},               // The explicit exponent cannot make up for the zeros
+        {"0.", '9', "", ESP_OK, 100},                   // Rounds up to 1.00
+    };
+    const size_t fill_len = 40000;
+    char *text = malloc(fill_len + 16);
+    TEST_REQUIRE(text != NULL);
+
+    for (size_t i = 0; i < sizeof(CASES) / sizeof(CASES[0]); i++) {
+        size_t head_len = strlen(CASES[i].head);
+        memcpy(text, CASES[i].head, head_len);
+        memset(text + head_len, CASES[i].fill, fill_len);
+        strcpy(text + head_len + fill_len, CASES[i].tail);
+
+        int32_t value = 0;
+        esp_err_t err = decimal_parse(text, strlen(text), 2, DECIMAL_ROUND_HALF_UP, &value);
+        if (err != CASES[i].err || (err == ESP_OK && value != CASES[i].value)) {
+            fprintf(stderr, "\"%s<%zu x %c>%s\": %ld (err %d)\n", CASES[i].head, fill_len, CASES[i].fill,
+                    CASES[i].tail, (long)value, err);
+            test_failures++;
+        }
+    }
+    free(text);
+}
+
+int main(void) {
+    test_exhaustive_rounding();
+    test_round_trip();
+    test_edges();
+    test_malformed();
+    test_stream_end();
+    test_long_numbers();
+    return TEST_RESULT();
+}
@@ -0,0 +1,299 @@
+/**
+ * @file    test_dns_cache.c
+ * @brief   Host tests of the resolver cache with a stand-in resolver: TTL hits, background prefetch close to
+ *          expiry, stale answers when resolving fails, expiry after a failed connect and the counters
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "dns_cache.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "test_util.h"
+
+#define TTL_S 100                       // TTL reported by the stand-in resolver
+#define PREFETCH_WAIT_MS 2000           // Max wait for the prefetch task
+
+/* Stand-in resolver: each host resolves to 10.0.0.<generation>, the generation changes on demand */
+static struct {
+    uint32_t calls;         // Calls of the resolver
+    uint8_t generation;     // Last byte of the returned addresses
+    bool fail;              // Resolution fails
+    bool hold;              // Resolution waits until cleared
+    uint32_t ttl_s;         // TTL reported (0 to leave the default)
+} resolver;
+
+static esp_err_t stand_in_resolver(const char *host, const char *port, struct sockaddr_storage *addr,
+                                   socklen_t *addr_len, uint32_t *ttl_s) {
+    __atomic_add_fetch(&resolver.calls, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&resolver.hold, __ATOMIC_SEQ_CST)) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    if (__atomic_load_n(&resolver.fail, __ATOMIC_SEQ_CST)) {
+        return ESP_FAIL;
+    }
+
+    struct sockaddr_in *in = (struct sockaddr_in *)addr;
+    memset(addr, 0, sizeof(*addr));
+    in->sin_family = AF_INET;
+    in->sin_port = htons((uint16_t)atoi(port));
+    in->sin_addr.s_addr = htonl(0x0A000000 | __atomic_load_n(&resolver.generation, __ATOMIC_SEQ_CST));
+    *addr_len = sizeof(*in);
+    if (resolver.ttl_s != 0) {
+        *ttl_s = resolver.ttl_s;
+    }
+    return ESP_OK;
+}
+
+static uint32_t resolver_calls(void) {
+    return __atomic_load_n(&resolver.calls, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Resolve a host on port 443 and return the last byte of its address (-1 on error, err set).
+ */
+static int lookup(const char *host, esp_err_t *err) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = 0;
+
+    *err = dns_cache_resolve(host, "443", &addr, &addr_len);
+    if (*err != ESP_OK) {
+        return -1;
+    }
+    TEST_CHECK_EQ(addr_len, sizeof(struct sockaddr_in));
+    TEST_CHECK_EQ(ntohs(((struct sockaddr_in *)&addr)->sin_port), 443);
+    return (int)(ntohl(((struct sockaddr_in *)&addr)->sin_addr.s_addr) & 0xFF);
+}
+
+/**
+ * @brief Counters since a previous snapshot.
+ */
+static dns_cache_stats_t stats_since(const dns_cache_stats_t *before) {
+    dns_cache_stats_t now, diff;
+
+    TEST_CHECK_EQ(dns_cache_get_stats(&now), ESP_OK);
+    diff.hits = now.hits - before->hits;
+    diff.misses = now.misses - before->misses;
+    diff.stale = now.stale - before->stale;
+    diff.prefetches = now.prefetches - before->prefetches;
+    diff.failures = now.failures - before->failures;
+    return diff;
+}
+
+/**
+ * @brief Wait for the prefetch task to finish a number of refreshes since a snapshot.
+ */
+static bool wait_prefetches(const dns_cache_stats_t *before, uint32_t count) {
+    for (int waited = 0; waited < PREFETCH_WAIT_MS; waited++) {
+        if (stats_since(before).prefetches >= count) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    return false;
+}
+
+/**
+ * @brief Lookups within the TTL are answered from the cache, the first one after it resolves again.
+ */
+static void test_ttl_hit(void) {
+    dns_cache_stats_t before, diff;
+    esp_err_t err;
+
+    dns_cache_get_stats(&before);
+    resolver.generation = 1;
+    uint32_t calls = resolver_calls();
+
+    TEST_CHECK_EQ(lookup("ttl.test", &err), 1);
+    TEST_CHECK_EQ(resolver_calls(), calls + 1);
+    resolver.generation = 2;
+    TEST_CHECK_EQ(lookup("ttl.test", &err), 1);     // Cached answer, not the new address
+    TEST_CHECK_EQ(lookup("ttl.test", &err), 1);
+    TEST_CHECK_EQ(resolver_calls(), calls + 1);
+
+    /* Same host on another port is another entry */
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    TEST_CHECK_EQ(dns_cache_resolve("ttl.test", "80", &addr, &addr_len), ESP_OK);
+    TEST_CHECK_EQ(resolver_calls(), calls + 2);
+
+    host_timer_advance((int64_t)TTL_S * 1000000);
+    TEST_CHECK_EQ(lookup("ttl.test", &err), 2);
+    TEST_CHECK_EQ(resolver_calls(), calls + 3);
+
+    diff = stats_since(&before);
+    TEST_CHECK_EQ(diff.hits, 2);
+    TEST_CHECK_EQ(diff.misses, 3);
+    TEST_CHECK_EQ(diff.stale, 0);
+    TEST_CHECK_EQ(diff.failures, 0);
+}
+
+/**
+ * @brief A hit within DNS_CACHE_PREFETCH_S of the expiry refreshes the entry in the background, once.
+ */
+static void test_prefetch(void) {
+    dns_cache_stats_t before, diff;
+    esp_err_t err;
+
+    dns_cache_get_stats(&before);
+    resolver.generation = 3;
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 3);
+    uint32_t calls = resolver_calls();
+
+    /* Outside the prefetch window: plain hit */
+    host_timer_advance((int64_t)(TTL_S - DNS_CACHE_PREFETCH_S - 1) * 1000000);
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 3);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    TEST_CHECK_EQ(stats_since(&before).prefetches, 0);
+    TEST_CHECK_EQ(resolver_calls(), calls);
+
+    /* Inside the window: the lookup is answered at once and the task refreshes the entry */
+    host_timer_advance(2 * 1000000);
+    resolver.generation = 4;
+    __atomic_store_n(&resolver.hold, true, __ATOMIC_SEQ_CST);
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 3);
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 3);    // Refresh pending: no second one queued
+    __atomic_store_n(&resolver.hold, false, __ATOMIC_SEQ_CST);
+    TEST_REQUIRE(wait_prefetches(&before, 1));
+    TEST_CHECK_EQ(resolver_calls(), calls + 1);
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 4);
+
+    /* Refreshed TTL: past the original expiry the entry is still fresh */
+    host_timer_advance((int64_t)DNS_CACHE_PREFETCH_S * 1000000);
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 4);
+
+    diff = stats_since(&before);
+    TEST_CHECK_EQ(diff.prefetches, 1);
+    TEST_CHECK_EQ(diff.misses, 1);
+    TEST_CHECK_EQ(diff.hits, 5);
+    TEST_CHECK_EQ(resolver_calls(), calls + 1);
+
+    /* A failed refresh keeps the entry, which is resolved again by the first lookup after expiry */
+    dns_cache_get_stats(&before);
+    host_timer_advance((int64_t)(TTL_S - 2 * DNS_CACHE_PREFETCH_S + 1) * 1000000);   // Just inside the window
+    resolver.fail = true;
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 4);
+    TEST_REQUIRE(wait_prefetches(&before, 1));
+    resolver.fail = false;
+    resolver.generation = 5;
+    host_timer_advance((int64_t)DNS_CACHE_PREFETCH_S * 1000000);
+    TEST_CHECK_EQ(lookup("prefetch.test", &err), 5);
+    diff = stats_since(&before);
+    TEST_CHECK_EQ(diff.hits, 1);
+    TEST_CHECK_EQ(diff.misses, 1);
+}
+
+/**
+ * @brief An expired entry is served while resolving fails, up to DNS_CACHE_STALE_MAX_S past its expiry.
+ */
+static void test_stale(void) {
+    dns_cache_stats_t before, diff;
+    esp_err_t err;
+
+    dns_cache_get_stats(&before);
+    resolver.generation = 6;
+    TEST_CHECK_EQ(lookup("stale.test", &err), 6);
+
+    resolver.fail = true;
+    host_timer_advance((int64_t)TTL_S * 1000000);
+    TEST_CHECK_EQ(lookup("stale.test", &err), 6);
+    TEST_CHECK_EQ(err, ESP_OK);
+    host_timer_advance((int64_t)(DNS_CACHE_STALE_MAX_S - 1) * 1000000);
+    TEST_CHECK_EQ(lookup("stale.test", &err), 6);
+    host_timer_advance(2 * 1000000);
+    TEST_CHECK_EQ(lookup("stale.test", &err), -1);
+    TEST_CHECK_EQ(err, ESP_FAIL);
+
+    /* Unknown host with a failing resolver: no answer at all */
+    TEST_CHECK_EQ(lookup("unknown.test", &err), -1);
+    TEST_CHECK_EQ(err, ESP_FAIL);
+    resolver.fail = false;
+
+    /* Resolving works again: fresh answer */
+    resolver.generation = 7;
+    TEST_CHECK_EQ(lookup("stale.test", &err), 7);
+
+    diff = stats_since(&before);
+    TEST_CHECK_EQ(diff.stale, 2);
+    TEST_CHECK_EQ(diff.failures, 2);
+    TEST_CHECK_EQ(diff.misses, 2);
+    TEST_CHECK_EQ(diff.hits, 0);
+}
+
+/**
+ * @brief After a failed connect the address is resolved again, and kept as the stale answer.
+ */
+static void test_expire(void) {
+    dns_cache_stats_t before, diff;
+    esp_err_t err;
+
+    dns_cache_get_stats(&before);
+    resolver.generation = 8;
+    TEST_CHECK_EQ(lookup("expire.test", &err), 8);
+    uint32_t calls = resolver_calls();
+
+    dns_cache_expire("expire.test");
+    dns_cache_expire("other.test");     // Not cached: nothing to do
+    resolver.generation = 9;
+    TEST_CHECK_EQ(lookup("expire.test", &err), 9);
+    TEST_CHECK_EQ(resolver_calls(), calls + 1);
+    TEST_CHECK_EQ(lookup("expire.test", &err), 9);  // Fresh again
+    TEST_CHECK_EQ(resolver_calls(), calls + 1);
+
+    dns_cache_expire("expire.test");
+    resolver.fail = true;
+    TEST_CHECK_EQ(lookup("expire.test", &err), 9);
+    TEST_CHECK_EQ(resolver_calls(), calls + 2);
+    resolver.fail = false;
+
+    diff = stats_since(&before);
+    TEST_CHECK_EQ(diff.misses, 2);
+    TEST_CHECK_EQ(diff.hits, 1);
+    TEST_CHECK_EQ(diff.stale, 1);
+    TEST_CHECK_EQ(diff.failures, 0);
+}
+
+/**
+ * @brief A full cache replaces the entry that expires first.
+ */
+static void test_eviction(void) {
+    char host[16];
+    esp_err_t err;
+
+    host_timer_advance((int64_t)2 * DNS_CACHE_STALE_MAX_S * 1000000);   // Entries of the previous tests unusable
+    resolver.generation = 10;
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        snprintf(host, sizeof(host), "h%d.test", i);
+        TEST_CHECK_EQ(lookup(host, &err), 10);
+        host_timer_advance(1000000);
+    }
+
+    uint32_t calls = resolver_calls();
+    TEST_CHECK_EQ(lookup("new.test", &err), 10);    // Replaces h0, the oldest
+    for (int i = DNS_CACHE_ENTRIES - 1; i >= 1; i--) {
+        snprintf(host, sizeof(host), "h%d.test", i);
+        TEST_CHECK_EQ(lookup(host, &err), 10);
+    }
+    TEST_CHECK_EQ(resolver_calls(), calls + 1);
+    TEST_CHECK_EQ(lookup("h0.test", &err), 10);
+    TEST_CHECK_EQ(resolver_calls(), calls + 2);
+}
+
+int main(void) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+
+    TEST_CHECK_EQ(dns_cache_resolve("early.test", "443", &addr, &addr_len), ESP_ERR_INVALID_STATE);
+    resolver.ttl_s = TTL_S;
+    TEST_REQUIRE(dns_cache_init(stand_in_resolver) == ESP_OK);
+    TEST_CHECK_EQ(dns_cache_resolve(NULL, "443", &addr, &addr_len), ESP_ERR_INVALID_ARG);
+    TEST_CHECK_EQ(dns_cache_get_stats(NULL), ESP_ERR_INVALID_ARG);
+
+    test_ttl_hit();
+    test_prefetch();
+    test_stale();
+    test_expire();
+    test_eviction();
+    return TEST_RESULT();
+}
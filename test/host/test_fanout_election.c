@@ -0,0 +1,394 @@
+/**
+ * @file    test_fanout_election.c
+ * @brief   Host tests of the fan-out election and packets between devices exchanging signed datagrams over the
+ *          loopback interface (on a simulated clock): election, failover, packets replayed within a boot and from
+ *          an earlier boot, and packets replayed to a receiver that has just rebooted (challenge on first contact)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "fanout_election.h"
+#include "fanout_packet.h"
+#include "test_util.h"
+
+#define DEVICES 3
+#define MAX_RECORDED 64     // Datagrams recorded by the eavesdropper
+
+/* Simulated device: the steps of fanout.c with a unicast socket per device instead of the multicast group */
+typedef struct {
+    int fd;
+    uint16_t port;
+    bool running;
+    uint32_t epoch;                 // Boot counter
+    uint32_t seq;                   // Sequence number of the last packet sent
+    fanout_election_t election;
+    uint32_t received;              // Packets accepted
+    uint32_t rejected;              // Packets with a wrong size, version or signature
+    uint32_t replayed;              // Duplicate or replayed packets
+    uint32_t unverified;            // Packets of devices that have not answered a challenge yet
+    uint32_t challenges;            // Challenges sent
+    uint32_t samples;               // Samples of the leader passed on
+    int32_t last_value;             // Value of the last sample passed on
+} device_t;
+
+/* Datagrams captured on the LAN */
+typedef struct {
+    uint8_t data[MAX_RECORDED][FANOUT_PACKET_MAX_LEN];
+    size_t len[MAX_RECORDED];
+    int count;
+} recorder_t;
+
+static const uint64_t IDS[DEVICES] = {0x30, 0x10, 0x20};
+static device_t devices[DEVICES];
+static recorder_t recorder;
+static int64_t clock_ms;
+static uint64_t nonce_state = 0x9e3779b97f4a7c15;  // Stand-in for esp_random (xorshift64)
+
+static void device_boot(device_t *dev, uint64_t id, uint32_t epoch) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0};
+    socklen_t len = sizeof(addr);
+
+    if (dev->fd <= 0) {
+        dev->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        TEST_REQUIRE(dev->fd >= 0);
+        TEST_REQUIRE(bind(dev->fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+        TEST_REQUIRE(getsockname(dev->fd, (struct sockaddr *)&addr, &len) == 0);
+        dev->port = ntohs(addr.sin_port);
+    }
+    int fd = dev->fd;
+    uint16_t port = dev->port;
+    memset(dev, 0, sizeof(*dev));
+    dev->fd = fd;
+    dev->port = port;
+    dev->running = true;
+    dev->epoch = epoch;
+    fanout_election_init(&dev->election, id);
+}
+
+static void send_to_all(const uint8_t *buf, size_t len, const device_t *from) {
+    for (int i = 0; i < DEVICES; i++) {
+        if (&devices[i] == from || !devices[i].running) {
+            continue;
+        }
+        struct sockaddr_in to = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+                                 .sin_port = htons(devices[i].port)};
+        TEST_REQUIRE(sendto(from->fd, buf, len, 0, (struct sockaddr *)&to, sizeof(to)) == (ssize_t)len);
+    }
+}
+
+static uint64_t next_nonce(void) {
+    nonce_state ^= nonce_state << 13;
+    nonce_state ^= nonce_state >> 7;
+    nonce_state ^= nonce_state << 17;
+    return nonce_state;
+}
+
+/**
+ * @brief Sign a packet of the device and send it to the other devices (the eavesdropper records it).
+ */
+static void device_send_packet(device_t *dev, fanout_packet_t *pkt) {
+    uint8_t buf[FANOUT_PACKET_MAX_LEN];
+
+    pkt->sender = dev->election.self_id;
+    pkt->epoch = dev->epoch;
+    pkt->seq = ++dev->seq;
+    size_t len = fanout_packet_encode(pkt, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), buf, sizeof(buf));
+    TEST_REQUIRE(len > 0);
+    if (recorder.count < MAX_RECORDED) {
+        memcpy(recorder.data[recorder.count], buf, len);
+        recorder.len[recorder.count++] = len;
+    }
+    send_to_all(buf, len, dev);
+}
+
+static void device_send(device_t *dev, fanout_packet_type_t type, int32_t value) {
+    fanout_packet_t pkt = {.type = type, .values = {.found = 0x1, .values = {value}, .max_age_s = -1}};
+    device_send_packet(dev, &pkt);
+}
+
+/**
+ * @brief Receive the pending datagrams of a device, as fanout_receive does.
+ *
+ * @return Number of datagrams received.
+ */
+static int device_receive(device_t *dev) {
+    uint8_t buf[FANOUT_PACKET_MAX_LEN + 1];
+    fanout_packet_t pkt;
+    ssize_t len;
+    int count = 0;
+
+    while ((len = recv(dev->fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        count++;
+        if (!dev->running) {
+            continue;
+        }
+        if (fanout_packet_decode(buf, len, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), &pkt) != ESP_OK) {
+            dev->rejected++;
+            continue;
+        } else if (pkt.type == FANOUT_PACKET_CHALLENGE) {
+            if (pkt.target == dev->election.self_id) {
+                fanout_packet_t answer = {.type = FANOUT_PACKET_HELLO, .nonce = pkt.nonce};
+                device_send_packet(dev, &answer);
+            }
+            continue;
+        }
+
+        uint64_t echo = (pkt.type == FANOUT_PACKET_HELLO) ? pkt.nonce : 0;
+        fanout_heard_t heard = fanout_election_heard(&dev->election, pkt.sender, pkt.epoch, pkt.seq, echo, clock_ms);
+        if (heard == FANOUT_HEARD_UNVERIFIED) {
+            dev->unverified++;
+            uint64_t nonce = next_nonce();
+            if (fanout_election_challenge(&dev->election, pkt.sender, nonce, clock_ms)) {
+                fanout_packet_t challenge = {.type = FANOUT_PACKET_CHALLENGE, .target = pkt.sender, .nonce = nonce};
+                device_send_packet(dev, &challenge);
+                dev->challenges++;
+            }
+            continue;
+        } else if (heard == FANOUT_HEARD_REPLAYED) {
+            dev->replayed++;
+            continue;
+        }
+        dev->received++;
+        if (pkt.type == FANOUT_PACKET_SAMPLE && pkt.sender == fanout_election_leader(&dev->election, clock_ms)) {
+            dev->samples++;
+            dev->last_value = pkt.values.values[0];
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Let every device receive until the LAN is quiet (challenges and their answers included).
+ */
+static void receive_all(void) {
+    int count;
+    do {
+        count = 0;
+        for (int i = 0; i < DEVICES; i++) {
+            count += device_receive(&devices[i]);
+        }
+    } while (count > 0);
+}
+
+/**
+ * @brief Let every running device announce itself each FANOUT_HELLO_MS until the given time.
+ */
+static void run_until(int64_t end_ms) {
+    while (clock_ms < end_ms) {
+        for (int i = 0; i < DEVICES; i++) {
+            if (devices[i].running) {
+                device_send(&devices[i], FANOUT_PACKET_HELLO, 0);
+            }
+        }
+        receive_all();
+        clock_ms += FANOUT_HELLO_MS;
+    }
+}
+
+/**
+ * @brief Count the recorded packets accounted for by the election (challenges are only answered).
+ */
+static int count_accountable(int from, int to) {
+    int count = 0;
+    for (int r = from; r < to; r++) {
+        count += (recorder.data[r][5] != FANOUT_PACKET_CHALLENGE);
+    }
+    return count;
+}
+
+static uint64_t leader_of(int i) {
+    return fanout_election_leader(&devices[i].election, clock_ms);
+}
+
+/**
+ * @brief The devices agree on the lowest ID, the samples of the leader reach the others, and the next lowest ID
+ *        takes over once the leader is silent.
+ */
+static void test_election_and_failover(void) {
+    clock_ms = 0;
+    for (int i = 0; i < DEVICES; i++) {
+        device_boot(&devices[i], IDS[i], 1);
+    }
+    run_until(FANOUT_LEADER_TIMEOUT_MS);
+    for (int i = 0; i < DEVICES; i++) {
+        TEST_CHECK_EQ(leader_of(i), 0x10);
+    }
+
+    device_send(&devices[1], FANOUT_PACKET_SAMPLE, 4999);
+    receive_all();
+    TEST_CHECK_EQ(devices[0].samples, 1);
+    TEST_CHECK_EQ(devices[2].samples, 1);
+    TEST_CHECK_EQ(devices[0].last_value, 4999);
+
+    device_send(&devices[2], FANOUT_PACKET_SAMPLE, 1234);     // Not the leader: ignored
+    receive_all();
+    TEST_CHECK_EQ(devices[0].samples, 1);
+
+    devices[1].running = false;
+    run_until(clock_ms + FANOUT_LEADER_TIMEOUT_MS + FANOUT_HELLO_MS);
+    TEST_CHECK_EQ(leader_of(0), 0x20);
+    TEST_CHECK_EQ(leader_of(2), 0x20);
+    for (int i = 0; i < DEVICES; i++) {
+        TEST_CHECK_EQ(devices[i].rejected + devices[i].replayed, 0);
+    }
+}
+
+/**
+ * @brief Packets recorded during an earlier boot of the leader, or replayed within its current boot, are dropped,
+ *        also after the leader has gone silent.
+ */
+static void test_replay(void) {
+    clock_ms = 0;
+    recorder.count = 0;
+    for (int i = 0; i < DEVICES; i++) {
+        device_boot(&devices[i], IDS[i], 7);
+    }
+    run_until(FANOUT_LEADER_TIMEOUT_MS);
+    device_send(&devices[1], FANOUT_PACKET_SAMPLE, 4990);
+    device_send(&devices[1], FANOUT_PACKET_SAMPLE, 4995);
+    receive_all();
+    TEST_CHECK_EQ(devices[0].last_value, 4995);
+    int first_boot = recorder.count;
+
+    /* The leader reboots: the boot counter grows and the sequence restarts */
+    device_boot(&devices[1], IDS[1], 8);
+    device_send(&devices[1], FANOUT_PACKET_HELLO, 0);
+    device_send(&devices[1], FANOUT_PACKET_SAMPLE, 5002);
+    receive_all();
+    TEST_CHECK_EQ(devices[0].last_value, 5002);
+    uint32_t samples = devices[0].samples;
+
+    /* Everything recorded during the first boot (sequence numbers above the current ones included) */
+    for (int r = 0; r < first_boot; r++) {
+        send_to_all(recorder.data[r], recorder.len[r], &devices[2]);
+    }
+    receive_all();
+    TEST_CHECK_EQ(devices[0].samples, samples);
+    TEST_CHECK_EQ(devices[0].last_value, 5002);
+
+    /* The current boot, replayed */
+    for (int r = first_boot; r < recorder.count; r++) {
+        send_to_all(recorder.data[r], recorder.len[r], &devices[2]);
+    }
+    receive_all();
+    TEST_CHECK_EQ(devices[0].samples, samples);
+
+    /* The leader goes silent: its packets are still recognised as replayed */
+    devices[1].running = false;
+    run_until(clock_ms + FANOUT_LEADER_TIMEOUT_MS + FANOUT_HELLO_MS);
+    TEST_CHECK_EQ(leader_of(0), 0x20);
+    uint32_t replayed = devices[0].replayed;
+    for (int r = 0; r < first_boot + 2; r++) {
+        send_to_all(recorder.data[r], recorder.len[r], &devices[2]);
+    }
+    receive_all();
+    TEST_CHECK_EQ(devices[0].replayed - replayed, count_accountable(0, first_boot + 2));
+    TEST_CHECK_EQ(leader_of(0), 0x20);
+    TEST_CHECK_EQ(devices[0].last_value, 5002);
+}
+
+/**
+ * @brief A receiver that has just rebooted knows no epoch to compare with: recordings of a device that is off
+ *        (its samples, hellos and answers to earlier challenges) are never accepted, however long they are
+ *        replayed, while devices that answer the challenges are verified at once.
+ */
+static void test_replay_after_reboot(void) {
+    clock_ms = 0;
+    recorder.count = 0;
+    for (int i = 0; i < DEVICES; i++) {
+        device_boot(&devices[i], IDS[i], 3);
+    }
+    run_until(FANOUT_LEADER_TIMEOUT_MS);
+    TEST_CHECK_EQ(leader_of(0), 0x10);
+    TEST_CHECK(devices[0].challenges >= 2);     // Both other devices challenged on first contact
+    device_send(&devices[1], FANOUT_PACKET_SAMPLE, 4990);
+    device_send(&devices[1], FANOUT_PACKET_SAMPLE, 4995);
+    receive_all();
+    TEST_CHECK_EQ(devices[0].last_value, 4995);
+    int recorded = recorder.count;
+
+    /* The leader is off and the receiver reboots */
+    devices[1].running = false;
+    device_boot(&devices[0], IDS[0], 4);
+    for (int round = 0; round < 2 * FANOUT_LEADER_TIMEOUT_MS / FANOUT_HELLO_MS; round++) {
+        device_send(&devices[2], FANOUT_PACKET_HELLO, 0);
+        for (int r = 0; r < recorded; r++) {
+            send_to_all(recorder.data[r], recorder.len[r], &devices[2]);
+        }
+        receive_all();
+        clock_ms += FANOUT_HELLO_MS;
+    }
+    TEST_CHECK_EQ(devices[0].samples, 0);
+    TEST_CHECK_EQ(leader_of(0), 0x20);          // The device answering its challenge, not the replayed leader
+    TEST_CHECK(devices[0].unverified > 0);
+    TEST_CHECK(devices[0].challenges >= 2);
+
+    /* The leader is back (same boot): it answers the challenge and leads again, replays stay ineffective */
+    devices[1].running = true;
+    run_until(clock_ms + FANOUT_HELLO_MS);
+    TEST_CHECK_EQ(leader_of(0), 0x10);
+    device_send(&devices[1], FANOUT_PACKET_SAMPLE, 5003);
+    receive_all();
+    TEST_CHECK_EQ(devices[0].samples, 1);
+    TEST_CHECK_EQ(devices[0].last_value, 5003);
+    for (int r = 0; r < recorded; r++) {
+        send_to_all(recorder.data[r], recorder.len[r], &devices[2]);
+    }
+    receive_all();
+    TEST_CHECK_EQ(devices[0].samples, 1);
+    TEST_CHECK_EQ(devices[0].last_value, 5003);
+}
+
+/**
+ * @brief Tampered packets and packets signed with another key are rejected.
+ */
+static void test_signature(void) {
+    uint8_t buf[FANOUT_PACKET_MAX_LEN];
+    fanout_packet_t pkt = {.type = FANOUT_PACKET_SAMPLE, .sender = 0x10, .epoch = 9, .seq = 1,
+                           .values = {.found = 0x1, .values = {5000}}};
+    fanout_packet_t out;
+
+    size_t len = fanout_packet_encode(&pkt, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), buf, sizeof(buf));
+    TEST_REQUIRE(len == FANOUT_PACKET_MAX_LEN);
+    TEST_CHECK_EQ(fanout_packet_decode(buf, len, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), &out), ESP_OK);
+    TEST_CHECK_EQ(out.epoch, 9);
+    TEST_CHECK_EQ(out.values.values[0], 5000);
+    TEST_CHECK_EQ(fanout_packet_decode(buf, len, (const uint8_t *)"other-key", 9, &out), ESP_ERR_INVALID_CRC);
+
+    for (size_t i = 8; i < len; i++) {     // Sender, epoch, sequence number, values and MAC
+        buf[i] ^= 0x01;
+        TEST_CHECK_EQ(fanout_packet_decode(buf, len, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), &out),
+                      ESP_ERR_INVALID_CRC);
+        buf[i] ^= 0x01;
+    }
+    TEST_CHECK_EQ(fanout_packet_decode(buf, len - 1, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), &out),
+                  ESP_ERR_INVALID_SIZE);
+
+    fanout_packet_t challenge = {.type = FANOUT_PACKET_CHALLENGE, .sender = 0x30, .epoch = 2, .seq = 5,
+                                 .target = 0x10, .nonce = 0x0123456789abcdefull};
+    len = fanout_packet_encode(&challenge, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), buf, sizeof(buf));
+    TEST_REQUIRE(len == FANOUT_PACKET_HEADER_LEN + FANOUT_PACKET_CHALLENGE_LEN + FANOUT_PACKET_MAC_LEN);
+    TEST_CHECK_EQ(fanout_packet_decode(buf, len, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), &out), ESP_OK);
+    TEST_CHECK_EQ(out.type, FANOUT_PACKET_CHALLENGE);
+    TEST_CHECK_EQ(out.target, 0x10);
+    TEST_CHECK(out.nonce == challenge.nonce);
+    buf[5] = 0x04;      // Unknown type
+    TEST_CHECK_EQ(fanout_packet_decode(buf, len, (const uint8_t *)FANOUT_KEY, strlen(FANOUT_KEY), &out),
+                  ESP_ERR_INVALID_SIZE);
+}
+
+int main(void) {
+    test_election_and_failover();
+    test_replay();
+    test_replay_after_reboot();
+    test_signature();
+    for (int i = 0; i < DEVICES; i++) {
+        close(devices[i].fd);
+    }
+    return TEST_RESULT();
+}
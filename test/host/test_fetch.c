@@ -0,0 +1,165 @@
+/**
+ * @file    test_fetch.c
+ * @brief   Host test of the fetch task on the POSIX FreeRTOS stand-in with an injected fetch function: sequence
+ *          numbers and timestamps of the published samples, periods measured from the fetch start without drift,
+ *          and failed polls published as error samples
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "esp_timer.h"
+#include "fetch.h"
+#include "fetch_mock.h"
+#include "freertos/task.h"
+#include "test_util.h"
+
+#define SOURCE_COUNT 2
+#define MAX_CALLS 64            // Calls recorded per source
+#define RUN_MS 1050             // Time the task runs before the records are checked
+#define JITTER_US 20000         // Allowed lateness of a poll (thread wake-up on a loaded machine)
+#define FAILING_CALL 3          // Call of source 0 that fails
+
+/* Stand-in fetch of one source: duration and the calls seen */
+typedef struct {
+    uint32_t duration_ms;                   // Time the fetch takes
+    uint32_t calls;                         // Calls recorded
+    int64_t start_us[MAX_CALLS];            // Start of each call
+    esp_err_t err[MAX_CALLS];               // Result returned by each call
+    esp_err_t latest_err[MAX_CALLS];        // fetch_get_latest at the start of each call
+    fetch_sample_t latest[MAX_CALLS];       // Sample published before each call
+} stand_in_t;
+
+static const data_scraping_source_t SOURCES[SOURCE_COUNT] = {
+    {"fast", "localhost", "443", "/a", SOURCE_FORMAT_HTML, NULL, NULL, 1, 100, 100, 100, 0, NULL},
+    {"slow", "localhost", "443", "/b", SOURCE_FORMAT_HTML, NULL, NULL, 1, 250, 250, 250, 1, NULL},
+};
+
+static stand_in_t stand_ins[SOURCE_COUNT] = {{.duration_ms = 30}, {.duration_ms = 10}};
+static volatile bool recording = true;  // Cleared before the records are checked (the task keeps running)
+
+/**
+ * @brief Value returned by a call (different for each call of each source).
+ */
+static int32_t call_value(uint8_t index, uint32_t call) {
+    return 1000 * (index + 1) + (int32_t)call;
+}
+
+/**
+ * @brief Injected fetch function: records the sample published so far, takes its duration and returns a value
+ *        (or an error on FAILING_CALL of source 0).
+ */
+static esp_err_t fetch_stand_in(const data_scraping_source_t *source, data_scraping_values_t *values) {
+    uint8_t index = (uint8_t)(source - SOURCES);
+    stand_in_t *s = &stand_ins[index];
+    uint32_t call = s->calls;
+    esp_err_t err = (index == 0 && call == FAILING_CALL) ? ESP_ERR_TIMEOUT : ESP_OK;
+
+    if (recording && call < MAX_CALLS) {
+        s->start_us[call] = esp_timer_get_time();
+        s->latest_err[call] = fetch_get_latest(index, &s->latest[call], 0);
+        s->err[call] = err;
+        s->calls++;
+    }
+    vTaskDelay(pdMS_TO_TICKS(s->duration_ms));
+
+    values->found = 1;              // Left in place on error: the task must clear it
+    values->values[0] = call_value(index, call);
+    values->max_age_s = -1;
+    return err;
+}
+
+/**
+ * @brief Arguments and state checks before the task is started.
+ */
+static void test_init_args(void) {
+    fetch_sample_t sample;
+
+    TEST_CHECK_EQ(fetch_get_latest(0, &sample, 0), ESP_ERR_INVALID_STATE);
+    TEST_CHECK_EQ(fetch_init(NULL, 1, fetch_stand_in), ESP_ERR_INVALID_ARG);
+    TEST_CHECK_EQ(fetch_init(SOURCES, 0, fetch_stand_in), ESP_ERR_INVALID_ARG);
+    TEST_CHECK_EQ(fetch_init(SOURCES, FETCH_MAX_SOURCES + 1, fetch_stand_in), ESP_ERR_INVALID_ARG);
+    TEST_CHECK_EQ(fetch_init(SOURCES, SOURCE_COUNT, NULL), ESP_ERR_INVALID_ARG);
+}
+
+/**
+ * @brief Each call sees the sample of the previous call of its source: the next sequence number, the start of
+ *        that call as its timestamp, its duration and its values (none for the failed call).
+ */
+static void check_samples(uint8_t index) {
+    const stand_in_t *s = &stand_ins[index];
+
+    TEST_CHECK_EQ(s->latest_err[0], ESP_ERR_NOT_FOUND);     // Nothing published before the first fetch
+    for (uint32_t k = 1; k < s->calls; k++) {
+        const fetch_sample_t *sample = &s->latest[k];
+        TEST_CHECK_EQ(s->latest_err[k], ESP_OK);
+        TEST_CHECK_EQ(sample->source, index);
+        TEST_CHECK_EQ(sample->seq, k);
+        TEST_CHECK(!sample->pushed);
+        TEST_CHECK(s->start_us[k - 1] - sample->timestamp_us >= 0 &&
+                   s->start_us[k - 1] - sample->timestamp_us < 1000);     // Taken just before the call
+        TEST_CHECK(sample->duration_us >= (int64_t)s->duration_ms * 1000 &&
+                   sample->duration_us < (int64_t)s->duration_ms * 1000 + JITTER_US);
+        TEST_CHECK_EQ(sample->err, s->err[k - 1]);
+        if (s->err[k - 1] == ESP_OK) {
+            TEST_CHECK_EQ(sample->values.found, 1);
+            TEST_CHECK_EQ(sample->values.values[0], call_value(index, k - 1));
+        } else {
+            TEST_CHECK_EQ(sample->values.found, 0);             // Error sample: no values
+            TEST_CHECK_EQ(sample->values.values[0], 0);
+        }
+    }
+}
+
+/**
+ * @brief Call k starts k intervals after the start (both sources are due at once, the first one is polled first):
+ *        neither the fetch duration nor a poll delayed by the other source shifts the later ones.
+ */
+static void check_period(uint8_t index) {
+    const stand_in_t *s = &stand_ins[index];
+    int64_t start_us = stand_ins[0].start_us[0];
+    int64_t interval_us = (int64_t)SOURCES[index].interval_ms * 1000;
+    int64_t max_late_us = JITTER_US + ((index > 0) ? (int64_t)stand_ins[0].duration_ms * 1000 : 0);
+
+    for (uint32_t k = 0; k < s->calls; k++) {
+        int64_t late_us = s->start_us[k] - start_us - k * interval_us;
+        if (late_us < -1000 || late_us > max_late_us) {
+            fprintf(stderr, "source %u call %u: %lld us late\n", (unsigned)index, (unsigned)k, (long long)late_us);
+            test_failures++;
+        }
+    }
+}
+
+/**
+ * @brief Run the task for RUN_MS, then check what each fetch saw.
+ */
+static void test_fetch_task(void) {
+    fetch_sample_t sample;
+
+    TEST_REQUIRE(fetch_init(SOURCES, SOURCE_COUNT, fetch_stand_in) == ESP_OK);
+    TEST_CHECK_EQ(fetch_init(SOURCES, SOURCE_COUNT, fetch_stand_in), ESP_ERR_INVALID_STATE);
+    TEST_CHECK_EQ(fetch_get_latest(SOURCE_COUNT, &sample, 0), ESP_ERR_INVALID_ARG);
+    TEST_CHECK_EQ(fetch_get_latest(0, &sample, pdMS_TO_TICKS(500)), ESP_OK);   // Waits for the first sample
+    TEST_CHECK_EQ(sample.seq, 1);
+
+    vTaskDelay(pdMS_TO_TICKS(RUN_MS));
+    recording = false;
+    vTaskDelay(pdMS_TO_TICKS(100));     // Let a fetch in progress finish recording
+
+    TEST_CHECK(stand_ins[0].calls >= RUN_MS / 100 && stand_ins[0].calls <= RUN_MS / 100 + 2);
+    TEST_CHECK(stand_ins[1].calls >= RUN_MS / 250 && stand_ins[1].calls <= RUN_MS / 250 + 2);
+    TEST_REQUIRE(stand_ins[0].calls > FAILING_CALL + 1);
+    for (uint8_t i = 0; i < SOURCE_COUNT; i++) {
+        check_samples(i);
+        check_period(i);
+    }
+    TEST_CHECK_EQ(fetch_mock.fanout_inits, 0);      // FETCH_FANOUT and FETCH_PUSH are off
+    TEST_CHECK_EQ(fetch_mock.push_inits, 0);
+    TEST_CHECK_EQ(fetch_mock.fanout_published, 0);
+}
+
+int main(void) {
+    test_init_args();
+    test_fetch_task();
+    return TEST_RESULT();
+}
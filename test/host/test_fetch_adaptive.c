@@ -0,0 +1,133 @@
+/**
+ * @file    test_fetch_adaptive.c
+ * @brief   Host tests of the adaptive poll interval: convergence of the volatility EWMA, interval decisions and
+ *          the interval after failed fetches
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "fetch_adaptive.h"
+#include "test_util.h"
+
+#define BASE_MS 30000
+#define UNIT (1 << FETCH_ADAPTIVE_FRAC_BITS)    // One scaled unit of volatility
+#define SETTLE (20 << FETCH_VOLATILITY_SHIFT)   // Samples for the EWMA to settle after a step of the change
+
+static data_scraping_values_t sample(int32_t value, int32_t max_age_s) {
+    data_scraping_values_t v = {.found = 0x1, .max_age_s = max_age_s};
+    v.values[0] = value;
+    return v;
+}
+
+/**
+ * @brief Feed samples whose value alternates by a constant change.
+ */
+static void feed_change(fetch_adaptive_t *a, uint32_t change, int count) {
+    for (int i = 0; i < count; i++) {
+        data_scraping_values_t v = sample(5000 + ((a->last.values[0] == 5000) ? (int32_t)change : 0), -1);
+        fetch_adaptive_update(a, ESP_OK, &v);
+    }
+}
+
+/**
+ * @brief A constant change is reached within half a unit, coming from below and from above.
+ */
+static void test_ewma_converges(void) {
+    fetch_adaptive_t a;
+    int stuck = 0;
+
+    for (uint32_t change = 0; change <= 3 * FETCH_VOLATILITY_HIGH; change++) {
+        for (uint32_t from = 0; from <= 3 * FETCH_VOLATILITY_HIGH; from += FETCH_VOLATILITY_HIGH) {
+            fetch_adaptive_init(&a, BASE_MS, 1000, 600000);
+            feed_change(&a, from, 10 * SETTLE);
+            feed_change(&a, change, 10 * SETTLE);
+            int64_t error = (int64_t)a.volatility - (int64_t)change * UNIT;
+            if (error < -UNIT / 2 || error > UNIT / 2) {
+                if (stuck++ < 10) {
+                    fprintf(stderr, "change %u from %u: volatility %u/%d\n", change, from, a.volatility, UNIT);
+                }
+            }
+        }
+    }
+    TEST_CHECK_EQ(stuck, 0);
+
+    /* Volatility back below the low threshold once the values stop changing */
+    fetch_adaptive_init(&a, BASE_MS, 1000, 600000);
+    feed_change(&a, 100, SETTLE);
+    feed_change(&a, 0, 2 * SETTLE);
+    TEST_CHECK(a.volatility < (uint32_t)FETCH_VOLATILITY_LOW * UNIT);
+}
+
+/**
+ * @brief Volatile values halve the interval down to the minimum, stable values grow it up to the maximum, and
+ *        a longer max-age stretches it.
+ */
+static void test_interval_decisions(void) {
+    fetch_adaptive_t a;
+    data_scraping_values_t v = sample(5000, -1);
+
+    fetch_adaptive_init(&a, BASE_MS, 10000, 300000);
+    TEST_CHECK_EQ(fetch_adaptive_update(&a, ESP_OK, &v), FETCH_ADAPTIVE_HOLD);     // First sample
+    TEST_CHECK_EQ(a.interval_ms, BASE_MS);
+
+    feed_change(&a, 10 * FETCH_VOLATILITY_HIGH, SETTLE);
+    TEST_CHECK_EQ(a.interval_ms, 10000);
+    v = sample(a.last.values[0] == 5000 ? 6000 : 5000, -1);
+    TEST_CHECK_EQ(fetch_adaptive_update(&a, ESP_OK, &v), FETCH_ADAPTIVE_VOLATILE);
+
+    feed_change(&a, 0, 3 * SETTLE);
+    TEST_CHECK_EQ(a.interval_ms, 300000);
+    v = a.last;
+    TEST_CHECK_EQ(fetch_adaptive_update(&a, ESP_OK, &v), FETCH_ADAPTIVE_STABLE);
+
+    fetch_adaptive_init(&a, BASE_MS, 10000, 300000);
+    v = sample(5000, 120);
+    TEST_CHECK_EQ(fetch_adaptive_update(&a, ESP_OK, &v), FETCH_ADAPTIVE_MAX_AGE);
+    TEST_CHECK_EQ(a.interval_ms, 120000);
+    v = sample(5000, 3600);
+    TEST_CHECK_EQ(fetch_adaptive_update(&a, ESP_OK, &v), FETCH_ADAPTIVE_MAX_AGE);
+    TEST_CHECK_EQ(a.interval_ms, 300000);
+}
+
+/**
+ * @brief A failed fetch brings a stretched interval back to the base one, further failures double it up to the
+ *        maximum, and a successful fetch ends the back-off.
+ */
+static void test_error_backoff(void) {
+    static const uint32_t EXPECTED_MS[] = {BASE_MS, 2 * BASE_MS, 4 * BASE_MS, 8 * BASE_MS, 300000, 300000};
+    fetch_adaptive_t a;
+    data_scraping_values_t v = sample(5000, 3600);
+
+    fetch_adaptive_init(&a, BASE_MS, 10000, 300000);
+    fetch_adaptive_update(&a, ESP_OK, &v);
+    TEST_CHECK_EQ(a.interval_ms, 300000);
+
+    for (size_t i = 0; i < sizeof(EXPECTED_MS) / sizeof(EXPECTED_MS[0]); i++) {
+        TEST_CHECK_EQ(fetch_adaptive_update(&a, ESP_FAIL, &v), FETCH_ADAPTIVE_ERROR);
+        TEST_CHECK_EQ(a.interval_ms, EXPECTED_MS[i]);
+    }
+    for (int i = 0; i < 300; i++) {
+        fetch_adaptive_update(&a, ESP_ERR_TIMEOUT, &v);
+    }
+    TEST_CHECK_EQ(a.interval_ms, 300000);
+
+    v = sample(5000, -1);
+    fetch_adaptive_update(&a, ESP_OK, &v);
+    TEST_CHECK_EQ(fetch_adaptive_update(&a, ESP_FAIL, &v), FETCH_ADAPTIVE_ERROR);
+    TEST_CHECK_EQ(a.interval_ms, BASE_MS);
+
+    /* A volatile source shortened below the base interval also retries at the base interval */
+    fetch_adaptive_init(&a, BASE_MS, 10000, 300000);
+    feed_change(&a, 10 * FETCH_VOLATILITY_HIGH, SETTLE);
+    TEST_CHECK_EQ(a.interval_ms, 10000);
+    fetch_adaptive_update(&a, ESP_FAIL, &v);
+    TEST_CHECK_EQ(a.interval_ms, BASE_MS);
+}
+
+int main(void) {
+    test_ewma_converges();
+    test_interval_decisions();
+    test_error_backoff();
+    return TEST_RESULT();
+}
@@ -0,0 +1,282 @@
+/**
+ * @file    test_fetch_push.c
+ * @brief   Host test of the MQTT subscription through the fetch task against a stand-in broker on loopback: latency
+ *          from publishing a message to the value being visible to the display loop, the duration of the pushed
+ *          samples, polling suspended while subscribed and resumed when the broker goes away, and nothing started by
+ *          an init that fails
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_timer.h"
+#include "fetch.h"
+#include "fetch_mock.h"
+#include "fetch_push.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+#include "test_util.h"
+
+#define TOPIC "grid/freq"
+#define INTERVAL_MS 200         // Poll interval of the source (messages are stale after 2 intervals)
+#define MESSAGES 50             // Messages published in the latency test
+#define PUBLISH_GAP_MS 20       // Time between messages (several per poll interval)
+#define MAX_LATENCY_US 50000    // Limit of the publish-to-display latency on a loaded machine
+
+/* Stand-in broker: a single client, CONNECT and SUBSCRIBE acknowledged, PUBLISH sent by the test */
+typedef struct {
+    int listen_fd;
+    int fd;                     // Connection of the client (-1 if none)
+    uint16_t port;
+} broker_t;
+
+static const data_scraping_source_t SOURCES[] = {
+    {"grid", "localhost", "443", "/", SOURCE_FORMAT_HTML, NULL, NULL, 1, INTERVAL_MS, INTERVAL_MS, INTERVAL_MS, 0,
+     TOPIC},
+};
+
+static volatile uint32_t polls = 0;     // Calls of the poll stand-in
+
+/**
+ * @brief Poll stand-in (the values are recognisable as polled ones).
+ */
+static esp_err_t poll_stand_in(const data_scraping_source_t *source, data_scraping_values_t *values) {
+    polls++;
+    values->found = 1;
+    values->values[0] = -1;
+    values->max_age_s = -1;
+    return ESP_OK;
+}
+
+static void broker_start(broker_t *b) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK), .sin_port = 0};
+    socklen_t len = sizeof(addr);
+
+    b->fd = -1;
+    b->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_REQUIRE(b->listen_fd >= 0);
+    TEST_REQUIRE(bind(b->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    TEST_REQUIRE(listen(b->listen_fd, 1) == 0);
+    TEST_REQUIRE(getsockname(b->listen_fd, (struct sockaddr *)&addr, &len) == 0);
+    b->port = ntohs(addr.sin_port);
+}
+
+/**
+ * @brief Read one packet of the client (remaining length below 128 bytes).
+ *
+ * @return Packet type, -1 if the connection is closed.
+ */
+static int broker_read(broker_t *b, uint8_t *body, size_t size, size_t *len) {
+    uint8_t head[2];
+
+    if (recv(b->fd, head, 2, MSG_WAITALL) != 2 || head[1] > size) {
+        return -1;
+    }
+    *len = head[1];
+    if (*len > 0 && recv(b->fd, body, *len, MSG_WAITALL) != (ssize_t)*len) {
+        return -1;
+    }
+    return head[0];
+}
+
+/**
+ * @brief Accept the client, acknowledge its CONNECT and its SUBSCRIBE to TOPIC.
+ */
+static void broker_accept(broker_t *b) {
+    static const uint8_t CONNACK[] = {0x20, 2, 0, 0};
+    uint8_t body[128];
+    size_t len;
+    int one = 1;
+
+    b->fd = accept(b->listen_fd, NULL, NULL);
+    TEST_REQUIRE(b->fd >= 0);
+    setsockopt(b->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    TEST_REQUIRE(broker_read(b, body, sizeof(body), &len) == 0x10);
+    TEST_CHECK(len >= 10 && memcmp(body + 2, "MQTT", 4) == 0 && body[6] == 4);
+    TEST_REQUIRE(send(b->fd, CONNACK, sizeof(CONNACK), 0) == sizeof(CONNACK));
+
+    TEST_REQUIRE(broker_read(b, body, sizeof(body), &len) == 0x82);
+    TEST_REQUIRE(len == 2 + 2 + strlen(TOPIC) + 1);
+    TEST_CHECK(memcmp(body + 4, TOPIC, strlen(TOPIC)) == 0);
+    TEST_CHECK_EQ(body[len - 1], 0);     // QoS 0
+    uint8_t suback[] = {0x90, 3, body[0], body[1], 0};
+    TEST_REQUIRE(send(b->fd, suback, sizeof(suback), 0) == sizeof(suback));
+}
+
+/**
+ * @brief Publish a message on a topic to the client (QoS 0).
+ */
+static void broker_publish(broker_t *b, const char *topic, const char *payload) {
+    uint8_t packet[128];
+    size_t topic_len = strlen(topic), payload_len = strlen(payload), len = 0;
+
+    packet[len++] = 0x30;
+    packet[len++] = (uint8_t)(2 + topic_len + payload_len);
+    packet[len++] = 0;
+    packet[len++] = (uint8_t)topic_len;
+    memcpy(packet + len, topic, topic_len);
+    len += topic_len;
+    memcpy(packet + len, payload, payload_len);
+    len += payload_len;
+    TEST_REQUIRE(send(b->fd, packet, len, 0) == (ssize_t)len);
+}
+
+/**
+ * @brief Wait until the subscription counters reach a number of connects and messages.
+ */
+static bool wait_stats(uint32_t connects, uint32_t messages, uint32_t timeout_ms) {
+    fetch_push_stats_t stats;
+
+    for (uint32_t t = 0; t < timeout_ms; t++) {
+        fetch_push_get_stats(&stats);
+        if (stats.connects >= connects && stats.messages >= messages) {
+            return true;
+        }
+        vTaskDelay(1);
+    }
+    return false;
+}
+
+/**
+ * @brief A failed fetch_init starts neither the fan-out nor the MQTT client (both would publish into the deleted
+ *        mailboxes), and a later init succeeds.
+ */
+static void test_init_failure(broker_t *b) {
+    struct pollfd pfd = {.fd = b->listen_fd, .events = POLLIN};
+
+    host_task_create_failures = 1;
+    TEST_CHECK_EQ(fetch_init(SOURCES, 1, poll_stand_in), ESP_ERR_NO_MEM);
+    TEST_CHECK_EQ(fetch_mock.fanout_inits, 0);
+    TEST_CHECK_EQ(poll(&pfd, 1, 2 * HOST_MQTT_RECONNECT_MS), 0);    // No connection to the broker
+
+    TEST_REQUIRE(fetch_init(SOURCES, 1, poll_stand_in) == ESP_OK);
+    TEST_CHECK_EQ(fetch_mock.fanout_inits, 1);
+    TEST_CHECK(fetch_mock.fanout_cb != NULL);
+}
+
+static int compare_us(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Publish MESSAGES values and measure when each becomes visible through fetch_get_latest, read every
+ *        millisecond like the display loop of main.c.
+ */
+static void test_latency(broker_t *b) {
+    int64_t latency_us[MESSAGES];
+    fetch_sample_t sample;
+    char payload[16];
+    uint32_t last_seq = 0;
+
+    uint32_t polls_before = polls;
+    for (int i = 0; i < MESSAGES; i++) {
+        int32_t value = 4990 + i;
+        snprintf(payload, sizeof(payload), "%ld", (long)value);
+        int64_t publish_us = esp_timer_get_time();
+        broker_publish(b, TOPIC, payload);
+
+        int64_t seen_us = 0;
+        while (seen_us == 0 && esp_timer_get_time() - publish_us < 1000000) {
+            if (fetch_get_latest(0, &sample, 0) == ESP_OK && sample.pushed && sample.values.values[0] == value) {
+                seen_us = esp_timer_get_time();
+            } else {
+                vTaskDelay(1);
+            }
+        }
+        TEST_REQUIRE(seen_us != 0);
+        latency_us[i] = seen_us - publish_us;
+
+        TEST_CHECK_EQ(sample.err, ESP_OK);
+        TEST_CHECK(sample.seq > last_seq);
+        TEST_CHECK(sample.timestamp_us >= publish_us && sample.timestamp_us <= seen_us);
+        TEST_CHECK(sample.duration_us > 0);                                     // Measured before publishing
+        TEST_CHECK(sample.timestamp_us + sample.duration_us <= seen_us);
+        last_seq = sample.seq;
+        vTaskDelay(pdMS_TO_TICKS(PUBLISH_GAP_MS));
+    }
+    TEST_CHECK_EQ(polls, polls_before);     // Subscribed and fresh: not polled
+
+    qsort(latency_us, MESSAGES, sizeof(latency_us[0]), compare_us);
+    printf("Publish to display over loopback (%d messages): median %lld us, p90 %lld us, max %lld us\n", MESSAGES,
+           (long long)latency_us[MESSAGES / 2], (long long)latency_us[MESSAGES * 9 / 10],
+           (long long)latency_us[MESSAGES - 1]);
+    TEST_CHECK(latency_us[MESSAGES - 1] < MAX_LATENCY_US);
+
+    fetch_push_stats_t stats;
+    TEST_CHECK_EQ(fetch_push_get_stats(&stats), ESP_OK);
+    TEST_CHECK_EQ(stats.messages, MESSAGES);
+    TEST_CHECK_EQ(stats.dropped, 0);
+}
+
+/**
+ * @brief Messages on other topics and longer than FETCH_PUSH_PAYLOAD_MAX are dropped, malformed ones keep the
+ *        last good sample.
+ */
+static void test_dropped(broker_t *b) {
+    fetch_push_stats_t before, after;
+    fetch_sample_t sample, latest;
+
+    fetch_push_get_stats(&before);
+    TEST_REQUIRE(fetch_get_latest(0, &latest, 0) == ESP_OK);
+    broker_publish(b, "grid/other", "5000");
+    broker_publish(b, TOPIC, "not a number");
+    vTaskDelay(pdMS_TO_TICKS(50));
+
+    fetch_push_get_stats(&after);
+    TEST_CHECK_EQ(after.dropped, before.dropped + 1);     // Other topic
+    TEST_CHECK_EQ(after.messages, before.messages + 1);   // Queued, then rejected by the extractor
+    TEST_REQUIRE(fetch_get_latest(0, &sample, 0) == ESP_OK);
+    TEST_CHECK_EQ(sample.seq, latest.seq);
+}
+
+/**
+ * @brief A lost broker resumes polling, the client reconnects and subscribes again on its own.
+ */
+static void test_disconnect(broker_t *b) {
+    fetch_push_stats_t stats;
+
+    close(b->fd);
+    uint32_t polls_before = polls;
+    vTaskDelay(pdMS_TO_TICKS(2 * INTERVAL_MS + 50));
+    TEST_CHECK(polls > polls_before);
+    fetch_push_get_stats(&stats);
+    TEST_CHECK_EQ(stats.disconnects, 1);
+
+    broker_accept(b);
+    TEST_REQUIRE(wait_stats(2, 0, 1000));
+    vTaskDelay(pdMS_TO_TICKS(INTERVAL_MS + 50));    // Poll in progress (if any) finished, subscription acknowledged
+    polls_before = polls;
+    for (int i = 0; i < 10; i++) {
+        broker_publish(b, TOPIC, "5000");
+        vTaskDelay(pdMS_TO_TICKS(PUBLISH_GAP_MS * 2));
+    }
+    TEST_CHECK_EQ(polls, polls_before);
+}
+
+int main(void) {
+    broker_t broker;
+    fetch_sample_t sample;
+
+    broker_start(&broker);
+    host_mqtt_port = broker.port;
+    test_init_failure(&broker);
+    broker_accept(&broker);
+    TEST_REQUIRE(wait_stats(1, 0, 1000));
+    TEST_REQUIRE(fetch_get_latest(0, &sample, pdMS_TO_TICKS(1000)) == ESP_OK);   // First poll before subscribing
+    vTaskDelay(pdMS_TO_TICKS(50));      // SUBACK processed by the client
+
+    test_latency(&broker);
+    test_dropped(&broker);
+    test_disconnect(&broker);
+    close(broker.fd);
+    close(broker.listen_fd);
+    return TEST_RESULT();
+}
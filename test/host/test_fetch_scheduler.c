@@ -0,0 +1,250 @@
+/**
+ * @file    test_fetch_scheduler.c
+ * @brief   Host tests of the fetch scheduler on a simulated clock: poll times of sources with their own intervals
+ *          and stand-in fetch durations, order of sources due together, missed polls and a reference model
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "fetch_scheduler.h"
+#include "test_util.h"
+
+#define MAX_POLLS 256   // Polls recorded per source
+
+/* Stand-in source: interval, priority and the time the fetch takes */
+typedef struct {
+    uint32_t interval_ms;
+    uint8_t priority;
+    uint32_t duration_ms;
+} sim_source_t;
+
+/* Polls recorded by the simulated fetch task */
+typedef struct {
+    int64_t due_ms[FETCH_MAX_SOURCES][MAX_POLLS];       // Due time of each poll
+    int64_t start_ms[FETCH_MAX_SOURCES][MAX_POLLS];     // Time each poll started
+    uint32_t count[FETCH_MAX_SOURCES];                  // Polls of each source
+    uint8_t order[4 * MAX_POLLS];                       // Sources in the order they were polled
+    uint32_t total;                                     // Polls of all sources
+} sim_log_t;
+
+static int64_t clock_ms;    // Simulated clock
+static sim_log_t sim_log;
+
+/**
+ * @brief Run the loop of the fetch task until the simulated clock reaches end_ms (sleeping is advancing the clock).
+ *
+ * @param long_poll Poll (counted over all sources) taking long_ms instead of the source duration, -1 for none.
+ */
+static void sim_run(fetch_scheduler_t *s, const sim_source_t *sources, int64_t end_ms, int long_poll, uint32_t long_ms) {
+    uint8_t index;
+    int64_t due_ms;
+
+    while (fetch_scheduler_next(s, &index, &due_ms) && due_ms < end_ms) {
+        if (due_ms > clock_ms) {
+            clock_ms = due_ms;
+            continue;
+        }
+        TEST_REQUIRE(sim_log.count[index] < MAX_POLLS && sim_log.total < sizeof(sim_log.order));
+        sim_log.due_ms[index][sim_log.count[index]] = due_ms;
+        sim_log.start_ms[index][sim_log.count[index]] = clock_ms;
+        sim_log.count[index]++;
+        sim_log.order[sim_log.total] = index;
+
+        int64_t started_ms = clock_ms;
+        clock_ms += ((int)sim_log.total == long_poll) ? long_ms : sources[index].duration_ms;
+        sim_log.total++;
+        fetch_scheduler_done(s, started_ms);
+    }
+}
+
+static void sim_start(fetch_scheduler_t *s, const sim_source_t *sources, uint8_t count) {
+    clock_ms = 0;
+    memset(&sim_log, 0, sizeof(sim_log));
+    fetch_scheduler_init(s);
+    for (uint8_t i = 0; i < count; i++) {
+        TEST_REQUIRE(fetch_scheduler_add(s, i, sources[i].interval_ms, sources[i].priority, 0) == ESP_OK);
+    }
+}
+
+/**
+ * @brief Due times stay on the grid of each interval however long the fetches take, and each source is polled
+ *        once per interval.
+ */
+static void test_no_drift(void) {
+    static const sim_source_t SOURCES[] = {
+        {.interval_ms = 1000, .priority = 1, .duration_ms = 120},
+        {.interval_ms = 2500, .priority = 0, .duration_ms = 300},
+        {.interval_ms = 5000, .priority = 2, .duration_ms = 80},
+    };
+    fetch_scheduler_t s;
+
+    sim_start(&s, SOURCES, 3);
+    sim_run(&s, SOURCES, 60000, -1, 0);
+
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_CHECK_EQ(sim_log.count[i], 60000 / SOURCES[i].interval_ms);
+        int off_grid = 0, late = 0;
+        for (uint32_t k = 0; k < sim_log.count[i]; k++) {
+            off_grid += (sim_log.due_ms[i][k] != (int64_t)k * SOURCES[i].interval_ms);
+            late += (sim_log.start_ms[i][k] - sim_log.due_ms[i][k] > 300 + 120 + 80);  // Behind the others at most
+        }
+        TEST_CHECK_EQ(off_grid, 0);
+        TEST_CHECK_EQ(late, 0);
+    }
+
+    /* All due at 0: by priority; at 5000 ms, all due again in the same order */
+    TEST_CHECK_EQ(sim_log.order[0], 1);
+    TEST_CHECK_EQ(sim_log.order[1], 0);
+    TEST_CHECK_EQ(sim_log.order[2], 2);
+    TEST_CHECK_EQ(sim_log.start_ms[1][2], 5000);
+    TEST_CHECK_EQ(sim_log.start_ms[0][5], 5300);
+    TEST_CHECK_EQ(sim_log.start_ms[2][1], 5420);
+}
+
+/**
+ * @brief A fetch longer than several intervals is followed by one poll, then the source is back on an interval
+ *        measured from that poll (no burst of catch-up polls).
+ */
+static void test_fall_behind(void) {
+    static const sim_source_t SOURCES[] = {{.interval_ms = 1000, .priority = 0, .duration_ms = 50}};
+    static const int64_t EXPECTED_START[] = {0, 1000, 2000, 3000, 6500, 7500, 8500, 9500};
+    fetch_scheduler_t s;
+
+    sim_start(&s, SOURCES, 1);
+    sim_run(&s, SOURCES, 10000, 3, 3500);
+    TEST_CHECK_EQ(sim_log.count[0], sizeof(EXPECTED_START) / sizeof(EXPECTED_START[0]));
+    for (uint32_t k = 0; k < sim_log.count[0]; k++) {
+        TEST_CHECK_EQ(sim_log.start_ms[0][k], EXPECTED_START[k]);
+    }
+}
+
+/**
+ * @brief Sources due at the same time are polled by priority, then by index.
+ */
+static void test_ties(void) {
+    static const sim_source_t SOURCES[] = {
+        {.interval_ms = 1000, .priority = 2, .duration_ms = 0},
+        {.interval_ms = 1000, .priority = 1, .duration_ms = 0},
+        {.interval_ms = 1000, .priority = 2, .duration_ms = 0},
+        {.interval_ms = 1000, .priority = 1, .duration_ms = 0},
+    };
+    static const uint8_t EXPECTED[] = {1, 3, 0, 2};
+    fetch_scheduler_t s;
+
+    sim_start(&s, SOURCES, 4);
+    sim_run(&s, SOURCES, 3000, -1, 0);
+    TEST_CHECK_EQ(sim_log.total, 12);
+    for (uint32_t k = 0; k < sim_log.total; k++) {
+        TEST_CHECK_EQ(sim_log.order[k], EXPECTED[k % 4]);
+    }
+}
+
+/**
+ * @brief A new interval of the source due first applies from its next poll.
+ */
+static void test_set_interval(void) {
+    fetch_scheduler_t s;
+    uint8_t index;
+    int64_t due_ms;
+
+    fetch_scheduler_init(&s);
+    TEST_REQUIRE(fetch_scheduler_add(&s, 0, 1000, 0, 0) == ESP_OK);
+    TEST_REQUIRE(fetch_scheduler_add(&s, 1, 1500, 0, 0) == ESP_OK);
+
+    fetch_scheduler_set_interval(&s, 4000);
+    TEST_CHECK_EQ(fetch_scheduler_done(&s, 0), 0);
+    fetch_scheduler_set_interval(&s, 0);   // Ignored
+    TEST_CHECK_EQ(fetch_scheduler_done(&s, 10), 1);
+    TEST_CHECK(fetch_scheduler_next(&s, &index, &due_ms));
+    TEST_CHECK_EQ(index, 1);
+    TEST_CHECK_EQ(due_ms, 1500);
+    fetch_scheduler_done(&s, 1500);
+    fetch_scheduler_done(&s, 3000);
+    TEST_CHECK(fetch_scheduler_next(&s, &index, &due_ms));
+    TEST_CHECK_EQ(index, 0);
+    TEST_CHECK_EQ(due_ms, 4000);
+}
+
+/**
+ * @brief Invalid intervals and a full table are rejected.
+ */
+static void test_add_errors(void) {
+    fetch_scheduler_t s;
+    uint8_t index;
+    int64_t due_ms;
+
+    fetch_scheduler_init(&s);
+    TEST_CHECK(!fetch_scheduler_next(&s, &index, &due_ms));
+    TEST_CHECK_EQ(fetch_scheduler_add(&s, 0, 0, 0, 0), ESP_ERR_INVALID_ARG);
+    for (uint8_t i = 0; i < FETCH_MAX_SOURCES; i++) {
+        TEST_CHECK_EQ(fetch_scheduler_add(&s, i, 1000, 0, 0), ESP_OK);
+    }
+    TEST_CHECK_EQ(fetch_scheduler_add(&s, FETCH_MAX_SOURCES, 1000, 0, 0), ESP_ERR_NO_MEM);
+}
+
+/**
+ * @brief Random intervals, priorities and fetch durations: the source due first is always the one a linear scan
+ *        of a reference table finds.
+ */
+static void test_reference(void) {
+    fetch_scheduler_entry_t ref[FETCH_MAX_SOURCES];
+    fetch_scheduler_t s;
+    uint32_t rng_state = 1;
+    int mismatches = 0;
+
+    for (int run = 0; run < 200; run++) {
+        clock_ms = 0;
+        fetch_scheduler_init(&s);
+        for (uint8_t i = 0; i < FETCH_MAX_SOURCES; i++) {
+            rng_state = rng_state * 1103515245 + 12345;
+            ref[i] = (fetch_scheduler_entry_t){.due_ms = (rng_state >> 8) % 500,
+                                               .interval_ms = 100 + (rng_state >> 12) % 2000,
+                                               .priority = (rng_state >> 24) % 3,
+                                               .index = i};
+            TEST_REQUIRE(fetch_scheduler_add(&s, i, ref[i].interval_ms, ref[i].priority, ref[i].due_ms) == ESP_OK);
+        }
+
+        for (int step = 0; step < 500; step++) {
+            uint8_t first = 0;
+            for (uint8_t i = 1; i < FETCH_MAX_SOURCES; i++) {
+                if (ref[i].due_ms < ref[first].due_ms ||
+                    (ref[i].due_ms == ref[first].due_ms && (ref[i].priority < ref[first].priority ||
+                                                            (ref[i].priority == ref[first].priority && i < first)))) {
+                    first = i;
+                }
+            }
+
+            uint8_t index;
+            int64_t due_ms;
+            TEST_REQUIRE(fetch_scheduler_next(&s, &index, &due_ms));
+            if (index != first || due_ms != ref[first].due_ms) {
+                mismatches++;
+                break;
+            }
+
+            if (due_ms > clock_ms) {
+                clock_ms = due_ms;
+            }
+            int64_t started_ms = clock_ms;
+            rng_state = rng_state * 1103515245 + 12345;
+            clock_ms += (rng_state >> 8) % 3000;
+            ref[first].due_ms += ref[first].interval_ms;
+            if (ref[first].due_ms <= started_ms) {
+                ref[first].due_ms = started_ms + ref[first].interval_ms;
+            }
+            fetch_scheduler_done(&s, started_ms);
+        }
+    }
+    TEST_CHECK_EQ(mismatches, 0);
+}
+
+int main(void) {
+    test_no_drift();
+    test_fall_behind();
+    test_ties();
+    test_set_interval();
+    test_add_errors();
+    test_reference();
+    return TEST_RESULT();
+}
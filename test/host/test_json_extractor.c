@@ -0,0 +1,387 @@
+/**
+ * @file    test_json_extractor.c
+ * @brief   Host tests of the JSON extractor: a document fed in every possible split must give the same values and
+ *          fingerprint as in one chunk, nested paths and indices, numbers sent as strings, escapes, deep nesting
+ *          and malformed documents
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "json_extractor.h"
+#include "test_util.h"
+
+/* Document with every kind of token: escapes in keys and strings, literals, nested arrays, numbers as strings */
+static const char DOC[] =
+    "{\"meta\": {\"source\": \"grid \\\"live\\\" feed\", \"ok\": true, \"n\": null, \"tags\": [\"a\", \"b\", []]},\r\n"
+    " \"fr\\\"eq\": 1.0,\n"
+    " \"data\": {\"items\": [{\"freq\": 50.012, \"demand\": \"28.41\"}, {\"freq\": -4.9e1, \"demand\": \"x\"},\n"
+    "                      [1, 2, [3]], {\"freq\": 49.987}],\n"
+    "          \"total\": {\"e\\\\scaped\": 7, \"freq\": false}},\n"
+    " \"price\": \"12.5\",\t\"frequency\":60}\n";
+
+static const json_extractor_path_t DOC_PATHS[] = {
+    {"freq0", "data.items[0].freq", 3, DECIMAL_ROUND_HALF_UP},
+    {"freq3", "data.items[3].freq", 2, DECIMAL_ROUND_HALF_UP},
+    {"demand", "data.items[0].demand", 2, DECIMAL_ROUND_HALF_UP},
+    {"freq1", "data.items[1].freq", 1, DECIMAL_ROUND_HALF_UP},
+    {"inner", "data.items[2][2][0]", 0, DECIMAL_ROUND_HALF_UP},
+    {"price", "price", 1, DECIMAL_ROUND_HALF_UP},
+    {"frequency", "frequency", 0, DECIMAL_ROUND_HALF_UP},
+    {"freq", "freq", 2, DECIMAL_ROUND_HALF_UP},     // Only present under an escaped key: never found
+};
+
+#define DOC_FOUND 0x7F
+static const int32_t DOC_VALUES[] = {50012, 4999, 2841, -490, 3, 125, 60, 0};
+
+/* Outcome of one pass over a document */
+typedef struct {
+    esp_err_t feed_err;
+    esp_err_t err;
+    json_extractor_result_t result;
+    uint32_t fingerprint;
+} outcome_t;
+
+/**
+ * @brief Feed a document split at the given offsets and collect the outcome.
+ */
+static void feed_split(json_extractor_t *ex, const char *doc, const size_t *cuts, size_t ncuts, outcome_t *out) {
+    size_t len = strlen(doc);
+    size_t from = 0;
+
+    memset(out, 0, sizeof(*out));
+    json_extractor_reset(ex);
+    out->feed_err = ESP_ERR_NOT_FINISHED;
+    for (size_t i = 0; i <= ncuts; i++) {
+        size_t to = (i < ncuts) ? cuts[i] : len;
+        out->feed_err = json_extractor_feed(ex, doc + from, to - from);
+        from = to;
+    }
+    out->err = json_extractor_finish(ex, &out->result);
+    out->fingerprint = json_extractor_fingerprint(ex);
+}
+
+/**
+ * @brief Compare an outcome with the reference, reporting the split on the first difference.
+ */
+static bool same_outcome(const outcome_t *a, const outcome_t *ref, const size_t *cuts, size_t ncuts) {
+    if (a->feed_err == ref->feed_err && a->err == ref->err && a->result.found == ref->result.found &&
+        memcmp(a->result.values, ref->result.values, sizeof(a->result.values)) == 0 &&
+        a->fingerprint == ref->fingerprint) {
+        return true;
+    }
+    fprintf(stderr, "outcome differs for the split at");
+    for (size_t i = 0; i < ncuts; i++) {
+        fprintf(stderr, " %zu", cuts[i]);
+    }
+    fprintf(stderr, "\n");
+    return false;
+}
+
+/**
+ * @brief Every token split across chunks: all splits into two and three chunks, and byte-by-byte feeding.
+ */
+static void test_all_splits(void) {
+    static json_extractor_t ex;
+    outcome_t ref, out;
+    size_t len = strlen(DOC);
+    size_t cuts[2];
+
+    TEST_REQUIRE(json_extractor_init(&ex, DOC_PATHS, 8) == ESP_OK);
+    feed_split(&ex, DOC, NULL, 0, &ref);
+    TEST_CHECK_EQ(ref.feed_err, ESP_ERR_NOT_FINISHED);   // "freq" never found, so the whole document is read
+    TEST_CHECK_EQ(ref.err, ESP_OK);
+    TEST_CHECK_EQ(ref.result.found, DOC_FOUND);
+    for (int p = 0; p < 8; p++) {
+        if (DOC_FOUND & (1u << p)) {
+            TEST_CHECK_EQ(ref.result.values[p], DOC_VALUES[p]);
+        }
+    }
+
+    bool ok = true;
+    for (cuts[0] = 0; cuts[0] <= len && ok; cuts[0]++) {
+        feed_split(&ex, DOC, cuts, 1, &out);
+        ok = same_outcome(&out, &ref, cuts, 1);
+    }
+    for (cuts[0] = 0; cuts[0] <= len && ok; cuts[0]++) {
+        for (cuts[1] = cuts[0]; cuts[1] <= len && ok; cuts[1]++) {
+            feed_split(&ex, DOC, cuts, 2, &out);
+            ok = same_outcome(&out, &ref, cuts, 2);
+        }
+    }
+    TEST_CHECK(ok);
+
+    json_extractor_reset(&ex);
+    for (size_t i = 0; i < len; i++) {
+        out.feed_err = json_extractor_feed(&ex, DOC + i, 1);
+    }
+    out.err = json_extractor_finish(&ex, &out.result);
+    out.fingerprint = json_extractor_fingerprint(&ex);
+    TEST_CHECK(same_outcome(&out, &ref, NULL, 0));
+
+    /* Same values in the same order with other bytes elsewhere: same fingerprint; another value: another one */
+    static const char OTHER[] =
+        "{\"data\":{\"items\":[{\"freq\":50.012,\"x\":[],\"demand\":\"28.41\"},{\"freq\":-4.9e1},[0,0,[3]],"
+        "{\"freq\":49.987}]},\"price\":\"12.5\",\"frequency\":60}";
+    feed_split(&ex, OTHER, NULL, 0, &out);
+    TEST_CHECK_EQ(out.result.found, DOC_FOUND);
+    TEST_CHECK_EQ(out.fingerprint, ref.fingerprint);
+    static const char CHANGED[] =
+        "{\"data\":{\"items\":[{\"freq\":50.013,\"demand\":\"28.41\"},{\"freq\":-4.9e1},[0,0,[3]],"
+        "{\"freq\":49.987}]},\"price\":\"12.5\",\"frequency\":60}";
+    feed_split(&ex, CHANGED, NULL, 0, &out);
+    TEST_CHECK_EQ(out.result.found, DOC_FOUND);
+    TEST_CHECK(out.fingerprint != ref.fingerprint);
+}
+
+/**
+ * @brief Extract a single path from a document in one chunk.
+ *
+ * @return Result of json_extractor_finish (value valid on ESP_OK with the bit set), feed result in feed_err.
+ */
+static esp_err_t extract_one(const char *path, uint8_t scale, const char *doc, int32_t *value, esp_err_t *feed_err) {
+    static json_extractor_t ex;
+    json_extractor_path_t paths[1] = {{"value", path, scale, DECIMAL_ROUND_HALF_UP}};
+    json_extractor_result_t result;
+
+    TEST_REQUIRE(json_extractor_init(&ex, paths, 1) == ESP_OK);
+    *feed_err = json_extractor_feed(&ex, doc, strlen(doc));
+    esp_err_t err = json_extractor_finish(&ex, &result);
+    *value = result.values[0];
+    return (err == ESP_OK && (result.found & 1)) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+/* Expected outcome of one path on one document */
+typedef struct {
+    const char *path;
+    uint8_t scale;
+    const char *doc;
+    esp_err_t err;
+    int32_t value;
+} case_t;
+
+static void run_cases(const case_t *cases, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t value = 0;
+        esp_err_t feed_err;
+        esp_err_t err = extract_one(cases[i].path, cases[i].scale, cases[i].doc, &value, &feed_err);
+        if (err != cases[i].err || (err == ESP_OK && value != cases[i].value)) {
+            fprintf(stderr, "%s in %s: %ld (err 0x%x, feed 0x%x)\n", cases[i].path, cases[i].doc, (long)value,
+                    err, feed_err);
+            test_failures++;
+        }
+    }
+}
+
+/**
+ * @brief Nested paths, array indices (also of nested and top-level arrays) and values that must not match.
+ */
+static void test_paths(void) {
+    static const case_t CASES[] = {
+        {"a.b.c", 0, "{\"a\":{\"b\":{\"c\":7}}}", ESP_OK, 7},
+        {"a.b.c", 0, "{\"a\":{\"x\":{\"c\":7},\"b\":{\"c\":8}}}", ESP_OK, 8},
+        {"a.b", 0, "{\"ab\":1,\"a\":{\"bb\":2,\"b\":3}}", ESP_OK, 3},               // Prefixes of keys
+        {"a.b", 0, "{\"a\":{\"b\":{\"c\":1}}}", ESP_ERR_NOT_FOUND, 0},              // Container, not a number
+        {"a.b", 0, "{\"b\":1,\"a\":{\"c\":{\"b\":2}}}", ESP_ERR_NOT_FOUND, 0},     // Same key at another depth
+        {"a[2]", 0, "{\"a\":[10,11,12,13]}", ESP_OK, 12},
+        {"a[0]", 0, "{\"a\":[10]}", ESP_OK, 10},
+        {"a[1]", 0, "{\"a\":[10]}", ESP_ERR_NOT_FOUND, 0},
+        {"a[1]", 0, "{\"a\":[[9,9],{\"x\":9},\"s\",5]}", ESP_ERR_NOT_FOUND, 0},   // Element 1 is an object
+        {"a[3]", 0, "{\"a\":[[9,9],{\"x\":9},\"s\",5]}", ESP_OK, 5},
+        {"[1].v", 0, "[{\"v\":1},{\"v\":2}]", ESP_OK, 2},                          // Top-level array
+        {"m[1][0]", 0, "{\"m\":[[1,2],[3,4]]}", ESP_OK, 3},
+        {"a.b", 0, "{\"a\":[{\"b\":1}]}", ESP_ERR_NOT_FOUND, 0},                   // Array where an object is expected
+        {"a[0]", 0, "{\"a\":{\"0\":1}}", ESP_ERR_NOT_FOUND, 0},                    // Object where an array is expected
+        {"x[10]", 0, "{\"x\":[0,1,2,3,4,5,6,7,8,9,10,11]}", ESP_OK, 10},
+        {"a.b", 0, "{\"a\":{},\"a\":{\"b\":4}}", ESP_OK, 4},                       // Empty containers
+        {"a[0]", 0, "{\"a\":[],\"b\":[[]],\"a\":[6]}", ESP_OK, 6},
+        {"a.b", 0, "{\"a\":{\"b\":true,\"b\":null}}", ESP_ERR_NOT_FOUND, 0},       // Literals are not numbers
+    };
+    run_cases(CASES, sizeof(CASES) / sizeof(CASES[0]));
+}
+
+/**
+ * @brief Numbers sent as strings are converted unless the string holds anything else.
+ */
+static void test_string_numbers(void) {
+    static const case_t CASES[] = {
+        {"v", 3, "{\"v\":\"49.987\"}", ESP_OK, 49987},
+        {"v", 2, "{\"v\":\"-0.005\"}", ESP_OK, -1},
+        {"v", 0, "{\"v\":\"1e2\"}", ESP_OK, 100},
+        {"v", 0, "{\"v\":\"12abc\"}", ESP_ERR_NOT_FOUND, 0},
+        {"v", 0, "{\"v\":\" 5\"}", ESP_ERR_NOT_FOUND, 0},
+        {"v", 0, "{\"v\":\"\"}", ESP_ERR_NOT_FOUND, 0},
+        {"v", 0, "{\"v\":\"4\\u0039\"}", ESP_ERR_NOT_FOUND, 0},    // Escapes are not decoded
+        {"v", 0, "{\"v\":\"n/a\",\"v\":\"7\"}", ESP_OK, 7},
+        {"v", 2, "{\"v\":49.987e-1}", ESP_OK, 500},
+        {"v", 0, "{\"v\":1.5.5}", ESP_ERR_NOT_FOUND, 0},
+        {"v", 0, "{\"v\":99999999999}", ESP_ERR_NOT_FOUND, 0},    // Out of range
+    };
+    run_cases(CASES, sizeof(CASES) / sizeof(CASES[0]));
+}
+
+/**
+ * @brief Escaped characters in keys neither end the key nor match a path (escaped keys are never decoded).
+ */
+static void test_key_escapes(void) {
+    static const case_t CASES[] = {
+        {"freq", 0, "{\"fr\\\"eq\":1,\"freq\":2}", ESP_OK, 2},
+        {"freq", 0, "{\"fre\\u0071\":1}", ESP_ERR_NOT_FOUND, 0},
+        {"a.freq", 0, "{\"a\\\\\":{\"freq\":3},\"a\":{\"freq\":4}}", ESP_OK, 4},
+        {"b", 0, "{\"\\\\\":1,\"\\\"\":2,\"b\":5}", ESP_OK, 5},
+        {"b", 0, "{\"x\":\"}\\\"{\",\"b\":6}", ESP_OK, 6},                      // Brackets and escapes in strings
+    };
+    run_cases(CASES, sizeof(CASES) / sizeof(CASES[0]));
+}
+
+/**
+ * @brief Containers nested deeper than a path can reach are skipped, past JSON_EXTRACTOR_MAX_NESTING the
+ *        document is rejected.
+ */
+static void test_deep_nesting(void) {
+    char doc[512];
+    size_t len = 0;
+    int32_t value;
+    esp_err_t feed_err;
+
+    /* Deep array and object before the value, holding keys and indices of the path */
+    len += snprintf(doc + len, sizeof(doc) - len, "{\"a\":");
+    for (int i = 0; i < 2 * JSON_EXTRACTOR_MAX_STEPS; i++) {
+        len += snprintf(doc + len, sizeof(doc) - len, "[");
+    }
+    len += snprintf(doc + len, sizeof(doc) - len, "{\"freq\":1}");
+    for (int i = 0; i < 2 * JSON_EXTRACTOR_MAX_STEPS; i++) {
+        len += snprintf(doc + len, sizeof(doc) - len, "]");
+    }
+    len += snprintf(doc + len, sizeof(doc) - len, ",\"b\":");
+    for (int i = 0; i < 2 * JSON_EXTRACTOR_MAX_STEPS; i++) {
+        len += snprintf(doc + len, sizeof(doc) - len, "{\"freq\":%d,\"b\":", i);
+    }
+    len += snprintf(doc + len, sizeof(doc) - len, "0");
+    for (int i = 0; i < 2 * JSON_EXTRACTOR_MAX_STEPS; i++) {
+        len += snprintf(doc + len, sizeof(doc) - len, "}");
+    }
+    snprintf(doc + len, sizeof(doc) - len, ",\"freq\":49.5}");
+
+    TEST_CHECK_EQ(extract_one("freq", 1, doc, &value, &feed_err), ESP_OK);
+    TEST_CHECK_EQ(value, 495);
+    TEST_CHECK_EQ(feed_err, ESP_OK);
+    TEST_CHECK_EQ(extract_one("b.b.b.b.b.b.b.freq", 0, doc, &value, &feed_err), ESP_OK);   // Deepest path
+    TEST_CHECK_EQ(value, 6);
+    TEST_CHECK_EQ(extract_one("a[0][0][0][0][0][0][0]", 0, doc, &value, &feed_err), ESP_ERR_NOT_FOUND);
+
+    /* A path longer than JSON_EXTRACTOR_MAX_STEPS cannot be compiled */
+    json_extractor_t ex;
+    json_extractor_path_t path = {"deep", "b.b.b.b.b.b.b.b.freq", 0, DECIMAL_ROUND_HALF_UP};
+    TEST_CHECK_EQ(json_extractor_init(&ex, &path, 1), ESP_ERR_INVALID_SIZE);
+
+    /* Nesting limit: 64 levels are read, 65 are rejected */
+    for (int depth = JSON_EXTRACTOR_MAX_NESTING; depth <= JSON_EXTRACTOR_MAX_NESTING + 1; depth++) {
+        len = 0;
+        for (int i = 0; i < depth; i++) {
+            doc[len++] = '[';
+        }
+        for (int i = 0; i < depth; i++) {
+            doc[len++] = ']';
+        }
+        doc[len] = '\0';
+        extract_one("x", 0, doc, &value, &feed_err);
+        TEST_CHECK_EQ(feed_err, (depth > JSON_EXTRACTOR_MAX_NESTING) ? ESP_ERR_INVALID_RESPONSE : ESP_ERR_NOT_FINISHED);
+    }
+}
+
+/**
+ * @brief Malformed documents are rejected, whole or fed byte by byte, and stay rejected until reset.
+ */
+static void test_malformed(void) {
+    static const char *DOCS[] = {
+        "}", "]", "{\"a\":1]", "[1}", "{\"a\" 1}", "{\"a\"::1}", "{\"a\":}", "{1:2}", "{\"a\":x}", "[1 2]",
+        "{\"a\":1 \"b\":2}", "{,}", "[,1]", "{\"a\":[1,2}", "{'a':1}", "{\"a\":1}}",
+    };
+    static const json_extractor_path_t PATH = {"v", "v", 0, DECIMAL_ROUND_HALF_UP};
+    json_extractor_t ex;
+
+    TEST_REQUIRE(json_extractor_init(&ex, &PATH, 1) == ESP_OK);
+    for (size_t i = 0; i < sizeof(DOCS) / sizeof(DOCS[0]); i++) {
+        /* A second document after the end of the first one is not read, so "{...}}" is accepted */
+        esp_err_t expected = (i == sizeof(DOCS) / sizeof(DOCS[0]) - 1) ? ESP_ERR_NOT_FINISHED : ESP_ERR_INVALID_RESPONSE;
+
+        json_extractor_reset(&ex);
+        esp_err_t err = json_extractor_feed(&ex, DOCS[i], strlen(DOCS[i]));
+        if (err != expected) {
+            fprintf(stderr, "%s: 0x%x\n", DOCS[i], err);
+            test_failures++;
+        }
+
+        json_extractor_reset(&ex);
+        err = ESP_ERR_NOT_FINISHED;
+        for (const char *c = DOCS[i]; *c != '\0' && err == ESP_ERR_NOT_FINISHED; c++) {
+            err = json_extractor_feed(&ex, c, 1);
+        }
+        TEST_CHECK_EQ(err, expected);
+        if (expected == ESP_ERR_INVALID_RESPONSE) {
+            TEST_CHECK_EQ(json_extractor_feed(&ex, "{\"v\":1}", 7), ESP_ERR_INVALID_RESPONSE);
+        }
+    }
+
+    /* Reset after an error: the next document is read */
+    json_extractor_reset(&ex);
+    TEST_CHECK_EQ(json_extractor_feed(&ex, "{\"v\":1}", 7), ESP_OK);
+}
+
+/**
+ * @brief Malformed paths are rejected by init.
+ */
+static void test_invalid_paths(void) {
+    static const char *PATHS[] = {"", "a..b", ".a", "a.", "a[", "a[]", "a[x]", "a[1", "a.[0]", "a[70000]"};
+    json_extractor_t ex;
+
+    for (size_t i = 0; i < sizeof(PATHS) / sizeof(PATHS[0]); i++) {
+        json_extractor_path_t path = {"p", PATHS[i], 0, DECIMAL_ROUND_HALF_UP};
+        if (json_extractor_init(&ex, &path, 1) != ESP_ERR_INVALID_ARG) {
+            fprintf(stderr, "path \"%s\" accepted\n", PATHS[i]);
+            test_failures++;
+        }
+    }
+
+    json_extractor_path_t paths[JSON_EXTRACTOR_MAX_PATHS + 1];
+    for (int i = 0; i <= JSON_EXTRACTOR_MAX_PATHS; i++) {
+        paths[i] = (json_extractor_path_t){"p", "a", 0, DECIMAL_ROUND_HALF_UP};
+    }
+    TEST_CHECK_EQ(json_extractor_init(&ex, paths, JSON_EXTRACTOR_MAX_PATHS + 1), ESP_ERR_INVALID_SIZE);
+    TEST_CHECK_EQ(json_extractor_init(&ex, paths, 0), ESP_ERR_INVALID_SIZE);
+    TEST_CHECK_EQ(json_extractor_init(&ex, paths, JSON_EXTRACTOR_MAX_PATHS), ESP_OK);
+}
+
+/**
+ * @brief Two paths selecting the same value keep their own scale, and the feed stops once all are found.
+ */
+static void test_shared_value(void) {
+    static const json_extractor_path_t PATHS[] = {
+        {"hz", "f", 0, DECIMAL_ROUND_HALF_UP},
+        {"mhz", "f", 3, DECIMAL_ROUND_HALF_UP},
+    };
+    json_extractor_t ex;
+    json_extractor_result_t result;
+    const char *doc = "{\"f\":49.9876,\"rest\":[not json at all";
+
+    TEST_REQUIRE(json_extractor_init(&ex, PATHS, 2) == ESP_OK);
+    TEST_CHECK_EQ(json_extractor_feed(&ex, doc, strlen(doc)), ESP_OK);
+    TEST_CHECK(json_extractor_is_done(&ex));
+    TEST_CHECK_EQ(json_extractor_finish(&ex, &result), ESP_OK);
+    TEST_CHECK_EQ(result.found, 0x3);
+    TEST_CHECK_EQ(result.values[0], 50);
+    TEST_CHECK_EQ(result.values[1], 49988);
+}
+
+int main(void) {
+    test_all_splits();
+    test_paths();
+    test_string_numbers();
+    test_key_escapes();
+    test_deep_nesting();
+    test_malformed();
+    test_invalid_paths();
+    test_shared_value();
+    return TEST_RESULT();
+}
@@ -0,0 +1,198 @@
+/**
+ * @file    test_latency_histogram.c
+ * @brief   Host tests of the latency histograms: bucket boundaries, percentile estimates, min/max/average,
+ *          the formatted buckets and reset
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "latency_histogram.h"
+#include "test_util.h"
+
+#define LAST_BUCKET (LATENCY_HISTOGRAM_BUCKETS - 1)
+
+/**
+ * @brief Index of the only non-empty bucket of a histogram holding a single sample (-1 if none or several).
+ */
+static int single_bucket(const latency_histogram_t *h) {
+    int found = -1;
+
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++) {
+        if (h->buckets[i] != 0) {
+            if (found >= 0) {
+                return -1;
+            }
+            found = i;
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Bucket of a single sample.
+ */
+static int bucket_of(int64_t us) {
+    latency_histogram_t h;
+
+    latency_histogram_reset(&h);
+    latency_histogram_add(&h, us);
+    return single_bucket(&h);
+}
+
+/**
+ * @brief Bucket 0 holds < 1 ms, each further bucket doubles, the last one is open-ended from 16.384 s.
+ */
+static void test_bucket_boundaries(void) {
+    TEST_CHECK_EQ(bucket_of(0), 0);
+    TEST_CHECK_EQ(bucket_of(-5), 0);    // Clock going backwards counts as 0
+    TEST_CHECK_EQ(bucket_of(999), 0);
+    TEST_CHECK_EQ(bucket_of(1000), 1);
+    TEST_CHECK_EQ(bucket_of(1999), 1);
+    TEST_CHECK_EQ(bucket_of(2000), 2);
+
+    for (int i = 0; i < LAST_BUCKET; i++) {
+        int64_t limit = latency_histogram_bucket_limit(i);
+        TEST_CHECK_EQ(limit, (int64_t)LATENCY_HISTOGRAM_BASE_US << i);
+        TEST_CHECK_EQ(bucket_of(limit - 1), i);
+        TEST_CHECK_EQ(bucket_of(limit), i + 1);
+    }
+
+    TEST_CHECK_EQ(latency_histogram_bucket_limit(LAST_BUCKET - 1), 16384000);
+    TEST_CHECK_EQ(latency_histogram_bucket_limit(LAST_BUCKET), INT64_MAX);
+    TEST_CHECK_EQ(latency_histogram_bucket_limit(255), INT64_MAX);
+    TEST_CHECK_EQ(bucket_of(16383999), LAST_BUCKET - 1);
+    TEST_CHECK_EQ(bucket_of(16384000), LAST_BUCKET);
+    TEST_CHECK_EQ(bucket_of(3600 * 1000000LL), LAST_BUCKET);
+    TEST_CHECK_EQ(bucket_of(INT64_MAX), LAST_BUCKET);
+}
+
+/**
+ * @brief Percentiles are the upper bound of the bucket holding the sample of that rank, capped at the max sample.
+ */
+static void test_percentiles(void) {
+    latency_histogram_t h;
+
+    latency_histogram_reset(&h);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 50), -1);
+
+    /* 100 samples: 50 in [1, 2) ms, 40 in [4, 8) ms, 9 in [64, 128) ms, 1 in [1, 2) s */
+    for (int i = 0; i < 50; i++) {
+        latency_histogram_add(&h, 1000 + i);
+    }
+    for (int i = 0; i < 40; i++) {
+        latency_histogram_add(&h, 5000 + i);
+    }
+    for (int i = 0; i < 9; i++) {
+        latency_histogram_add(&h, 100000 + i);
+    }
+    latency_histogram_add(&h, 1500000);
+
+    TEST_CHECK_EQ(h.count, 100);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 0), 2000);     // Rank 1
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 50), 2000);    // Rank 50 is the last sample below 2 ms
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 51), 8000);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 90), 8000);    // Rank 90 is the last sample below 8 ms
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 91), 128000);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 99), 128000);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 100), 1500000);    // Capped at the max, not 2048 ms
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 200), 1500000);
+
+    /* Ranks are rounded up: p50 of 3 samples is the second one */
+    latency_histogram_reset(&h);
+    latency_histogram_add(&h, 500);
+    latency_histogram_add(&h, 3000);
+    latency_histogram_add(&h, 20000);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 50), 4000);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 34), 4000);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 33), 1000);
+
+    /* Open-ended bucket reports the max sample */
+    latency_histogram_reset(&h);
+    latency_histogram_add(&h, 20 * 1000000LL);
+    latency_histogram_add(&h, 40 * 1000000LL);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 50), 40 * 1000000LL);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 99), 40 * 1000000LL);
+}
+
+/**
+ * @brief Min, max and the sum the average is taken from.
+ */
+static void test_min_max_avg(void) {
+    static const int64_t SAMPLES[] = {7000, 250, 123456, 250, 40000000, 0};
+    latency_histogram_t h;
+    int64_t sum = 0;
+
+    latency_histogram_reset(&h);
+    for (size_t i = 0; i < sizeof(SAMPLES) / sizeof(SAMPLES[0]); i++) {
+        latency_histogram_add(&h, SAMPLES[i]);
+        sum += SAMPLES[i];
+    }
+    TEST_CHECK_EQ(h.count, 6);
+    TEST_CHECK_EQ(h.min_us, 0);
+    TEST_CHECK_EQ(h.max_us, 40000000);
+    TEST_CHECK_EQ(h.sum_us, sum);
+    TEST_CHECK_EQ(h.sum_us / h.count, 6688492);
+
+    /* First sample sets both bounds, even when larger than the zeroed fields */
+    latency_histogram_reset(&h);
+    latency_histogram_add(&h, 5000);
+    TEST_CHECK_EQ(h.min_us, 5000);
+    TEST_CHECK_EQ(h.max_us, 5000);
+}
+
+/**
+ * @brief Formatted buckets, including the open-ended one and a buffer too small for all of them.
+ */
+static void test_format(void) {
+    latency_histogram_t h;
+    char buf[128];
+
+    latency_histogram_reset(&h);
+    TEST_CHECK_EQ(latency_histogram_format(&h, buf, sizeof(buf)), 0);
+    TEST_CHECK(strcmp(buf, "") == 0);
+
+    latency_histogram_add(&h, 10);
+    latency_histogram_add(&h, 20);
+    latency_histogram_add(&h, 1500);
+    latency_histogram_add(&h, 20 * 1000000LL);
+    size_t len = latency_histogram_format(&h, buf, sizeof(buf));
+    TEST_CHECK(strcmp(buf, "<1ms:2 <2ms:1 >=16384ms:1") == 0);
+    TEST_CHECK_EQ(len, strlen(buf));
+
+    len = latency_histogram_format(&h, buf, 8);
+    TEST_CHECK_EQ(len, 7);
+    TEST_CHECK(strcmp(buf, "<1ms:2 ") == 0);
+    TEST_CHECK_EQ(latency_histogram_format(&h, buf, 0), 0);
+}
+
+/**
+ * @brief Reset clears the samples, the statistics and the buckets.
+ */
+static void test_reset(void) {
+    latency_histogram_t h;
+
+    latency_histogram_reset(&h);
+    latency_histogram_add(&h, 3000);
+    latency_histogram_add(&h, 30 * 1000000LL);
+    latency_histogram_reset(&h);
+
+    TEST_CHECK_EQ(h.count, 0);
+    TEST_CHECK_EQ(h.sum_us, 0);
+    TEST_CHECK_EQ(single_bucket(&h), -1);
+    TEST_CHECK_EQ(latency_histogram_percentile(&h, 99), -1);
+
+    latency_histogram_add(&h, 100);
+    TEST_CHECK_EQ(h.min_us, 100);
+    TEST_CHECK_EQ(h.max_us, 100);
+    TEST_CHECK_EQ(single_bucket(&h), 0);
+}
+
+int main(void) {
+    test_bucket_boundaries();
+    test_percentiles();
+    test_min_max_avg();
+    test_format();
+    test_reset();
+    return TEST_RESULT();
+}
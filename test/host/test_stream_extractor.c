@@ -0,0 +1,166 @@
+/**
+ * @file    test_stream_extractor.c
+ * @brief   Host tests of the stream extractor: a recorded page fed in every possible split must give the same
+ *          values, fingerprint and span as the page fed in one chunk
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "stream_extractor.h"
+#include "test_util.h"
+
+/* Part of the system data page (decoys before the value: a marker without a number and overlapping markers) */
+static const char PAGE[] =
+    "<table class=\"grid\">\r\n"
+    "<tr><th>Frequency</th><td>n/a</td></tr>\r\n"
+    "<tr><th>FrFreFreq (Hz):  49.987</td></tr>\r\n"
+    "<tr><td>Demand: 28.41 GW</td></tr>\r\n"
+    "<tr><td>Transfers: -1.5 GW</td></tr>\r\n"
+    "</table>\r\n";
+
+/* Key of the firmware (data_scraping.c) */
+static const stream_extractor_key_t FREQ_KEYS[] = {
+    {"freq", FREQ_MARKER, STREAM_RULE_OFFSET, FREQ_VALUE_OFFSET, FREQ_VALUE_WINDOW, '\0',
+     FREQ_VALUE_SCALE, FREQ_VALUE_ROUNDING},
+};
+
+/* Several keys with both rules, one marker being a suffix of another */
+static const stream_extractor_key_t MULTI_KEYS[] = {
+    {"freq", "Freq", STREAM_RULE_OFFSET, 11, 29, '\0', 3, DECIMAL_ROUND_TRUNCATE},
+    {"demand", "Demand", STREAM_RULE_DELIMITER, 4, 12, ':', 1, DECIMAL_ROUND_HALF_UP},
+    {"transfers", "Transfers", STREAM_RULE_DELIMITER, 4, 12, ':', 0, DECIMAL_ROUND_HALF_EVEN},
+    {"fers", "fers", STREAM_RULE_DELIMITER, 4, 12, ':', 2, DECIMAL_ROUND_HALF_UP},
+};
+
+/* Outcome of one pass over the page */
+typedef struct {
+    esp_err_t err;
+    stream_extractor_result_t result;
+    uint32_t fingerprint;
+    uint32_t start, end;
+} outcome_t;
+
+/**
+ * @brief Feed the page split at the given offsets and collect the outcome.
+ *
+ * @param ex     Pointer to the initialised extractor.
+ * @param cuts   Offsets the page is split at (ascending).
+ * @param ncuts  Number of offsets.
+ * @param out    Pointer to the outcome.
+ */
+static void feed_split(stream_extractor_t *ex, const size_t *cuts, size_t ncuts, outcome_t *out) {
+    size_t len = strlen(PAGE);
+    size_t from = 0;
+
+    stream_extractor_reset(ex);
+    for (size_t i = 0; i <= ncuts; i++) {
+        size_t to = (i < ncuts) ? cuts[i] : len;
+        stream_extractor_feed(ex, PAGE + from, to - from);
+        from = to;
+    }
+    memset(out, 0, sizeof(*out));
+    out->err = stream_extractor_finish(ex, &out->result);
+    out->fingerprint = stream_extractor_fingerprint(ex);
+    stream_extractor_get_span(ex, &out->start, &out->end);
+}
+
+/**
+ * @brief Compare an outcome with the reference, reporting the split on the first difference.
+ *
+ * @return true if the outcomes are identical.
+ */
+static bool same_outcome(const outcome_t *a, const outcome_t *ref, const size_t *cuts, size_t ncuts) {
+    if (a->err == ref->err && memcmp(&a->result, &ref->result, sizeof(a->result)) == 0 &&
+        a->fingerprint == ref->fingerprint && a->start == ref->start && a->end == ref->end) {
+        return true;
+    }
+    fprintf(stderr, "outcome differs for the split at");
+    for (size_t i = 0; i < ncuts; i++) {
+        fprintf(stderr, " %zu", cuts[i]);
+    }
+    fprintf(stderr, "\n");
+    return false;
+}
+
+/**
+ * @brief Check every split of the page into two and three chunks, and byte-by-byte feeding.
+ */
+static void test_all_splits(const stream_extractor_key_t *keys, uint8_t count, const outcome_t *expected) {
+    stream_extractor_t ex;
+    outcome_t ref, out;
+    size_t len = strlen(PAGE);
+    size_t cuts[2];
+
+    TEST_REQUIRE(stream_extractor_init(&ex, keys, count) == ESP_OK);
+    feed_split(&ex, NULL, 0, &ref);
+    TEST_CHECK_EQ(ref.err, expected->err);
+    TEST_CHECK_EQ(ref.result.found, expected->result.found);
+    for (uint8_t k = 0; k < count; k++) {
+        TEST_CHECK_EQ(ref.result.values[k], expected->result.values[k]);
+    }
+
+    bool ok = true;
+    for (cuts[0] = 0; cuts[0] <= len && ok; cuts[0]++) {
+        feed_split(&ex, cuts, 1, &out);
+        ok = same_outcome(&out, &ref, cuts, 1);
+    }
+    for (cuts[0] = 0; cuts[0] <= len && ok; cuts[0]++) {
+        for (cuts[1] = cuts[0]; cuts[1] <= len && ok; cuts[1]++) {
+            feed_split(&ex, cuts, 2, &out);
+            ok = same_outcome(&out, &ref, cuts, 2);
+        }
+    }
+    TEST_CHECK(ok);
+
+    /* One byte at a time */
+    stream_extractor_reset(&ex);
+    for (size_t i = 0; i < len; i++) {
+        stream_extractor_feed(&ex, PAGE + i, 1);
+    }
+    memset(&out, 0, sizeof(out));
+    out.err = stream_extractor_finish(&ex, &out.result);
+    out.fingerprint = stream_extractor_fingerprint(&ex);
+    stream_extractor_get_span(&ex, &out.start, &out.end);
+    TEST_CHECK(same_outcome(&out, &ref, NULL, 0));
+}
+
+/**
+ * @brief A response ending inside the value window still yields the digits received.
+ */
+static void test_truncated_window(void) {
+    stream_extractor_t ex;
+    stream_extractor_result_t result;
+    const char *page = "<th>Freq (Hz):  49.9";
+
+    TEST_REQUIRE(stream_extractor_init(&ex, FREQ_KEYS, 1) == ESP_OK);
+    TEST_CHECK_EQ(stream_extractor_feed(&ex, page, strlen(page)), ESP_ERR_NOT_FINISHED);
+    TEST_CHECK_EQ(stream_extractor_finish(&ex, &result), ESP_OK);
+    TEST_CHECK_EQ(result.values[0], 4990);
+}
+
+/**
+ * @brief A page without the marker gives no value.
+ */
+static void test_not_found(void) {
+    stream_extractor_t ex;
+    stream_extractor_result_t result;
+    const char *page = "<html>Service unavailable</html>";
+
+    TEST_REQUIRE(stream_extractor_init(&ex, FREQ_KEYS, 1) == ESP_OK);
+    TEST_CHECK_EQ(stream_extractor_feed(&ex, page, strlen(page)), ESP_ERR_NOT_FINISHED);
+    TEST_CHECK_EQ(stream_extractor_finish(&ex, &result), ESP_ERR_NOT_FOUND);
+    TEST_CHECK_EQ(result.found, 0);
+}
+
+int main(void) {
+    outcome_t expected = {.err = ESP_OK, .result = {.found = 0x1, .values = {4999}}};
+    test_all_splits(FREQ_KEYS, 1, &expected);
+
+    outcome_t expected_multi = {.err = ESP_OK, .result = {.found = 0xF, .values = {49987, 284, -2, -150}}};
+    test_all_splits(MULTI_KEYS, 4, &expected_multi);
+
+    test_truncated_window();
+    test_not_found();
+    return TEST_RESULT();
+}
@@ -0,0 +1,216 @@
+/**
+ * @file    test_tls_arena.c
+ * @brief   Host soak test of the TLS arena: thousands of simulated fetches with the allocation pattern of mbedtls
+ *          (handshake temporaries, blocks held by the open connection, a saved session kept across connections)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "mbedtls/platform.h"
+#include "test_util.h"
+#include "tls_arena.h"
+
+#define SOAK_FETCHES 5000       // Simulated fetches
+#define CLOSE_EVERY 4           // On average, the server closes the connection after this many fetches
+#define MAX_BLOCKS 64           // Blocks held by one group of a simulated connection
+#define RECORD_BUFFER 16717     // Size of an mbedtls record buffer (always left to the heap)
+
+/* Blocks allocated through the mbedtls allocator */
+typedef struct {
+    void *ptr[MAX_BLOCKS];
+    int count;
+} blocks_t;
+
+/* Simulated TLS connection, following the steps of data_scraping.c */
+typedef struct {
+    blocks_t context;           // Record buffers and host name (mbedtls_ssl_setup, mbedtls_ssl_set_hostname)
+    blocks_t handshake;         // Structures prepared for the next handshake (mbedtls_ssl_session_reset)
+    blocks_t session;           // Blocks held while connected (cipher contexts, peer certificate chain)
+    blocks_t saved;             // Saved session (mbedtls_ssl_get_session)
+    bool connected;
+    bool save_in_arena;         // Keep the saved session in the arena (the allocation pattern before the fix)
+} sim_conn_t;
+
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(uint32_t n) {
+    rng_state = rng_state * 1103515245 + 12345;
+    return (rng_state >> 8) % n;
+}
+
+/**
+ * @brief Allocation size with the spread of a handshake: mostly small structures, some bignums and
+ *        certificate fields, a few large buffers.
+ */
+static size_t random_size(void) {
+    uint32_t r = rng(100);
+    if (r < 70) {
+        return 8 + rng(248);
+    } else if (r < 95) {
+        return 256 + rng(768);
+    }
+    return 1024 + rng(2800);
+}
+
+static void blocks_alloc(blocks_t *b, int n) {
+    for (int i = 0; i < n; i++) {
+        TEST_REQUIRE(b->count < MAX_BLOCKS);
+        b->ptr[b->count] = mbedtls_calloc(1, random_size());
+        TEST_REQUIRE(b->ptr[b->count] != NULL);
+        b->count++;
+    }
+}
+
+static void blocks_free(blocks_t *b) {
+    for (int i = 0; i < b->count; i++) {
+        mbedtls_free(b->ptr[i]);
+    }
+    b->count = 0;
+}
+
+/**
+ * @brief Free the blocks of a group in a random order, allocating new ones in between.
+ */
+static void blocks_churn(blocks_t *b, int rounds) {
+    for (int r = 0; r < rounds && b->count > 0; r++) {
+        int i = rng(b->count);
+        mbedtls_free(b->ptr[i]);
+        b->ptr[i] = b->ptr[--b->count];
+        if (rng(2) == 0) {
+            blocks_alloc(b, 1);
+        }
+    }
+}
+
+static void sim_setup(sim_conn_t *c) {
+    memset(c, 0, sizeof(*c));
+    tls_arena_bypass(true);
+    c->context.ptr[c->context.count++] = mbedtls_calloc(1, RECORD_BUFFER);
+    c->context.ptr[c->context.count++] = mbedtls_calloc(1, RECORD_BUFFER);
+    blocks_alloc(&c->context, 1);
+    blocks_alloc(&c->handshake, 3);
+    tls_arena_bypass(false);
+}
+
+static void sim_handshake(sim_conn_t *c) {
+    blocks_t temp = {0};
+
+    blocks_alloc(&temp, 20 + rng(20));     // Key exchange, certificate parsing
+    blocks_churn(&temp, 30);
+    blocks_alloc(&c->session, 8 + rng(12));
+    blocks_free(&temp);
+    blocks_free(&c->handshake);             // Freed when the handshake completes
+
+    blocks_free(&c->saved);
+    tls_arena_bypass(!c->save_in_arena);
+    blocks_alloc(&c->saved, 4 + rng(6));
+    tls_arena_bypass(false);
+    c->connected = true;
+}
+
+static void sim_request(void) {
+    blocks_t temp = {0};
+    blocks_alloc(&temp, 1 + rng(4));
+    blocks_free(&temp);
+}
+
+/**
+ * @brief Close the connection as mbedtls_reset does.
+ *
+ * @return true if the arena was emptied.
+ */
+static bool sim_reset(sim_conn_t *c) {
+    tls_arena_bypass(true);
+    blocks_free(&c->session);
+    blocks_free(&c->handshake);
+    blocks_alloc(&c->handshake, 3);
+    tls_arena_bypass(false);
+    c->connected = false;
+    return tls_arena_reset();
+}
+
+static void sim_release(sim_conn_t *c) {
+    sim_reset(c);
+    blocks_free(&c->handshake);
+    blocks_free(&c->saved);
+    blocks_free(&c->context);
+}
+
+/**
+ * @brief Every closed connection empties the arena, so the largest free block is back to the whole region
+ *        after each of them, and the largest free block while connected does not shrink over the soak.
+ */
+static void test_soak(void) {
+    sim_conn_t c;
+    tls_arena_stats_t start, st;
+    uint32_t closes = 0, resets_missed = 0, not_flat = 0;
+    uint32_t min_connected_first = UINT32_MAX, min_connected_last = UINT32_MAX;
+
+    tls_arena_get_stats(&start);
+    sim_setup(&c);
+    for (int i = 0; i < SOAK_FETCHES; i++) {
+        if (!c.connected) {
+            sim_handshake(&c);
+        }
+        sim_request();
+
+        tls_arena_get_stats(&st);
+        if (i < SOAK_FETCHES / 4 && st.largest_free < min_connected_first) {
+            min_connected_first = st.largest_free;
+        } else if (i >= SOAK_FETCHES * 3 / 4 && st.largest_free < min_connected_last) {
+            min_connected_last = st.largest_free;
+        }
+
+        if (rng(CLOSE_EVERY) == 0) {
+            closes++;
+            resets_missed += !sim_reset(&c);
+            tls_arena_get_stats(&st);
+            not_flat += (st.largest_free != TLS_ARENA_SIZE || st.fragmentation != 0 || st.live_count != 0);
+        }
+    }
+    sim_release(&c);
+
+    tls_arena_get_stats(&st);
+    printf("%u fetches, %u closes, %u resets, %u arena allocs (%u to the heap), peak %u bytes\n", SOAK_FETCHES,
+           closes, st.resets - start.resets, st.allocs - start.allocs, st.heap_allocs - start.heap_allocs,
+           st.peak_bytes);
+    printf("largest free block while connected: %u bytes (first quarter), %u bytes (last quarter)\n",
+           min_connected_first, min_connected_last);
+    TEST_CHECK(closes > SOAK_FETCHES / (2 * CLOSE_EVERY));
+    TEST_CHECK_EQ(resets_missed, 0);
+    TEST_CHECK_EQ(not_flat, 0);
+    TEST_CHECK_EQ(st.resets - start.resets, closes + 1);
+    TEST_CHECK(min_connected_last >= min_connected_first);
+    TEST_CHECK_EQ(st.live_count, 0);
+    TEST_CHECK(st.peak_bytes <= TLS_ARENA_SIZE);
+}
+
+/**
+ * @brief A saved session allocated from the arena outlives the connection and keeps it from being reset.
+ */
+static void test_session_in_arena(void) {
+    sim_conn_t c;
+    tls_arena_stats_t start, st;
+
+    tls_arena_get_stats(&start);
+    sim_setup(&c);
+    c.save_in_arena = true;
+    for (int i = 0; i < 100; i++) {
+        sim_handshake(&c);
+        sim_request();
+        sim_reset(&c);
+    }
+    tls_arena_get_stats(&st);
+    TEST_CHECK_EQ(st.resets - start.resets, 0);
+    TEST_CHECK(st.live_count > 0);
+    sim_release(&c);
+}
+
+int main(void) {
+    TEST_REQUIRE(tls_arena_init() == ESP_OK);
+    tls_arena_set_owner();
+    test_soak();
+    test_session_in_arena();
+    return TEST_RESULT();
+}
@@ -0,0 +1,222 @@
+/**
+ * @file    test_tls_pin.c
+ * @brief   Host test of the pinned-key verification callback of TLS_TRUST_PIN: the paths mbedtls presents for a
+ *          server certificate with the pinned key, below a pinned issuer, with a wrong pin and with the pinned key
+ *          missing, with the flags mbedtls would set on them, and malformed pins rejected at init
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ *
+ * The keys are real (P-256, generated by OpenSSL) so the pin is hashed over a genuine SubjectPublicKeyInfo; the
+ * signature and validity checks are the job of mbedtls and are represented by the flags it passes to the callback.
+ */
+
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "test_util.h"
+#include "tls_pin.h"
+
+enum { ROOT, INTERMEDIATE, LEAF, OTHER, KEY_COUNT };
+
+/* Certificate stand-in: the SubjectPublicKeyInfo of a generated key */
+typedef struct {
+    unsigned char spki[128];
+    mbedtls_x509_crt crt;
+} cert_t;
+
+static cert_t certs[KEY_COUNT];
+static char pins[KEY_COUNT][2 * TLS_PIN_LEN + 1];   // Hex SHA-256 of the SubjectPublicKeyInfo of each key
+
+static void make_cert(cert_t *cert, char *pin_hex) {
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    unsigned char *p = cert->spki;
+    unsigned char hash[TLS_PIN_LEN];
+    unsigned int hash_len;
+
+    TEST_REQUIRE(key != NULL);
+    TEST_REQUIRE(i2d_PUBKEY(key, NULL) <= (int)sizeof(cert->spki));
+    int len = i2d_PUBKEY(key, &p);
+    TEST_REQUIRE(len > 0);
+    EVP_PKEY_free(key);
+    memset(&cert->crt, 0, sizeof(cert->crt));
+    cert->crt.pk_raw.p = cert->spki;
+    cert->crt.pk_raw.len = (size_t)len;
+
+    TEST_REQUIRE(EVP_Digest(cert->spki, (size_t)len, hash, &hash_len, EVP_sha256(), NULL) == 1);
+    for (int i = 0; i < TLS_PIN_LEN; i++) {
+        sprintf(pin_hex + 2 * i, "%02x", hash[i]);
+    }
+}
+
+/**
+ * @brief Run a handshake's worth of callbacks over a path, top first, as mbedtls does.
+ *
+ * @param keys  Keys of the path from the top down to the server certificate.
+ * @param flags Flags of each certificate (same order).
+ * @return Result of the handshake (flags of the server certificate after the callback).
+ */
+static uint32_t verify_path(tls_pin_t *pin, const int *keys, const uint32_t *flags, int len) {
+    uint32_t result = 0;
+
+    tls_pin_begin(pin);
+    for (int i = 0; i < len; i++) {
+        uint32_t f = flags[i];
+        TEST_CHECK_EQ(tls_pin_verify(pin, &certs[keys[i]].crt, len - 1 - i, &f), 0);
+        if (i == len - 1) {
+            result = f;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Malformed pins are rejected: missing, too short, too long and not hex.
+ */
+static void test_init(void) {
+    tls_pin_t pin;
+    char bad[2 * TLS_PIN_LEN + 2];
+
+    TEST_CHECK_EQ(tls_pin_init(&pin, NULL), ESP_ERR_INVALID_ARG);
+    TEST_CHECK_EQ(tls_pin_init(&pin, ""), ESP_ERR_INVALID_ARG);
+    memcpy(bad, pins[LEAF], sizeof(pins[LEAF]));
+    bad[2 * TLS_PIN_LEN - 1] = '\0';
+    TEST_CHECK_EQ(tls_pin_init(&pin, bad), ESP_ERR_INVALID_ARG);
+    strcpy(bad, pins[LEAF]);
+    strcat(bad, "0");
+    TEST_CHECK_EQ(tls_pin_init(&pin, bad), ESP_ERR_INVALID_ARG);
+    strcpy(bad, pins[LEAF]);
+    bad[10] = 'g';
+    TEST_CHECK_EQ(tls_pin_init(&pin, bad), ESP_ERR_INVALID_ARG);
+    bad[10] = ' ';
+    bad[11] = 'f';
+    TEST_CHECK_EQ(tls_pin_init(&pin, bad), ESP_ERR_INVALID_ARG);  // strtoul would skip the space
+
+    strcpy(bad, pins[LEAF]);
+    for (char *c = bad; *c != '\0'; c++) {
+        *c = (char)((*c >= 'a') ? *c - 'a' + 'A' : *c);
+    }
+    TEST_REQUIRE(tls_pin_init(&pin, bad) == ESP_OK);              // Upper case digits
+    TEST_CHECK_EQ(tls_pin_init(&pin, pins[LEAF]), ESP_OK);
+}
+
+/**
+ * @brief Good pin: the server certificate itself or one of its issuers has the pinned key.
+ */
+static void test_good_pin(void) {
+    static const int LEAF_ONLY[] = {LEAF};
+    static const int CHAIN[] = {ROOT, INTERMEDIATE, LEAF};
+    const uint32_t untrusted_leaf[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED};
+    const uint32_t untrusted_top[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED, 0, 0};
+    const uint32_t untrusted_path[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED, MBEDTLS_X509_BADCERT_NOT_TRUSTED, 0};
+    tls_pin_t pin;
+    uint32_t result;
+
+    /* Self-signed or unknown issuer: the only problem reported is the missing trust anchor */
+    TEST_REQUIRE(tls_pin_init(&pin, pins[LEAF]) == ESP_OK);
+    result = verify_path(&pin, LEAF_ONLY, untrusted_leaf, 1);
+    TEST_CHECK(pin.verified);
+    TEST_CHECK(tls_pin_accepted(&pin, result));
+
+    /* Pinned root or intermediate above a clean path */
+    TEST_REQUIRE(tls_pin_init(&pin, pins[ROOT]) == ESP_OK);
+    result = verify_path(&pin, CHAIN, untrusted_top, 3);
+    TEST_CHECK(tls_pin_accepted(&pin, result));
+
+    TEST_REQUIRE(tls_pin_init(&pin, pins[INTERMEDIATE]) == ESP_OK);
+    result = verify_path(&pin, CHAIN, untrusted_path, 3);
+    TEST_CHECK(tls_pin_accepted(&pin, result));
+}
+
+/**
+ * @brief Wrong pin: the pinned key is not the one of any certificate of the path.
+ */
+static void test_wrong_pin(void) {
+    static const int CHAIN[] = {ROOT, INTERMEDIATE, LEAF};
+    const uint32_t untrusted_top[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED, 0, 0};
+    tls_pin_t pin;
+    uint32_t result;
+
+    TEST_REQUIRE(tls_pin_init(&pin, pins[OTHER]) == ESP_OK);
+    result = verify_path(&pin, CHAIN, untrusted_top, 3);
+    TEST_CHECK(!pin.verified);
+    TEST_CHECK(!tls_pin_accepted(&pin, result));
+    TEST_CHECK(result & MBEDTLS_X509_BADCERT_NOT_TRUSTED);      // Verdict reported through the flags
+
+    /* One flipped bit of the right pin */
+    char hex[sizeof(pins[LEAF])];
+    strcpy(hex, pins[LEAF]);
+    hex[0] = (hex[0] == '0') ? '1' : '0';
+    TEST_REQUIRE(tls_pin_init(&pin, hex) == ESP_OK);
+    result = verify_path(&pin, CHAIN, untrusted_top, 3);
+    TEST_CHECK(!tls_pin_accepted(&pin, result));
+}
+
+/**
+ * @brief Missing pin: the pinned certificate is not in the path presented by the server (intermediate left out),
+ *        and a verdict is never carried over from a previous handshake.
+ */
+static void test_missing_pin(void) {
+    static const int FULL[] = {ROOT, INTERMEDIATE, LEAF};
+    static const int SHORT[] = {ROOT, LEAF};
+    const uint32_t untrusted_top[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED, 0, 0};
+    const uint32_t short_flags[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED, MBEDTLS_X509_BADCERT_NOT_TRUSTED};
+    tls_pin_t pin;
+    uint32_t result;
+
+    TEST_REQUIRE(tls_pin_init(&pin, pins[INTERMEDIATE]) == ESP_OK);
+    result = verify_path(&pin, FULL, untrusted_top, 3);
+    TEST_REQUIRE(tls_pin_accepted(&pin, result));
+    result = verify_path(&pin, SHORT, short_flags, 2);
+    TEST_CHECK(!pin.found);
+    TEST_CHECK(!tls_pin_accepted(&pin, result));
+}
+
+/**
+ * @brief Problems below the pinned key reject the chain: expired or badly signed certificates under it, a hostname
+ *        mismatch of the server certificate, and usage flags left to VERIFY_OPTIONAL.
+ */
+static void test_flags(void) {
+    static const int CHAIN[] = {ROOT, INTERMEDIATE, LEAF};
+    static const int LEAF_ONLY[] = {LEAF};
+    const uint32_t expired_below[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED, MBEDTLS_X509_BADCERT_EXPIRED, 0};
+    const uint32_t bad_signature[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED, MBEDTLS_X509_BADCERT_NOT_TRUSTED, 0};
+    const uint32_t expired_pinned[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED | MBEDTLS_X509_BADCERT_EXPIRED};
+    const uint32_t cn_mismatch[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED | MBEDTLS_X509_BADCERT_CN_MISMATCH};
+    const uint32_t leaf_flags[] = {MBEDTLS_X509_BADCERT_KEY_USAGE, MBEDTLS_X509_BADCERT_EXT_KEY_USAGE,
+                                   MBEDTLS_X509_BADCERT_BAD_KEY};
+    tls_pin_t pin;
+    uint32_t result;
+
+    TEST_REQUIRE(tls_pin_init(&pin, pins[ROOT]) == ESP_OK);
+    result = verify_path(&pin, CHAIN, expired_below, 3);
+    TEST_CHECK(!tls_pin_accepted(&pin, result));
+    result = verify_path(&pin, CHAIN, bad_signature, 3);      // Intermediate not signed by the pinned root
+    TEST_CHECK(!tls_pin_accepted(&pin, result));
+
+    TEST_REQUIRE(tls_pin_init(&pin, pins[LEAF]) == ESP_OK);
+    result = verify_path(&pin, LEAF_ONLY, expired_pinned, 1);
+    TEST_CHECK(!tls_pin_accepted(&pin, result));
+    result = verify_path(&pin, LEAF_ONLY, cn_mismatch, 1);
+    TEST_CHECK(!tls_pin_accepted(&pin, result));
+
+    /* Usage and key checks of the server certificate run after the chain verification (no callback) */
+    for (size_t i = 0; i < sizeof(leaf_flags) / sizeof(leaf_flags[0]); i++) {
+        const uint32_t flags[] = {MBEDTLS_X509_BADCERT_NOT_TRUSTED};
+        result = verify_path(&pin, LEAF_ONLY, flags, 1) | leaf_flags[i];
+        TEST_CHECK(pin.verified);                               // Covered by the pin...
+        TEST_CHECK(!tls_pin_accepted(&pin, result));            // ...but not usable as a server certificate
+    }
+}
+
+int main(void) {
+    for (int i = 0; i < KEY_COUNT; i++) {
+        make_cert(&certs[i], pins[i]);
+    }
+    test_init();
+    test_good_pin();
+    test_wrong_pin();
+    test_missing_pin();
+    test_flags();
+    return TEST_RESULT();
+}
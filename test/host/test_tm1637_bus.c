@@ -0,0 +1,141 @@
+/**
+ * @file    test_tm1637_bus.c
+ * @brief   Host tests of the tm1637 bus waveform against an emulated chip: datasheet timing at each bit delay
+ *          (the pin calls taking no time, the worst case), decoding, ACK handover, and the bus time of a redraw
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "test_util.h"
+#include "tm1637_mock.h"
+
+/* TM1637 datasheet timing */
+#define CLK_PULSE_MIN_NS 400        // CLK pulse width
+#define CLK_PERIOD_MIN_NS 2000      // Clock frequency at most 500 kHz
+#define SETUP_MIN_NS 100            // Data setup time
+#define HOLD_MIN_NS 100             // Data hold time
+
+static const uint8_t DIGITS_4999[] = {0x66, 0x6F, 0x6F, 0x6F};
+
+static tm1637_led_t *start(uint8_t delay_us) {
+    tm1637_mock_init();
+    tm1637_led_t *led = tm1637_init_pins(MOCK_PIN_CLK, MOCK_PIN_DIO, &tm1637_pins_mock);
+    TEST_REQUIRE(led != NULL);
+    tm1637_set_bit_delay(led, delay_us);
+    tm1637_mock_clear();
+    return led;
+}
+
+static void check_timing(void) {
+    TEST_CHECK(mock.min_clk_high_ns >= CLK_PULSE_MIN_NS);
+    TEST_CHECK(mock.min_clk_low_ns >= CLK_PULSE_MIN_NS);
+    TEST_CHECK(mock.min_clk_period_ns >= CLK_PERIOD_MIN_NS);
+    TEST_CHECK(mock.min_setup_ns >= SETUP_MIN_NS);
+    TEST_CHECK(mock.min_hold_ns >= HOLD_MIN_NS);
+    TEST_CHECK_EQ(mock.protocol_errors, 0);
+    TEST_CHECK_EQ(mock.contention, 0);
+}
+
+/**
+ * @brief Every bit delay from the shortest allowed one meets the datasheet timing, and each frame decodes to
+ *        the digits on the chip with every byte acknowledged.
+ */
+static void test_timing(void) {
+    for (uint8_t delay_us = TM1637_DELAY_MIN_US; delay_us <= TM1637_DELAY_US; delay_us++) {
+        tm1637_led_t *led = start(delay_us);
+        tm1637_set_number_lead_dot(led, 4999, true, 0x00);
+        tm1637_set_segment_raw(led, 1, 0x80);
+        tm1637_set_brightness(led, 2);
+        tm1637_flush(led);
+
+        check_timing();
+        TEST_CHECK_EQ(mock.min_clk_high_ns, delay_us * 1000);
+        TEST_CHECK_EQ(led->m_stats.nacks, 0);
+        TEST_CHECK(memcmp(mock.digits, ((const uint8_t[]){0x66, 0x80, 0x6F, 0x6F}), TM1637_DIGITS) == 0);
+        TEST_CHECK(mock.display_on);
+        TEST_CHECK_EQ(mock.brightness, 2);
+        for (uint32_t i = 0; i < mock.transaction_count; i++) {
+            TEST_CHECK(mock.transactions[i].acked);
+        }
+        free(led);
+    }
+
+    tm1637_led_t *led = start(0);   // Clamped to the shortest allowed delay
+    TEST_CHECK_EQ(led->m_delay_us, TM1637_DELAY_MIN_US);
+    free(led);
+}
+
+/**
+ * @brief The MCU releases DIO before the chip pulls it low for the ACK and drives it again only after the chip
+ *        has let go, so the two never drive DIO at the same time, also with slow pin calls.
+ */
+static void test_ack_handover(void) {
+    tm1637_led_t *led = start(TM1637_DELAY_US);
+    mock.pin_op_ns = 500;
+    tm1637_set_number_lead_dot(led, 8888, false, 0x0F);
+    check_timing();
+
+    uint32_t pulled = 0;
+    for (uint32_t i = 0; i < mock.edge_count; i++) {
+        const mock_edge_t *e = &mock.edges[i];
+        pulled += (!e->driven && !e->dio && !e->clk && i > 0 && mock.edges[i - 1].clk);     // ACK pull-down
+    }
+    TEST_CHECK_EQ(pulled, 1 + 5 + 1);
+    free(led);
+}
+
+/**
+ * @brief A chip that does not acknowledge is counted in the NACK stat, and does not change its registers.
+ */
+static void test_nack(void) {
+    tm1637_led_t *led = start(TM1637_DELAY_US);
+    mock.absent = true;
+    tm1637_set_number(led, 1234);
+    TEST_CHECK_EQ(led->m_stats.nacks, 1 + 5 + 1);
+    TEST_CHECK(!mock.display_on);
+    check_timing();
+    free(led);
+}
+
+/**
+ * @brief Bus time of a redraw of all digits, written per digit (tm1637_set_segment_raw) or flushed at once, on
+ *        the simulated clock: the bit delays plus pin_op_ns per pin call. The first redraw also turns the display
+ *        on; the second one finds the brightness already sent.
+ */
+static void report_redraw(const char *path, uint8_t delay_us, int64_t pin_op_ns, bool flush) {
+    tm1637_led_t *led = start(delay_us);
+    mock.pin_op_ns = pin_op_ns;
+    for (int redraw = 0; redraw < 2; redraw++) {
+        int64_t start_ns = mock.now_ns;
+        tm1637_reset_stats(led);
+        tm1637_mock_clear();
+        if (flush) {
+            memcpy(led->m_frame, DIGITS_4999, TM1637_DIGITS);
+            tm1637_flush(led);
+        } else {
+            for (uint8_t i = 0; i < TM1637_DIGITS; i++) {
+                tm1637_set_segment_raw(led, i, DIGITS_4999[i]);
+            }
+        }
+        printf("%-9s %-10s delay %u us, %u ns/pin call: %2u transactions, %2u bytes, %3u pin calls, %6.1f us\n",
+               path, redraw ? "(steady)" : "(first)", delay_us, (unsigned)pin_op_ns, led->m_stats.transactions,
+               led->m_stats.bytes, mock.pin_calls, (mock.now_ns - start_ns) / 1000.0);
+        TEST_CHECK(memcmp(mock.digits, DIGITS_4999, TM1637_DIGITS) == 0);
+        check_timing();
+    }
+    free(led);
+}
+
+int main(void) {
+    test_timing();
+    test_ack_handover();
+    test_nack();
+
+    static const uint8_t DELAYS_US[] = {TM1637_DELAY_US, TM1637_DELAY_MIN_US};
+    for (size_t d = 0; d < sizeof(DELAYS_US); d++) {
+        report_redraw("per-digit", DELAYS_US[d], 0, false);
+        report_redraw("flush", DELAYS_US[d], 0, true);
+    }
+    return TEST_RESULT();
+}
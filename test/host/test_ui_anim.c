@@ -0,0 +1,209 @@
+/**
+ * @file    test_ui_anim.c
+ * @brief   Host tests of the keyframe animation engine on a simulated clock: times at which the animation timer
+ *          fires for each animation, the frames shown at those times, and timers firing late
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "test_util.h"
+#include "ui_anim.h"
+
+#define START_MS 1000       // Time the content is posted
+#define MAX_FIRES 32        // Timer firings recorded
+
+static const uint8_t CONTENT[UI_DIGITS] = {0x3F, 0x06, 0x5B, 0x4F};
+
+/* Timer firings recorded by the simulated animation timer */
+typedef struct {
+    int64_t at_ms[MAX_FIRES];
+    uint8_t segments[MAX_FIRES][UI_DIGITS];
+    uint8_t brightness[MAX_FIRES];
+    int count;
+} fires_t;
+
+static void play(ui_anim_player_t *p, const ui_anim_t *transition, const ui_anim_t *anim) {
+    ui_anim_content_t content = {.brightness = 7, .transition = transition, .anim = anim};
+
+    memcpy(content.segments, CONTENT, UI_DIGITS);
+    ui_anim_init(p);
+    ui_anim_play(p, &content, START_MS);
+}
+
+/**
+ * @brief Fire the timer at each next keyframe, late_ms after it, as the animation timer callback does, until
+ *        the frame stays the same or max firings have been recorded (the one at START_MS included).
+ */
+static void run(const ui_anim_player_t *p, int max, int64_t late_ms, fires_t *f) {
+    int64_t now_ms = START_MS;
+
+    memset(f, 0, sizeof(*f));
+    while (f->count < max && f->count < MAX_FIRES) {
+        f->at_ms[f->count] = now_ms;
+        ui_anim_render(p, now_ms, f->segments[f->count], &f->brightness[f->count]);
+        f->count++;
+        int64_t next_ms = ui_anim_next_ms(p, now_ms);
+        if (next_ms < 0) {
+            break;
+        }
+        TEST_REQUIRE(next_ms > now_ms);
+        now_ms = next_ms + late_ms;
+    }
+}
+
+static void check_times(const fires_t *f, const int64_t *expected, int count) {
+    TEST_CHECK_EQ(f->count, count);
+    for (int i = 0; i < count && i < f->count; i++) {
+        TEST_CHECK_EQ(f->at_ms[i], expected[i]);
+    }
+}
+
+/**
+ * @brief The startup fade steps up one brightness level every UI_STARTUP_STEP_MS, then the content stays.
+ */
+static void test_fade_in(void) {
+    ui_anim_player_t p;
+    fires_t f;
+    int64_t expected[8];
+
+    for (int i = 0; i < 8; i++) {
+        expected[i] = START_MS + i * UI_STARTUP_STEP_MS;
+    }
+    play(&p, &ui_anim_fade_in, NULL);
+    run(&p, MAX_FIRES, 0, &f);
+    check_times(&f, expected, 8);
+    for (int i = 0; i < f.count; i++) {
+        TEST_CHECK_EQ(f.brightness[i], (i < 7) ? i : 7);
+        TEST_CHECK(memcmp(f.segments[i], CONTENT, UI_DIGITS) == 0);
+    }
+    TEST_CHECK(ui_anim_busy(&p, START_MS + 7 * UI_STARTUP_STEP_MS - 1));
+    TEST_CHECK(!ui_anim_busy(&p, START_MS + 7 * UI_STARTUP_STEP_MS));
+}
+
+/**
+ * @brief A message slides in one digit every UI_ANIM_STEP_MS, then the spinner shows it for UI_SPINNER_HOLD_MS
+ *        and laps the display one segment every UI_ANIM_STEP_MS, over and over.
+ */
+static void test_slide_in_spinner(void) {
+    static const uint8_t LAP[][UI_DIGITS] = {
+        {0x01, 0, 0, 0}, {0, 0x01, 0, 0}, {0, 0, 0x01, 0}, {0, 0, 0, 0x01}, {0, 0, 0, 0x02}, {0, 0, 0, 0x04},
+        {0, 0, 0, 0x08}, {0, 0, 0x08, 0}, {0, 0x08, 0, 0}, {0x08, 0, 0, 0}, {0x10, 0, 0, 0}, {0x20, 0, 0, 0},
+    };
+    const int64_t lap_ms = UI_SPINNER_HOLD_MS + 12 * UI_ANIM_STEP_MS;
+    const int64_t spin_ms = START_MS + 3 * UI_ANIM_STEP_MS;     // End of the slide
+    ui_anim_player_t p;
+    fires_t f;
+    int64_t expected[3 + 2 * 13 + 1];
+    int n = 0;
+
+    for (int i = 0; i < 3; i++) {
+        expected[n++] = START_MS + i * UI_ANIM_STEP_MS;
+    }
+    for (int lap = 0; lap < 2; lap++) {
+        expected[n++] = spin_ms + lap * lap_ms;
+        for (int step = 0; step < 12; step++) {
+            expected[n++] = spin_ms + lap * lap_ms + UI_SPINNER_HOLD_MS + step * UI_ANIM_STEP_MS;
+        }
+    }
+    expected[n++] = spin_ms + 2 * lap_ms;
+
+    play(&p, &ui_anim_slide_in, &ui_anim_spinner);
+    run(&p, n, 0, &f);
+    check_times(&f, expected, n);
+
+    TEST_CHECK(memcmp(f.segments[0], ((const uint8_t[]){0, 0, 0, 0x3F}), UI_DIGITS) == 0);
+    TEST_CHECK(memcmp(f.segments[1], ((const uint8_t[]){0, 0, 0x3F, 0x06}), UI_DIGITS) == 0);
+    TEST_CHECK(memcmp(f.segments[2], ((const uint8_t[]){0, 0x3F, 0x06, 0x5B}), UI_DIGITS) == 0);
+    TEST_CHECK(memcmp(f.segments[3], CONTENT, UI_DIGITS) == 0);
+    for (int step = 0; step < 12; step++) {
+        TEST_CHECK(memcmp(f.segments[4 + step], LAP[step], UI_DIGITS) == 0);
+    }
+    TEST_CHECK(memcmp(f.segments[16], CONTENT, UI_DIGITS) == 0);
+}
+
+/**
+ * @brief A new value morphs for UI_ANIM_STEP_MS, then its dots blink every UI_BLINK_PERIOD_MS.
+ */
+static void test_morph_blink_dots(void) {
+    ui_anim_player_t p;
+    ui_anim_content_t content = {.brightness = 7, .transition = &ui_anim_morph, .anim = &ui_anim_blink_dots};
+    fires_t f;
+    int64_t expected[6] = {START_MS, START_MS + UI_ANIM_STEP_MS};
+
+    for (int i = 2; i < 6; i++) {
+        expected[i] = expected[i - 1] + UI_BLINK_PERIOD_MS;
+    }
+    ui_anim_init(&p);
+    memset(content.segments, 0x06, UI_DIGITS);          // 1111
+    ui_anim_play(&p, &content, 0);
+    memcpy(content.segments, CONTENT, UI_DIGITS);
+    for (int i = 0; i < UI_DIGITS; i++) {
+        content.segments[i] |= 0x80;
+    }
+    ui_anim_play(&p, &content, START_MS);
+    run(&p, 6, 0, &f);
+    check_times(&f, expected, 6);
+
+    for (int i = 0; i < UI_DIGITS; i++) {
+        TEST_CHECK_EQ(f.segments[0][i], content.segments[i] & 0x06);     // Segments common to both
+        TEST_CHECK_EQ(f.segments[1][i], content.segments[i]);
+        TEST_CHECK_EQ(f.segments[2][i], content.segments[i] & 0x7F);
+        TEST_CHECK_EQ(f.segments[3][i], content.segments[i]);
+    }
+
+    /* The same value posted again keeps the blink timeline */
+    ui_anim_play(&p, &content, START_MS + 1500);
+    TEST_CHECK_EQ(ui_anim_next_ms(&p, START_MS + 1500), START_MS + UI_ANIM_STEP_MS + 2 * UI_BLINK_PERIOD_MS);
+}
+
+/**
+ * @brief A whole-display blink without a transition, and static content (the timer is not re-armed).
+ */
+static void test_blink_and_static(void) {
+    ui_anim_player_t p;
+    fires_t f;
+    int64_t expected[5];
+
+    for (int i = 0; i < 5; i++) {
+        expected[i] = START_MS + i * UI_BLINK_PERIOD_MS;
+    }
+    play(&p, NULL, &ui_anim_blink);
+    run(&p, 5, 0, &f);
+    check_times(&f, expected, 5);
+    TEST_CHECK(memcmp(f.segments[1], ((const uint8_t[]){0, 0, 0, 0}), UI_DIGITS) == 0);
+    TEST_CHECK(memcmp(f.segments[2], CONTENT, UI_DIGITS) == 0);
+
+    play(&p, NULL, NULL);
+    TEST_CHECK_EQ(ui_anim_next_ms(&p, START_MS), -1);
+    TEST_CHECK(!ui_anim_busy(&p, START_MS));
+}
+
+/**
+ * @brief A timer firing late does not push the following keyframes back: each one stays on the timeline of
+ *        the content.
+ */
+static void test_late_timer(void) {
+    ui_anim_player_t p;
+    fires_t f;
+
+    play(&p, &ui_anim_fade_in, &ui_anim_blink);
+    run(&p, 12, 7, &f);
+    TEST_CHECK_EQ(f.count, 12);
+    for (int i = 1; i < 8; i++) {
+        TEST_CHECK_EQ(f.at_ms[i], START_MS + i * UI_STARTUP_STEP_MS + 7);
+        TEST_CHECK_EQ(f.brightness[i], (i < 7) ? i : 7);
+    }
+    for (int i = 8; i < 12; i++) {
+        TEST_CHECK_EQ(f.at_ms[i], START_MS + 7 * UI_STARTUP_STEP_MS + (i - 7) * UI_BLINK_PERIOD_MS + 7);
+    }
+}
+
+int main(void) {
+    test_fade_in();
+    test_slide_in_spinner();
+    test_morph_blink_dots();
+    test_blink_and_static();
+    test_late_timer();
+    return TEST_RESULT();
+}
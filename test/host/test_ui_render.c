@@ -0,0 +1,167 @@
+/**
+ * @file    test_ui_render.c
+ * @brief   Host tests of the display diffing against a recording pin backend: bus transactions of full, partial,
+ *          unchanged and brightness-only frames, and the full resend after a byte is not acknowledged
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include <string.h>
+
+#include "test_util.h"
+#include "tm1637_mock.h"
+#include "ui_render.h"
+
+static tm1637_led_t *led;
+static ui_render_t shown;
+
+/**
+ * @brief Check the recorded transaction against the expected bytes.
+ */
+static void check_transaction(uint32_t index, const uint8_t *bytes, uint8_t count) {
+    TEST_REQUIRE(index < mock.transaction_count);
+    const mock_transaction_t *t = &mock.transactions[index];
+    TEST_CHECK_EQ(t->count, count);
+    TEST_CHECK(t->acked);
+    for (uint8_t i = 0; i < count && i < t->count; i++) {
+        TEST_CHECK_EQ(t->bytes[i], bytes[i]);
+    }
+}
+
+/**
+ * @brief The chip registers hold the frame, and the bus had no protocol error.
+ */
+static void check_chip(const uint8_t frame[TM1637_DIGITS], uint8_t brightness) {
+    TEST_CHECK(memcmp(mock.digits, frame, TM1637_DIGITS) == 0);
+    TEST_CHECK(mock.display_on);
+    TEST_CHECK_EQ(mock.brightness, brightness);
+    TEST_CHECK_EQ(mock.protocol_errors, 0);
+    TEST_CHECK_EQ(mock.contention, 0);
+}
+
+static uint8_t render(const uint8_t frame[TM1637_DIGITS], uint8_t brightness) {
+    tm1637_mock_clear();
+    tm1637_set_brightness(led, brightness);
+    return ui_render(&shown, led, frame);
+}
+
+static void start(void) {
+    tm1637_mock_init();
+    led = tm1637_init_pins(MOCK_PIN_CLK, MOCK_PIN_DIO, &tm1637_pins_mock);
+    TEST_REQUIRE(led != NULL);
+    ui_render_init(&shown);
+}
+
+/**
+ * @brief The first frame is sent in full with the brightness; then an unchanged frame causes no edge at all,
+ *        changed digits are written as one span, and a changed brightness alone sends only the display control.
+ */
+static void test_diffing(void) {
+    const uint8_t frame1[] = {0x06, 0x5B, 0x4F, 0x66};
+    const uint8_t frame2[] = {0x06, 0x5B, 0x7F, 0x66};
+    const uint8_t frame3[] = {0x06, 0x3F, 0x7F, 0x6F};
+
+    start();
+    TEST_CHECK_EQ(render(frame1, 7), TM1637_DIGITS);
+    TEST_CHECK_EQ(mock.transaction_count, 3);
+    check_transaction(0, (const uint8_t[]){0x40}, 1);
+    check_transaction(1, (const uint8_t[]){0xC0, 0x06, 0x5B, 0x4F, 0x66}, 5);
+    check_transaction(2, (const uint8_t[]){0x8F}, 1);
+    check_chip(frame1, 7);
+
+    TEST_CHECK_EQ(render(frame1, 7), 0);
+    TEST_CHECK_EQ(mock.edge_count, 0);
+
+    TEST_CHECK_EQ(render(frame2, 7), 1);
+    TEST_CHECK_EQ(mock.transaction_count, 2);
+    check_transaction(0, (const uint8_t[]){0x40}, 1);
+    check_transaction(1, (const uint8_t[]){0xC2, 0x7F}, 2);
+    check_chip(frame2, 7);
+
+    TEST_CHECK_EQ(render(frame3, 7), 3);
+    TEST_CHECK_EQ(mock.transaction_count, 2);
+    check_transaction(1, (const uint8_t[]){0xC1, 0x3F, 0x7F, 0x6F}, 4);
+    check_chip(frame3, 7);
+
+    TEST_CHECK_EQ(render(frame3, 3), 0);
+    TEST_CHECK_EQ(mock.transaction_count, 1);
+    check_transaction(0, (const uint8_t[]){0x8B}, 1);
+    check_chip(frame3, 3);
+}
+
+/**
+ * @brief A digit byte not acknowledged: the next frame, even unchanged, is sent in full.
+ */
+static void test_nack_digit(void) {
+    const uint8_t frame1[] = {0x06, 0x5B, 0x4F, 0x66};
+    const uint8_t frame2[] = {0x3F, 0x5B, 0x4F, 0x66};
+
+    start();
+    render(frame1, 7);
+    mock.nack_byte = mock.byte_count + 2;   // Data command, address, then the digit
+    TEST_CHECK_EQ(render(frame2, 7), 1);
+    TEST_CHECK(!mock.transactions[1].acked);
+    TEST_CHECK(!shown.valid);
+    TEST_CHECK_EQ(mock.digits[0], 0x06);    // Dropped by the chip
+
+    TEST_CHECK_EQ(render(frame2, 7), TM1637_DIGITS);
+    TEST_CHECK_EQ(mock.transaction_count, 2);
+    check_transaction(1, (const uint8_t[]){0xC0, 0x3F, 0x5B, 0x4F, 0x66}, 5);
+    check_chip(frame2, 7);
+    TEST_CHECK(shown.valid);
+    TEST_CHECK_EQ(render(frame2, 7), 0);
+}
+
+/**
+ * @brief The display control byte not acknowledged: the next frame sends the digits and the brightness again.
+ */
+static void test_nack_brightness(void) {
+    const uint8_t frame[] = {0x06, 0x5B, 0x4F, 0x66};
+
+    start();
+    render(frame, 7);
+    mock.nack_byte = mock.byte_count;
+    TEST_CHECK_EQ(render(frame, 2), 0);
+    TEST_CHECK_EQ(mock.transaction_count, 1);
+    TEST_CHECK(!mock.transactions[0].acked);
+    TEST_CHECK_EQ(mock.brightness, 7);
+
+    TEST_CHECK_EQ(render(frame, 2), TM1637_DIGITS);
+    TEST_CHECK_EQ(mock.transaction_count, 3);
+    check_transaction(1, (const uint8_t[]){0xC0, 0x06, 0x5B, 0x4F, 0x66}, 5);
+    check_transaction(2, (const uint8_t[]){0x8A}, 1);
+    check_chip(frame, 2);
+}
+
+/**
+ * @brief A module unplugged and plugged in again (it powers up blank and off) is redrawn in full, with the
+ *        brightness, once a write has gone unacknowledged.
+ */
+static void test_reconnect(void) {
+    const uint8_t frame1[] = {0x06, 0x5B, 0x4F, 0x66};
+    const uint8_t frame2[] = {0x06, 0x5B, 0x4F, 0x6F};
+
+    start();
+    render(frame1, 7);
+    mock.absent = true;
+    TEST_CHECK_EQ(render(frame2, 7), 1);
+    TEST_CHECK(!shown.valid);
+    for (int i = 0; i < 3; i++) {
+        TEST_CHECK_EQ(render(frame2, 7), TM1637_DIGITS);
+        TEST_CHECK_EQ(mock.transaction_count, 3);   // The brightness is retried too
+    }
+
+    mock.absent = false;
+    memset(mock.digits, 0, sizeof(mock.digits));
+    mock.display_on = false;
+    TEST_CHECK_EQ(render(frame2, 7), TM1637_DIGITS);
+    check_chip(frame2, 7);
+    TEST_CHECK(shown.valid);
+}
+
+int main(void) {
+    test_diffing();
+    test_nack_digit();
+    test_nack_brightness();
+    test_reconnect();
+    return TEST_RESULT();
+}
@@ -0,0 +1,39 @@
+/**
+ * @file    test_util.h
+ * @brief   Minimal assertions for the host tests (a failed check is reported and the test exits non-zero)
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+#define TEST_CHECK(cond)                                                        \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+#define TEST_CHECK_EQ(a, b)                                                     \
+    do {                                                                        \
+        long long _a = (long long)(a), _b = (long long)(b);                     \
+        if (_a != _b) {                                                         \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #a, _a, _b); \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+#define TEST_REQUIRE(cond)                                                      \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: required check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+#define TEST_RESULT() (test_failures == 0 ? 0 : (fprintf(stderr, "%d check(s) failed\n", test_failures), 1))
@@ -0,0 +1,240 @@
+/**
+ * @file    tm1637_mock.c
+ * @brief   Recording pin backend for the tm1637 driver with an emulated chip on the bus
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#include "tm1637_mock.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "esp32/rom/ets_sys.h"
+
+tm1637_mock_t mock;
+
+/* Bus lines and the state of the chip between edges */
+static struct {
+    uint8_t clk;
+    uint8_t mcu_level;              // DIO level output by the MCU
+    bool driven;                    // DIO output enabled
+    bool pull;                      // Chip pulling DIO low (ACK)
+    uint8_t line;                   // DIO line level
+    bool active;                    // Between a start and a stop condition
+    bool ack;                       // Between the falling edges of the ACK clock
+    bool ignore;                    // A byte of the transaction was not acknowledged
+    uint8_t bits;                   // Bits of the current byte clocked in
+    uint8_t byte;                   // Current byte (LSB first)
+    mock_transaction_t current;
+    int64_t clk_edge_ns;            // Last edge of CLK within the transaction (-1: none yet)
+    int64_t clk_rise_ns;            // Last rising edge of CLK within the transaction (-1: none yet)
+    int64_t dio_edge_ns;            // Last DIO change by the MCU within the transaction (-1: none yet)
+} bus;
+
+void ets_delay_us(uint32_t us) {
+    mock.now_ns += (int64_t)us * 1000;
+}
+
+static void mock_apply(const mock_transaction_t *t) {
+    uint8_t command = t->bytes[0];
+
+    if ((command & 0xC0) == 0x40) {             // Data command
+        mock.auto_increment = !(command & 0x04);
+    } else if ((command & 0xC0) == 0xC0) {      // Address command followed by the digits
+        uint8_t address = command & 0x07;
+        for (uint8_t i = 1; i < t->count && i < MOCK_MAX_BYTES; i++) {
+            if (address < MOCK_CHIP_DIGITS) {
+                mock.digits[address] = t->bytes[i];
+            }
+            address += mock.auto_increment ? 1 : 0;
+        }
+    } else if ((command & 0xC0) == 0x80) {      // Display control
+        mock.display_on = command & 0x08;
+        mock.brightness = command & 0x07;
+    }
+}
+
+static void mock_min(int64_t *min, int64_t since_ns) {
+    if (since_ns >= 0 && mock.now_ns - since_ns < *min) {
+        *min = mock.now_ns - since_ns;
+    }
+}
+
+static void mock_record(void) {
+    if (mock.edge_count < MOCK_MAX_EDGES) {
+        mock.edges[mock.edge_count++] =
+            (mock_edge_t){.t_ns = mock.now_ns, .clk = bus.clk, .dio = bus.line, .driven = bus.driven};
+    }
+}
+
+/**
+ * @brief Update the DIO line after a change of either driver, and detect start and stop conditions.
+ */
+static void mock_update_line(void) {
+    uint8_t line = ((bus.driven ? bus.mcu_level : 1) && !bus.pull) ? 1 : 0;
+
+    if (bus.driven && bus.mcu_level && bus.pull) {
+        mock.contention++;
+    }
+    if (line == bus.line) {
+        return;
+    }
+    bus.line = line;
+    /* The chip looks for start and stop conditions only within a byte: DIO released for the ACK while CLK is
+     * still high after the 8th bit is not a stop */
+    if (bus.clk && !bus.ack && bus.bits < 8) {
+        if (!line) {                            // Start condition
+            bus.active = true;
+            bus.clk_edge_ns = -1;
+            bus.clk_rise_ns = -1;
+            bus.dio_edge_ns = mock.now_ns;
+            bus.ignore = false;
+            bus.bits = 0;
+            bus.byte = 0;
+            memset(&bus.current, 0, sizeof(bus.current));
+        } else if (bus.active) {                // Stop condition
+            bus.active = false;
+            mock.protocol_errors += (bus.bits > 1 || bus.byte != 0);     // Only the low bit clocked by the stop
+            bus.current.acked = !bus.ignore && !mock.absent;
+            if (bus.current.acked && bus.current.count > 0) {
+                mock_apply(&bus.current);
+            }
+            if (mock.transaction_count < MOCK_MAX_TRANSACTIONS) {
+                mock.transactions[mock.transaction_count++] = bus.current;
+            }
+        }
+    }
+}
+
+static void mock_clk(uint8_t level) {
+    if (level == bus.clk) {
+        return;
+    }
+    bus.clk = level;
+    if (!bus.active) {
+        return;
+    }
+    mock_min(level ? &mock.min_clk_low_ns : &mock.min_clk_high_ns, bus.clk_edge_ns);
+    bus.clk_edge_ns = mock.now_ns;
+    if (level) {
+        mock_min(&mock.min_clk_period_ns, bus.clk_rise_ns);
+        mock_min(&mock.min_setup_ns, bus.dio_edge_ns);
+        bus.clk_rise_ns = mock.now_ns;
+    }
+    if (level && !bus.ack) {                    // Bit clocked in on the rising edge
+        bus.byte |= bus.line << bus.bits;
+        bus.bits++;
+    } else if (!level && bus.bits == 8 && !bus.ack) {     // ACK from the falling edge after the 8th bit
+        bus.ack = true;
+        mock.protocol_errors += bus.driven;
+        if ((int32_t)mock.byte_count == mock.nack_byte || mock.absent) {
+            bus.ignore = true;                  // The chip drops the rest of the transaction
+        }
+        bus.pull = !bus.ignore;
+        mock_update_line();
+    } else if (!level && bus.ack) {             // to the next falling edge
+        bus.ack = false;
+        bus.pull = false;
+        if (bus.current.count < MOCK_MAX_BYTES) {
+            bus.current.bytes[bus.current.count] = bus.byte;
+        }
+        bus.current.count++;
+        mock.byte_count++;
+        bus.bits = 0;
+        bus.byte = 0;
+        mock_update_line();
+    }
+}
+
+/**
+ * @brief Measure the hold time of a DIO change by the MCU (the start and stop conditions included).
+ */
+static void mock_dio_changed(bool was_active) {
+    if (was_active || bus.active) {
+        mock_min(&mock.min_hold_ns, was_active ? bus.clk_rise_ns : -1);
+        bus.dio_edge_ns = mock.now_ns;
+    }
+}
+
+static void mock_call(void) {
+    mock.now_ns += mock.pin_op_ns;
+    mock.pin_calls++;
+}
+
+static void mock_setup(gpio_num_t pin, bool readable) {
+    mock_call();
+}
+
+static void mock_set_level(gpio_num_t pin, uint32_t level) {
+    uint8_t before_clk = bus.clk, before_line = bus.line;
+    bool was_active = bus.active;
+
+    mock_call();
+    if (pin == MOCK_PIN_CLK) {
+        mock_clk(level ? 1 : 0);
+    } else {
+        mock.protocol_errors += (bus.ack && bus.driven);
+        bus.mcu_level = level ? 1 : 0;
+        mock_update_line();
+        if (bus.line != before_line) {
+            mock_dio_changed(was_active);
+        }
+    }
+    if (bus.clk != before_clk || bus.line != before_line) {
+        mock_record();
+    }
+}
+
+static void mock_set_input(gpio_num_t pin, bool input) {
+    uint8_t before_line = bus.line;
+    bool was_active = bus.active;
+
+    mock_call();
+    if (input == !bus.driven) {
+        return;
+    }
+    bus.driven = !input;
+    mock.protocol_errors += (bus.ack && bus.driven);
+    mock_update_line();
+    if (bus.line != before_line) {
+        mock_dio_changed(was_active);
+    }
+    mock_record();
+}
+
+static int mock_get_level(gpio_num_t pin) {
+    mock_call();
+    return (pin == MOCK_PIN_CLK) ? bus.clk : bus.line;
+}
+
+const tm1637_pin_ops_t tm1637_pins_mock = {
+    .setup = mock_setup,
+    .set_level = mock_set_level,
+    .set_input = mock_set_input,
+    .get_level = mock_get_level,
+};
+
+void tm1637_mock_init(void) {
+    memset(&mock, 0, sizeof(mock));
+    memset(&bus, 0, sizeof(bus));
+    mock.nack_byte = -1;
+    mock.auto_increment = true;
+    bus.clk = 1;
+    bus.mcu_level = 1;
+    bus.driven = true;
+    bus.line = 1;
+    tm1637_mock_clear();
+}
+
+void tm1637_mock_clear(void) {
+    mock.edge_count = 0;
+    mock.transaction_count = 0;
+    mock.protocol_errors = 0;
+    mock.contention = 0;
+    mock.pin_calls = 0;
+    mock.min_clk_high_ns = INT64_MAX;
+    mock.min_clk_low_ns = INT64_MAX;
+    mock.min_clk_period_ns = INT64_MAX;
+    mock.min_setup_ns = INT64_MAX;
+    mock.min_hold_ns = INT64_MAX;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file    tm1637_mock.h
+ * @brief   Recording pin backend for the tm1637 driver with an emulated chip on the bus: records every edge of
+ *          CLK and DIO on a simulated clock, decodes the transactions and applies them to the chip registers
+ * @author  Karol Wojslaw (wojslaw.tech@gmail.com)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tm1637.h"
+
+#define MOCK_PIN_CLK 16             // CLK pin passed to the driver
+#define MOCK_PIN_DIO 17             // DIO pin passed to the driver
+#define MOCK_MAX_EDGES 4096         // Edges recorded
+#define MOCK_MAX_TRANSACTIONS 64    // Transactions recorded
+#define MOCK_MAX_BYTES 8            // Bytes recorded per transaction
+#define MOCK_CHIP_DIGITS 6          // Display registers of the chip
+
+/* Bus state after a change of CLK, of the DIO line, or of the DIO driver of the MCU */
+typedef struct {
+    int64_t t_ns;                   // Simulated time
+    uint8_t clk;                    // CLK level
+    uint8_t dio;                    // DIO line level (MCU output and chip pull-down)
+    uint8_t driven;                 // DIO driven by the MCU (0 while released for the ACK)
+} mock_edge_t;
+
+/* Start condition to stop condition */
+typedef struct {
+    uint8_t bytes[MOCK_MAX_BYTES];  // Bytes clocked in (the first MOCK_MAX_BYTES)
+    uint8_t count;                  // Bytes clocked in
+    bool acked;                     // Every byte acknowledged (the transaction was applied)
+} mock_transaction_t;
+
+typedef struct {
+    /* Settings, kept by tm1637_mock_clear */
+    int64_t pin_op_ns;              // Time each call of the pin backend takes
+    int32_t nack_byte;              // Byte (counted over all transactions) the chip does not acknowledge, -1: none
+    bool absent;                    // No chip on the bus: nothing is acknowledged
+
+    /* Recording */
+    int64_t now_ns;                 // Simulated clock (advanced by ets_delay_us and the pin calls)
+    mock_edge_t edges[MOCK_MAX_EDGES];
+    uint32_t edge_count;
+    mock_transaction_t transactions[MOCK_MAX_TRANSACTIONS];
+    uint32_t transaction_count;
+    uint32_t byte_count;            // Bytes clocked in over all transactions
+    uint32_t protocol_errors;       // Partial bytes, DIO driven by the MCU during an ACK
+    uint32_t contention;            // Edges with the MCU driving DIO high while the chip pulls it low
+    uint32_t pin_calls;             // Calls of the pin backend
+
+    /* Shortest timings within transactions (INT64_MAX until measured) */
+    int64_t min_clk_high_ns;        // CLK pulse width, high
+    int64_t min_clk_low_ns;         // CLK pulse width, low
+    int64_t min_clk_period_ns;      // Between rising edges of CLK
+    int64_t min_setup_ns;           // DIO change by the MCU to the next rising edge of CLK
+    int64_t min_hold_ns;            // Rising edge of CLK to the next DIO change by the MCU
+
+    /* Chip registers */
+    uint8_t digits[MOCK_CHIP_DIGITS];
+    bool display_on;
+    uint8_t brightness;
+    bool auto_increment;
+} tm1637_mock_t;
+
+extern tm1637_mock_t mock;
+extern const tm1637_pin_ops_t tm1637_pins_mock;
+
+/**
+ * @brief Power up the emulated chip (registers cleared, display off) and clear the recording and settings.
+ */
+void tm1637_mock_init(void);
+
+/**
+ * @brief Clear the recording (edges, transactions, error counts, timings), keeping the settings and chip registers.
+ */
+void tm1637_mock_clear(void);